@@ -0,0 +1,128 @@
+#include "DisplayLabel.h"
+
+DisplayLabel *DisplayLabel::_labels = NULL;
+
+DisplayLabel::DisplayLabel(DisplayRefresh &refresh, const char *name, int x,
+                           int y, const GUI_FONT *font, GUI_COLOR color,
+                           GUI_COLOR bkColor)
+    : _refresh(refresh), _name(name), _x(x), _y(y), _font(font), _color(color),
+      _bkColor(bkColor), _length(0), _glyphsDrawn(0), _clears(0),
+      _next(_labels) {
+  _text[0] = '\0';
+  _glyphX[0] = x;
+  _labels = this;
+}
+
+DisplayLabel::~DisplayLabel() {
+  for (DisplayLabel **label = &_labels; *label; label = &(*label)->_next) {
+    if (*label == this) {
+      *label = _next;
+      break;
+    }
+  }
+}
+
+// Glyphs before the first one that changed keep their text and their
+// position, so they need no drawing. Every cell from there up to the end of
+// the old or the new text, whichever is longer, is invalidated; the refresh
+// clears it and draws the new glyphs over it.
+void DisplayLabel::SetText(const char *text) {
+  uint8_t length = 0;
+  while (length < MAX_CHARS && text[length])
+    length++;
+  if (length == _length && memcmp(text, _text, length) == 0)
+    return;
+
+  uint8_t first = 0;
+  while (first < length && first < _length && text[first] == _text[first])
+    first++;
+
+  if (GUI_GetFont() != _font)
+    GUI_SetFont(_font);
+  int oldEnd = _glyphX[_length];
+  int x = _glyphX[first];
+  for (uint8_t i = first; i < length; i++) {
+    _glyphX[i] = x;
+    x += GUI_GetCharDistX((U8)text[i]);
+  }
+  _glyphX[length] = x;
+  if (oldEnd > x)
+    _clears++;
+  _refresh.Invalidate(_glyphX[first], _y, (oldEnd > x ? oldEnd : x) - 1,
+                      _y + GetHeight() - 1);
+
+  memcpy(_text, text, length);
+  _text[length] = '\0';
+  _length = length;
+}
+
+void DisplayLabel::SetColor(GUI_COLOR color) {
+  if (color == _color)
+    return;
+
+  _color = color;
+  _refresh.Invalidate(_x, _y, _glyphX[_length] - 1, _y + GetHeight() - 1);
+}
+
+void DisplayLabel::Reset() { SetText(""); }
+
+// Glyphs are drawn in normal text mode and paint their own cells; past the
+// end of the text the line is cleared, so old text and whatever the draw
+// function put under the label take the label's background.
+void DisplayLabel::Draw(const GUI_RECT &area) {
+  int y1 = _y + GetHeight() - 1;
+  if (area.y1 < _y || area.y0 > y1 || area.x1 < _x)
+    return;
+
+  Select();
+  for (uint8_t i = 0; i < _length; i++) {
+    if (_glyphX[i + 1] > area.x0 && _glyphX[i] <= area.x1) {
+      GUI_DispCharAt((U8)_text[i], _glyphX[i], _y);
+      _glyphsDrawn++;
+    }
+  }
+  int x0 = _glyphX[_length] > area.x0 ? _glyphX[_length] : area.x0;
+  if (x0 <= area.x1)
+    GUI_ClearRect(x0, area.y0 > _y ? area.y0 : _y, area.x1,
+                  area.y1 < y1 ? area.y1 : y1);
+}
+
+const char *DisplayLabel::GetName() const { return _name; }
+
+const char *DisplayLabel::GetText() const { return _text; }
+
+uint32_t DisplayLabel::GetGlyphsDrawn() const { return _glyphsDrawn; }
+
+uint32_t DisplayLabel::GetClears() const { return _clears; }
+
+DisplayLabel *DisplayLabel::Find(const char *name) {
+  for (DisplayLabel *label = _labels; label; label = label->_next) {
+    if (strcmp(label->_name, name) == 0)
+      return label;
+  }
+  return NULL;
+}
+
+void DisplayLabel::ResetAll() {
+  for (DisplayLabel *label = _labels; label; label = label->_next)
+    label->Reset();
+}
+
+void DisplayLabel::DrawAll(const GUI_RECT &area) {
+  for (DisplayLabel *label = _labels; label; label = label->_next)
+    label->Draw(area);
+}
+
+// emWin keeps one drawing context, so the label's font and colours are put
+// back only when something else changed them.
+void DisplayLabel::Select() {
+  if (GUI_GetFont() != _font)
+    GUI_SetFont(_font);
+  if (GUI_GetColor() != _color)
+    GUI_SetColor(_color);
+  if (GUI_GetBkColor() != _bkColor)
+    GUI_SetBkColor(_bkColor);
+  GUI_SetTextMode(GUI_TM_NORMAL);
+}
+
+int DisplayLabel::GetHeight() const { return GUI_GetYSizeOfFont(_font); }
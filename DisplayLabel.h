@@ -0,0 +1,68 @@
+#ifndef DISPLAYLABEL_H
+#define DISPLAYLABEL_H
+
+#include "mbed.h"
+#include "GUI.h"
+#include "DisplayRefresh.h"
+
+// A named line of text kept on the display, with its own position, font and
+// colours. SetText compares the new text with the old glyph by glyph and
+// invalidates only the span from the first glyph that changed to the end of
+// the longer text; the refresh then draws the glyphs that fall in its area.
+// Text that did not change invalidates nothing. Left aligned, one line, at
+// most MAX_CHARS glyphs. A label owns its line from x to the right edge of
+// the display and paints all of it in its background colour.
+//
+//     DisplayLabel status(refresh, "status", 0, 40, GUI_FONT_16B_1, GUI_WHITE);
+//     status.SetText("Waiting for card...");
+//     refresh.Flush();
+class DisplayLabel {
+public:
+    static const uint8_t MAX_CHARS = 40;
+
+    DisplayLabel(DisplayRefresh &refresh, const char *name, int x, int y, const GUI_FONT *font, GUI_COLOR color, GUI_COLOR bkColor = GUI_BLACK);
+    ~DisplayLabel();
+
+    void SetText(const char *text);
+    // Invalidates the whole text, to be drawn in the new colour.
+    void SetColor(GUI_COLOR color);
+    // Empties the label.
+    void Reset();
+    // Draws the glyphs that fall in area and clears the rest of the label's
+    // line in it, for the refresh's draw function.
+    void Draw(const GUI_RECT &area);
+
+    const char *GetName() const;
+    const char *GetText() const;
+    // Glyphs drawn, and updates that left old text to clear past the end of
+    // the new one, since construction.
+    uint32_t GetGlyphsDrawn() const;
+    uint32_t GetClears() const;
+
+    static DisplayLabel *Find(const char *name);
+    static void ResetAll();
+    static void DrawAll(const GUI_RECT &area);
+
+private:
+    void Select();
+    int GetHeight() const;
+
+    DisplayRefresh &_refresh;
+    const char *_name;
+    int _x;
+    int _y;
+    const GUI_FONT *_font;
+    GUI_COLOR _color;
+    GUI_COLOR _bkColor;
+
+    char _text[MAX_CHARS + 1];
+    uint8_t _length;
+    int _glyphX[MAX_CHARS + 1];         // left edge of each glyph, then the end
+    uint32_t _glyphsDrawn;
+    uint32_t _clears;
+
+    DisplayLabel *_next;
+    static DisplayLabel *_labels;
+};
+
+#endif
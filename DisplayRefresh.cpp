@@ -0,0 +1,172 @@
+#include "DisplayRefresh.h"
+
+namespace {
+
+// Memory devices on the GUICC_M565 display hold two bytes per pixel.
+const uint32_t BYTES_PER_PIXEL = 2;
+
+} // namespace
+
+DisplayRefresh::DisplayRefresh(DrawFunction draw, uint32_t bandBytes)
+    : _draw(draw), _bandBytes(bandBytes), _count(0), _flushes(0),
+      _rectsFlushed(0), _bands(0), _direct(0), _pixels(0), _poolPeak(0) {}
+
+void DisplayRefresh::Invalidate(int x0, int y0, int x1, int y1) {
+  GUI_RECT rect;
+  rect.x0 = x0 < 0 ? 0 : x0;
+  rect.y0 = y0 < 0 ? 0 : y0;
+  rect.x1 = x1 < LCD_GetXSize() ? x1 : LCD_GetXSize() - 1;
+  rect.y1 = y1 < LCD_GetYSize() ? y1 : LCD_GetYSize() - 1;
+  if (rect.x1 < rect.x0 || rect.y1 < rect.y0)
+    return;
+
+  Add(rect);
+}
+
+void DisplayRefresh::InvalidateAll() {
+  _count = 0;
+  Invalidate(0, 0, LCD_GetXSize() - 1, LCD_GetYSize() - 1);
+}
+
+void DisplayRefresh::Flush() {
+  if (_count == 0)
+    return;
+
+  for (uint8_t i = 0; i < _count; i++)
+    Render(_rects[i]);
+  _flushes++;
+  _rectsFlushed += _count;
+  _count = 0;
+}
+
+void DisplayRefresh::SetBandBytes(uint32_t bandBytes) { _bandBytes = bandBytes; }
+
+uint32_t DisplayRefresh::GetBandBytes() const { return _bandBytes; }
+
+uint32_t DisplayRefresh::GetFlushes() const { return _flushes; }
+
+uint32_t DisplayRefresh::GetRects() const { return _rectsFlushed; }
+
+uint32_t DisplayRefresh::GetBands() const { return _bands; }
+
+uint32_t DisplayRefresh::GetDirect() const { return _direct; }
+
+uint32_t DisplayRefresh::GetPixels() const { return _pixels; }
+
+uint32_t DisplayRefresh::GetPoolPeak() const { return _poolPeak; }
+
+uint32_t DisplayRefresh::GetPoolSize() const {
+  return (uint32_t)(GUI_ALLOC_GetNumUsedBytes() + GUI_ALLOC_GetNumFreeBytes());
+}
+
+// A merged rectangle can reach others it did not touch before, so the scan
+// starts again after each merge. With the list full the new rectangle goes
+// into the one it grows least.
+void DisplayRefresh::Add(GUI_RECT rect) {
+  for (uint8_t i = 0; i < _count;) {
+    GUI_RECT merged = Union(rect, _rects[i]);
+    if (Overlaps(rect, _rects[i]) ||
+        Area(merged) <= Area(rect) + Area(_rects[i]) + MergeSlack()) {
+      rect = merged;
+      Remove(i);
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+
+  if (_count == MAX_RECTS) {
+    uint8_t best = 0;
+    uint32_t bestGrowth = UINT32_MAX;
+    for (uint8_t i = 0; i < _count; i++) {
+      uint32_t growth = Area(Union(rect, _rects[i])) - Area(_rects[i]);
+      if (growth < bestGrowth) {
+        best = i;
+        bestGrowth = growth;
+      }
+    }
+    rect = Union(rect, _rects[best]);
+    Remove(best);
+    Add(rect);
+    return;
+  }
+
+  _rects[_count++] = rect;
+}
+
+void DisplayRefresh::Remove(uint8_t index) {
+  _rects[index] = _rects[--_count];
+}
+
+// Bands are as tall as the budget allows for the rectangle's width, at least
+// one line. If the pool cannot supply a band, for instance because it is
+// fragmented, the band is halved, and a single line that still does not fit
+// is drawn directly.
+void DisplayRefresh::Render(const GUI_RECT &rect) {
+  int width = rect.x1 - rect.x0 + 1;
+  if (_bandBytes == 0) {
+    DrawDirect(rect);
+    _pixels += Area(rect);
+    return;
+  }
+
+  int lines = _bandBytes / (width * BYTES_PER_PIXEL);
+  if (lines < 1)
+    lines = 1;
+
+  for (int y = rect.y0; y <= rect.y1;) {
+    int height = rect.y1 - y + 1 < lines ? rect.y1 - y + 1 : lines;
+    GUI_RECT area = {rect.x0, (I16)y, rect.x1, (I16)(y + height - 1)};
+    GUI_MEMDEV_Handle band =
+        GUI_MEMDEV_CreateEx(rect.x0, y, width, height, GUI_MEMDEV_NOTRANS);
+    if (band) {
+      SamplePool();
+      GUI_MEMDEV_Handle previous = GUI_MEMDEV_Select(band);
+      _draw(area);
+      GUI_MEMDEV_Select(previous);
+      GUI_MEMDEV_CopyToLCD(band);
+      GUI_MEMDEV_Delete(band);
+      _bands++;
+    } else if (height > 1) {
+      lines = height / 2;
+      continue;
+    } else {
+      DrawDirect(area);
+      _direct++;
+    }
+    _pixels += Area(area);
+    y += height;
+  }
+}
+
+void DisplayRefresh::DrawDirect(const GUI_RECT &area) {
+  const GUI_RECT *previous = GUI_SetClipRect(&area);
+  _draw(area);
+  GUI_SetClipRect(previous);
+  _bands++;
+}
+
+void DisplayRefresh::SamplePool() {
+  uint32_t used = (uint32_t)GUI_ALLOC_GetNumUsedBytes();
+  if (used > _poolPeak)
+    _poolPeak = used;
+}
+
+uint32_t DisplayRefresh::MergeSlack() { return (uint32_t)LCD_GetXSize(); }
+
+uint32_t DisplayRefresh::Area(const GUI_RECT &rect) {
+  return (uint32_t)(rect.x1 - rect.x0 + 1) * (uint32_t)(rect.y1 - rect.y0 + 1);
+}
+
+GUI_RECT DisplayRefresh::Union(const GUI_RECT &a, const GUI_RECT &b) {
+  GUI_RECT rect;
+  rect.x0 = a.x0 < b.x0 ? a.x0 : b.x0;
+  rect.y0 = a.y0 < b.y0 ? a.y0 : b.y0;
+  rect.x1 = a.x1 > b.x1 ? a.x1 : b.x1;
+  rect.y1 = a.y1 > b.y1 ? a.y1 : b.y1;
+  return rect;
+}
+
+bool DisplayRefresh::Overlaps(const GUI_RECT &a, const GUI_RECT &b) {
+  return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
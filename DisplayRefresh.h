@@ -0,0 +1,78 @@
+#ifndef DISPLAYREFRESH_H
+#define DISPLAYREFRESH_H
+
+#include "mbed.h"
+#include "GUI.h"
+
+// Collects the areas of the display that need drawing again and redraws
+// them off screen. Invalidate adds a rectangle; rectangles that overlap, or
+// whose bounding box wastes at most one line of the display, are merged. Flush
+// renders each rectangle in bands: a memory device of at most bandBytes is
+// taken from the emWin pool, the draw function fills it, and it is copied to
+// the panel in one piece, so nothing is seen half drawn and no pixel is sent
+// twice. A larger budget means fewer, taller bands and fewer draw passes;
+// bandBytes 0, or a pool too full for a one-line band, draws straight to the
+// panel inside a clip rectangle.
+//
+//     void Draw(const GUI_RECT &area) { GUI_ClearRect(...); ... }
+//     DisplayRefresh refresh(Draw, 10240);
+//     refresh.Invalidate(0, 40, 319, 55);
+//     refresh.Flush();
+class DisplayRefresh {
+public:
+    typedef void (*DrawFunction)(const GUI_RECT &area);
+
+    static const uint8_t MAX_RECTS = 8;
+
+    // Flush calls draw with a GUI_MEMDEV or the display selected and must
+    // paint every pixel of area, background included.
+    DisplayRefresh(DrawFunction draw, uint32_t bandBytes);
+
+    void Invalidate(int x0, int y0, int x1, int y1);
+    void InvalidateAll();
+    void Flush();
+
+    void SetBandBytes(uint32_t bandBytes);
+    uint32_t GetBandBytes() const;
+
+    // Counts since construction. Bands counts every draw pass, direct ones
+    // included; GetDirect counts those that found no room in the pool.
+    uint32_t GetFlushes() const;
+    uint32_t GetRects() const;
+    uint32_t GetBands() const;
+    uint32_t GetDirect() const;
+    uint32_t GetPixels() const;
+    // The most emWin pool bytes in use, sampled while each band is held, and
+    // the size of the pool. Size the budget so the peak stays under it.
+    uint32_t GetPoolPeak() const;
+    uint32_t GetPoolSize() const;
+
+private:
+    void Add(GUI_RECT rect);
+    void Remove(uint8_t index);
+    void Render(const GUI_RECT &rect);
+    void DrawDirect(const GUI_RECT &area);
+    void SamplePool();
+
+    // A separate rectangle costs a window setup and a full draw pass, which
+    // is worth about one line of pixels.
+    static uint32_t MergeSlack();
+    static uint32_t Area(const GUI_RECT &rect);
+    static GUI_RECT Union(const GUI_RECT &a, const GUI_RECT &b);
+    static bool Overlaps(const GUI_RECT &a, const GUI_RECT &b);
+
+    DrawFunction _draw;
+    uint32_t _bandBytes;
+
+    GUI_RECT _rects[MAX_RECTS];
+    uint8_t _count;
+
+    uint32_t _flushes;
+    uint32_t _rectsFlushed;
+    uint32_t _bands;
+    uint32_t _direct;
+    uint32_t _pixels;
+    uint32_t _poolPeak;
+};
+
+#endif
@@ -51,9 +51,14 @@ Purpose     : Display controller initialization
 **********************************************************************
 */
 //
-// Define the available number of bytes available for the GUI
+// Define the available number of bytes available for the GUI,
+// memory devices included. Set by emwin-pool-bytes in mbed_app.json.
 //
-#define GUI_NUMBYTES  0x8000
+#ifdef MBED_CONF_APP_EMWIN_POOL_BYTES
+  #define GUI_NUMBYTES  MBED_CONF_APP_EMWIN_POOL_BYTES
+#else
+  #define GUI_NUMBYTES  0x8000
+#endif
 
 /*********************************************************************
 *
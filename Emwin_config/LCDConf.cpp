@@ -46,6 +46,7 @@ Purpose     : Display controller configuration (single layer)
 #include "GUIDRV_FlexColor.h"
 
 #include "cy8ckit_028_tft.h"
+#include "LCDConf.h"
 
 
 /*********************************************************************
@@ -75,6 +76,19 @@ Purpose     : Display controller configuration (single layer)
 //
 #define DISPLAY_DRIVER GUIDRV_FLEXCOLOR
 
+//
+// Orientation
+//   Landscape, 320x240 logical. The ST7789 does the rotation itself:
+//   MADCTL MY, MX and MV do to the frame memory what GUI_MIRROR_Y,
+//   GUI_MIRROR_X and GUI_SWAP_XY do to emWin's coordinates, so with the
+//   matching MADCTL the controller takes logical coordinates, CASET x and
+//   RASET y. The fill and blit handlers below rely on that.
+//
+#define ORIENTATION (GUI_MIRROR_Y | GUI_SWAP_XY)
+#define MADCTL      (((ORIENTATION & GUI_MIRROR_Y) ? 0x80 : 0) \
+                   | ((ORIENTATION & GUI_MIRROR_X) ? 0x40 : 0) \
+                   | ((ORIENTATION & GUI_SWAP_XY)  ? 0x20 : 0))
+
 /*********************************************************************
 *
 *       Configuration checking
@@ -135,7 +149,7 @@ static void CY8CKIT_028_TFT_InitController(void) {
 	DisplayIntf_Write8_A0(0x11);	/* Exit Sleep mode */
 	GUI_Delay(100);
 	DisplayIntf_Write8_A0(0x36);
-	DisplayIntf_Write8_A1(0xA0);	/* MADCTL: memory data access control */
+	DisplayIntf_Write8_A1(MADCTL);	/* MADCTL: memory data access control */
 	DisplayIntf_Write8_A0(0x3A);
 	DisplayIntf_Write8_A1(0x65);	/* COLMOD: Interface Pixel format */
 	DisplayIntf_Write8_A0(0xB2);
@@ -206,6 +220,46 @@ static void CY8CKIT_028_TFT_InitController(void) {
 	DisplayIntf_Write8_A0(0x29);
 }
 
+/*********************************************************************
+*
+*       Static data
+*
+*/
+typedef void FILLRECT_FUNC(int LayerIndex, int x0, int y0, int x1, int y1, U32 PixelIndex);
+
+static FILLRECT_FUNC * _pfDriverFillRect;   // FlexColor's own fill, for XOR
+static unsigned        _Accel;              // LCDCONF_ACCEL_... in place
+
+/*********************************************************************
+*
+*       _FillRect
+*
+* Purpose:
+*   Fills a rectangle through one ST7789 address window instead of the
+*   generic FlexColor path. XOR fills need the pixels read back, so they
+*   go to the driver's own fill, saved when this one was registered.
+*/
+static void _FillRect(int LayerIndex, int x0, int y0, int x1, int y1, U32 PixelIndex) {
+  if (GUI_GetDrawMode() & GUI_DM_XOR) {
+    _pfDriverFillRect(LayerIndex, x0, y0, x1, y1, PixelIndex);
+    return;
+  }
+  DisplayIntf_FillRect(x0, y0, x1, y1, (U16)PixelIndex);
+}
+
+/*********************************************************************
+*
+*       _DrawBitmap16bpp
+*
+* Purpose:
+*   Copies a 16bpp bitmap through one ST7789 address window. emWin
+*   only calls this for bitmaps already in the display's color format.
+*/
+static void _DrawBitmap16bpp(int LayerIndex, int x, int y, U16 const * p, int xSize, int ySize, int BytesPerLine) {
+  GUI_USE_PARA(LayerIndex);
+  DisplayIntf_DrawBitmap16(x, y, xSize, ySize, p, BytesPerLine);
+}
+
 /*********************************************************************
 *
 *       Public code
@@ -236,7 +290,7 @@ void LCD_X_Config(void) {
   //
   // Orientation
   //
-  Config.Orientation   = GUI_MIRROR_Y | GUI_SWAP_XY;
+  Config.Orientation   = ORIENTATION;
   GUIDRV_FlexColor_Config(pDevice, &Config);
   //
   // Set controller and operation mode
@@ -248,6 +302,33 @@ void LCD_X_Config(void) {
   PortAPI.pfReadM8_A1  = DisplayIntf_ReadM8_A1;
   
   GUIDRV_FlexColor_SetFunc(pDevice, &PortAPI, GUIDRV_FLEXCOLOR_F66709, GUIDRV_FLEXCOLOR_M16C0B8);
+  //
+  // Accelerated fill and blit, where the driver accepts them. The fill
+  // handler needs the driver's own fill for XOR, so it is only set if the
+  // driver hands that out. A handler the driver refuses leaves its generic
+  // path in place; LCDConf_GetAccel() tells which ones took.
+  //
+  _Accel = 0;
+  _pfDriverFillRect = (FILLRECT_FUNC *)LCD_GetDevFunc(0, LCD_DEVFUNC_FILLRECT);
+  if (_pfDriverFillRect && (_pfDriverFillRect != _FillRect)) {
+    if (LCD_SetDevFunc(0, LCD_DEVFUNC_FILLRECT, (void (*)(void))_FillRect) == 0) {
+      _Accel |= LCDCONF_ACCEL_FILLRECT;
+    }
+  }
+  if (LCD_SetDevFunc(0, LCD_DEVFUNC_DRAWBMP_16BPP, (void (*)(void))_DrawBitmap16bpp) == 0) {
+    _Accel |= LCDCONF_ACCEL_DRAWBMP_16BPP;
+  }
+}
+
+/*********************************************************************
+*
+*       LCDConf_GetAccel
+*
+* Function description
+*   Returns the LCDCONF_ACCEL_... handlers LCD_X_Config put in place.
+*/
+unsigned LCDConf_GetAccel(void) {
+  return _Accel;
 }
 
 /*********************************************************************
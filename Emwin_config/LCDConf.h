@@ -45,6 +45,14 @@ Purpose     : Display driver configuration file
 #ifndef LCDCONF_H
 #define LCDCONF_H
 
+//
+// Device functions LCD_X_Config replaces with ST7789 window transfers
+//
+#define LCDCONF_ACCEL_FILLRECT       (1 << 0)
+#define LCDCONF_ACCEL_DRAWBMP_16BPP  (1 << 1)
+
+unsigned LCDConf_GetAccel(void);
+
 #endif /* LCDCONF_H */
 
 /*************************** End of file ****************************/
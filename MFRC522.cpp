@@ -1,145 +1,829 @@
 #include "MFRC522.h"
+#include "NdefParser.h"
 
-MFRC522::MFRC522(PinName mosi, PinName miso, PinName sclk, PinName cs,
-                 PinName reset)
-    : _spi(mosi, miso, sclk), _cs(cs), _reset(reset) {
-  _spi.format(8, 0);
-  _spi.frequency(1000000);
-  _cs = 1;
-  _reset = 1;
+namespace {
+
+struct CrcATable {
+  uint16_t value[256];
+};
+
+// ISO/IEC 14443-3 CRC_A: x^16 + x^12 + x^5 + 1, LSB first, preset 0x6363.
+constexpr CrcATable makeCrcATable() {
+  CrcATable table = {};
+  for (uint16_t i = 0; i < 256; i++) {
+    uint16_t crc = i;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x0001) ? (crc >> 1) ^ 0x8408 : (crc >> 1);
+    }
+    table.value[i] = crc;
+  }
+  return table;
+}
+
+constexpr CrcATable crcATable = makeCrcATable();
+
+// FIFO contents after the digital self-test, from the MFRC522 datasheet.
+const uint8_t SELF_TEST_V1_0[64] = {
+    0x00, 0xC6, 0x37, 0xD5, 0x32, 0xB7, 0x57, 0x5C, 0xC2, 0xD8, 0x7C,
+    0x4D, 0xD9, 0x70, 0xC7, 0x73, 0x10, 0xE6, 0xD2, 0xAA, 0x5E, 0xA1,
+    0x3E, 0x5A, 0x14, 0xAF, 0x30, 0x61, 0xC9, 0x70, 0xDB, 0x2E, 0x64,
+    0x22, 0x72, 0xB5, 0xBD, 0x65, 0xF4, 0xEC, 0x22, 0xBC, 0xD3, 0x72,
+    0x35, 0xCD, 0xAA, 0x41, 0x1F, 0xA7, 0xF3, 0x53, 0x14, 0xDE, 0x7E,
+    0x02, 0xD9, 0x0F, 0xB5, 0x5E, 0x25, 0x1D, 0x29, 0x79};
+
+const uint8_t SELF_TEST_V2_0[64] = {
+    0x00, 0xEB, 0x66, 0xBA, 0x57, 0xBF, 0x23, 0x95, 0xD0, 0xE3, 0x0D,
+    0x3D, 0x27, 0x89, 0x5C, 0xDE, 0x9D, 0x3B, 0xA7, 0x00, 0x21, 0x5B,
+    0x89, 0x82, 0x51, 0x3A, 0xEB, 0x02, 0x0C, 0xA5, 0x00, 0x49, 0x7C,
+    0x84, 0x4D, 0xB3, 0xCC, 0xD2, 0x1B, 0x81, 0x5D, 0x48, 0x76, 0xD5,
+    0x71, 0x61, 0x21, 0xA9, 0x86, 0x96, 0x83, 0x38, 0xCF, 0x9D, 0x5B,
+    0x6D, 0xDC, 0x15, 0xBA, 0x3E, 0x7D, 0x95, 0x3B, 0x2F};
+
+const uint8_t *selfTestReference(uint8_t version) {
+  switch (version) {
+  case 0x91:
+    return SELF_TEST_V1_0;
+  case 0x92:
+    return SELF_TEST_V2_0;
+  default:
+    return NULL;
+  }
 }
 
-void MFRC522::PCD_Init() {
-  _reset = 0;
-  wait_us(50000);
-  _reset = 1;
-  wait_us(50000);
+// Well below the limit first, then up to the 10 MHz of the datasheet.
+const uint32_t SPI_CLOCK_STEPS[] = {1000000, 2000000, 4000000,
+                                    6000000, 8000000, 10000000};
+const uint8_t SPI_CLOCK_STEP_COUNT =
+    sizeof(SPI_CLOCK_STEPS) / sizeof(SPI_CLOCK_STEPS[0]);
+
+} // namespace
+
+template <class Transport>
+MFRC522T<Transport>::MFRC522T(PinName mosi, PinName miso, PinName sclk,
+                              PinName cs, PinName reset, PinName irq)
+    : _transport(new MFRC522SpiTransport(mosi, miso, sclk, cs, reset, irq)),
+      _ownsTransport(true), _timeoutUs(0), _timerPrescaler(0),
+      _timerReload(0), _hardwareCrc(false), _shadowEnabled(true),
+      _shadowValid(0), _spiFrames(0), _spiBytes(0), _spiHz(0),
+      _asyncTransaction(NULL), _asyncFrame(0) {
+  PCD_SetTimeout(TIMEOUT_DEFAULT_US);
+  PCD_ResetShadowCounters();
+  PCD_ResetStatusCounters();
+}
+
+template <class Transport>
+MFRC522T<Transport>::MFRC522T(Transport *transport)
+    : _transport(transport), _ownsTransport(false), _timeoutUs(0),
+      _timerPrescaler(0), _timerReload(0), _hardwareCrc(false),
+      _shadowEnabled(true), _shadowValid(0), _spiFrames(0), _spiBytes(0),
+      _spiHz(0), _asyncTransaction(NULL), _asyncFrame(0) {
+  PCD_SetTimeout(TIMEOUT_DEFAULT_US);
+  PCD_ResetShadowCounters();
+  PCD_ResetStatusCounters();
+}
+
+template <class Transport>
+MFRC522T<Transport>::~MFRC522T() {
+  if (_ownsTransport)
+    delete _transport;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_Init() {
+  PCD_SetResetLine(true);
+  _transport->DelayUs(50000);
+  PCD_SetResetLine(false);
+  _transport->DelayUs(50000);
 
   PCD_Reset();
+  PCD_Configure();
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_SetResetLine(bool active) {
+  _transport->SetResetLine(active);
+}
+
+template <class Transport>
+uint64_t MFRC522T<Transport>::PCD_GetTimeUs() {
+  return _transport->GetTimeUs();
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_DelayUs(uint32_t us) { _transport->DelayUs(us); }
+
+// TAuto starts the timer when transmission ends and stops it when a response
+// starts, so TimerIRq marks a card that missed its frame waiting time. Ticks
+// are 25 us, which covers 1.6 s; longer budgets use a coarser prescaler.
+template <class Transport>
+void MFRC522T<Transport>::PCD_SetTimeout(uint32_t timeoutUs) {
+  uint64_t cycles = (uint64_t)timeoutUs * 339 / 25;
+  uint32_t prescaler = TIMER_PRESCALER;
+  if (cycles > 0x10000ULL * (2 * prescaler + 1)) {
+    prescaler = cycles / 0x10000 / 2 + 1;
+    if (prescaler > 0xFFF)
+      prescaler = 0xFFF;
+  }
+
+  uint32_t period = 2 * prescaler + 1;
+  uint64_t ticks = (cycles + period - 1) / period;
+  if (ticks == 0)
+    ticks = 1;
+  if (ticks > 0x10000)
+    ticks = 0x10000;
+
+  _timeoutUs = timeoutUs;
+  _timerPrescaler = prescaler;
+  _timerReload = ticks - 1;
+}
 
-  PCD_WriteRegister(TModeReg, 0x8D);
-  PCD_WriteRegister(TPrescalerReg, 0x3E);
-  PCD_WriteRegister(TReloadRegL, 30);
-  PCD_WriteRegister(TReloadRegH, 0);
+template <class Transport>
+uint32_t MFRC522T<Transport>::PCD_GetTimeout() const { return _timeoutUs; }
+
+// Host clock backstop for a command: the chip timer budget and the longest
+// response for every reply it waits for, plus its own frame on air.
+template <class Transport>
+uint32_t MFRC522T<Transport>::PCD_GetHostTimeout(uint8_t command,
+                                                 uint16_t sendLen) const {
+  uint8_t replies = (command == PCD_MFAuthent) ? 2 : 1;
+  return replies * (_timeoutUs + PCD_GetFrameTimeUs(FIFO_SIZE)) +
+         PCD_GetFrameTimeUs(sendLen) + HOST_TIMEOUT_MARGIN_US;
+}
+
+// At 106 kbit/s every byte is nine bits of 128 carrier cycles, plus the
+// start and end of frame.
+uint32_t MFRC522Base::PCD_GetFrameTimeUs(uint16_t bytes) {
+  return ((uint32_t)bytes * 9 + 2) * 128 * 25 / 339 + 1;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_Configure() {
+  PCD_WriteRegister(TModeReg, 0x80 | (_timerPrescaler >> 8));
+  PCD_WriteRegister(TPrescalerReg, _timerPrescaler & 0xFF);
+  PCD_WriteRegister(TReloadRegH, _timerReload >> 8);
+  PCD_WriteRegister(TReloadRegL, _timerReload & 0xFF);
   PCD_WriteRegister(TxASKReg, 0x40);
   PCD_WriteRegister(ModeReg, 0x3D);
+  PCD_WriteRegister(WaterLevelReg, STREAM_WATER_LEVEL);
+
+  // IRQ pin: push-pull, active low, every source masked until a wait arms it.
+  PCD_WriteRegister(ComIEnReg, 0x80);
+  PCD_WriteRegister(DivIEnReg, 0x80);
 
   PCD_AntennaOn();
 }
 
-void MFRC522::PCD_Reset() {
+template <class Transport>
+void MFRC522T<Transport>::PCD_Reset() {
   PCD_WriteRegister(CommandReg, PCD_SoftReset);
+  PCD_InvalidateRegisterShadow();
 
   uint8_t count = 0;
   do {
-    wait_us(50000);
+    _transport->DelayUs(50000);
   } while ((PCD_ReadRegister(CommandReg) & (1 << 4)) && (++count) < 3);
 }
 
-void MFRC522::PCD_AntennaOn() {
+template <class Transport>
+void MFRC522T<Transport>::PCD_AntennaOn() {
   uint8_t value = PCD_ReadRegister(TxControlReg);
   if ((value & 0x03) != 0x03) {
     PCD_WriteRegister(TxControlReg, value | 0x03);
   }
 }
 
-void MFRC522::PCD_AntennaOff() { PCD_ClearRegisterBitMask(TxControlReg, 0x03); }
+template <class Transport>
+void MFRC522T<Transport>::PCD_AntennaOff() {
+  PCD_ClearRegisterBitMask(TxControlReg, 0x03);
+}
 
-uint8_t MFRC522::PCD_GetAntennaGain() {
+template <class Transport>
+uint8_t MFRC522T<Transport>::PCD_GetAntennaGain() {
   return PCD_ReadRegister(RFCfgReg) & (0x07 << 4);
 }
 
-void MFRC522::PCD_SetAntennaGain(uint8_t mask) {
+template <class Transport>
+void MFRC522T<Transport>::PCD_SetAntennaGain(uint8_t mask) {
   if (PCD_GetAntennaGain() != mask) {
     PCD_ClearRegisterBitMask(RFCfgReg, (0x07 << 4));
     PCD_SetRegisterBitMask(RFCfgReg, mask & (0x07 << 4));
   }
 }
 
-void MFRC522::PCD_WriteRegister(uint8_t reg, uint8_t value) {
-  _cs = 0;
-  _spi.write((reg << 1) & 0x7E);
-  _spi.write(value);
-  _cs = 1;
+template <class Transport>
+bool MFRC522T<Transport>::PCD_PerformSelfTest() {
+  const uint8_t *reference = selfTestReference(PCD_ReadRegister(VersionReg));
+  if (reference == NULL)
+    return false;
+
+  PCD_Reset();
+
+  // Clear the internal buffer, then let the CRC coprocessor run the test.
+  uint8_t zeroes[25];
+  memset(zeroes, 0, sizeof(zeroes));
+  PCD_WriteRegister(FIFOLevelReg, 0x80);
+  PCD_WriteRegister(FIFODataReg, sizeof(zeroes), zeroes);
+  PCD_WriteRegister(CommandReg, PCD_Mem);
+  PCD_WriteRegister(AutoTestReg, 0x09);
+  PCD_WriteRegister(FIFODataReg, 0x00);
+  PCD_WriteRegister(CommandReg, PCD_CalcCRC);
+
+  uint64_t deadline = PCD_GetTimeUs() + SELF_TEST_TIMEOUT_US;
+  uint8_t level;
+  do {
+    level = PCD_ReadRegister(FIFOLevelReg) & 0x7F;
+  } while (level < FIFO_SIZE && PCD_GetTimeUs() < deadline);
+  PCD_WriteRegister(CommandReg, PCD_Idle);
+
+  uint8_t result[FIFO_SIZE];
+  PCD_ReadRegister(FIFODataReg, FIFO_SIZE, result);
+  bool passed = level >= FIFO_SIZE && memcmp(result, reference, FIFO_SIZE) == 0;
+
+  PCD_Reset();
+  PCD_Configure();
+  return passed;
 }
 
-void MFRC522::PCD_WriteRegister(uint8_t reg, uint8_t count, uint8_t *values) {
-  _cs = 0;
-  _spi.write((reg << 1) & 0x7E);
-  for (uint8_t i = 0; i < count; i++) {
-    _spi.write(values[i]);
+// Each step must read back VersionReg and FIFO patterns and pass the
+// self-test; the first step that fails ends the search, so a marginal
+// link runs one step below where it broke.
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_CalibrateSpiClock(uint32_t maxHz) {
+  if (!_transport->SetFrequency(SPI_CLOCK_STEPS[0]))
+    return STATUS_ERROR;
+
+  uint8_t version = PCD_ReadRegister(VersionReg);
+  if (version == 0x00 || version == 0xFF)
+    return STATUS_ERROR;
+
+  bool selfTest = selfTestReference(version) != NULL;
+  uint32_t good = 0;
+  for (uint8_t i = 0; i < SPI_CLOCK_STEP_COUNT; i++) {
+    if (i > 0 && (SPI_CLOCK_STEPS[i] > maxHz ||
+                  !_transport->SetFrequency(SPI_CLOCK_STEPS[i])))
+      break;
+    if (!PCD_CheckSpiLink(version) || (selfTest && !PCD_PerformSelfTest()))
+      break;
+    good = SPI_CLOCK_STEPS[i];
   }
-  _cs = 1;
+
+  // A failed step may have left garbage in the chip, so start it over at
+  // the chosen clock.
+  _transport->SetFrequency(good ? good : SPI_CLOCK_STEPS[0]);
+  _spiHz = good;
+  PCD_Reset();
+  PCD_Configure();
+  return good ? STATUS_OK : STATUS_ERROR;
 }
 
-uint8_t MFRC522::PCD_ReadRegister(uint8_t reg) {
-  uint8_t value;
-  _cs = 0;
-  _spi.write(((reg << 1) & 0x7E) | 0x80);
-  value = _spi.write(0);
-  _cs = 1;
-  return value;
+template <class Transport>
+uint32_t MFRC522T<Transport>::PCD_GetSpiFrequency() const { return _spiHz; }
+
+template <class Transport>
+bool MFRC522T<Transport>::PCD_CheckSpiLink(uint8_t version) {
+  if (PCD_ReadRegister(VersionReg) != version)
+    return false;
+
+  uint8_t pattern[FIFO_SIZE];
+  uint8_t back[FIFO_SIZE];
+  uint8_t value = 0x5A;
+  for (uint8_t round = 0; round < SPI_CHECK_ROUNDS; round++) {
+    for (uint8_t i = 0; i < FIFO_SIZE; i++) {
+      pattern[i] = value;
+      value = value * 13 + 0x55;
+    }
+
+    PCD_WriteRegister(CommandReg, PCD_Idle);
+    PCD_WriteRegister(FIFOLevelReg, 0x80);
+    PCD_WriteRegister(FIFODataReg, FIFO_SIZE, pattern);
+    if ((PCD_ReadRegister(FIFOLevelReg) & 0x7F) != FIFO_SIZE)
+      return false;
+    PCD_ReadRegister(FIFODataReg, FIFO_SIZE, back);
+    if (memcmp(pattern, back, FIFO_SIZE) != 0)
+      return false;
+  }
+  return true;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_WriteRegister(uint8_t reg, uint8_t value) {
+  reg &= 0x3F;
+  if (PCD_ShadowPolicy(reg) != SHADOW_NONE) {
+    if ((_shadowValid & (1ULL << reg)) && _shadow[reg] == value) {
+      _shadowHits[reg]++;
+      return;
+    }
+    _shadowMisses[reg]++;
+    _shadow[reg] = value;
+    _shadowValid |= (1ULL << reg);
+  }
+
+  uint8_t tx[2] = {WriteAddress(reg), value};
+  PCD_BeginFrame();
+  PCD_SpiTransfer(tx, NULL, sizeof(tx));
+  PCD_EndFrame();
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_WriteRegister(uint8_t reg, uint8_t count,
+                                            uint8_t *values) {
+  reg &= 0x3F;
+  if (count && PCD_ShadowPolicy(reg) != SHADOW_NONE) {
+    _shadowMisses[reg]++;
+    _shadow[reg] = values[count - 1];
+    _shadowValid |= (1ULL << reg);
+  }
+
+  uint8_t address = WriteAddress(reg);
+  PCD_BeginFrame();
+  PCD_SpiTransfer(&address, NULL, 1);
+  PCD_SpiTransfer(values, NULL, count);
+  PCD_EndFrame();
 }
 
-void MFRC522::PCD_ReadRegister(uint8_t reg, uint8_t count, uint8_t *values,
-                               uint8_t rxAlign) {
+template <class Transport>
+uint8_t MFRC522T<Transport>::PCD_ReadRegister(uint8_t reg) {
+  reg &= 0x3F;
+  bool shadowed = PCD_ShadowPolicy(reg) & SHADOW_READ;
+  if (shadowed && (_shadowValid & (1ULL << reg))) {
+    _shadowHits[reg]++;
+    return _shadow[reg];
+  }
+
+  uint8_t tx[2] = {ReadAddress(reg), 0};
+  uint8_t rx[2];
+  PCD_BeginFrame();
+  PCD_SpiTransfer(tx, rx, sizeof(tx));
+  PCD_EndFrame();
+
+  if (shadowed) {
+    _shadowMisses[reg]++;
+    _shadow[reg] = rx[1];
+    _shadowValid |= (1ULL << reg);
+  }
+  return rx[1];
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_ReadRegister(uint8_t reg, uint8_t count,
+                                           uint8_t *values, uint8_t rxAlign) {
   if (count == 0)
     return;
 
-  uint8_t address = 0x80 | ((reg << 1) & 0x7E);
-  uint8_t index = 0;
-
-  _cs = 0;
-  count--;
-  _spi.write(address);
+  uint8_t address = ReadAddress(reg);
+  uint8_t first = values[0];
+  uint8_t tx[FIFO_SIZE];
+  memset(tx, address, sizeof(tx));
+
+  PCD_BeginFrame();
+  PCD_SpiTransfer(&address, NULL, 1);
+  for (uint8_t index = 0; index < count;) {
+    uint8_t chunk = (count - index > FIFO_SIZE) ? FIFO_SIZE : count - index;
+    if (index + chunk == count)
+      tx[chunk - 1] = 0;
+    PCD_SpiTransfer(tx, &values[index], chunk);
+    index += chunk;
+  }
+  PCD_EndFrame();
 
   if (rxAlign) {
     uint8_t mask = (0xFF << rxAlign) & 0xFF;
-    uint8_t value = _spi.write(address);
-    values[0] = (values[0] & ~mask) | (value & mask);
-    index++;
+    values[0] = (first & ~mask) | (values[0] & mask);
+  }
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_BeginFrame() {
+  _transport->Select();
+  _spiFrames++;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_EndFrame() { _transport->Deselect(); }
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_SpiTransfer(const uint8_t *tx, uint8_t *rx,
+                                          uint8_t length) {
+  if (length == 0)
+    return;
+  _transport->Transfer(tx, rx, length);
+  _spiBytes += length;
+}
+
+template <class Transport>
+uint32_t MFRC522T<Transport>::PCD_GetSpiFrameCount() const {
+  return _spiFrames;
+}
+
+template <class Transport>
+uint32_t MFRC522T<Transport>::PCD_GetSpiByteCount() const { return _spiBytes; }
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_ResetSpiCounters() {
+  _spiFrames = 0;
+  _spiBytes = 0;
+}
+
+template <class Transport>
+uint32_t MFRC522T<Transport>::PCD_GetStatusCount(StatusCode status) const {
+  return status < STATUS_CODE_COUNT ? _statusCounts[status] : 0;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_ResetStatusCounters() {
+  memset(_statusCounts, 0, sizeof(_statusCounts));
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_CountStatus(StatusCode status) {
+  if (status < STATUS_CODE_COUNT)
+    _statusCounts[status]++;
+  return status;
+}
+
+MFRC522Base::Transaction::Transaction() { Clear(); }
+
+void MFRC522Base::Transaction::Clear() {
+  _length = 0;
+  _frameCount = 0;
+  _readCount = 0;
+  _readFrameOpen = false;
+}
+
+bool MFRC522Base::Transaction::Write(uint8_t reg, uint8_t value) {
+  return Write(reg, 1, &value);
+}
+
+bool MFRC522Base::Transaction::Write(uint8_t reg, uint8_t count,
+                                     const uint8_t *values) {
+  if (_frameCount >= MAX_FRAMES || _length + 1 + count > MAX_BYTES)
+    return false;
+
+  _frameStart[_frameCount++] = _length;
+  _tx[_length++] = WriteAddress(reg);
+  memcpy(&_tx[_length], values, count);
+  _length += count;
+  _readFrameOpen = false;
+  return true;
+}
+
+bool MFRC522Base::Transaction::Read(uint8_t reg, uint8_t *value) {
+  return Read(reg, 1, value);
+}
+
+// Reads append to the open read frame: each address byte clocks out the
+// value addressed by the previous one, and a trailing 0 ends the frame.
+bool MFRC522Base::Transaction::Read(uint8_t reg, uint8_t count,
+                                    uint8_t *values) {
+  if (count == 0)
+    return true;
+
+  bool newFrame = !_readFrameOpen;
+  if (_readCount >= MAX_READS ||
+      (newFrame && _frameCount >= MAX_FRAMES) ||
+      _length + count + (newFrame ? 1 : 0) > MAX_BYTES)
+    return false;
+
+  if (newFrame) {
+    _frameStart[_frameCount++] = _length;
+    _tx[_length++] = 0;
+    _readFrameOpen = true;
+  }
+
+  uint8_t offset = _length - 1;
+  memset(&_tx[offset], ReadAddress(reg), count);
+  _tx[offset + count] = 0;
+  _length = offset + count + 1;
+
+  _reads[_readCount].offset = offset + 1;
+  _reads[_readCount].count = count;
+  _reads[_readCount].dest = values;
+  _readCount++;
+  return true;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_ExecuteTransaction(Transaction *transaction) {
+  for (uint8_t frame = 0; frame < transaction->_frameCount; frame++) {
+    if (PCD_SkipShadowedFrame(transaction, frame))
+      continue;
+
+    uint8_t start = transaction->FrameStart(frame);
+    PCD_BeginFrame();
+    PCD_SpiTransfer(&transaction->_tx[start], &transaction->_rx[start],
+                    transaction->FrameEnd(frame) - start);
+    PCD_EndFrame();
+  }
+  PCD_CompleteTransaction(transaction);
+}
+
+template <class Transport>
+bool MFRC522T<Transport>::PCD_SkipShadowedFrame(Transaction *transaction,
+                                                uint8_t frame) {
+  uint8_t start = transaction->FrameStart(frame);
+  uint8_t count = transaction->FrameEnd(frame) - start - 1;
+  uint8_t address = transaction->_tx[start];
+  uint8_t reg = (address >> 1) & 0x3F;
+
+  if ((address & 0x80) || PCD_ShadowPolicy(reg) == SHADOW_NONE)
+    return false;
+
+  uint8_t value = transaction->_tx[start + count];
+  if (count == 1 && (_shadowValid & (1ULL << reg)) && _shadow[reg] == value) {
+    _shadowHits[reg]++;
+    return true;
+  }
+
+  _shadowMisses[reg]++;
+  _shadow[reg] = value;
+  _shadowValid |= (1ULL << reg);
+  return false;
+}
+
+// The shadow takes a frame's value before the frame goes out. A frame that
+// never reached the chip must not leave it there, or later writes of the
+// same value would be skipped.
+template <class Transport>
+void MFRC522T<Transport>::PCD_ForgetShadowedFrame(Transaction *transaction,
+                                                  uint8_t frame) {
+  uint8_t address = transaction->_tx[transaction->FrameStart(frame)];
+  if (!(address & 0x80))
+    _shadowValid &= ~(1ULL << ((address >> 1) & 0x3F));
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_CompleteTransaction(Transaction *transaction) {
+  for (uint8_t i = 0; i < transaction->_readCount; i++) {
+    const Transaction::ReadSlot &slot = transaction->_reads[i];
+    memcpy(slot.dest, &transaction->_rx[slot.offset], slot.count);
+  }
+}
+
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::PCD_ExecuteTransactionAsync(
+    Transaction *transaction, Callback<void(StatusCode)> done) {
+  if (_asyncTransaction)
+    return STATUS_ERROR;
+
+  _asyncTransaction = transaction;
+  _asyncFrame = 0;
+  _asyncDone = done;
+  PCD_StartAsyncFrame();
+  return STATUS_OK;
+}
+
+template <class Transport>
+bool MFRC522T<Transport>::PCD_IsTransactionPending() const {
+  return _asyncTransaction != NULL;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_StartAsyncFrame() {
+  Transaction *transaction = _asyncTransaction;
+  while (_asyncFrame < transaction->_frameCount &&
+         PCD_SkipShadowedFrame(transaction, _asyncFrame)) {
+    _asyncFrame++;
+  }
+
+  if (_asyncFrame == transaction->_frameCount) {
+    PCD_FinishAsyncTransaction(STATUS_OK);
+    return;
+  }
+
+  uint8_t start = transaction->FrameStart(_asyncFrame);
+  uint8_t length = transaction->FrameEnd(_asyncFrame) - start;
+  PCD_BeginFrame();
+  _spiBytes += length;
+  if (!_transport->TransferAsync(
+          &transaction->_tx[start], &transaction->_rx[start], length,
+          callback(this, &MFRC522T::PCD_AsyncFrameDone))) {
+    PCD_EndFrame();
+    PCD_ForgetShadowedFrame(transaction, _asyncFrame);
+    PCD_FinishAsyncTransaction(STATUS_ERROR);
   }
+}
 
-  while (index < count) {
-    values[index] = _spi.write(address);
-    index++;
+template <class Transport>
+void MFRC522T<Transport>::PCD_AsyncFrameDone(bool ok) {
+  PCD_EndFrame();
+  if (!ok) {
+    PCD_ForgetShadowedFrame(_asyncTransaction, _asyncFrame);
+    PCD_FinishAsyncTransaction(STATUS_ERROR);
+    return;
   }
 
-  values[index] = _spi.write(0);
-  _cs = 1;
+  _asyncFrame++;
+  PCD_StartAsyncFrame();
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_FinishAsyncTransaction(StatusCode status) {
+  Callback<void(StatusCode)> done = _asyncDone;
+  if (status == STATUS_OK)
+    PCD_CompleteTransaction(_asyncTransaction);
+  _asyncTransaction = NULL;
+  if (done)
+    done(status);
 }
 
-void MFRC522::PCD_SetRegisterBitMask(uint8_t reg, uint8_t mask) {
-  uint8_t tmp = PCD_ReadRegister(reg);
+template <class Transport>
+void MFRC522T<Transport>::PCD_SetRegisterBitMask(uint8_t reg, uint8_t mask) {
+  uint8_t tmp = PCD_ReadRegisterForUpdate(reg);
   PCD_WriteRegister(reg, tmp | mask);
 }
 
-void MFRC522::PCD_ClearRegisterBitMask(uint8_t reg, uint8_t mask) {
-  uint8_t tmp = PCD_ReadRegister(reg);
+template <class Transport>
+void MFRC522T<Transport>::PCD_ClearRegisterBitMask(uint8_t reg, uint8_t mask) {
+  uint8_t tmp = PCD_ReadRegisterForUpdate(reg);
   PCD_WriteRegister(reg, tmp & (~mask));
 }
 
-MFRC522::StatusCode MFRC522::PCD_CalculateCRC(uint8_t *data, uint8_t length,
-                                              uint8_t *result) {
-  PCD_WriteRegister(CommandReg, PCD_Idle);
-  PCD_WriteRegister(DivIrqReg, 0x04);
-  PCD_WriteRegister(FIFOLevelReg, 0x80);
-  PCD_WriteRegister(FIFODataReg, length, data);
-  PCD_WriteRegister(CommandReg, PCD_CalcCRC);
+template <class Transport>
+uint8_t MFRC522T<Transport>::PCD_ReadRegisterForUpdate(uint8_t reg) {
+  reg &= 0x3F;
+  uint8_t policy = PCD_ShadowPolicy(reg);
+  if (policy == SHADOW_NONE || (policy & SHADOW_READ))
+    return PCD_ReadRegister(reg);
 
-  for (uint16_t i = 5000; i > 0; i--) {
-    uint8_t n = PCD_ReadRegister(DivIrqReg);
-    if (n & 0x04) {
-      PCD_WriteRegister(CommandReg, PCD_Idle);
-      result[0] = PCD_ReadRegister(CRCResultRegL);
-      result[1] = PCD_ReadRegister(CRCResultRegH);
-      return STATUS_OK;
+  if (_shadowValid & (1ULL << reg)) {
+    _shadowHits[reg]++;
+    return _shadow[reg];
+  }
+
+  uint8_t value = PCD_ReadRegister(reg);
+  _shadowMisses[reg]++;
+  _shadow[reg] = value;
+  _shadowValid |= (1ULL << reg);
+  return value;
+}
+
+// Configuration registers only change when the driver writes them, so they
+// can be served from the shadow. CollReg and BitFramingReg are only tracked
+// for writes: CollReg carries collision status in its low bits and
+// BitFramingReg is always rewritten before StartSend is set. IRQ, FIFO,
+// status and command registers are never cached.
+template <class Transport>
+uint8_t MFRC522T<Transport>::PCD_ShadowPolicy(uint8_t reg) const {
+  if (!_shadowEnabled)
+    return SHADOW_NONE;
+
+  switch (reg) {
+  case ComIEnReg:
+  case DivIEnReg:
+  case WaterLevelReg:
+  case ModeReg:
+  case TxModeReg:
+  case RxModeReg:
+  case TxControlReg:
+  case TxASKReg:
+  case TxSelReg:
+  case RxSelReg:
+  case RxThresholdReg:
+  case DemodReg:
+  case MfTxReg:
+  case MfRxReg:
+  case ModWidthReg:
+  case RFCfgReg:
+  case GsNReg:
+  case CWGsPReg:
+  case ModGsPReg:
+  case TModeReg:
+  case TPrescalerReg:
+  case TReloadRegH:
+  case TReloadRegL:
+    return SHADOW_READ | SHADOW_WRITE;
+  case BitFramingReg:
+  case CollReg:
+    return SHADOW_WRITE;
+  default:
+    return SHADOW_NONE;
+  }
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_SetRegisterShadow(bool enable) {
+  _shadowEnabled = enable;
+  PCD_InvalidateRegisterShadow();
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_InvalidateRegisterShadow() { _shadowValid = 0; }
+
+template <class Transport>
+uint32_t MFRC522T<Transport>::PCD_GetShadowHits(uint8_t reg) const {
+  return _shadowHits[reg & 0x3F];
+}
+
+template <class Transport>
+uint32_t MFRC522T<Transport>::PCD_GetShadowMisses(uint8_t reg) const {
+  return _shadowMisses[reg & 0x3F];
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_ResetShadowCounters() {
+  memset(_shadowHits, 0, sizeof(_shadowHits));
+  memset(_shadowMisses, 0, sizeof(_shadowMisses));
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_CalculateCRC(uint8_t *data, uint8_t length,
+                                      uint8_t *result) {
+  if (_hardwareCrc)
+    return PCD_CalculateCRCOnChip(data, length, result);
+
+  CalculateCRC_A(data, length, result);
+  return STATUS_OK;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PCD_SetHardwareCRC(bool enable) {
+  _hardwareCrc = enable;
+}
+
+void MFRC522Base::CalculateCRC_A(const uint8_t *data, uint8_t length,
+                                 uint8_t *result) {
+  uint16_t crc = 0x6363;
+  for (uint8_t i = 0; i < length; i++) {
+    crc = (crc >> 8) ^ crcATable.value[(crc ^ data[i]) & 0xFF];
+  }
+  result[0] = crc & 0xFF;
+  result[1] = crc >> 8;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_CalculateCRCOnChip(uint8_t *data, uint8_t length,
+                                            uint8_t *result) {
+  Transaction transaction;
+  transaction.Write(CommandReg, PCD_Idle);
+  transaction.Write(DivIrqReg, 0x04);
+  transaction.Write(FIFOLevelReg, 0x80);
+  if (!transaction.Write(FIFODataReg, length, data))
+    return STATUS_NO_ROOM;
+  transaction.Write(CommandReg, PCD_CalcCRC);
+  PCD_ExecuteTransaction(&transaction);
+
+  StatusCode status =
+      PCD_WaitForIrq(DivIrqReg, DivIEnReg, 0x04, 0, CRC_TIMEOUT_US);
+  if (status != STATUS_OK)
+    return status;
+
+  transaction.Clear();
+  transaction.Write(CommandReg, PCD_Idle);
+  transaction.Read(CRCResultRegL, &result[0]);
+  transaction.Read(CRCResultRegH, &result[1]);
+  PCD_ExecuteTransaction(&transaction);
+  return STATUS_OK;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_WaitForIrq(uint8_t irqReg, uint8_t enableReg,
+                                    uint8_t waitIRq, uint8_t timerIRq,
+                                    uint32_t timeoutUs, uint8_t *irq) {
+  uint64_t deadline = _transport->GetTimeUs() + timeoutUs;
+  if (!_transport->HasIrq()) {
+    while (true) {
+      uint8_t n = PCD_ReadRegister(irqReg);
+      if (irq)
+        *irq = n;
+      if (n & waitIRq)
+        return STATUS_OK;
+      if ((n & timerIRq) || _transport->GetTimeUs() >= deadline)
+        return STATUS_TIMEOUT;
     }
   }
-  return STATUS_TIMEOUT;
+
+  // The IRQ line is level sensitive, so arming after the command has been
+  // started still produces an edge if it has already completed.
+  _transport->ClearIrq();
+  PCD_WriteRegister(enableReg, 0x80 | waitIRq | timerIRq);
+
+  StatusCode status = STATUS_TIMEOUT;
+  while (true) {
+    uint64_t now = _transport->GetTimeUs();
+    bool fired = _transport->WaitForIrq(
+        now < deadline ? (deadline - now + 999) / 1000 : 0);
+    uint8_t n = PCD_ReadRegister(irqReg);
+    if (irq)
+      *irq = n;
+    if (n & waitIRq) {
+      status = STATUS_OK;
+      break;
+    }
+    if ((n & timerIRq) || !fired)
+      break;
+  }
+
+  PCD_WriteRegister(enableReg, 0x80);
+  return status;
 }
 
-MFRC522::StatusCode MFRC522::PCD_TransceiveData(
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::PCD_TransceiveData(
     uint8_t *sendData, uint8_t sendLen, uint8_t *backData, uint8_t *backLen,
     uint8_t *validBits, uint8_t rxAlign, bool checkCRC) {
   uint8_t waitIRq = 0x30;
@@ -148,50 +832,206 @@ MFRC522::StatusCode MFRC522::PCD_TransceiveData(
                                  checkCRC);
 }
 
-MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(
+// The first FIFO load goes out with the command. LoAlert then means at most
+// STREAM_WATER_LEVEL bytes are left to send, so FIFO_SIZE - STREAM_WATER_LEVEL
+// more always fit; once TxIRq has been seen, HiAlert means at least that many
+// have arrived. Neither needs a FIFOLevelReg read. Each alert is cleared after
+// its transfer, because the level crosses the threshold again while bytes
+// are being moved. TxIRq before the last refill means the FIFO ran dry and
+// the card got a truncated frame; an overflowing receive sets BufferOvfl.
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_TransceiveStream(uint8_t *sendData, uint16_t sendLen,
+                                          uint8_t *backData, uint16_t *backLen,
+                                          bool checkCRC) {
+  return PCD_CountStatus(
+      PCD_StreamFrame(sendData, sendLen, backData, backLen, checkCRC));
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_StreamFrame(uint8_t *sendData, uint16_t sendLen,
+                                     uint8_t *backData, uint16_t *backLen,
+                                     bool checkCRC) {
+  if (sendData == NULL || sendLen == 0 || sendLen > MAX_STREAM_FRAME ||
+      backData == NULL || backLen == NULL)
+    return STATUS_INVALID;
+
+  const uint8_t chunkSize = FIFO_SIZE - STREAM_WATER_LEVEL;
+  uint16_t capacity = *backLen < MAX_STREAM_FRAME ? *backLen : MAX_STREAM_FRAME;
+  uint16_t sent = sendLen < FIFO_SIZE ? sendLen : FIFO_SIZE;
+  uint16_t received = 0;
+  uint64_t deadline = _transport->GetTimeUs() + _timeoutUs +
+                      PCD_GetFrameTimeUs(sendLen) +
+                      PCD_GetFrameTimeUs(capacity) + HOST_TIMEOUT_MARGIN_US;
+  uint8_t irq;
+
+  StatusCode status = PCD_BeginCommunication(PCD_Transceive, sendData, sent);
+  if (status != STATUS_OK)
+    return status;
+
+  Transaction transaction;
+  while (sent < sendLen) {
+    uint64_t now = _transport->GetTimeUs();
+    status = PCD_WaitForIrq(ComIrqReg, ComIEnReg, 0x44, 0x01,
+                            now < deadline ? deadline - now : 0, &irq);
+    if (status == STATUS_OK && (irq & 0x40))
+      status = STATUS_ERROR;
+    if (status != STATUS_OK) {
+      PCD_AbortCommunication();
+      return status;
+    }
+
+    uint8_t chunk = sendLen - sent < chunkSize ? sendLen - sent : chunkSize;
+    transaction.Clear();
+    transaction.Write(FIFODataReg, chunk, &sendData[sent]);
+    transaction.Write(ComIrqReg, 0x04);
+    PCD_ExecuteTransaction(&transaction);
+    sent += chunk;
+  }
+
+  bool txDone = false;
+  while (true) {
+    uint64_t now = _transport->GetTimeUs();
+    status = PCD_WaitForIrq(ComIrqReg, ComIEnReg, txDone ? 0x38 : 0x70, 0x01,
+                            now < deadline ? deadline - now : 0, &irq);
+    if (status != STATUS_OK) {
+      PCD_AbortCommunication();
+      return status;
+    }
+    if (irq & 0x30)
+      break;
+    if (!txDone) {
+      txDone = true;
+      PCD_WriteRegister(ComIrqReg, 0x08);
+      continue;
+    }
+
+    if (received + chunkSize > capacity) {
+      PCD_AbortCommunication();
+      return STATUS_NO_ROOM;
+    }
+    transaction.Clear();
+    transaction.Read(FIFODataReg, chunkSize, &backData[received]);
+    transaction.Write(ComIrqReg, 0x08);
+    PCD_ExecuteTransaction(&transaction);
+    received += chunkSize;
+  }
+
+  uint8_t rest = capacity - received < 0xFF ? capacity - received : 0xFF;
+  uint8_t validBits = 0;
+  status = PCD_FinishCommunication(&backData[received], &rest, &validBits);
+  if (status != STATUS_OK)
+    return status;
+  *backLen = received + rest;
+
+  if (checkCRC)
+    return PCD_CheckResponseCRC(backData, *backLen, validBits);
+  return STATUS_OK;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::PCD_CommunicateWithPICC(
     uint8_t command, uint8_t waitIRq, uint8_t *sendData, uint8_t sendLen,
     uint8_t *backData, uint8_t *backLen, uint8_t *validBits, uint8_t rxAlign,
     bool checkCRC) {
-  uint8_t txLastBits = validBits ? *validBits : 0;
-  uint8_t bitFraming = (rxAlign << 4) + txLastBits;
+  StatusCode status = PCD_BeginCommunication(
+      command, sendData, sendLen, validBits ? *validBits : 0, rxAlign);
+  if (status == STATUS_OK)
+    status = PCD_WaitForIrq(ComIrqReg, ComIEnReg, waitIRq, 0x01,
+                            PCD_GetHostTimeout(command, sendLen));
+  if (status == STATUS_OK)
+    status = PCD_FinishCommunication(backData, backLen, validBits, rxAlign,
+                                     checkCRC);
+  return PCD_CountStatus(status);
+}
 
-  PCD_WriteRegister(CommandReg, PCD_Idle);
-  PCD_WriteRegister(ComIrqReg, 0x7F);
-  PCD_WriteRegister(FIFOLevelReg, 0x80);
-  PCD_WriteRegister(FIFODataReg, sendLen, sendData);
-  PCD_WriteRegister(BitFramingReg, bitFraming);
-  PCD_WriteRegister(CommandReg, command);
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_BeginCommunication(uint8_t command, uint8_t *sendData,
+                                            uint8_t sendLen, uint8_t txLastBits,
+                                            uint8_t rxAlign) {
+  Transaction transaction;
+  if (!PCD_PrepareCommunication(&transaction, command, sendData, sendLen,
+                                txLastBits, rxAlign))
+    return STATUS_NO_ROOM;
+  PCD_ExecuteTransaction(&transaction);
+  return STATUS_OK;
+}
+
+// Appends the writes that start a command, so a caller can put reads of the
+// previous exchange in front of them and save an SPI round trip.
+template <class Transport>
+bool MFRC522T<Transport>::PCD_PrepareCommunication(
+    Transaction *transaction, uint8_t command, uint8_t *sendData,
+    uint8_t sendLen, uint8_t txLastBits, uint8_t rxAlign) {
+  uint8_t bitFraming = (rxAlign << 4) + txLastBits;
 
-  if (command == PCD_Transceive) {
-    PCD_SetRegisterBitMask(BitFramingReg, 0x80);
+  // IRQs are cleared after the FIFO is loaded so the water level alerts
+  // raised by flushing and filling it do not look like transfer progress.
+  bool ok = transaction->Write(CommandReg, PCD_Idle) &&
+            transaction->Write(FIFOLevelReg, 0x80) &&
+            transaction->Write(FIFODataReg, sendLen, sendData) &&
+            transaction->Write(ComIrqReg, 0x7F) &&
+            transaction->Write(BitFramingReg, bitFraming) &&
+            transaction->Write(TModeReg, 0x80 | (_timerPrescaler >> 8)) &&
+            transaction->Write(TPrescalerReg, _timerPrescaler & 0xFF) &&
+            transaction->Write(TReloadRegH, _timerReload >> 8) &&
+            transaction->Write(TReloadRegL, _timerReload & 0xFF) &&
+            transaction->Write(CommandReg, command);
+  if (ok && command == PCD_Transceive) {
+    ok = transaction->Write(BitFramingReg, bitFraming | 0x80);
   }
+  return ok;
+}
 
-  uint16_t i;
-  for (i = 2000; i > 0; i--) {
-    uint8_t n = PCD_ReadRegister(ComIrqReg);
-    if (n & waitIRq)
-      break;
-    if (n & 0x01)
-      return STATUS_TIMEOUT;
+template <class Transport>
+bool MFRC522T<Transport>::PCD_PollCommunication(uint8_t waitIRq,
+                                                StatusCode *status) {
+  uint8_t n = PCD_ReadRegister(ComIrqReg);
+  if (n & waitIRq) {
+    *status = STATUS_OK;
+    return true;
   }
+  if (n & 0x01) {
+    *status = STATUS_TIMEOUT;
+    return true;
+  }
+  return false;
+}
 
-  if (i == 0)
-    return STATUS_TIMEOUT;
+template <class Transport>
+void MFRC522T<Transport>::PCD_AbortCommunication() {
+  PCD_WriteRegister(CommandReg, PCD_Idle);
+  PCD_ClearRegisterBitMask(BitFramingReg, 0x80);
+}
+
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::PCD_FinishCommunication(
+    uint8_t *backData, uint8_t *backLen, uint8_t *validBits, uint8_t rxAlign,
+    bool checkCRC) {
+  uint8_t errorRegValue;
+  uint8_t fifoLevel;
+  uint8_t controlRegValue;
+  Transaction transaction;
+  transaction.Read(ErrorReg, &errorRegValue);
+  transaction.Read(FIFOLevelReg, &fifoLevel);
+  transaction.Read(ControlReg, &controlRegValue);
+  PCD_ExecuteTransaction(&transaction);
 
-  uint8_t errorRegValue = PCD_ReadRegister(ErrorReg);
   if (errorRegValue & 0x13)
     return STATUS_ERROR;
 
   uint8_t _validBits = 0;
 
   if (backData && backLen) {
-    uint8_t n = PCD_ReadRegister(FIFOLevelReg);
+    uint8_t n = fifoLevel;
     if (n > *backLen)
       return STATUS_NO_ROOM;
 
     *backLen = n;
     PCD_ReadRegister(FIFODataReg, n, backData, rxAlign);
-    _validBits = PCD_ReadRegister(ControlReg) & 0x07;
+    _validBits = controlRegValue & 0x07;
     if (validBits)
       *validBits = _validBits;
   }
@@ -199,40 +1039,51 @@ MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(
   if (errorRegValue & 0x08)
     return STATUS_COLLISION;
 
-  if (backData && backLen && checkCRC) {
-    if (*backLen == 1 && _validBits == 4)
-      return STATUS_MIFARE_NACK;
-    if (*backLen < 2 || _validBits != 0)
-      return STATUS_CRC_WRONG;
+  if (backData && backLen && checkCRC)
+    return PCD_CheckResponseCRC(backData, *backLen, _validBits);
 
-    uint8_t controlBuffer[2];
-    StatusCode status =
-        PCD_CalculateCRC(&backData[0], *backLen - 2, &controlBuffer[0]);
-    if (status != STATUS_OK)
-      return status;
+  return STATUS_OK;
+}
 
-    if ((backData[*backLen - 2] != controlBuffer[0]) ||
-        (backData[*backLen - 1] != controlBuffer[1])) {
-      return STATUS_CRC_WRONG;
-    }
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_CheckResponseCRC(uint8_t *backData, uint16_t backLen,
+                                          uint8_t validBits) {
+  if (backLen == 1 && validBits == 4)
+    return STATUS_MIFARE_NACK;
+  if (backLen < 2 || validBits != 0)
+    return STATUS_CRC_WRONG;
+
+  uint8_t controlBuffer[2];
+  StatusCode status =
+      PCD_CalculateCRC(&backData[0], backLen - 2, &controlBuffer[0]);
+  if (status != STATUS_OK)
+    return status;
+
+  if ((backData[backLen - 2] != controlBuffer[0]) ||
+      (backData[backLen - 1] != controlBuffer[1])) {
+    return STATUS_CRC_WRONG;
   }
 
   return STATUS_OK;
 }
 
-MFRC522::StatusCode MFRC522::PICC_RequestA(uint8_t *bufferATQA,
-                                           uint8_t *bufferSize) {
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_RequestA(uint8_t *bufferATQA, uint8_t *bufferSize) {
   return PICC_REQA_or_WUPA(PICC_CMD_REQA, bufferATQA, bufferSize);
 }
 
-MFRC522::StatusCode MFRC522::PICC_WakeupA(uint8_t *bufferATQA,
-                                          uint8_t *bufferSize) {
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_WakeupA(uint8_t *bufferATQA, uint8_t *bufferSize) {
   return PICC_REQA_or_WUPA(PICC_CMD_WUPA, bufferATQA, bufferSize);
 }
 
-MFRC522::StatusCode MFRC522::PICC_REQA_or_WUPA(uint8_t command,
-                                               uint8_t *bufferATQA,
-                                               uint8_t *bufferSize) {
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_REQA_or_WUPA(uint8_t command, uint8_t *bufferATQA,
+                                       uint8_t *bufferSize) {
   uint8_t validBits;
   StatusCode status;
 
@@ -240,6 +1091,7 @@ MFRC522::StatusCode MFRC522::PICC_REQA_or_WUPA(uint8_t command,
     return STATUS_NO_ROOM;
 
   PCD_ClearRegisterBitMask(CollReg, 0x80);
+  PCD_SetTimeout(TIMEOUT_ACTIVATION_US);
   validBits = 7;
   status = PCD_TransceiveData(&command, 1, bufferATQA, bufferSize, &validBits);
 
@@ -251,160 +1103,191 @@ MFRC522::StatusCode MFRC522::PICC_REQA_or_WUPA(uint8_t command,
   return STATUS_OK;
 }
 
-MFRC522::StatusCode MFRC522::PICC_Select(Uid *uid, uint8_t validBits) {
-  bool uidComplete;
-  bool selectDone;
-  bool useCascadeTag;
-  uint8_t cascadeLevel = 1;
-  StatusCode result;
-  uint8_t count;
-  uint8_t index;
-  uint8_t uidIndex;
-  int8_t currentLevelKnownBits;
-  uint8_t buffer[9];
-  uint8_t bufferUsed;
-  uint8_t rxAlign;
-  uint8_t txLastBits;
-  uint8_t *responseBuffer;
-  uint8_t responseLength;
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_Select(Uid *uid, uint8_t validBits) {
+  SelectContext ctx;
+  StatusCode result = PICC_SelectBegin(&ctx, uid, validBits);
 
+  while (result == STATUS_OK && !ctx.complete) {
+    result = PICC_SelectPrepareFrame(&ctx);
+    if (result != STATUS_OK)
+      return result;
+
+    result = PCD_TransceiveData(ctx.buffer, ctx.bufferUsed,
+                                &ctx.buffer[ctx.responseIndex],
+                                &ctx.responseLength, &ctx.txLastBits,
+                                ctx.rxAlign);
+    result = PICC_SelectHandleResponse(&ctx, result);
+  }
+
+  return result;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_SelectBegin(SelectContext *ctx, Uid *uid,
+                                      uint8_t validBits) {
   if (validBits > 80)
     return STATUS_INVALID;
 
+  ctx->uid = uid;
+  ctx->validBits = validBits;
+  ctx->cascadeLevel = 1;
+  ctx->complete = false;
+
   PCD_ClearRegisterBitMask(CollReg, 0x80);
+  PCD_SetTimeout(TIMEOUT_ACTIVATION_US);
 
-  uidComplete = false;
-  while (!uidComplete) {
-    switch (cascadeLevel) {
-    case 1:
-      buffer[0] = PICC_CMD_SEL_CL1;
-      uidIndex = 0;
-      useCascadeTag = validBits && uid->size > 4;
-      break;
-    case 2:
-      buffer[0] = PICC_CMD_SEL_CL2;
-      uidIndex = 3;
-      useCascadeTag = validBits && uid->size > 7;
-      break;
-    case 3:
-      buffer[0] = PICC_CMD_SEL_CL3;
-      uidIndex = 6;
-      useCascadeTag = false;
-      break;
-    default:
-      return STATUS_INTERNAL_ERROR;
-    }
+  return PICC_SelectStartLevel(ctx);
+}
 
-    currentLevelKnownBits = validBits - (8 * uidIndex);
-    if (currentLevelKnownBits < 0)
-      currentLevelKnownBits = 0;
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_SelectStartLevel(SelectContext *ctx) {
+  uint8_t *buffer = ctx->buffer;
+
+  switch (ctx->cascadeLevel) {
+  case 1:
+    buffer[0] = PICC_CMD_SEL_CL1;
+    ctx->uidIndex = 0;
+    ctx->useCascadeTag = ctx->validBits && ctx->uid->size > 4;
+    break;
+  case 2:
+    buffer[0] = PICC_CMD_SEL_CL2;
+    ctx->uidIndex = 3;
+    ctx->useCascadeTag = ctx->validBits && ctx->uid->size > 7;
+    break;
+  case 3:
+    buffer[0] = PICC_CMD_SEL_CL3;
+    ctx->uidIndex = 6;
+    ctx->useCascadeTag = false;
+    break;
+  default:
+    return STATUS_INTERNAL_ERROR;
+  }
 
-    index = 2;
-    if (useCascadeTag) {
-      buffer[index++] = PICC_CMD_CT;
-    }
+  ctx->currentLevelKnownBits = ctx->validBits - (8 * ctx->uidIndex);
+  if (ctx->currentLevelKnownBits < 0)
+    ctx->currentLevelKnownBits = 0;
 
-    uint8_t bytesToCopy =
-        currentLevelKnownBits / 8 + (currentLevelKnownBits % 8 ? 1 : 0);
-    if (bytesToCopy) {
-      uint8_t maxBytes = useCascadeTag ? 3 : 4;
-      if (bytesToCopy > maxBytes)
-        bytesToCopy = maxBytes;
-      for (count = 0; count < bytesToCopy; count++) {
-        buffer[index++] = uid->uidByte[uidIndex + count];
-      }
-    }
+  uint8_t index = 2;
+  if (ctx->useCascadeTag) {
+    buffer[index++] = PICC_CMD_CT;
+  }
 
-    if (useCascadeTag) {
-      currentLevelKnownBits += 8;
+  uint8_t bytesToCopy = ctx->currentLevelKnownBits / 8 +
+                        (ctx->currentLevelKnownBits % 8 ? 1 : 0);
+  if (bytesToCopy) {
+    uint8_t maxBytes = ctx->useCascadeTag ? 3 : 4;
+    if (bytesToCopy > maxBytes)
+      bytesToCopy = maxBytes;
+    for (uint8_t count = 0; count < bytesToCopy; count++) {
+      buffer[index++] = ctx->uid->uidByte[ctx->uidIndex + count];
     }
+  }
 
-    selectDone = false;
-    while (!selectDone) {
-      if (currentLevelKnownBits >= 32) {
-        buffer[1] = 0x70;
-        buffer[6] = buffer[2] ^ buffer[3] ^ buffer[4] ^ buffer[5];
-        result = PCD_CalculateCRC(buffer, 7, &buffer[7]);
-        if (result != STATUS_OK)
-          return result;
-
-        txLastBits = 0;
-        bufferUsed = 9;
-        responseBuffer = &buffer[6];
-        responseLength = 3;
-      } else {
-        txLastBits = currentLevelKnownBits % 8;
-        count = currentLevelKnownBits / 8;
-        index = 2 + count;
-        buffer[1] = (index << 4) + txLastBits;
-        bufferUsed = index + (txLastBits ? 1 : 0);
-        responseBuffer = &buffer[index];
-        responseLength = sizeof(buffer) - index;
-      }
+  if (ctx->useCascadeTag) {
+    ctx->currentLevelKnownBits += 8;
+  }
 
-      rxAlign = txLastBits;
-      PCD_WriteRegister(BitFramingReg, (rxAlign << 4) + txLastBits);
+  return STATUS_OK;
+}
 
-      result = PCD_TransceiveData(buffer, bufferUsed, responseBuffer,
-                                  &responseLength, &txLastBits, rxAlign);
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_SelectPrepareFrame(SelectContext *ctx) {
+  uint8_t *buffer = ctx->buffer;
 
-      if (result == STATUS_COLLISION) {
-        uint8_t valueOfCollReg = PCD_ReadRegister(CollReg);
-        if (valueOfCollReg & 0x20)
-          return STATUS_COLLISION;
+  if (ctx->currentLevelKnownBits >= 32) {
+    buffer[1] = 0x70;
+    buffer[6] = buffer[2] ^ buffer[3] ^ buffer[4] ^ buffer[5];
+    StatusCode result = PCD_CalculateCRC(buffer, 7, &buffer[7]);
+    if (result != STATUS_OK)
+      return result;
 
-        uint8_t collisionPos = valueOfCollReg & 0x1F;
-        if (collisionPos == 0)
-          collisionPos = 32;
-        if (collisionPos <= currentLevelKnownBits)
-          return STATUS_INTERNAL_ERROR;
+    ctx->txLastBits = 0;
+    ctx->bufferUsed = 9;
+    ctx->responseIndex = 6;
+    ctx->responseLength = 3;
+  } else {
+    ctx->txLastBits = ctx->currentLevelKnownBits % 8;
+    uint8_t count = ctx->currentLevelKnownBits / 8;
+    uint8_t index = 2 + count;
+    buffer[1] = (index << 4) + ctx->txLastBits;
+    ctx->bufferUsed = index + (ctx->txLastBits ? 1 : 0);
+    ctx->responseIndex = index;
+    ctx->responseLength = sizeof(ctx->buffer) - index;
+  }
 
-        currentLevelKnownBits = collisionPos;
-        count = (currentLevelKnownBits - 1) % 8;
-        index = 1 + (currentLevelKnownBits / 8) + (count ? 1 : 0);
-        buffer[index] |= (1 << count);
-      } else if (result != STATUS_OK) {
-        return result;
-      } else {
-        if (currentLevelKnownBits >= 32) {
-          selectDone = true;
-        } else {
-          currentLevelKnownBits = 32;
-        }
-      }
-    }
+  ctx->rxAlign = ctx->txLastBits;
+  return STATUS_OK;
+}
 
-    index = (buffer[2] == PICC_CMD_CT) ? 3 : 2;
-    bytesToCopy = (buffer[2] == PICC_CMD_CT) ? 3 : 4;
-    for (count = 0; count < bytesToCopy; count++) {
-      uid->uidByte[uidIndex + count] = buffer[index++];
-    }
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_SelectHandleResponse(SelectContext *ctx,
+                                               StatusCode result) {
+  uint8_t *buffer = ctx->buffer;
+
+  if (result == STATUS_COLLISION) {
+    uint8_t valueOfCollReg = PCD_ReadRegister(CollReg);
+    if (valueOfCollReg & 0x20)
+      return STATUS_COLLISION;
+
+    // CollPos counts from the first bit of the received frame as stored in
+    // the FIFO, so it includes RxAlign but not the whole bytes already sent.
+    uint8_t collisionPos = valueOfCollReg & 0x1F;
+    if (collisionPos == 0)
+      collisionPos = 32;
+    collisionPos += ctx->currentLevelKnownBits & ~0x07;
+    if (collisionPos <= ctx->currentLevelKnownBits || collisionPos > 32)
+      return STATUS_INTERNAL_ERROR;
 
-    if (responseLength != 3 || txLastBits != 0)
-      return STATUS_ERROR;
+    ctx->currentLevelKnownBits = collisionPos;
+    buffer[2 + (collisionPos - 1) / 8] |= 1 << ((collisionPos - 1) % 8);
+    return STATUS_OK;
+  }
 
-    result = PCD_CalculateCRC(responseBuffer, 1, &buffer[2]);
-    if (result != STATUS_OK)
-      return result;
+  if (result != STATUS_OK)
+    return result;
 
-    if ((buffer[2] != responseBuffer[1]) || (buffer[3] != responseBuffer[2])) {
-      return STATUS_CRC_WRONG;
-    }
+  if (ctx->currentLevelKnownBits < 32) {
+    ctx->currentLevelKnownBits = 32;
+    return STATUS_OK;
+  }
 
-    if (responseBuffer[0] & 0x04) {
-      cascadeLevel++;
-    } else {
-      uidComplete = true;
-      uid->sak = responseBuffer[0];
-    }
+  uint8_t index = (buffer[2] == PICC_CMD_CT) ? 3 : 2;
+  uint8_t bytesToCopy = (buffer[2] == PICC_CMD_CT) ? 3 : 4;
+  for (uint8_t count = 0; count < bytesToCopy; count++) {
+    ctx->uid->uidByte[ctx->uidIndex + count] = buffer[index++];
+  }
+
+  if (ctx->responseLength != 3 || ctx->txLastBits != 0)
+    return STATUS_ERROR;
+
+  uint8_t *responseBuffer = &buffer[ctx->responseIndex];
+  result = PCD_CalculateCRC(responseBuffer, 1, &buffer[2]);
+  if (result != STATUS_OK)
+    return result;
+
+  if ((buffer[2] != responseBuffer[1]) || (buffer[3] != responseBuffer[2])) {
+    return STATUS_CRC_WRONG;
   }
 
-  uid->size = 3 * cascadeLevel + 1;
+  if (responseBuffer[0] & 0x04) {
+    ctx->cascadeLevel++;
+    return PICC_SelectStartLevel(ctx);
+  }
 
+  ctx->complete = true;
+  ctx->uid->sak = responseBuffer[0];
+  ctx->uid->size = 3 * ctx->cascadeLevel + 1;
   return STATUS_OK;
 }
 
-MFRC522::StatusCode MFRC522::PICC_HaltA() {
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::PICC_HaltA() {
   StatusCode result;
   uint8_t buffer[4];
 
@@ -414,6 +1297,7 @@ MFRC522::StatusCode MFRC522::PICC_HaltA() {
   if (result != STATUS_OK)
     return result;
 
+  PCD_SetTimeout(TIMEOUT_ACTIVATION_US);
   result = PCD_TransceiveData(buffer, sizeof(buffer), NULL, 0);
   if (result == STATUS_TIMEOUT)
     return STATUS_OK;
@@ -423,9 +1307,27 @@ MFRC522::StatusCode MFRC522::PICC_HaltA() {
   return result;
 }
 
-MFRC522::StatusCode MFRC522::PCD_Authenticate(uint8_t command,
-                                              uint8_t blockAddr,
-                                              MIFARE_Key *key, Uid *uid) {
+// Brings a card that dropped out of its session after a failed
+// authentication or a NAK back to ACTIVE. WUPA wakes it from IDLE or HALT
+// and a SELECT with the complete UID singles it out again.
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::PICC_Reselect(Uid *uid) {
+  uint8_t bufferATQA[2];
+  uint8_t bufferSize = sizeof(bufferATQA);
+
+  PCD_StopCrypto1();
+  StatusCode result = PICC_WakeupA(bufferATQA, &bufferSize);
+  if (result != STATUS_OK && result != STATUS_COLLISION)
+    return result;
+
+  Uid known = *uid;
+  return PICC_Select(&known, known.size * 8);
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_Authenticate(uint8_t command, uint8_t blockAddr,
+                                      MIFARE_Key *key, Uid *uid) {
   uint8_t waitIRq = 0x10;
   uint8_t sendData[12];
 
@@ -438,14 +1340,20 @@ MFRC522::StatusCode MFRC522::PCD_Authenticate(uint8_t command,
     sendData[8 + i] = uid->uidByte[i];
   }
 
+  PCD_SetTimeout(TIMEOUT_MIFARE_US);
   return PCD_CommunicateWithPICC(PCD_MFAuthent, waitIRq, &sendData[0],
                                  sizeof(sendData));
 }
 
-void MFRC522::PCD_StopCrypto1() { PCD_ClearRegisterBitMask(Status2Reg, 0x08); }
+template <class Transport>
+void MFRC522T<Transport>::PCD_StopCrypto1() {
+  PCD_ClearRegisterBitMask(Status2Reg, 0x08);
+}
 
-MFRC522::StatusCode MFRC522::MIFARE_Read(uint8_t blockAddr, uint8_t *buffer,
-                                         uint8_t *bufferSize) {
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_Read(uint8_t blockAddr, uint8_t *buffer,
+                                 uint8_t *bufferSize) {
   StatusCode result;
 
   if (buffer == NULL || *bufferSize < 18)
@@ -457,30 +1365,343 @@ MFRC522::StatusCode MFRC522::MIFARE_Read(uint8_t blockAddr, uint8_t *buffer,
   if (result != STATUS_OK)
     return result;
 
+  PCD_SetTimeout(TIMEOUT_MIFARE_US);
   return PCD_TransceiveData(buffer, 4, buffer, bufferSize, NULL, 0, true);
 }
 
-MFRC522::StatusCode MFRC522::MIFARE_Write(uint8_t blockAddr, uint8_t *buffer,
-                                          uint8_t bufferSize) {
-  StatusCode result;
-
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_Write(uint8_t blockAddr, uint8_t *buffer,
+                                  uint8_t bufferSize) {
   if (buffer == NULL || bufferSize < 16)
     return STATUS_INVALID;
 
-  uint8_t cmdBuffer[2];
+  uint8_t cmdBuffer[4];
+  uint8_t dataBuffer[18];
   cmdBuffer[0] = PICC_CMD_MF_WRITE;
   cmdBuffer[1] = blockAddr;
-  result = PCD_MIFARE_Transceive(cmdBuffer, 2);
+  CalculateCRC_A(cmdBuffer, 2, &cmdBuffer[2]);
+  memcpy(dataBuffer, buffer, 16);
+  CalculateCRC_A(dataBuffer, 16, &dataBuffer[16]);
+
+  MIFARE_Frame frames[2] = {
+      {cmdBuffer, sizeof(cmdBuffer), TIMEOUT_MIFARE_US, false},
+      {dataBuffer, sizeof(dataBuffer), TIMEOUT_MIFARE_WRITE_US, false}};
+  return PCD_MIFARE_TransceiveChain(frames, 2);
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_UltralightWrite(uint8_t page, uint8_t *buffer,
+                                            uint8_t bufferSize) {
+  if (buffer == NULL || bufferSize < 4)
+    return STATUS_INVALID;
+
+  uint8_t cmdBuffer[8];
+  cmdBuffer[0] = PICC_CMD_UL_WRITE;
+  cmdBuffer[1] = page;
+  memcpy(&cmdBuffer[2], buffer, 4);
+  CalculateCRC_A(cmdBuffer, 6, &cmdBuffer[6]);
+
+  MIFARE_Frame frame = {cmdBuffer, sizeof(cmdBuffer), TIMEOUT_MIFARE_WRITE_US,
+                        false};
+  return PCD_MIFARE_TransceiveChain(&frame, 1);
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_GetValue(uint8_t blockAddr, int32_t *value) {
+  uint8_t buffer[18];
+  uint8_t size = sizeof(buffer);
+
+  if (value == NULL)
+    return STATUS_INVALID;
+
+  StatusCode result = MIFARE_Read(blockAddr, buffer, &size);
+  if (result != STATUS_OK)
+    return result;
+
+  return MIFARE_ParseValueBlock(buffer, value) ? STATUS_OK : STATUS_ERROR;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_SetValue(uint8_t blockAddr, int32_t value) {
+  uint8_t buffer[16];
+
+  MIFARE_MakeValueBlock(buffer, value, blockAddr);
+  return MIFARE_Write(blockAddr, buffer, sizeof(buffer));
+}
+
+void MFRC522Base::MIFARE_MakeValueBlock(uint8_t *buffer, int32_t value,
+                                        uint8_t blockAddr) {
+  for (uint8_t i = 0; i < 4; i++) {
+    uint8_t byte = (uint32_t)value >> (8 * i);
+    buffer[i] = byte;
+    buffer[4 + i] = ~byte;
+    buffer[8 + i] = byte;
+  }
+  buffer[12] = blockAddr;
+  buffer[13] = ~blockAddr;
+  buffer[14] = blockAddr;
+  buffer[15] = ~blockAddr;
+}
+
+// A value block holds the value three times, once inverted, and its address
+// byte four times, twice inverted. A torn write breaks the redundancy.
+bool MFRC522Base::MIFARE_ParseValueBlock(const uint8_t *buffer, int32_t *value,
+                                         uint8_t *blockAddr) {
+  for (uint8_t i = 0; i < 4; i++) {
+    if (buffer[i] != buffer[8 + i] || buffer[i] != (uint8_t)~buffer[4 + i])
+      return false;
+  }
+  if (buffer[12] != buffer[14] || buffer[13] != buffer[15] ||
+      buffer[12] != (uint8_t)~buffer[13])
+    return false;
+
+  *value = (int32_t)((uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
+                     ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24));
+  if (blockAddr)
+    *blockAddr = buffer[12];
+  return true;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_Decrement(uint8_t blockAddr, int32_t delta) {
+  return MIFARE_TwoStepHelper(PICC_CMD_MF_DECREMENT, blockAddr, delta);
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_Increment(uint8_t blockAddr, int32_t delta) {
+  return MIFARE_TwoStepHelper(PICC_CMD_MF_INCREMENT, blockAddr, delta);
+}
+
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::MIFARE_Restore(uint8_t blockAddr) {
+  return MIFARE_TwoStepHelper(PICC_CMD_MF_RESTORE, blockAddr, 0);
+}
+
+// DECREMENT, INCREMENT and RESTORE only fill the transfer buffer; TRANSFER
+// writes it to a block of the same sector.
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_Transfer(uint8_t blockAddr) {
+  uint8_t cmdBuffer[4];
+  cmdBuffer[0] = PICC_CMD_MF_TRANSFER;
+  cmdBuffer[1] = blockAddr;
+  CalculateCRC_A(cmdBuffer, 2, &cmdBuffer[2]);
+
+  MIFARE_Frame frame = {cmdBuffer, sizeof(cmdBuffer), TIMEOUT_MIFARE_WRITE_US,
+                        false};
+  return PCD_MIFARE_TransceiveChain(&frame, 1);
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_TwoStepHelper(uint8_t command, uint8_t blockAddr,
+                                          int32_t data) {
+  uint8_t cmdBuffer[4];
+  uint8_t dataBuffer[6];
+  cmdBuffer[0] = command;
+  cmdBuffer[1] = blockAddr;
+  CalculateCRC_A(cmdBuffer, 2, &cmdBuffer[2]);
+  for (uint8_t i = 0; i < 4; i++) {
+    dataBuffer[i] = (uint32_t)data >> (8 * i);
+  }
+  CalculateCRC_A(dataBuffer, 4, &dataBuffer[4]);
+
+  MIFARE_Frame frames[2] = {
+      {cmdBuffer, sizeof(cmdBuffer), TIMEOUT_MIFARE_US, false},
+      {dataBuffer, sizeof(dataBuffer), TIMEOUT_MIFARE_OPERAND_US, true}};
+  return PCD_MIFARE_TransceiveChain(frames, 2);
+}
+
+// Fills trailer bytes 6-8 from the access conditions of the four block
+// groups, each given as C1 C2 C3 in bits 2-0. Pure computation, so trailers
+// can be built without a reader.
+void MFRC522Base::MIFARE_SetAccessBits(uint8_t *accessBitBuffer, uint8_t g0,
+                                       uint8_t g1, uint8_t g2, uint8_t g3) {
+  uint8_t c1 = ((g3 & 4) << 1) | ((g2 & 4) << 0) | ((g1 & 4) >> 1) |
+               ((g0 & 4) >> 2);
+  uint8_t c2 = ((g3 & 2) << 2) | ((g2 & 2) << 1) | ((g1 & 2) << 0) |
+               ((g0 & 2) >> 1);
+  uint8_t c3 = ((g3 & 1) << 3) | ((g2 & 1) << 2) | ((g1 & 1) << 1) |
+               ((g0 & 1) << 0);
+
+  accessBitBuffer[0] = (~c2 & 0xF) << 4 | (~c1 & 0xF);
+  accessBitBuffer[1] = c1 << 4 | (~c3 & 0xF);
+  accessBitBuffer[2] = c3 << 4 | c2;
+}
+
+// The whole sector is read under one authentication. A block the card
+// refuses ends the session, so the card is reselected and authenticated
+// again before the next block.
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::MIFARE_ReadSector(
+    Uid *uid, MIFARE_Key *key, uint8_t sector, uint8_t *data,
+    StatusCode *blockStatus, uint8_t command) {
+  if (sector >= MIFARE_MAX_SECTORS || data == NULL || blockStatus == NULL)
+    return STATUS_INVALID;
+
+  uint8_t firstBlock = MIFARE_GetSectorFirstBlock(sector);
+  uint8_t blockCount = MIFARE_GetSectorBlockCount(sector);
+  uint8_t trailer = firstBlock + blockCount - 1;
+  StatusCode status = STATUS_OK;
+  bool authenticated = false;
+
+  for (uint8_t offset = 0; offset < blockCount; offset++) {
+    StatusCode result = STATUS_OK;
+    if (!authenticated) {
+      result = PCD_Authenticate(command, trailer, key, uid);
+      if (result != STATUS_OK) {
+        for (uint8_t i = offset; i < blockCount; i++) {
+          blockStatus[i] = result;
+        }
+        PICC_Reselect(uid);
+        return status == STATUS_OK ? result : status;
+      }
+      authenticated = true;
+    }
+
+    uint8_t buffer[18];
+    uint8_t size = sizeof(buffer);
+    result = MIFARE_Read(firstBlock + offset, buffer, &size);
+    blockStatus[offset] = result;
+    if (result == STATUS_OK) {
+      memcpy(&data[16 * offset], buffer, 16);
+      continue;
+    }
+
+    if (status == STATUS_OK)
+      status = result;
+    authenticated = false;
+    PICC_Reselect(uid);
+  }
+
+  return status;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_ReadCard(Uid *uid, uint8_t piccType,
+                                     MIFARE_Key *key, uint8_t *data,
+                                     StatusCode *blockStatus, uint8_t command) {
+  uint8_t sectorCount = MIFARE_GetSectorCount(piccType);
+  if (sectorCount == 0)
+    return STATUS_INVALID;
+
+  StatusCode status = STATUS_OK;
+  for (uint8_t sector = 0; sector < sectorCount; sector++) {
+    uint8_t firstBlock = MIFARE_GetSectorFirstBlock(sector);
+    StatusCode result =
+        MIFARE_ReadSector(uid, key, sector, &data[16 * firstBlock],
+                          &blockStatus[firstBlock], command);
+    if (status == STATUS_OK)
+      status = result;
+  }
+
+  return status;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_UltralightFastRead(uint8_t startPage,
+                                               uint8_t endPage, uint8_t *buffer,
+                                               uint8_t *bufferSize) {
+  StatusCode result;
+
+  if (buffer == NULL || endPage < startPage ||
+      endPage - startPage >= UL_MAX_CHUNK_PAGES)
+    return STATUS_INVALID;
+  if (*bufferSize < (endPage - startPage + 1) * 4 + 2)
+    return STATUS_NO_ROOM;
+
+  buffer[0] = PICC_CMD_UL_FAST_READ;
+  buffer[1] = startPage;
+  buffer[2] = endPage;
+  result = PCD_CalculateCRC(buffer, 3, &buffer[3]);
   if (result != STATUS_OK)
     return result;
 
-  result = PCD_MIFARE_Transceive(buffer, bufferSize);
+  PCD_SetTimeout(TIMEOUT_MIFARE_US);
+  result = PCD_TransceiveData(buffer, 5, buffer, bufferSize, NULL, 0, true);
+  if (result == STATUS_OK && *bufferSize != (endPage - startPage + 1) * 4 + 2)
+    return STATUS_ERROR;
   return result;
 }
 
-MFRC522::StatusCode MFRC522::PCD_MIFARE_Transceive(uint8_t *sendData,
-                                                   uint8_t sendLen,
-                                                   bool acceptTimeout) {
+// The first chunk is small because short NDEF messages end within a few
+// pages; later chunks double up to what fits the FIFO in one frame.
+template <class Transport>
+MFRC522Base::StatusCode MFRC522T<Transport>::MIFARE_UltralightReadPages(
+    uint8_t startPage, uint16_t pageCount,
+    Callback<bool(const uint8_t *, uint16_t)> consumer, bool fastRead) {
+  uint8_t buffer[FIFO_SIZE];
+  uint8_t chunk = UL_FIRST_CHUNK_PAGES;
+
+  while (pageCount > 0) {
+    uint8_t pages = (pageCount < chunk) ? pageCount : chunk;
+    uint8_t size = sizeof(buffer);
+    StatusCode result;
+    if (fastRead) {
+      result = MIFARE_UltralightFastRead(startPage, startPage + pages - 1,
+                                         buffer, &size);
+    } else {
+      if (pages > 4)
+        pages = 4;
+      result = MIFARE_Read(startPage, buffer, &size);
+    }
+    if (result != STATUS_OK)
+      return result;
+
+    if (!consumer(buffer, pages * 4))
+      return STATUS_OK;
+
+    startPage += pages;
+    pageCount -= pages;
+    chunk = (chunk * 2 < UL_MAX_CHUNK_PAGES) ? chunk * 2 : UL_MAX_CHUNK_PAGES;
+  }
+
+  return STATUS_OK;
+}
+
+// Page 3 holds the capability container; the READ that fetches it also
+// returns the first three data pages. Reading stops as soon as the parser
+// has what it needs. The parser is reset first; check it for the records.
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::MIFARE_UltralightReadNdef(NdefParser *parser,
+                                               bool fastRead) {
+  uint8_t buffer[18];
+  uint8_t size = sizeof(buffer);
+
+  if (parser == NULL)
+    return STATUS_INVALID;
+
+  parser->Reset();
+  StatusCode result = MIFARE_Read(3, buffer, &size);
+  if (result != STATUS_OK)
+    return result;
+  if (buffer[0] != 0xE1)
+    return STATUS_ERROR;
+
+  uint16_t dataPages = buffer[2] * 2;
+  if (parser->Feed(&buffer[4], 12) && dataPages > 3) {
+    result = MIFARE_UltralightReadPages(
+        7, dataPages - 3, callback(parser, &NdefParser::Feed), fastRead);
+  }
+
+  if (result == STATUS_OK && parser->HasError())
+    return STATUS_ERROR;
+  return result;
+}
+
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_MIFARE_Transceive(uint8_t *sendData, uint8_t sendLen,
+                                           bool acceptTimeout) {
   StatusCode result;
   uint8_t cmdBuffer[18];
 
@@ -512,7 +1733,82 @@ MFRC522::StatusCode MFRC522::PCD_MIFARE_Transceive(uint8_t *sendData,
   return STATUS_OK;
 }
 
-bool MFRC522::PICC_IsNewCardPresent() {
+// A NAK or a lost ACK means the card has dropped to IDLE, so the frame
+// already started behind it is aborted. A passive ACK frame succeeds when
+// its timer expires; only an answer to it is checked.
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PCD_MIFARE_TransceiveChain(const MIFARE_Frame *frames,
+                                                uint8_t count, uint8_t *acked) {
+  if (acked)
+    *acked = 0;
+  if (frames == NULL || count == 0)
+    return STATUS_INVALID;
+
+  PCD_SetTimeout(frames[0].timeoutUs);
+  StatusCode status =
+      PCD_BeginCommunication(PCD_Transceive, frames[0].data, frames[0].length);
+  if (status != STATUS_OK)
+    return status;
+
+  for (uint8_t i = 0; i < count; i++) {
+    status = PCD_WaitForIrq(ComIrqReg, ComIEnReg, 0x30, 0x01,
+                            PCD_GetHostTimeout(PCD_Transceive, frames[i].length));
+    bool silent = status == STATUS_TIMEOUT && frames[i].passiveAck;
+    if (status != STATUS_OK && !silent)
+      return PCD_CountStatus(status);
+
+    uint8_t errorRegValue;
+    uint8_t fifoLevel;
+    uint8_t controlRegValue;
+    uint8_t ack;
+    bool more = i + 1 < count;
+    Transaction transaction;
+    transaction.Read(ErrorReg, &errorRegValue);
+    transaction.Read(FIFOLevelReg, &fifoLevel);
+    transaction.Read(ControlReg, &controlRegValue);
+    transaction.Read(FIFODataReg, &ack);
+    if (more) {
+      PCD_SetTimeout(frames[i + 1].timeoutUs);
+      if (!PCD_PrepareCommunication(&transaction, PCD_Transceive,
+                                    frames[i + 1].data, frames[i + 1].length,
+                                    0, 0))
+        return STATUS_NO_ROOM;
+    }
+    PCD_ExecuteTransaction(&transaction);
+
+    status = PCD_CountStatus(
+        silent ? STATUS_OK
+               : PCD_CheckMifareAck(errorRegValue, fifoLevel,
+                                    controlRegValue & 0x07, ack));
+    if (status != STATUS_OK) {
+      if (more)
+        PCD_AbortCommunication();
+      return status;
+    }
+    if (acked)
+      (*acked)++;
+  }
+
+  return STATUS_OK;
+}
+
+MFRC522Base::StatusCode
+MFRC522Base::PCD_CheckMifareAck(uint8_t errorRegValue, uint8_t fifoLevel,
+                                uint8_t validBits, uint8_t ack) {
+  if (errorRegValue & 0x13)
+    return STATUS_ERROR;
+  if (errorRegValue & 0x08)
+    return STATUS_COLLISION;
+  if (fifoLevel != 1 || validBits != 4)
+    return STATUS_ERROR;
+  if (ack != 0x0A)
+    return STATUS_MIFARE_NACK;
+  return STATUS_OK;
+}
+
+template <class Transport>
+bool MFRC522T<Transport>::PICC_IsNewCardPresent() {
   uint8_t bufferATQA[2];
   uint8_t bufferSize = sizeof(bufferATQA);
 
@@ -524,12 +1820,84 @@ bool MFRC522::PICC_IsNewCardPresent() {
   return (result == STATUS_OK || result == STATUS_COLLISION);
 }
 
-bool MFRC522::PICC_ReadCardSerial() {
+template <class Transport>
+bool MFRC522T<Transport>::PICC_ReadCardSerial() {
   StatusCode result = PICC_Select(&uid);
   return (result == STATUS_OK);
 }
 
-uint8_t MFRC522::PICC_GetType(uint8_t sak) {
+// Enumerates every card in the field. Each pass selects the card on the
+// '1' branch of every collision and halts it, so the next REQA only wakes
+// the cards not yet read. The first request is a WUPA so that a card halted
+// by a previous read takes part again; of several halted cards only the
+// first selected does, as the others drop back to HALT.
+template <class Transport>
+MFRC522Base::StatusCode
+MFRC522T<Transport>::PICC_Inventory(Uid *uids, uint8_t maxUids,
+                                    uint8_t *uidCount) {
+  uint8_t command = PICC_CMD_WUPA;
+  uint8_t retries = 0;
+
+  if (uids == NULL || uidCount == NULL)
+    return STATUS_INVALID;
+
+  *uidCount = 0;
+
+  PCD_WriteRegister(TxModeReg, 0x00);
+  PCD_WriteRegister(RxModeReg, 0x00);
+  PCD_WriteRegister(ModWidthReg, 0x26);
+
+  while (*uidCount < maxUids) {
+    uint8_t bufferATQA[2];
+    uint8_t bufferSize = sizeof(bufferATQA);
+    StatusCode result = PICC_REQA_or_WUPA(command, bufferATQA, &bufferSize);
+
+    // Silence means the field is empty, unless a card is still settling
+    // after a failed select.
+    if (result == STATUS_TIMEOUT && retries == 0)
+      return STATUS_OK;
+
+    if (result == STATUS_OK || result == STATUS_COLLISION) {
+      Uid *card = &uids[*uidCount];
+      memset(card, 0, sizeof(Uid));
+      result = PICC_Select(card);
+    }
+
+    // A card left READY or ACTIVE by a failed select ignores REQA. WUPA
+    // returns it to IDLE and wakes the cards already halted, so the next
+    // round selects one of those again and goes back to REQA.
+    if (result != STATUS_OK) {
+      if (++retries > INVENTORY_MAX_RETRIES)
+        return result;
+      command = PICC_CMD_WUPA;
+      continue;
+    }
+
+    bool known = false;
+    for (uint8_t i = 0; i < *uidCount && !known; i++) {
+      known = uids[i].size == uids[*uidCount].size &&
+              memcmp(uids[i].uidByte, uids[*uidCount].uidByte,
+                     uids[i].size) == 0;
+    }
+    if (known) {
+      // Answering REQA again means the card ignored HLTA.
+      if (command == PICC_CMD_REQA)
+        return STATUS_OK;
+      command = PICC_CMD_REQA;
+      PICC_HaltA();
+      continue;
+    }
+
+    (*uidCount)++;
+    retries = 0;
+    command = PICC_CMD_REQA;
+    PICC_HaltA();
+  }
+
+  return STATUS_OK;
+}
+
+uint8_t MFRC522Base::PICC_GetType(uint8_t sak) {
   sak &= 0x7F;
   switch (sak) {
   case 0x04:
@@ -556,7 +1924,7 @@ uint8_t MFRC522::PICC_GetType(uint8_t sak) {
   }
 }
 
-const char *MFRC522::PICC_GetTypeName(uint8_t piccType) {
+const char * MFRC522Base::PICC_GetTypeName(uint8_t piccType) {
   switch (piccType) {
   case PICC_TYPE_ISO_14443_4:
     return "PICC compliant with ISO/IEC 14443-4";
@@ -582,7 +1950,7 @@ const char *MFRC522::PICC_GetTypeName(uint8_t piccType) {
   }
 }
 
-const char *MFRC522::GetStatusCodeName(StatusCode code) {
+const char * MFRC522Base::GetStatusCodeName(StatusCode code) {
   switch (code) {
   case STATUS_OK:
     return "Success";
@@ -606,3 +1974,182 @@ const char *MFRC522::GetStatusCodeName(StatusCode code) {
     return "Unknown error";
   }
 }
+
+uint8_t MFRC522Base::MIFARE_GetSectorCount(uint8_t piccType) {
+  switch (piccType) {
+  case PICC_TYPE_MIFARE_MINI:
+    return 5;
+  case PICC_TYPE_MIFARE_1K:
+    return 16;
+  case PICC_TYPE_MIFARE_4K:
+    return 40;
+  default:
+    return 0;
+  }
+}
+
+// Sectors 0-31 hold four blocks each; the 4K sectors 32-39 hold sixteen.
+uint8_t MFRC522Base::MIFARE_GetSectorFirstBlock(uint8_t sector) {
+  return sector < 32 ? sector * 4 : 128 + (sector - 32) * 16;
+}
+
+uint8_t MFRC522Base::MIFARE_GetSectorBlockCount(uint8_t sector) {
+  if (sector < 32)
+    return 4;
+  return sector < MIFARE_MAX_SECTORS ? 16 : 0;
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PICC_DumpToSerial(Uid *uid) {
+  MIFARE_Key key;
+  memset(key.keyByte, 0xFF, sizeof(key.keyByte));
+
+  PICC_DumpDetailsToSerial(uid);
+
+  uint8_t piccType = PICC_GetType(uid->sak);
+  switch (piccType) {
+  case PICC_TYPE_MIFARE_MINI:
+  case PICC_TYPE_MIFARE_1K:
+  case PICC_TYPE_MIFARE_4K:
+    PICC_DumpMifareClassicToSerial(uid, piccType, &key);
+    break;
+  case PICC_TYPE_MIFARE_UL:
+    PIFARE_UltralightDumpToSerial();
+    break;
+  case PICC_TYPE_ISO_14443_4:
+  case PICC_TYPE_ISO_18092:
+  case PICC_TYPE_MIFARE_PLUS:
+  case PICC_TYPE_TNP3XXX:
+    printf("Dumping memory contents not implemented for that PICC type.\n");
+    break;
+  default:
+    break;
+  }
+
+  printf("\n");
+  PICC_HaltA();
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PICC_DumpDetailsToSerial(Uid *uid) {
+  printf("Card UID:");
+  for (uint8_t i = 0; i < uid->size; i++) {
+    printf(" %02X", uid->uidByte[i]);
+  }
+  printf("\nCard SAK: %02X\n", uid->sak);
+  printf("PICC type: %s\n", PICC_GetTypeName(PICC_GetType(uid->sak)));
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PICC_DumpMifareClassicToSerial(
+    Uid *uid, uint8_t piccType, MIFARE_Key *key) {
+  uint8_t sectorCount = MIFARE_GetSectorCount(piccType);
+  if (sectorCount == 0)
+    return;
+
+  printf("Sector Block   0  1  2  3   4  5  6  7   8  9 10 11  12 13 14 15  "
+         "AccessBits\n");
+  for (int8_t sector = sectorCount - 1; sector >= 0; sector--) {
+    PICC_DumpMifareClassicSectorToSerial(uid, key, sector);
+  }
+
+  PICC_HaltA();
+  PCD_StopCrypto1();
+}
+
+// The sector is read in one pass before anything is printed, so the card
+// session does not wait on the serial port.
+template <class Transport>
+void MFRC522T<Transport>::PICC_DumpMifareClassicSectorToSerial(
+    Uid *uid, MIFARE_Key *key, uint8_t sector) {
+  uint8_t data[16 * 16];
+  StatusCode blockStatus[16];
+
+  uint8_t blockCount = MIFARE_GetSectorBlockCount(sector);
+  if (blockCount == 0)
+    return;
+
+  uint8_t firstBlock = MIFARE_GetSectorFirstBlock(sector);
+  MIFARE_ReadSector(uid, key, sector, data, blockStatus);
+
+  // Access bits live in trailer bytes 6-8, each stored with its inverse.
+  uint8_t groups[4];
+  bool hasAccessBits = blockStatus[blockCount - 1] == STATUS_OK;
+  bool invertedError = false;
+  if (hasAccessBits) {
+    const uint8_t *trailer = &data[16 * (blockCount - 1)];
+    uint8_t c1 = trailer[7] >> 4;
+    uint8_t c2 = trailer[8] & 0x0F;
+    uint8_t c3 = trailer[8] >> 4;
+    invertedError = c1 != (~trailer[6] & 0x0F) ||
+                    c2 != (~trailer[6] >> 4 & 0x0F) ||
+                    c3 != (~trailer[7] & 0x0F);
+    for (uint8_t i = 0; i < 4; i++) {
+      groups[i] = (((c1 >> i) & 1) << 2) | (((c2 >> i) & 1) << 1) |
+                  ((c3 >> i) & 1);
+    }
+  }
+
+  for (int8_t offset = blockCount - 1; offset >= 0; offset--) {
+    if (offset == blockCount - 1)
+      printf("%5u  ", sector);
+    else
+      printf("       ");
+    printf("%4u  ", firstBlock + offset);
+
+    if (blockStatus[offset] != STATUS_OK) {
+      printf("%s\n", GetStatusCodeName(blockStatus[offset]));
+      continue;
+    }
+
+    const uint8_t *block = &data[16 * offset];
+    for (uint8_t i = 0; i < 16; i++) {
+      printf(" %02X", block[i]);
+      if ((i % 4) == 3)
+        printf(" ");
+    }
+
+    if (hasAccessBits) {
+      uint8_t group = (blockCount == 4) ? offset : offset / 5;
+      if (offset == blockCount - 1)
+        group = 3;
+      printf(" [ %u %u %u ]", (groups[group] >> 2) & 1,
+             (groups[group] >> 1) & 1, groups[group] & 1);
+      if (offset == blockCount - 1 && invertedError)
+        printf(" Inverted access bits did not match!");
+      if (group != 3 && (groups[group] == 1 || groups[group] == 6)) {
+        uint32_t value = (uint32_t)block[0] | ((uint32_t)block[1] << 8) |
+                         ((uint32_t)block[2] << 16) |
+                         ((uint32_t)block[3] << 24);
+        printf(" Value=0x%08lX Adr=0x%02X", (unsigned long)value, block[12]);
+      }
+    }
+    printf("\n");
+  }
+}
+
+template <class Transport>
+void MFRC522T<Transport>::PIFARE_UltralightDumpToSerial() {
+  uint8_t buffer[18];
+
+  printf("Page  0  1  2  3\n");
+  for (uint8_t page = 0; page < 16; page += 4) {
+    uint8_t size = sizeof(buffer);
+    StatusCode result = MIFARE_Read(page, buffer, &size);
+    if (result != STATUS_OK) {
+      printf("MIFARE_Read() failed: %s\n", GetStatusCodeName(result));
+      return;
+    }
+
+    for (uint8_t offset = 0; offset < 4; offset++) {
+      printf("%3u  ", page + offset);
+      for (uint8_t i = 0; i < 4; i++) {
+        printf(" %02X", buffer[4 * offset + i]);
+      }
+      printf("\n");
+    }
+  }
+}
+
+template class MFRC522T<MFRC522Transport>;
+template class MFRC522T<MFRC522SpiTransport>;
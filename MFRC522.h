@@ -2,8 +2,11 @@
 #define MFRC522_H
 
 #include "mbed.h"
+#include "MFRC522Transport.h"
 
-class MFRC522 {
+class NdefParser;
+
+class MFRC522Base {
 public:
     enum PCD_Register {
         CommandReg            = 0x01,
@@ -87,7 +90,8 @@ public:
         PICC_CMD_MF_INCREMENT = 0xC1,
         PICC_CMD_MF_RESTORE   = 0xC2,
         PICC_CMD_MF_TRANSFER  = 0xB0,
-        PICC_CMD_UL_WRITE     = 0xA2
+        PICC_CMD_UL_WRITE     = 0xA2,
+        PICC_CMD_UL_FAST_READ = 0x3A
     };
 
     enum StatusCode {
@@ -99,9 +103,23 @@ public:
         STATUS_INTERNAL_ERROR = 6,
         STATUS_INVALID        = 7,
         STATUS_CRC_WRONG      = 8,
-        STATUS_MIFARE_NACK    = 9
+        STATUS_MIFARE_NACK    = 9,
+        STATUS_CODE_COUNT
     };
 
+    static const uint8_t REGISTER_COUNT = 64;
+
+    // Frame waiting time budgets, measured by the chip timer from the end of
+    // transmission to the start of the response.
+    static const uint32_t TIMEOUT_DEFAULT_US = 25000;
+    static const uint32_t TIMEOUT_ACTIVATION_US = 1000;     // REQA, WUPA, anticollision, SELECT, HLTA
+    static const uint32_t TIMEOUT_MIFARE_US = 5000;         // authentication, READ, command phase of WRITE
+    static const uint32_t TIMEOUT_MIFARE_WRITE_US = 10000;  // data phase of WRITE, TRANSFER
+    static const uint32_t TIMEOUT_MIFARE_OPERAND_US = 1000; // passive ACK of a value operand
+
+    static const uint16_t MAX_STREAM_FRAME = 256;           // ISO 14443-4 FSD/FSC limit
+    static const uint32_t SPI_MAX_FREQUENCY = 10000000;     // datasheet limit of the SPI interface
+
     struct Uid {
         uint8_t size;
         uint8_t uidByte[10];
@@ -112,15 +130,133 @@ public:
         uint8_t keyByte[6];
     };
 
-    MFRC522(PinName mosi, PinName miso, PinName sclk, PinName cs, PinName reset);
+    // Progress of a PICC_Select, so anticollision can be driven one frame at
+    // a time: PrepareFrame, transceive buffer[0..bufferUsed) into
+    // buffer[responseIndex], then HandleResponse until complete is set.
+    struct SelectContext {
+        Uid *uid;
+        uint8_t validBits;
+        uint8_t cascadeLevel;
+        uint8_t uidIndex;
+        bool useCascadeTag;
+        int8_t currentLevelKnownBits;
+        uint8_t buffer[9];
+        uint8_t bufferUsed;
+        uint8_t txLastBits;
+        uint8_t rxAlign;
+        uint8_t responseIndex;
+        uint8_t responseLength;
+        bool complete;
+    };
+
+    // A frame that the card answers with a 4-bit ACK, CRC_A already appended.
+    // The operand of a value command is acknowledged by silence instead.
+    struct MIFARE_Frame {
+        uint8_t *data;
+        uint8_t length;
+        uint32_t timeoutUs;
+        bool passiveAck;
+    };
+
+    // A sequence of register accesses executed as back-to-back SPI frames.
+    // Each write needs its own frame; consecutive reads share one frame.
+    class Transaction {
+    public:
+        static const uint8_t MAX_BYTES = 88;
+        static const uint8_t MAX_FRAMES = 12;
+        static const uint8_t MAX_READS = 8;
+
+        Transaction();
+        void Clear();
+        bool Write(uint8_t reg, uint8_t value);
+        bool Write(uint8_t reg, uint8_t count, const uint8_t *values);
+        bool Read(uint8_t reg, uint8_t *value);
+        bool Read(uint8_t reg, uint8_t count, uint8_t *values);
+        uint8_t GetFrameCount() const { return _frameCount; }
+        uint8_t GetByteCount() const { return _length; }
+
+    private:
+        template <class> friend class MFRC522T;
+
+        struct ReadSlot {
+            uint8_t offset;
+            uint8_t count;
+            uint8_t *dest;
+        };
+
+        uint8_t FrameStart(uint8_t frame) const { return _frameStart[frame]; }
+        uint8_t FrameEnd(uint8_t frame) const { return frame + 1 < _frameCount ? _frameStart[frame + 1] : _length; }
+
+        uint8_t _tx[MAX_BYTES];
+        uint8_t _rx[MAX_BYTES];
+        uint8_t _frameStart[MAX_FRAMES];
+        ReadSlot _reads[MAX_READS];
+        uint8_t _length;
+        uint8_t _frameCount;
+        uint8_t _readCount;
+        bool _readFrameOpen;
+    };
+
+    // Helpers that need no chip, shared by every transport.
+    static uint32_t PCD_GetFrameTimeUs(uint16_t bytes);
+    static void CalculateCRC_A(const uint8_t *data, uint8_t length, uint8_t *result);
+    static void MIFARE_MakeValueBlock(uint8_t *buffer, int32_t value, uint8_t blockAddr);
+    static bool MIFARE_ParseValueBlock(const uint8_t *buffer, int32_t *value, uint8_t *blockAddr = NULL);
+    static uint8_t PICC_GetType(uint8_t sak);
+    static const char* PICC_GetTypeName(uint8_t type);
+    static const char* GetStatusCodeName(StatusCode code);
+    static uint8_t MIFARE_GetSectorCount(uint8_t piccType);
+    static uint8_t MIFARE_GetSectorFirstBlock(uint8_t sector);
+    static uint8_t MIFARE_GetSectorBlockCount(uint8_t sector);
+    static void MIFARE_SetAccessBits(uint8_t *accessBitBuffer, uint8_t g0, uint8_t g1, uint8_t g2, uint8_t g3);
+
+    // First byte of an SPI frame: bit 7 reads, bits 6-1 the register.
+    static constexpr uint8_t ReadAddress(uint8_t reg) { return 0x80 | ((reg << 1) & 0x7E); }
+    static constexpr uint8_t WriteAddress(uint8_t reg) { return (reg << 1) & 0x7E; }
+
+protected:
+    static StatusCode PCD_CheckMifareAck(uint8_t errorRegValue, uint8_t fifoLevel, uint8_t validBits, uint8_t ack);
+
+    static const uint8_t MIFARE_MAX_SECTORS = 40;
+};
+
+// The driver, parameterised on its transport. Over MFRC522Transport every
+// SPI frame is a virtual call, which the simulator and other test doubles
+// rely on; over a final transport such as MFRC522SpiTransport the compiler
+// sees the SPI calls and inlines them into the register accessors. Only the
+// instantiations at the end of MFRC522.cpp exist.
+template <class Transport>
+class MFRC522T : public MFRC522Base {
+public:
+    MFRC522T(PinName mosi, PinName miso, PinName sclk, PinName cs, PinName reset, PinName irq = NC);
+    explicit MFRC522T(Transport *transport);
+    ~MFRC522T();
     
     void PCD_Init();
+    void PCD_SetResetLine(bool active);
+    void PCD_Configure();
+    uint64_t PCD_GetTimeUs();
+    void PCD_DelayUs(uint32_t us);
+    // PICC_* and MIFARE_* commands set their own budget; PCD_TransceiveData
+    // and PCD_CommunicateWithPICC use whichever was set last.
+    void PCD_SetTimeout(uint32_t timeoutUs);
+    uint32_t PCD_GetTimeout() const;
+    uint32_t PCD_GetHostTimeout(uint8_t command, uint16_t sendLen) const;
     void PCD_Reset();
     void PCD_AntennaOn();
     void PCD_AntennaOff();
     uint8_t PCD_GetAntennaGain();
     void PCD_SetAntennaGain(uint8_t mask);
+    // Datasheet digital self-test: the CRC coprocessor fills the FIFO with 64
+    // bytes that must match the reference of the chip version. Resets the
+    // chip and configures it as PCD_Init does. False for an unknown version.
     bool PCD_PerformSelfTest();
+    // Raises the SPI clock step by step up to maxHz while register read-back
+    // and the self-test pass, then settles on the last step that passed.
+    // Run it right after PCD_Init. STATUS_ERROR if the lowest step fails.
+    StatusCode PCD_CalibrateSpiClock(uint32_t maxHz = SPI_MAX_FREQUENCY);
+    // The clock chosen by PCD_CalibrateSpiClock, 0 before it ran.
+    uint32_t PCD_GetSpiFrequency() const;
     
     void PCD_WriteRegister(uint8_t reg, uint8_t value);
     void PCD_WriteRegister(uint8_t reg, uint8_t count, uint8_t *values);
@@ -128,35 +264,76 @@ public:
     void PCD_ReadRegister(uint8_t reg, uint8_t count, uint8_t *values, uint8_t rxAlign = 0);
     void PCD_SetRegisterBitMask(uint8_t reg, uint8_t mask);
     void PCD_ClearRegisterBitMask(uint8_t reg, uint8_t mask);
+    void PCD_SetRegisterShadow(bool enable);
+    void PCD_InvalidateRegisterShadow();
+    uint32_t PCD_GetShadowHits(uint8_t reg) const;
+    uint32_t PCD_GetShadowMisses(uint8_t reg) const;
+    void PCD_ResetShadowCounters();
+    void PCD_ExecuteTransaction(Transaction *transaction);
+    // The callback runs in interrupt context once every frame has completed.
+    // Returns STATUS_ERROR if the transport cannot transfer asynchronously.
+    StatusCode PCD_ExecuteTransactionAsync(Transaction *transaction, Callback<void(StatusCode)> done);
+    bool PCD_IsTransactionPending() const;
+    uint32_t PCD_GetSpiFrameCount() const;
+    uint32_t PCD_GetSpiByteCount() const;
+    void PCD_ResetSpiCounters();
+    // Outcome of every synchronous exchange with a card, by status.
+    uint32_t PCD_GetStatusCount(StatusCode status) const;
+    void PCD_ResetStatusCounters();
     StatusCode PCD_CalculateCRC(uint8_t *data, uint8_t length, uint8_t *result);
+    void PCD_SetHardwareCRC(bool enable);
     
     StatusCode PCD_TransceiveData(uint8_t *sendData, uint8_t sendLen, uint8_t *backData, uint8_t *backLen, uint8_t *validBits = NULL, uint8_t rxAlign = 0, bool checkCRC = false);
+    // Frames longer than the FIFO, up to MAX_STREAM_FRAME bytes each way: the
+    // FIFO is refilled while the frame goes out and drained while the answer
+    // comes in, paced by the water level alerts.
+    StatusCode PCD_TransceiveStream(uint8_t *sendData, uint16_t sendLen, uint8_t *backData, uint16_t *backLen, bool checkCRC = false);
     StatusCode PCD_CommunicateWithPICC(uint8_t command, uint8_t waitIRq, uint8_t *sendData, uint8_t sendLen, uint8_t *backData = NULL, uint8_t *backLen = NULL, uint8_t *validBits = NULL, uint8_t rxAlign = 0, bool checkCRC = false);
+    StatusCode PCD_BeginCommunication(uint8_t command, uint8_t *sendData, uint8_t sendLen, uint8_t txLastBits = 0, uint8_t rxAlign = 0);
+    bool PCD_PollCommunication(uint8_t waitIRq, StatusCode *status);
+    void PCD_AbortCommunication();
+    StatusCode PCD_FinishCommunication(uint8_t *backData = NULL, uint8_t *backLen = NULL, uint8_t *validBits = NULL, uint8_t rxAlign = 0, bool checkCRC = false);
+    StatusCode PCD_CheckResponseCRC(uint8_t *backData, uint16_t backLen, uint8_t validBits);
     StatusCode PICC_RequestA(uint8_t *bufferATQA, uint8_t *bufferSize);
     StatusCode PICC_WakeupA(uint8_t *bufferATQA, uint8_t *bufferSize);
     StatusCode PICC_REQA_or_WUPA(uint8_t command, uint8_t *bufferATQA, uint8_t *bufferSize);
     StatusCode PICC_Select(Uid *uid, uint8_t validBits = 0);
+    StatusCode PICC_SelectBegin(SelectContext *ctx, Uid *uid, uint8_t validBits = 0);
+    StatusCode PICC_SelectPrepareFrame(SelectContext *ctx);
+    StatusCode PICC_SelectHandleResponse(SelectContext *ctx, StatusCode result);
     StatusCode PICC_HaltA();
+    StatusCode PICC_Reselect(Uid *uid);
     
     StatusCode PCD_Authenticate(uint8_t command, uint8_t blockAddr, MIFARE_Key *key, Uid *uid);
     void PCD_StopCrypto1();
     StatusCode MIFARE_Read(uint8_t blockAddr, uint8_t *buffer, uint8_t *bufferSize);
     StatusCode MIFARE_Write(uint8_t blockAddr, uint8_t *buffer, uint8_t bufferSize);
+    // Bulk reads authenticate once per sector and store 16 bytes per block.
+    // blockStatus receives the result of every block; the return value is
+    // STATUS_OK or the first failure. ReadCard indexes both by block address.
+    StatusCode MIFARE_ReadSector(Uid *uid, MIFARE_Key *key, uint8_t sector, uint8_t *data, StatusCode *blockStatus, uint8_t command = PICC_CMD_MF_AUTH_KEY_A);
+    StatusCode MIFARE_ReadCard(Uid *uid, uint8_t piccType, MIFARE_Key *key, uint8_t *data, StatusCode *blockStatus, uint8_t command = PICC_CMD_MF_AUTH_KEY_A);
     StatusCode MIFARE_Decrement(uint8_t blockAddr, int32_t delta);
     StatusCode MIFARE_Increment(uint8_t blockAddr, int32_t delta);
     StatusCode MIFARE_Restore(uint8_t blockAddr);
     StatusCode MIFARE_Transfer(uint8_t blockAddr);
     StatusCode MIFARE_UltralightWrite(uint8_t page, uint8_t *buffer, uint8_t bufferSize);
+    StatusCode MIFARE_UltralightFastRead(uint8_t startPage, uint8_t endPage, uint8_t *buffer, uint8_t *bufferSize);
+    // Reads pages in growing chunks with FAST_READ (or READ, four pages at a
+    // time) and hands each chunk to consumer, which returns false to stop.
+    StatusCode MIFARE_UltralightReadPages(uint8_t startPage, uint16_t pageCount, Callback<bool(const uint8_t *, uint16_t)> consumer, bool fastRead = true);
+    StatusCode MIFARE_UltralightReadNdef(NdefParser *parser, bool fastRead = true);
     StatusCode MIFARE_GetValue(uint8_t blockAddr, int32_t *value);
     StatusCode MIFARE_SetValue(uint8_t blockAddr, int32_t value);
     StatusCode PCD_MIFARE_Transceive(uint8_t *sendData, uint8_t sendLen, bool acceptTimeout = false);
+    // Sends the frames back to back: the ACK of each is read in the SPI
+    // transaction that starts the next. Stops at the first failure; *acked
+    // receives the number of frames the card acknowledged.
+    StatusCode PCD_MIFARE_TransceiveChain(const MIFARE_Frame *frames, uint8_t count, uint8_t *acked = NULL);
     
     bool PICC_IsNewCardPresent();
     bool PICC_ReadCardSerial();
-    
-    static uint8_t PICC_GetType(uint8_t sak);
-    static const char* PICC_GetTypeName(uint8_t type);
-    static const char* GetStatusCodeName(StatusCode code);
+    StatusCode PICC_Inventory(Uid *uids, uint8_t maxUids, uint8_t *uidCount);
     
     void PICC_DumpToSerial(Uid *uid);
     void PICC_DumpDetailsToSerial(Uid *uid);
@@ -164,7 +341,6 @@ public:
     void PICC_DumpMifareClassicSectorToSerial(Uid *uid, MIFARE_Key *key, uint8_t sector);
     void PIFARE_UltralightDumpToSerial();
     
-    void MIFARE_SetAccessBits(uint8_t *accessBitBuffer, uint8_t g0, uint8_t g1, uint8_t g2, uint8_t g3);
     bool MIFARE_OpenUidBackdoor(bool logErrors);
     bool MIFARE_SetUid(uint8_t *newUid, uint8_t uidSize, bool logErrors);
     bool MIFARE_UnbrickUidSector(bool logErrors);
@@ -172,13 +348,71 @@ public:
     Uid uid;
 
 private:
-    SPI _spi;
-    DigitalOut _cs;
-    DigitalOut _reset;
+    enum ShadowPolicy {
+        SHADOW_NONE           = 0x00,
+        SHADOW_WRITE          = 0x01,
+        SHADOW_READ           = 0x02
+    };
+
+    uint8_t PCD_ShadowPolicy(uint8_t reg) const;
+    uint8_t PCD_ReadRegisterForUpdate(uint8_t reg);
+    StatusCode PICC_SelectStartLevel(SelectContext *ctx);
+    void PCD_BeginFrame();
+    void PCD_EndFrame();
+    void PCD_SpiTransfer(const uint8_t *tx, uint8_t *rx, uint8_t length);
+    bool PCD_SkipShadowedFrame(Transaction *transaction, uint8_t frame);
+    void PCD_ForgetShadowedFrame(Transaction *transaction, uint8_t frame);
+    void PCD_CompleteTransaction(Transaction *transaction);
+    void PCD_StartAsyncFrame();
+    void PCD_AsyncFrameDone(bool ok);
+    void PCD_FinishAsyncTransaction(StatusCode status);
+    StatusCode PCD_CalculateCRCOnChip(uint8_t *data, uint8_t length, uint8_t *result);
+    bool PCD_CheckSpiLink(uint8_t version);
+    StatusCode PCD_CountStatus(StatusCode status);
+    StatusCode PCD_StreamFrame(uint8_t *sendData, uint16_t sendLen, uint8_t *backData, uint16_t *backLen, bool checkCRC);
+    bool PCD_PrepareCommunication(Transaction *transaction, uint8_t command, uint8_t *sendData, uint8_t sendLen, uint8_t txLastBits, uint8_t rxAlign);
+    StatusCode MIFARE_TwoStepHelper(uint8_t command, uint8_t blockAddr, int32_t data);
+    StatusCode PCD_WaitForIrq(uint8_t irqReg, uint8_t enableReg, uint8_t waitIRq, uint8_t timerIRq, uint32_t timeoutUs, uint8_t *irq = NULL);
+
+    Transport *_transport;
+    bool _ownsTransport;
+    uint32_t _timeoutUs;
+    uint16_t _timerPrescaler;
+    uint16_t _timerReload;
+    bool _hardwareCrc;
+    bool _shadowEnabled;
+    uint64_t _shadowValid;
+    uint8_t _shadow[REGISTER_COUNT];
+    uint32_t _shadowHits[REGISTER_COUNT];
+    uint32_t _shadowMisses[REGISTER_COUNT];
+    uint32_t _spiFrames;
+    uint32_t _spiBytes;
+    uint32_t _spiHz;
+    uint32_t _statusCounts[STATUS_CODE_COUNT];
+    Transaction *_asyncTransaction;
+    uint8_t _asyncFrame;
+    Callback<void(StatusCode)> _asyncDone;
     
     static const uint8_t FIFO_SIZE = 64;
+    static const uint8_t STREAM_WATER_LEVEL = 32;           // LoAlert at <= 32 bytes, HiAlert at >= 32
+    static const uint8_t INVENTORY_MAX_RETRIES = 3;
+    static const uint8_t UL_FIRST_CHUNK_PAGES = 4;
+    static const uint8_t UL_MAX_CHUNK_PAGES = 15;           // 60 bytes and CRC fit the FIFO
+    static const uint16_t TIMER_PRESCALER = 169;            // 25 us ticks
+    static const uint32_t CRC_TIMEOUT_US = 5000;
+    static const uint32_t SELF_TEST_TIMEOUT_US = 5000;
+    static const uint8_t SPI_CHECK_ROUNDS = 4;              // FIFO patterns written and read back per clock step
+    static const uint32_t HOST_TIMEOUT_MARGIN_US = 1000;
 };
 
+// Every front end takes an MFRC522. The firmware has only the mbed SPI
+// transport, so MFRC522 calls it directly; the host build defines
+// MFRC522_TRANSPORT as MFRC522Transport to run everything over the simulator.
+#ifndef MFRC522_TRANSPORT
+#define MFRC522_TRANSPORT MFRC522SpiTransport
+#endif
+typedef MFRC522T<MFRC522_TRANSPORT> MFRC522;
+
 enum PICC_Type {
     PICC_TYPE_UNKNOWN       = 0,
     PICC_TYPE_ISO_14443_4   = 1,
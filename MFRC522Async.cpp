@@ -0,0 +1,330 @@
+#include "MFRC522Async.h"
+
+MFRC522Async::MFRC522Async(MFRC522 &pcd)
+    : _pcd(pcd), _operation(OP_NONE), _state(STATE_IDLE),
+      _status(MFRC522::STATUS_OK), _deadline(0), _resetStep(0),
+      _resetTries(0), _command(MFRC522::PCD_Idle), _waitIRq(0), _sendLen(0),
+      _backData(NULL), _backLen(NULL), _validBits(0), _rxAlign(0),
+      _atqaSize(0) {}
+
+bool MFRC522Async::StartInit() {
+  if (!Begin(OP_INIT, STATE_RESET))
+    return false;
+
+  _pcd.PCD_SetResetLine(true);
+  _deadline = Now() + RESET_DELAY_US;
+  _resetStep = 1;
+  return true;
+}
+
+bool MFRC522Async::StartRequestA(uint8_t *bufferATQA, uint8_t *bufferSize) {
+  return StartREQA_or_WUPA(OP_REQUEST_A, MFRC522::PICC_CMD_REQA, bufferATQA,
+                           bufferSize);
+}
+
+bool MFRC522Async::StartWakeupA(uint8_t *bufferATQA, uint8_t *bufferSize) {
+  return StartREQA_or_WUPA(OP_WAKEUP_A, MFRC522::PICC_CMD_WUPA, bufferATQA,
+                           bufferSize);
+}
+
+bool MFRC522Async::StartIsNewCardPresent() {
+  if (IsBusy())
+    return false;
+
+  _pcd.PCD_WriteRegister(MFRC522::TxModeReg, 0x00);
+  _pcd.PCD_WriteRegister(MFRC522::RxModeReg, 0x00);
+  _pcd.PCD_WriteRegister(MFRC522::ModWidthReg, 0x26);
+
+  _atqaSize = sizeof(_atqa);
+  return StartREQA_or_WUPA(OP_IS_NEW_CARD_PRESENT, MFRC522::PICC_CMD_REQA,
+                           _atqa, &_atqaSize);
+}
+
+bool MFRC522Async::StartREQA_or_WUPA(Operation operation, uint8_t command,
+                                     uint8_t *bufferATQA,
+                                     uint8_t *bufferSize) {
+  if (!Begin(operation, STATE_FIFO_LOAD))
+    return false;
+
+  if (bufferATQA == NULL || *bufferSize < 2) {
+    Complete(MFRC522::STATUS_NO_ROOM);
+    return true;
+  }
+
+  _pcd.PCD_ClearRegisterBitMask(MFRC522::CollReg, 0x80);
+  _pcd.PCD_SetTimeout(MFRC522::TIMEOUT_ACTIVATION_US);
+  _command = MFRC522::PCD_Transceive;
+  _waitIRq = 0x30;
+  _sendData[0] = command;
+  _sendLen = 1;
+  _backData = bufferATQA;
+  _backLen = bufferSize;
+  _validBits = 7;
+  _rxAlign = 0;
+  return true;
+}
+
+bool MFRC522Async::StartSelect(MFRC522::Uid *uid, uint8_t validBits) {
+  if (!Begin(OP_SELECT, STATE_FIFO_LOAD))
+    return false;
+
+  _command = MFRC522::PCD_Transceive;
+  _waitIRq = 0x30;
+
+  MFRC522::StatusCode status = _pcd.PICC_SelectBegin(&_select, uid, validBits);
+  if (status != MFRC522::STATUS_OK)
+    Complete(status);
+  return true;
+}
+
+bool MFRC522Async::StartReadCardSerial() { return StartSelect(&_pcd.uid); }
+
+bool MFRC522Async::StartAuthenticate(uint8_t command, uint8_t blockAddr,
+                                     MFRC522::MIFARE_Key *key,
+                                     MFRC522::Uid *uid) {
+  if (!Begin(OP_AUTHENTICATE, STATE_FIFO_LOAD))
+    return false;
+
+  _sendData[0] = command;
+  _sendData[1] = blockAddr;
+  for (uint8_t i = 0; i < 6; i++) {
+    _sendData[2 + i] = key->keyByte[i];
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    _sendData[8 + i] = uid->uidByte[i];
+  }
+
+  _pcd.PCD_SetTimeout(MFRC522::TIMEOUT_MIFARE_US);
+  _command = MFRC522::PCD_MFAuthent;
+  _waitIRq = 0x10;
+  _sendLen = 12;
+  _backData = NULL;
+  _backLen = NULL;
+  _validBits = 0;
+  _rxAlign = 0;
+  return true;
+}
+
+bool MFRC522Async::StartRead(uint8_t blockAddr, uint8_t *buffer,
+                             uint8_t *bufferSize) {
+  if (!Begin(OP_READ, STATE_FIFO_LOAD))
+    return false;
+
+  if (buffer == NULL || *bufferSize < 18) {
+    Complete(MFRC522::STATUS_NO_ROOM);
+    return true;
+  }
+
+  _sendData[0] = MFRC522::PICC_CMD_MF_READ;
+  _sendData[1] = blockAddr;
+  _pcd.PCD_CalculateCRC(_sendData, 2, &_sendData[2]);
+
+  _pcd.PCD_SetTimeout(MFRC522::TIMEOUT_MIFARE_US);
+  _command = MFRC522::PCD_Transceive;
+  _waitIRq = 0x30;
+  _sendLen = 4;
+  _backData = buffer;
+  _backLen = bufferSize;
+  _validBits = 0;
+  _rxAlign = 0;
+  return true;
+}
+
+bool MFRC522Async::Poll() {
+  switch (_state) {
+  case STATE_RESET:
+    PollReset();
+    break;
+  case STATE_FIFO_LOAD:
+    LoadFifo();
+    break;
+  case STATE_TRANSCEIVE:
+    PollTransceive();
+    break;
+  case STATE_COLLISION:
+  case STATE_CRC_CHECK:
+    CheckResponse();
+    break;
+  case STATE_IDLE:
+  case STATE_DONE:
+  default:
+    break;
+  }
+  return IsBusy();
+}
+
+void MFRC522Async::Abort() {
+  if (!IsBusy())
+    return;
+
+  if (_state == STATE_TRANSCEIVE)
+    _pcd.PCD_AbortCommunication();
+  if (_state == STATE_RESET)
+    _pcd.PCD_SetResetLine(false);
+
+  Complete(MFRC522::STATUS_TIMEOUT);
+}
+
+bool MFRC522Async::IsBusy() const {
+  return _state != STATE_IDLE && _state != STATE_DONE;
+}
+
+MFRC522Async::Operation MFRC522Async::GetOperation() const {
+  return _operation;
+}
+
+MFRC522Async::State MFRC522Async::GetState() const { return _state; }
+
+MFRC522::StatusCode MFRC522Async::GetStatus() const { return _status; }
+
+void MFRC522Async::SetStateCallback(Callback<void(State)> callback) {
+  _onState = callback;
+}
+
+void MFRC522Async::SetCompletionCallback(
+    Callback<void(MFRC522::StatusCode)> callback) {
+  _onComplete = callback;
+}
+
+bool MFRC522Async::Begin(Operation operation, State state) {
+  if (IsBusy())
+    return false;
+
+  _operation = operation;
+  _status = MFRC522::STATUS_OK;
+  SetState(state);
+  return true;
+}
+
+void MFRC522Async::SetState(State state) {
+  _state = state;
+  if (_onState)
+    _onState(state);
+}
+
+void MFRC522Async::Complete(MFRC522::StatusCode status) {
+  _status = status;
+  SetState(STATE_DONE);
+  if (_onComplete)
+    _onComplete(status);
+}
+
+void MFRC522Async::PollReset() {
+  if (Now() < _deadline)
+    return;
+
+  switch (_resetStep) {
+  case 1:
+    _pcd.PCD_SetResetLine(false);
+    _resetStep = 2;
+    break;
+  case 2:
+    _pcd.PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_SoftReset);
+    _pcd.PCD_InvalidateRegisterShadow();
+    _resetTries = 0;
+    _resetStep = 3;
+    break;
+  default:
+    if ((_pcd.PCD_ReadRegister(MFRC522::CommandReg) & (1 << 4)) &&
+        (++_resetTries) < 3)
+      break;
+    _pcd.PCD_Configure();
+    Complete(MFRC522::STATUS_OK);
+    return;
+  }
+  _deadline = Now() + RESET_DELAY_US;
+}
+
+void MFRC522Async::LoadFifo() {
+  uint8_t *sendData = _sendData;
+  uint8_t sendLen = _sendLen;
+
+  if (_operation == OP_SELECT) {
+    MFRC522::StatusCode status = _pcd.PICC_SelectPrepareFrame(&_select);
+    if (status != MFRC522::STATUS_OK) {
+      Complete(status);
+      return;
+    }
+    sendData = _select.buffer;
+    sendLen = _select.bufferUsed;
+    _backData = &_select.buffer[_select.responseIndex];
+    _backLen = &_select.responseLength;
+    _validBits = _select.txLastBits;
+    _rxAlign = _select.rxAlign;
+  }
+
+  MFRC522::StatusCode status = _pcd.PCD_BeginCommunication(
+      _command, sendData, sendLen, _validBits, _rxAlign);
+  if (status != MFRC522::STATUS_OK) {
+    Complete(status);
+    return;
+  }
+
+  _deadline = Now() + _pcd.PCD_GetHostTimeout(_command, sendLen);
+  SetState(STATE_TRANSCEIVE);
+}
+
+void MFRC522Async::PollTransceive() {
+  MFRC522::StatusCode status;
+  if (!_pcd.PCD_PollCommunication(_waitIRq, &status)) {
+    if (Now() >= _deadline) {
+      _pcd.PCD_AbortCommunication();
+      Complete(MFRC522::STATUS_TIMEOUT);
+    }
+    return;
+  }
+
+  if (status == MFRC522::STATUS_OK)
+    status = _pcd.PCD_FinishCommunication(_backData, _backLen, &_validBits,
+                                          _rxAlign, false);
+
+  switch (_operation) {
+  case OP_REQUEST_A:
+  case OP_WAKEUP_A:
+  case OP_IS_NEW_CARD_PRESENT:
+    if (status == MFRC522::STATUS_OK && (*_backLen != 2 || _validBits != 0))
+      status = MFRC522::STATUS_ERROR;
+    Complete(status);
+    break;
+  case OP_READ:
+    if (status != MFRC522::STATUS_OK)
+      Complete(status);
+    else
+      SetState(STATE_CRC_CHECK);
+    break;
+  case OP_SELECT:
+    _select.txLastBits = _validBits;
+    if (status == MFRC522::STATUS_COLLISION) {
+      SetState(STATE_COLLISION);
+    } else if (status != MFRC522::STATUS_OK) {
+      Complete(status);
+    } else if (_select.currentLevelKnownBits >= 32) {
+      SetState(STATE_CRC_CHECK);
+    } else {
+      CheckResponse();
+    }
+    break;
+  default:
+    Complete(status);
+    break;
+  }
+}
+
+void MFRC522Async::CheckResponse() {
+  MFRC522::StatusCode status;
+
+  if (_operation == OP_READ) {
+    Complete(_pcd.PCD_CheckResponseCRC(_backData, *_backLen, _validBits));
+    return;
+  }
+
+  status = _pcd.PICC_SelectHandleResponse(
+      &_select, _state == STATE_COLLISION ? MFRC522::STATUS_COLLISION
+                                          : MFRC522::STATUS_OK);
+  if (status != MFRC522::STATUS_OK || _select.complete)
+    Complete(status);
+  else
+    SetState(STATE_FIFO_LOAD);
+}
+
+uint64_t MFRC522Async::Now() { return _pcd.PCD_GetTimeUs(); }
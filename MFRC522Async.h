@@ -0,0 +1,92 @@
+#ifndef MFRC522ASYNC_H
+#define MFRC522ASYNC_H
+
+#include "mbed.h"
+#include "MFRC522.h"
+
+// Non-blocking front end for MFRC522. Start one operation, then call Poll()
+// from the main loop; every call does at most one step (a few SPI frames) and
+// returns while the chip or the card is busy. Only one operation runs at a
+// time per reader, and the MFRC522 must not be used directly meanwhile.
+class MFRC522Async {
+public:
+    enum Operation {
+        OP_NONE,
+        OP_INIT,
+        OP_REQUEST_A,
+        OP_WAKEUP_A,
+        OP_IS_NEW_CARD_PRESENT,
+        OP_SELECT,
+        OP_AUTHENTICATE,
+        OP_READ
+    };
+
+    enum State {
+        STATE_IDLE,
+        STATE_RESET,
+        STATE_FIFO_LOAD,
+        STATE_TRANSCEIVE,
+        STATE_COLLISION,
+        STATE_CRC_CHECK,
+        STATE_DONE
+    };
+
+    MFRC522Async(MFRC522 &pcd);
+
+    bool StartInit();
+    bool StartRequestA(uint8_t *bufferATQA, uint8_t *bufferSize);
+    bool StartWakeupA(uint8_t *bufferATQA, uint8_t *bufferSize);
+    bool StartIsNewCardPresent();
+    bool StartSelect(MFRC522::Uid *uid, uint8_t validBits = 0);
+    bool StartReadCardSerial();
+    bool StartAuthenticate(uint8_t command, uint8_t blockAddr, MFRC522::MIFARE_Key *key, MFRC522::Uid *uid);
+    bool StartRead(uint8_t blockAddr, uint8_t *buffer, uint8_t *bufferSize);
+
+    bool Poll();
+    void Abort();
+
+    bool IsBusy() const;
+    Operation GetOperation() const;
+    State GetState() const;
+    MFRC522::StatusCode GetStatus() const;
+
+    void SetStateCallback(Callback<void(State)> callback);
+    void SetCompletionCallback(Callback<void(MFRC522::StatusCode)> callback);
+
+private:
+    bool Begin(Operation operation, State state);
+    bool StartREQA_or_WUPA(Operation operation, uint8_t command, uint8_t *bufferATQA, uint8_t *bufferSize);
+    void SetState(State state);
+    void Complete(MFRC522::StatusCode status);
+    void PollReset();
+    void LoadFifo();
+    void PollTransceive();
+    void CheckResponse();
+    uint64_t Now();
+
+    MFRC522 &_pcd;
+    Operation _operation;
+    State _state;
+    MFRC522::StatusCode _status;
+    Callback<void(State)> _onState;
+    Callback<void(MFRC522::StatusCode)> _onComplete;
+    uint64_t _deadline;
+    uint8_t _resetStep;
+    uint8_t _resetTries;
+
+    uint8_t _command;
+    uint8_t _waitIRq;
+    uint8_t _sendData[12];
+    uint8_t _sendLen;
+    uint8_t *_backData;
+    uint8_t *_backLen;
+    uint8_t _validBits;
+    uint8_t _rxAlign;
+    uint8_t _atqa[2];
+    uint8_t _atqaSize;
+    MFRC522::SelectContext _select;
+
+    static const uint32_t RESET_DELAY_US = 50000;
+};
+
+#endif
@@ -0,0 +1,359 @@
+#include "MFRC522IsoDep.h"
+
+namespace {
+
+const uint8_t CMD_RATS = 0xE0;
+const uint8_t CMD_PPS = 0xD0;
+
+const uint8_t PCB_I_BLOCK = 0x02;
+const uint8_t PCB_R_ACK = 0xA2;
+const uint8_t PCB_R_NAK = 0xB2;
+const uint8_t PCB_S_DESELECT = 0xC2;
+const uint8_t PCB_S_WTX = 0xF2;
+const uint8_t PCB_CHAINING = 0x10;
+const uint8_t PCB_NAK = 0x10;
+const uint8_t PCB_CID = 0x08;
+const uint8_t PCB_NAD = 0x04;
+const uint8_t PCB_BLOCK_NUMBER = 0x01;
+
+const uint16_t FSC_TABLE[9] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+// Modulation width for 106, 212, 424 and 848 kbit/s.
+const uint8_t MOD_WIDTH[4] = {0x26, 0x15, 0x0A, 0x05};
+
+bool IsIBlock(uint8_t pcb) { return (pcb & 0xE2) == PCB_I_BLOCK; }
+
+bool IsRBlock(uint8_t pcb) { return (pcb & 0xE6) == PCB_R_ACK; }
+
+bool IsSBlock(uint8_t pcb, uint8_t type) { return (pcb & 0xF7) == type; }
+
+} // namespace
+
+MFRC522IsoDep::MFRC522IsoDep(MFRC522 &pcd)
+    : _pcd(pcd), _active(false), _atsSize(0), _useCid(false), _cid(0),
+      _fsc(FSC_TABLE[2]), _fwtUs(GetFrameWaitTimeUs(4)), _blockNumber(0),
+      _txBitRate(BITRATE_106), _rxBitRate(BITRATE_106), _wtxCount(0),
+      _retryCount(0) {}
+
+MFRC522::StatusCode MFRC522IsoDep::Activate(uint8_t cid, BitRate maxBitRate) {
+  if (cid > 14)
+    return MFRC522::STATUS_INVALID;
+
+  _active = false;
+  SetBitRates(BITRATE_106, BITRATE_106);
+  MFRC522::StatusCode result = RequestAts(cid);
+  if (result != MFRC522::STATUS_OK)
+    return result;
+
+  _active = true;
+  _blockNumber = 0;
+
+  // TA(1): b7-b5 PICC to PCD and b3-b1 PCD to PICC support 848/424/212,
+  // b8 requires the same rate in both directions.
+  uint8_t t0 = _atsSize > 1 ? _ats[1] : 0;
+  uint8_t ta1 = ((t0 & 0x10) && _atsSize > 2) ? _ats[2] : 0;
+  BitRate tx = BITRATE_106;
+  BitRate rx = BITRATE_106;
+  for (uint8_t rate = maxBitRate; rate > BITRATE_106; rate--) {
+    bool toCard = ta1 & (0x01 << (rate - 1));
+    bool fromCard = ta1 & (0x08 << rate);
+    if (ta1 & 0x80) {
+      if (toCard && fromCard) {
+        tx = rx = (BitRate)rate;
+        break;
+      }
+      continue;
+    }
+    if (toCard && tx == BITRATE_106)
+      tx = (BitRate)rate;
+    if (fromCard && rx == BITRATE_106)
+      rx = (BitRate)rate;
+  }
+
+  if (tx == BITRATE_106 && rx == BITRATE_106)
+    return MFRC522::STATUS_OK;
+  return SendPps(tx, rx);
+}
+
+MFRC522::StatusCode MFRC522IsoDep::RequestAts(uint8_t cid) {
+  uint8_t buffer[MAX_ATS_SIZE + 2];
+  uint8_t size = sizeof(buffer);
+
+  buffer[0] = CMD_RATS;
+  buffer[1] = (FSDI << 4) | cid;
+  MFRC522::StatusCode result = _pcd.PCD_CalculateCRC(buffer, 2, &buffer[2]);
+  if (result != MFRC522::STATUS_OK)
+    return result;
+
+  _pcd.PCD_SetTimeout(ACTIVATION_FWT_US + DELTA_FWT_US);
+  result = _pcd.PCD_TransceiveData(buffer, 4, buffer, &size, NULL, 0, true);
+  if (result != MFRC522::STATUS_OK)
+    return result;
+  if (size < 3 || buffer[0] != size - 2)
+    return MFRC522::STATUS_ERROR;
+
+  _atsSize = size - 2;
+  memcpy(_ats, buffer, _atsSize);
+
+  // Interface bytes that are absent take their default values.
+  uint8_t t0 = _atsSize > 1 ? _ats[1] : 0x02;
+  uint8_t index = 2;
+  uint8_t tb1 = 0x40;
+  uint8_t tc1 = 0x02;
+  if (t0 & 0x10)
+    index++;
+  if ((t0 & 0x20) && index < _atsSize)
+    tb1 = _ats[index++];
+  if ((t0 & 0x40) && index < _atsSize)
+    tc1 = _ats[index++];
+
+  uint8_t fsci = t0 & 0x0F;
+  _fsc = FSC_TABLE[fsci < 8 ? fsci : 8];
+  uint8_t fwi = tb1 >> 4;
+  _fwtUs = GetFrameWaitTimeUs(fwi < 15 ? fwi : 4) + DELTA_FWT_US;
+  _useCid = cid != 0 && (tc1 & 0x02);
+  _cid = _useCid ? cid : 0;
+
+  // The card needs its start-up frame guard time before the next frame.
+  uint8_t sfgi = tb1 & 0x0F;
+  if (sfgi && sfgi < 15)
+    _pcd.PCD_DelayUs(GetFrameWaitTimeUs(sfgi));
+  return MFRC522::STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522IsoDep::SendPps(BitRate tx, BitRate rx) {
+  uint8_t buffer[5];
+  uint8_t size = 3;
+
+  buffer[0] = CMD_PPS | _cid;
+  buffer[1] = 0x11;
+  buffer[2] = (rx << 2) | tx;
+  MFRC522::StatusCode result = _pcd.PCD_CalculateCRC(buffer, 3, &buffer[3]);
+  if (result != MFRC522::STATUS_OK)
+    return result;
+
+  _pcd.PCD_SetTimeout(_fwtUs);
+  result = _pcd.PCD_TransceiveData(buffer, 5, buffer, &size, NULL, 0, true);
+  if (result != MFRC522::STATUS_OK)
+    return result;
+  if (size != 3 || buffer[0] != (CMD_PPS | _cid))
+    return MFRC522::STATUS_ERROR;
+
+  SetBitRates(tx, rx);
+  return MFRC522::STATUS_OK;
+}
+
+void MFRC522IsoDep::SetBitRates(BitRate tx, BitRate rx) {
+  _pcd.PCD_WriteRegister(MFRC522::TxModeReg, tx << 4);
+  _pcd.PCD_WriteRegister(MFRC522::RxModeReg, rx << 4);
+  _pcd.PCD_WriteRegister(MFRC522::ModWidthReg, MOD_WIDTH[tx]);
+  _txBitRate = tx;
+  _rxBitRate = rx;
+}
+
+MFRC522::StatusCode MFRC522IsoDep::Transceive(const uint8_t *command,
+                                              uint16_t commandLength,
+                                              uint8_t *response,
+                                              uint16_t *responseLength) {
+  uint8_t frame[MAX_FRAME_SIZE];
+  uint16_t frameLength;
+  MFRC522::StatusCode result;
+
+  if (!_active)
+    return MFRC522::STATUS_ERROR;
+  if (command == NULL || response == NULL || responseLength == NULL)
+    return MFRC522::STATUS_INVALID;
+
+  // PCD chaining: every I-block but the last is acknowledged with R(ACK).
+  uint16_t capacity = *responseLength;
+  uint16_t sent = 0;
+  while (true) {
+    uint16_t chunk = commandLength - sent;
+    bool chaining = chunk > GetMaxInfLength();
+    if (chaining)
+      chunk = GetMaxInfLength();
+
+    uint8_t pcb = PCB_I_BLOCK | _blockNumber | (chaining ? PCB_CHAINING : 0);
+    result = Exchange(pcb, &command[sent], chunk, frame, &frameLength);
+    if (result != MFRC522::STATUS_OK)
+      return result;
+    if (!chaining)
+      break;
+
+    if (!IsRBlock(frame[0]) || (frame[0] & PCB_NAK) ||
+        (frame[0] & PCB_BLOCK_NUMBER) != _blockNumber)
+      return MFRC522::STATUS_ERROR;
+    _blockNumber ^= 1;
+    sent += chunk;
+  }
+
+  // PICC chaining: each chained I-block is acknowledged to get the next.
+  *responseLength = 0;
+  while (true) {
+    uint8_t pcb = frame[0];
+    uint8_t offset = GetInfOffset(pcb);
+    if (!IsIBlock(pcb) || (pcb & PCB_BLOCK_NUMBER) != _blockNumber ||
+        frameLength < offset)
+      return MFRC522::STATUS_ERROR;
+    _blockNumber ^= 1;
+
+    uint16_t length = frameLength - offset;
+    if (*responseLength + length > capacity)
+      return MFRC522::STATUS_NO_ROOM;
+    memcpy(&response[*responseLength], &frame[offset], length);
+    *responseLength += length;
+    if (!(pcb & PCB_CHAINING))
+      return MFRC522::STATUS_OK;
+
+    result = Exchange(PCB_R_ACK | _blockNumber, NULL, 0, frame, &frameLength);
+    if (result != MFRC522::STATUS_OK)
+      return result;
+  }
+}
+
+MFRC522::StatusCode MFRC522IsoDep::Deselect() {
+  uint8_t frame[MAX_FRAME_SIZE];
+  uint16_t frameLength;
+
+  if (!_active)
+    return MFRC522::STATUS_OK;
+
+  MFRC522::StatusCode result =
+      Exchange(PCB_S_DESELECT, NULL, 0, frame, &frameLength);
+  _active = false;
+  SetBitRates(BITRATE_106, BITRATE_106);
+  if (result == MFRC522::STATUS_OK && !IsSBlock(frame[0], PCB_S_DESELECT))
+    return MFRC522::STATUS_ERROR;
+  return result;
+}
+
+// Sends one block and returns the card's answer to it. A waiting time
+// extension request is confirmed and the answer awaited for the extended
+// time. A missing or corrupt answer is asked for again: R(NAK) after an
+// I-block, the same block otherwise. An R(ACK) for the previous block
+// means the card missed this I-block, which is then sent again.
+MFRC522::StatusCode MFRC522IsoDep::Exchange(uint8_t pcb, const uint8_t *inf,
+                                            uint16_t infLength, uint8_t *frame,
+                                            uint16_t *frameLength) {
+  uint8_t sendPcb = pcb;
+  const uint8_t *sendInf = inf;
+  uint16_t sendLength = infLength;
+  uint32_t timeoutUs = _fwtUs;
+  uint8_t wtxm = 0;
+  uint8_t retries = 0;
+
+  while (true) {
+    MFRC522::StatusCode result =
+        SendFrame(sendPcb, sendInf, sendLength, frame, frameLength, timeoutUs);
+    timeoutUs = _fwtUs;
+
+    if (result == MFRC522::STATUS_OK) {
+      uint8_t offset = GetInfOffset(frame[0]);
+      if (IsSBlock(frame[0], PCB_S_WTX) && *frameLength > offset) {
+        wtxm = frame[offset] & 0x3F;
+        if (wtxm == 0)
+          return MFRC522::STATUS_ERROR;
+        if (wtxm > 59)
+          wtxm = 59;
+        _wtxCount++;
+        sendPcb = PCB_S_WTX;
+        sendInf = &wtxm;
+        sendLength = 1;
+        timeoutUs = _fwtUs * wtxm;
+        continue;
+      }
+
+      bool missed = IsIBlock(pcb) && IsRBlock(frame[0]) &&
+                    !(frame[0] & PCB_NAK) &&
+                    (frame[0] & PCB_BLOCK_NUMBER) != _blockNumber;
+      if (!missed)
+        return MFRC522::STATUS_OK;
+      result = MFRC522::STATUS_ERROR;
+      sendPcb = pcb;
+      sendInf = inf;
+      sendLength = infLength;
+    } else if (IsIBlock(pcb) || sendPcb == PCB_S_WTX) {
+      sendPcb = PCB_R_NAK | _blockNumber;
+      sendInf = NULL;
+      sendLength = 0;
+    }
+
+    if (++retries > MAX_RETRIES)
+      return result;
+    _retryCount++;
+  }
+}
+
+MFRC522::StatusCode MFRC522IsoDep::SendFrame(uint8_t pcb, const uint8_t *inf,
+                                             uint16_t infLength, uint8_t *frame,
+                                             uint16_t *frameLength,
+                                             uint32_t timeoutUs) {
+  uint8_t buffer[MAX_FRAME_SIZE];
+  uint16_t length = 0;
+
+  buffer[length++] = pcb | (_useCid ? PCB_CID : 0);
+  if (_useCid)
+    buffer[length++] = _cid;
+  if (infLength)
+    memcpy(&buffer[length], inf, infLength);
+  length += infLength;
+  MFRC522::StatusCode result =
+      _pcd.PCD_CalculateCRC(buffer, length, &buffer[length]);
+  if (result != MFRC522::STATUS_OK)
+    return result;
+
+  *frameLength = MAX_FRAME_SIZE;
+  _pcd.PCD_SetTimeout(timeoutUs);
+  result = _pcd.PCD_TransceiveStream(buffer, length + 2, frame, frameLength,
+                                     true);
+  if (result != MFRC522::STATUS_OK)
+    return result;
+
+  *frameLength -= 2;
+  if ((frame[0] & PCB_CID) && (*frameLength < 2 || frame[1] != _cid))
+    return MFRC522::STATUS_ERROR;
+  return MFRC522::STATUS_OK;
+}
+
+uint8_t MFRC522IsoDep::GetInfOffset(uint8_t pcb) const {
+  uint8_t offset = 1;
+  if (pcb & PCB_CID)
+    offset++;
+  if (IsIBlock(pcb) && (pcb & PCB_NAD))
+    offset++;
+  return offset;
+}
+
+// Room for INF in a frame to the card: PCB, optional CID and CRC_A take
+// the rest of FSC.
+uint16_t MFRC522IsoDep::GetMaxInfLength() const {
+  uint16_t frameSize = _fsc < MAX_FRAME_SIZE ? _fsc : MAX_FRAME_SIZE;
+  return frameSize - 3 - (_useCid ? 1 : 0);
+}
+
+// FWT = 256 * 16 / fc * 2^FWI, 302 us for FWI 0.
+uint32_t MFRC522IsoDep::GetFrameWaitTimeUs(uint8_t fwi) {
+  return ((uint64_t)4096 << fwi) * 25 / 339 + 1;
+}
+
+bool MFRC522IsoDep::IsActive() const { return _active; }
+
+const uint8_t *MFRC522IsoDep::GetAts() const { return _ats; }
+
+uint8_t MFRC522IsoDep::GetAtsSize() const { return _atsSize; }
+
+uint16_t MFRC522IsoDep::GetFsc() const { return _fsc; }
+
+uint32_t MFRC522IsoDep::GetFrameWaitTimeUs() const { return _fwtUs; }
+
+MFRC522IsoDep::BitRate MFRC522IsoDep::GetTxBitRate() const {
+  return _txBitRate;
+}
+
+MFRC522IsoDep::BitRate MFRC522IsoDep::GetRxBitRate() const {
+  return _rxBitRate;
+}
+
+uint32_t MFRC522IsoDep::GetWtxCount() const { return _wtxCount; }
+
+uint32_t MFRC522IsoDep::GetRetryCount() const { return _retryCount; }
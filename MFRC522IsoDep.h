@@ -0,0 +1,73 @@
+#ifndef MFRC522ISODEP_H
+#define MFRC522ISODEP_H
+
+#include "mbed.h"
+#include "MFRC522.h"
+
+// ISO/IEC 14443-4 (T=CL) block transmission on top of MFRC522, for cards
+// whose SAK announces it (PICC_TYPE_ISO_14443_4). After PICC_Select,
+// Activate() sends RATS, takes the frame size, frame waiting time and bit
+// rates from the ATS and moves both directions to the fastest common rate
+// with PPS. Transceive() then exchanges APDUs, chaining I-blocks both ways,
+// answering waiting time extensions and recovering lost blocks with
+// R(NAK). Frames of up to 256 bytes are streamed through the FIFO.
+class MFRC522IsoDep {
+public:
+    enum BitRate {
+        BITRATE_106 = 0,
+        BITRATE_212 = 1,
+        BITRATE_424 = 2,
+        BITRATE_848 = 3
+    };
+
+    static const uint16_t MAX_FRAME_SIZE = MFRC522::MAX_STREAM_FRAME;
+    static const uint8_t MAX_ATS_SIZE = 20;
+    static const uint8_t MAX_RETRIES = 2;
+
+    MFRC522IsoDep(MFRC522 &pcd);
+
+    // cid 1-14 is only used if the card supports CIDs; 0 sends none.
+    MFRC522::StatusCode Activate(uint8_t cid = 0, BitRate maxBitRate = BITRATE_848);
+    MFRC522::StatusCode Transceive(const uint8_t *command, uint16_t commandLength, uint8_t *response, uint16_t *responseLength);
+    MFRC522::StatusCode Deselect();
+
+    bool IsActive() const;
+    const uint8_t *GetAts() const;
+    uint8_t GetAtsSize() const;
+    uint16_t GetFsc() const;
+    uint32_t GetFrameWaitTimeUs() const;
+    BitRate GetTxBitRate() const;
+    BitRate GetRxBitRate() const;
+    uint32_t GetWtxCount() const;
+    uint32_t GetRetryCount() const;
+
+private:
+    MFRC522::StatusCode RequestAts(uint8_t cid);
+    MFRC522::StatusCode SendPps(BitRate tx, BitRate rx);
+    void SetBitRates(BitRate tx, BitRate rx);
+    MFRC522::StatusCode Exchange(uint8_t pcb, const uint8_t *inf, uint16_t infLength, uint8_t *frame, uint16_t *frameLength);
+    MFRC522::StatusCode SendFrame(uint8_t pcb, const uint8_t *inf, uint16_t infLength, uint8_t *frame, uint16_t *frameLength, uint32_t timeoutUs);
+    uint8_t GetInfOffset(uint8_t pcb) const;
+    uint16_t GetMaxInfLength() const;
+    static uint32_t GetFrameWaitTimeUs(uint8_t fwi);
+
+    MFRC522 &_pcd;
+    bool _active;
+    uint8_t _ats[MAX_ATS_SIZE];
+    uint8_t _atsSize;
+    bool _useCid;
+    uint8_t _cid;
+    uint16_t _fsc;
+    uint32_t _fwtUs;
+    uint8_t _blockNumber;
+    BitRate _txBitRate;
+    BitRate _rxBitRate;
+    uint32_t _wtxCount;
+    uint32_t _retryCount;
+
+    static const uint8_t FSDI = 8;                      // 256 bytes
+    static const uint32_t ACTIVATION_FWT_US = 5286;     // 71680/fc for RATS
+    static const uint32_t DELTA_FWT_US = 3625;          // 49152/fc
+};
+
+#endif
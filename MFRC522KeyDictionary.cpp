@@ -0,0 +1,116 @@
+#include "MFRC522KeyDictionary.h"
+
+MFRC522KeyDictionary::MFRC522KeyDictionary(MFRC522 &pcd)
+    : _pcd(pcd), _keyCount(0), _useCounter(0), _attempts(0), _reselects(0) {
+  ClearCache();
+}
+
+bool MFRC522KeyDictionary::AddKey(const MFRC522::MIFARE_Key &key) {
+  if (_keyCount >= MAX_KEYS)
+    return false;
+
+  _keys[_keyCount++] = key;
+  return true;
+}
+
+void MFRC522KeyDictionary::ClearKeys() {
+  _keyCount = 0;
+  ClearCache();
+}
+
+uint8_t MFRC522KeyDictionary::GetKeyCount() const { return _keyCount; }
+
+void MFRC522KeyDictionary::ClearCache() {
+  memset(_cache, 0, sizeof(_cache));
+  for (uint8_t i = 0; i < CACHE_SIZE; i++) {
+    _cache[i].lastSlot = SLOT_UNKNOWN;
+    memset(_cache[i].sectorSlot, SLOT_UNKNOWN, MAX_SECTORS);
+  }
+}
+
+MFRC522::StatusCode MFRC522KeyDictionary::Authenticate(MFRC522::Uid *uid,
+                                                       uint8_t sector,
+                                                       MFRC522::MIFARE_Key *key,
+                                                       uint8_t *command) {
+  if (uid == NULL || sector >= MAX_SECTORS || _keyCount == 0)
+    return MFRC522::STATUS_INVALID;
+
+  uint8_t trailer = MFRC522::MIFARE_GetSectorFirstBlock(sector) +
+                    MFRC522::MIFARE_GetSectorBlockCount(sector) - 1;
+  CacheEntry *entry = FindEntry(uid);
+
+  // Cached key for this sector, then the card's last good key, then the
+  // whole list. Each slot is tried at most once.
+  uint8_t preferred[2] = {entry->sectorSlot[sector], entry->lastSlot};
+  uint8_t slotCount = _keyCount * 2;
+  uint32_t tried = 0;
+  bool reselect = false;
+  MFRC522::StatusCode result = MFRC522::STATUS_TIMEOUT;
+
+  for (uint8_t i = 0; i < 2 + slotCount; i++) {
+    uint8_t slot = i < 2 ? preferred[i] : i - 2;
+    if (slot >= slotCount || (tried & (1UL << slot)))
+      continue;
+    tried |= 1UL << slot;
+
+    if (reselect) {
+      _reselects++;
+      result = _pcd.PICC_Reselect(uid);
+      if (result != MFRC522::STATUS_OK)
+        return result;
+    }
+
+    _attempts++;
+    uint8_t authCommand = (slot & 1) ? MFRC522::PICC_CMD_MF_AUTH_KEY_B
+                                     : MFRC522::PICC_CMD_MF_AUTH_KEY_A;
+    result = _pcd.PCD_Authenticate(authCommand, trailer, &_keys[slot / 2], uid);
+    if (result == MFRC522::STATUS_OK) {
+      entry->sectorSlot[sector] = slot;
+      entry->lastSlot = slot;
+      if (key)
+        *key = _keys[slot / 2];
+      if (command)
+        *command = authCommand;
+      return MFRC522::STATUS_OK;
+    }
+    reselect = true;
+  }
+
+  entry->sectorSlot[sector] = SLOT_UNKNOWN;
+  _reselects++;
+  _pcd.PICC_Reselect(uid);
+  return result;
+}
+
+// Returns the entry for the UID, taking over the least recently used one
+// if the card is not cached yet.
+MFRC522KeyDictionary::CacheEntry *
+MFRC522KeyDictionary::FindEntry(const MFRC522::Uid *uid) {
+  CacheEntry *oldest = &_cache[0];
+  for (uint8_t i = 0; i < CACHE_SIZE; i++) {
+    CacheEntry *entry = &_cache[i];
+    if (entry->lastUse && entry->uid.size == uid->size &&
+        memcmp(entry->uid.uidByte, uid->uidByte, uid->size) == 0) {
+      entry->lastUse = ++_useCounter;
+      return entry;
+    }
+    if (entry->lastUse < oldest->lastUse)
+      oldest = entry;
+  }
+
+  memset(oldest, 0, sizeof(CacheEntry));
+  oldest->uid = *uid;
+  oldest->lastUse = ++_useCounter;
+  oldest->lastSlot = SLOT_UNKNOWN;
+  memset(oldest->sectorSlot, SLOT_UNKNOWN, MAX_SECTORS);
+  return oldest;
+}
+
+uint32_t MFRC522KeyDictionary::GetAttemptCount() const { return _attempts; }
+
+uint32_t MFRC522KeyDictionary::GetReselectCount() const { return _reselects; }
+
+void MFRC522KeyDictionary::ResetCounters() {
+  _attempts = 0;
+  _reselects = 0;
+}
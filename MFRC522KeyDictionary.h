@@ -0,0 +1,57 @@
+#ifndef MFRC522KEYDICTIONARY_H
+#define MFRC522KEYDICTIONARY_H
+
+#include "mbed.h"
+#include "MFRC522.h"
+
+// Authenticates MIFARE Classic sectors against a list of known keys. The key
+// (A or B) that opened each sector is remembered per UID in a small LRU
+// cache, so a card seen before authenticates at the first attempt. For an
+// unknown sector the key that last worked on the same card is tried before
+// the rest of the list. A failed attempt drops the card out of its session,
+// so it is reselected only when another attempt follows.
+class MFRC522KeyDictionary {
+public:
+    static const uint8_t MAX_KEYS = 16;
+    static const uint8_t CACHE_SIZE = 8;
+    static const uint8_t MAX_SECTORS = 40;
+
+    MFRC522KeyDictionary(MFRC522 &pcd);
+
+    bool AddKey(const MFRC522::MIFARE_Key &key);
+    void ClearKeys();
+    uint8_t GetKeyCount() const;
+    void ClearCache();
+
+    // On success the card is authenticated to the sector and key/command
+    // (if given) receive the key that worked. On failure the card has been
+    // reselected and is unauthenticated.
+    MFRC522::StatusCode Authenticate(MFRC522::Uid *uid, uint8_t sector, MFRC522::MIFARE_Key *key = NULL, uint8_t *command = NULL);
+
+    uint32_t GetAttemptCount() const;
+    uint32_t GetReselectCount() const;
+    void ResetCounters();
+
+private:
+    struct CacheEntry {
+        MFRC522::Uid uid;
+        uint32_t lastUse;
+        uint8_t lastSlot;
+        uint8_t sectorSlot[MAX_SECTORS];
+    };
+
+    CacheEntry *FindEntry(const MFRC522::Uid *uid);
+
+    MFRC522 &_pcd;
+    MFRC522::MIFARE_Key _keys[MAX_KEYS];
+    uint8_t _keyCount;
+    CacheEntry _cache[CACHE_SIZE];
+    uint32_t _useCounter;
+    uint32_t _attempts;
+    uint32_t _reselects;
+
+    // A slot is a key index and key type: index * 2, plus one for key B.
+    static const uint8_t SLOT_UNKNOWN = 0xFF;
+};
+
+#endif
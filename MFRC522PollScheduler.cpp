@@ -0,0 +1,153 @@
+#include "MFRC522PollScheduler.h"
+
+MFRC522PollScheduler::MFRC522PollScheduler(MFRC522 &pcd)
+    : _pcd(pcd), _activeIntervalUs(DEFAULT_ACTIVE_INTERVAL_US),
+      _activeHoldUs(DEFAULT_ACTIVE_HOLD_US), _idleMinUs(DEFAULT_IDLE_MIN_US),
+      _idleMaxUs(DEFAULT_IDLE_MAX_US), _settleUs(DEFAULT_FIELD_SETTLE_US),
+      _fieldKnown(false), _fieldOn(false), _seenCard(false), _intervalUs(0), _probeAt(0),
+      _lastCardAt(0), _fieldOnSince(0), _probes(0), _detects(0),
+      _fieldOnUs(0) {}
+
+void MFRC522PollScheduler::SetActiveInterval(uint32_t intervalUs,
+                                             uint32_t holdUs) {
+  _activeIntervalUs = intervalUs;
+  _activeHoldUs = holdUs;
+}
+
+void MFRC522PollScheduler::SetIdleInterval(uint32_t minUs, uint32_t maxUs) {
+  _idleMinUs = minUs;
+  _idleMaxUs = maxUs < minUs ? minUs : maxUs;
+}
+
+void MFRC522PollScheduler::SetFieldSettle(uint32_t settleUs) {
+  _settleUs = settleUs;
+}
+
+bool MFRC522PollScheduler::Poll() {
+  uint64_t now = _pcd.PCD_GetTimeUs();
+  // The scheduler is usually built before PCD_Init, which leaves the
+  // antenna on, so the first call takes over whatever state it finds.
+  if (!_fieldKnown) {
+    _fieldKnown = true;
+    if ((_pcd.PCD_ReadRegister(MFRC522::TxControlReg) & 0x03) == 0x03) {
+      _fieldOn = true;
+      _fieldOnSince = now;
+    }
+  }
+
+  if (now < NextStepAt())
+    return false;
+
+  // The card needs the guard time to power up before it can answer.
+  if (!_fieldOn) {
+    FieldOn(now);
+    _probeAt = now + _settleUs;
+    if (_settleUs > 0)
+      return false;
+  }
+
+  _probes++;
+  bool found = Probe();
+  now = _pcd.PCD_GetTimeUs();
+  if (found) {
+    _detects++;
+    _seenCard = true;
+    _lastCardAt = now;
+    return true;
+  }
+
+  Schedule(now);
+  return false;
+}
+
+uint32_t MFRC522PollScheduler::GetDelayUs() {
+  uint64_t now = _pcd.PCD_GetTimeUs();
+  uint64_t at = NextStepAt();
+  return at > now ? at - now : 0;
+}
+
+void MFRC522PollScheduler::CardDone() {
+  uint64_t now = _pcd.PCD_GetTimeUs();
+  _seenCard = true;
+  _lastCardAt = now;
+  Schedule(now);
+}
+
+bool MFRC522PollScheduler::IsActive() {
+  return _seenCard && _pcd.PCD_GetTimeUs() - _lastCardAt < _activeHoldUs;
+}
+
+uint32_t MFRC522PollScheduler::GetProbeCount() const { return _probes; }
+
+uint32_t MFRC522PollScheduler::GetDetectCount() const { return _detects; }
+
+uint64_t MFRC522PollScheduler::GetFieldOnUs() {
+  if (!_fieldOn)
+    return _fieldOnUs;
+  return _fieldOnUs + _pcd.PCD_GetTimeUs() - _fieldOnSince;
+}
+
+void MFRC522PollScheduler::ResetStats() {
+  _probes = 0;
+  _detects = 0;
+  _fieldOnUs = 0;
+  _fieldOnSince = _pcd.PCD_GetTimeUs();
+}
+
+// REQA at 106 kbit/s with a timer just long enough for the ATQA. Any answer
+// counts, a collision means more than one card.
+bool MFRC522PollScheduler::Probe() {
+  uint8_t command = MFRC522::PICC_CMD_REQA;
+  uint8_t bufferATQA[2];
+  uint8_t bufferSize = sizeof(bufferATQA);
+  uint8_t validBits = 7;
+
+  _pcd.PCD_WriteRegister(MFRC522::TxModeReg, 0x00);
+  _pcd.PCD_WriteRegister(MFRC522::RxModeReg, 0x00);
+  _pcd.PCD_WriteRegister(MFRC522::ModWidthReg, 0x26);
+  _pcd.PCD_ClearRegisterBitMask(MFRC522::CollReg, 0x80);
+  _pcd.PCD_SetTimeout(PROBE_TIMEOUT_US);
+  MFRC522::StatusCode result = _pcd.PCD_TransceiveData(
+      &command, 1, bufferATQA, &bufferSize, &validBits);
+  return result == MFRC522::STATUS_OK || result == MFRC522::STATUS_COLLISION;
+}
+
+// Within the hold time of the last card the field stays on and probes are
+// close together; after it the interval starts at the idle minimum and
+// doubles with every empty probe.
+void MFRC522PollScheduler::Schedule(uint64_t now) {
+  if (_seenCard && now - _lastCardAt < _activeHoldUs) {
+    _intervalUs = _activeIntervalUs;
+    _probeAt = now + _intervalUs;
+    return;
+  }
+
+  if (_intervalUs < _idleMinUs)
+    _intervalUs = _idleMinUs;
+  else
+    _intervalUs = (_intervalUs > _idleMaxUs / 2) ? _idleMaxUs : _intervalUs * 2;
+  _probeAt = now + _intervalUs;
+  if (_intervalUs > _settleUs)
+    FieldOff(now);
+}
+
+void MFRC522PollScheduler::FieldOn(uint64_t now) {
+  _pcd.PCD_AntennaOn();
+  _fieldOn = true;
+  _fieldOnSince = now;
+}
+
+void MFRC522PollScheduler::FieldOff(uint64_t now) {
+  if (!_fieldOn)
+    return;
+
+  _pcd.PCD_AntennaOff();
+  _fieldOn = false;
+  _fieldOnUs += now - _fieldOnSince;
+}
+
+uint64_t MFRC522PollScheduler::NextStepAt() const {
+  if (_fieldOn || _probeAt < _settleUs)
+    return _probeAt;
+  return _probeAt - _settleUs;
+}
@@ -0,0 +1,77 @@
+#ifndef MFRC522POLLSCHEDULER_H
+#define MFRC522POLLSCHEDULER_H
+
+#include "mbed.h"
+#include "MFRC522.h"
+
+// Decides when to look for a card and keeps the RF field off in between.
+// For a while after a card, the field stays on and a short REQA probe runs
+// every few ms; once the reader has been idle that long, the field is only
+// switched on a guard time ahead of each probe and the interval doubles up
+// to a limit. A card left on the reader is powered down by the gaps and
+// answers again, like a new one, at the next idle probe.
+//
+//     while (true) {
+//         if (!scheduler.Poll()) { wait_us(scheduler.GetDelayUs()); continue; }
+//         ... PICC_ReadCardSerial, work with the card, PICC_HaltA ...
+//         scheduler.CardDone();
+//     }
+class MFRC522PollScheduler {
+public:
+    static const uint32_t DEFAULT_ACTIVE_INTERVAL_US = 5000;
+    static const uint32_t DEFAULT_ACTIVE_HOLD_US = 10000000;
+    static const uint32_t DEFAULT_IDLE_MIN_US = 50000;
+    static const uint32_t DEFAULT_IDLE_MAX_US = 100000;
+    static const uint32_t DEFAULT_FIELD_SETTLE_US = 5100;   // ISO/IEC 14443-3 guard time after field on
+
+    MFRC522PollScheduler(MFRC522 &pcd);
+
+    void SetActiveInterval(uint32_t intervalUs, uint32_t holdUs);
+    void SetIdleInterval(uint32_t minUs, uint32_t maxUs);
+    void SetFieldSettle(uint32_t settleUs);
+
+    // Does the next step if it is due: switches the field on, or probes.
+    // Returns true when a card answered; the field then stays on until
+    // CardDone. Never blocks longer than one probe.
+    bool Poll();
+    // Time until the next step is due.
+    uint32_t GetDelayUs();
+    // Ends the card transaction that followed a successful Poll.
+    void CardDone();
+    bool IsActive();
+
+    uint32_t GetProbeCount() const;
+    uint32_t GetDetectCount() const;
+    uint64_t GetFieldOnUs();
+    void ResetStats();
+
+private:
+    bool Probe();
+    void Schedule(uint64_t now);
+    void FieldOn(uint64_t now);
+    void FieldOff(uint64_t now);
+    uint64_t NextStepAt() const;
+
+    MFRC522 &_pcd;
+    uint32_t _activeIntervalUs;
+    uint32_t _activeHoldUs;
+    uint32_t _idleMinUs;
+    uint32_t _idleMaxUs;
+    uint32_t _settleUs;
+
+    bool _fieldKnown;
+    bool _fieldOn;
+    bool _seenCard;
+    uint32_t _intervalUs;
+    uint64_t _probeAt;
+    uint64_t _lastCardAt;
+    uint64_t _fieldOnSince;
+
+    uint32_t _probes;
+    uint32_t _detects;
+    uint64_t _fieldOnUs;
+
+    static const uint32_t PROBE_TIMEOUT_US = 300;          // ATQA is due 91 us after REQA
+};
+
+#endif
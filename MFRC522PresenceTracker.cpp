@@ -0,0 +1,94 @@
+#include "MFRC522PresenceTracker.h"
+
+MFRC522PresenceTracker::MFRC522PresenceTracker(MFRC522 &pcd)
+    : _pcd(pcd), _intervalUs(DEFAULT_CHECK_INTERVAL_US),
+      _missLimit(DEFAULT_MISS_LIMIT), _tracking(false), _misses(0),
+      _checkAt(0), _seenAt(0), _removalLatencyUs(0), _checks(0),
+      _lastCheckUs(0) {
+  memset(&_uid, 0, sizeof(_uid));
+}
+
+void MFRC522PresenceTracker::SetCheckInterval(uint32_t intervalUs) {
+  _intervalUs = intervalUs;
+}
+
+void MFRC522PresenceTracker::SetMissLimit(uint8_t misses) {
+  _missLimit = misses ? misses : 1;
+}
+
+MFRC522PresenceTracker::Event
+MFRC522PresenceTracker::Track(const MFRC522::Uid &uid) {
+  bool same = _tracking && uid.size == _uid.size &&
+              memcmp(uid.uidByte, _uid.uidByte, uid.size) == 0;
+
+  uint64_t now = _pcd.PCD_GetTimeUs();
+  _uid = uid;
+  _tracking = true;
+  _misses = 0;
+  _seenAt = now;
+  _checkAt = now + _intervalUs;
+  return same ? EVENT_NONE : EVENT_ARRIVED;
+}
+
+MFRC522PresenceTracker::Event MFRC522PresenceTracker::Poll() {
+  if (!_tracking || _pcd.PCD_GetTimeUs() < _checkAt)
+    return EVENT_NONE;
+
+  // A miss is repeated at once, so noise costs a frame, not an interval.
+  while (!Check()) {
+    if (++_misses >= _missLimit) {
+      _tracking = false;
+      _removalLatencyUs = _pcd.PCD_GetTimeUs() - _seenAt;
+      return EVENT_REMOVED;
+    }
+  }
+
+  _misses = 0;
+  _seenAt = _pcd.PCD_GetTimeUs();
+  _checkAt = _seenAt + _intervalUs;
+  return EVENT_NONE;
+}
+
+uint32_t MFRC522PresenceTracker::GetDelayUs() {
+  uint64_t now = _pcd.PCD_GetTimeUs();
+  return _tracking && _checkAt > now ? _checkAt - now : 0;
+}
+
+void MFRC522PresenceTracker::Stop() { _tracking = false; }
+
+bool MFRC522PresenceTracker::IsTracking() const { return _tracking; }
+
+const MFRC522::Uid &MFRC522PresenceTracker::GetUid() const { return _uid; }
+
+uint32_t MFRC522PresenceTracker::GetRemovalLatencyUs() const {
+  return _removalLatencyUs;
+}
+
+uint32_t MFRC522PresenceTracker::GetCheckCount() const { return _checks; }
+
+uint32_t MFRC522PresenceTracker::GetLastCheckUs() const {
+  return _lastCheckUs;
+}
+
+// WUPA and a SELECT with the complete UID: only the tracked card can answer
+// it, whatever else was halted on the reader.
+bool MFRC522PresenceTracker::Check() {
+  uint64_t start = _pcd.PCD_GetTimeUs();
+  MFRC522::Uid uid = _uid;
+  bool present = _pcd.PICC_Reselect(&uid) == MFRC522::STATUS_OK &&
+                 Halt() == MFRC522::STATUS_OK;
+  _checks++;
+  _lastCheckUs = _pcd.PCD_GetTimeUs() - start;
+  return present;
+}
+
+// HLTA is never answered, so it is only transmitted instead of waiting out
+// the timer as PICC_HaltA does.
+MFRC522::StatusCode MFRC522PresenceTracker::Halt() {
+  uint8_t buffer[4];
+  buffer[0] = MFRC522::PICC_CMD_HLTA;
+  buffer[1] = 0;
+  MFRC522::CalculateCRC_A(buffer, 2, &buffer[2]);
+  return _pcd.PCD_CommunicateWithPICC(MFRC522::PCD_Transmit, 0x40, buffer,
+                                      sizeof(buffer));
+}
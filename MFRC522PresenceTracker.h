@@ -0,0 +1,70 @@
+#ifndef MFRC522PRESENCETRACKER_H
+#define MFRC522PRESENCETRACKER_H
+
+#include "mbed.h"
+#include "MFRC522.h"
+
+// Follows one card that was read and halted, without anticollision: every
+// check wakes it with WUPA, selects it directly by its full UID and halts it
+// again, so a card left on a dock costs three short frames per check (one
+// more per extra cascade level). Other halted cards answer the WUPA too,
+// but only the tracked one answers the SELECT. A card counts as removed
+// after a number of checks in a row went unanswered; the repeats go out
+// back to back. The field must stay on while tracking.
+//
+//     if (tracker.IsTracking()) {
+//         if (tracker.Poll() == MFRC522PresenceTracker::EVENT_REMOVED) ...
+//         else wait_us(tracker.GetDelayUs());
+//     }
+class MFRC522PresenceTracker {
+public:
+    enum Event {
+        EVENT_NONE,
+        EVENT_ARRIVED,
+        EVENT_REMOVED
+    };
+
+    static const uint32_t DEFAULT_CHECK_INTERVAL_US = 20000;
+    static const uint8_t DEFAULT_MISS_LIMIT = 2;
+
+    MFRC522PresenceTracker(MFRC522 &pcd);
+
+    void SetCheckInterval(uint32_t intervalUs);
+    void SetMissLimit(uint8_t misses);
+
+    // Starts following a card that has been read; it must be halted before
+    // the next Poll. EVENT_NONE if that card was being followed already.
+    Event Track(const MFRC522::Uid &uid);
+    // Checks the card if a check is due. EVENT_REMOVED once it has gone.
+    Event Poll();
+    // Time until the next check is due.
+    uint32_t GetDelayUs();
+    void Stop();
+
+    bool IsTracking() const;
+    const MFRC522::Uid &GetUid() const;
+    // Time from the last answered check to the removal event, an upper
+    // bound for how long ago the card was taken away.
+    uint32_t GetRemovalLatencyUs() const;
+    uint32_t GetCheckCount() const;
+    uint32_t GetLastCheckUs() const;
+
+private:
+    bool Check();
+    MFRC522::StatusCode Halt();
+
+    MFRC522 &_pcd;
+    uint32_t _intervalUs;
+    uint8_t _missLimit;
+
+    bool _tracking;
+    MFRC522::Uid _uid;
+    uint8_t _misses;
+    uint64_t _checkAt;
+    uint64_t _seenAt;
+    uint32_t _removalLatencyUs;
+    uint32_t _checks;
+    uint32_t _lastCheckUs;
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "MFRC522Provisioner.h"
+
+namespace {
+
+const uint8_t GENERAL_PURPOSE_BYTE = 0x69;
+
+} // namespace
+
+MFRC522Provisioner::MFRC522Provisioner(MFRC522 &pcd)
+    : _pcd(pcd), _transportCommand(MFRC522::PICC_CMD_MF_AUTH_KEY_A),
+      _verify(true), _fastRead(true), _verifyPage(0) {
+  memset(_transportKey.keyByte, 0xFF, sizeof(_transportKey.keyByte));
+  Clear();
+  ResetStats();
+}
+
+void MFRC522Provisioner::Clear() {
+  _type = IMAGE_EMPTY;
+  memset(_present, 0, sizeof(_present));
+}
+
+void MFRC522Provisioner::SetTransportKey(const MFRC522::MIFARE_Key &key,
+                                         uint8_t command) {
+  _transportKey = key;
+  _transportCommand = command;
+}
+
+bool MFRC522Provisioner::Claim(ImageType type) {
+  if (_type != IMAGE_EMPTY && _type != type)
+    return false;
+
+  _type = type;
+  return true;
+}
+
+bool MFRC522Provisioner::SetBlock(uint8_t blockAddr, const uint8_t *data) {
+  if (blockAddr == 0 || data == NULL || !Claim(IMAGE_CLASSIC))
+    return false;
+
+  uint8_t *command = _commandFrames[blockAddr];
+  command[0] = MFRC522::PICC_CMD_MF_WRITE;
+  command[1] = blockAddr;
+  MFRC522::CalculateCRC_A(command, 2, &command[2]);
+
+  memcpy(_dataFrames[blockAddr], data, 16);
+  MFRC522::CalculateCRC_A(data, 16, &_dataFrames[blockAddr][16]);
+  _present[blockAddr / 32] |= 1UL << (blockAddr % 32);
+  return true;
+}
+
+bool MFRC522Provisioner::SetValueBlock(uint8_t blockAddr, int32_t value) {
+  uint8_t data[16];
+  MFRC522::MIFARE_MakeValueBlock(data, value, blockAddr);
+  return SetBlock(blockAddr, data);
+}
+
+bool MFRC522Provisioner::SetSectorTrailer(uint8_t sector,
+                                          const MFRC522::MIFARE_Key &keyA,
+                                          const MFRC522::MIFARE_Key &keyB,
+                                          uint8_t g0, uint8_t g1, uint8_t g2,
+                                          uint8_t g3) {
+  if (sector >= MAX_SECTORS)
+    return false;
+
+  uint8_t trailer[16];
+  memcpy(trailer, keyA.keyByte, 6);
+  MFRC522::MIFARE_SetAccessBits(&trailer[6], g0, g1, g2, g3);
+  trailer[9] = GENERAL_PURPOSE_BYTE;
+  memcpy(&trailer[10], keyB.keyByte, 6);
+  return SetBlock(MFRC522::MIFARE_GetSectorFirstBlock(sector) +
+                      MFRC522::MIFARE_GetSectorBlockCount(sector) - 1,
+                  trailer);
+}
+
+bool MFRC522Provisioner::SetPage(uint8_t page, const uint8_t *data) {
+  if (page < 2 || data == NULL || !Claim(IMAGE_ULTRALIGHT))
+    return false;
+
+  uint8_t *frame = _dataFrames[page];
+  frame[0] = MFRC522::PICC_CMD_UL_WRITE;
+  frame[1] = page;
+  memcpy(&frame[2], data, 4);
+  MFRC522::CalculateCRC_A(frame, 6, &frame[6]);
+  _present[page / 32] |= 1UL << (page % 32);
+  return true;
+}
+
+void MFRC522Provisioner::SetVerify(bool verify) { _verify = verify; }
+
+void MFRC522Provisioner::SetFastRead(bool fastRead) { _fastRead = fastRead; }
+
+MFRC522::StatusCode
+MFRC522Provisioner::Provision(MFRC522::Uid *uid,
+                              MFRC522::StatusCode *blockStatus) {
+  if (uid == NULL || _type == IMAGE_EMPTY)
+    return MFRC522::STATUS_INVALID;
+
+  uint64_t start = _pcd.PCD_GetTimeUs();
+  for (uint16_t block = 0; block < MAX_BLOCKS; block++) {
+    _status[block] = MFRC522::STATUS_INTERNAL_ERROR;
+  }
+
+  if (_type == IMAGE_CLASSIC) {
+    for (uint8_t sector = 0; sector < MAX_SECTORS; sector++) {
+      ProvisionSector(uid, sector);
+    }
+  } else {
+    ProvisionPages(uid);
+  }
+
+  MFRC522::StatusCode status = MFRC522::STATUS_OK;
+  for (uint16_t block = 0; block < MAX_BLOCKS; block++) {
+    if (!IsPresent(block))
+      continue;
+
+    if (blockStatus)
+      blockStatus[block] = _status[block];
+    if (_status[block] == MFRC522::STATUS_OK) {
+      _stats.blocksWritten++;
+      continue;
+    }
+    _stats.blocksFailed++;
+    if (status == MFRC522::STATUS_OK)
+      status = _status[block];
+  }
+
+  _stats.cards++;
+  if (status != MFRC522::STATUS_OK)
+    _stats.failedCards++;
+  _stats.busyUs += _pcd.PCD_GetTimeUs() - start;
+  return status;
+}
+
+// The trailer goes last, so the data blocks are written and read back with
+// the transport key and a bad trailer cannot lock them out of the check.
+void MFRC522Provisioner::ProvisionSector(MFRC522::Uid *uid, uint8_t sector) {
+  uint8_t firstBlock = MFRC522::MIFARE_GetSectorFirstBlock(sector);
+  uint8_t blockCount = MFRC522::MIFARE_GetSectorBlockCount(sector);
+  uint8_t trailer = firstBlock + blockCount - 1;
+
+  uint8_t blocks[16];
+  uint8_t count = 0;
+  for (uint8_t block = firstBlock; block < trailer; block++) {
+    if (IsPresent(block))
+      blocks[count++] = block;
+  }
+  if (count == 0 && !IsPresent(trailer))
+    return;
+
+  bool session = false;
+  WriteBlocks(uid, blocks, count, trailer, &session);
+
+  for (uint8_t i = 0; _verify && i < count; i++) {
+    uint8_t block = blocks[i];
+    if (_status[block] != MFRC522::STATUS_OK)
+      continue;
+
+    MFRC522::StatusCode result = MFRC522::STATUS_OK;
+    if (!session) {
+      result = Authenticate(uid, trailer, _transportKey.keyByte,
+                            _transportCommand);
+      if (result != MFRC522::STATUS_OK) {
+        Fail(&blocks[i], count - i, result);
+        break;
+      }
+      session = true;
+    }
+
+    uint8_t buffer[18];
+    uint8_t size = sizeof(buffer);
+    result = _pcd.MIFARE_Read(block, buffer, &size);
+    if (result != MFRC522::STATUS_OK) {
+      session = false;
+      _pcd.PICC_Reselect(uid);
+    } else if (memcmp(buffer, _dataFrames[block], 16) != 0) {
+      result = MFRC522::STATUS_ERROR;
+    }
+    _status[block] = result;
+  }
+
+  if (!IsPresent(trailer))
+    return;
+
+  blocks[0] = trailer;
+  WriteBlocks(uid, blocks, 1, trailer, &session);
+  if (!_verify || _status[trailer] != MFRC522::STATUS_OK)
+    return;
+
+  // Key A cannot be read back; the new key opening the sector proves it,
+  // and the access bits and general purpose byte are compared.
+  MFRC522::StatusCode result = Authenticate(
+      uid, trailer, _dataFrames[trailer], MFRC522::PICC_CMD_MF_AUTH_KEY_A);
+  if (result == MFRC522::STATUS_OK) {
+    uint8_t buffer[18];
+    uint8_t size = sizeof(buffer);
+    result = _pcd.MIFARE_Read(trailer, buffer, &size);
+    if (result != MFRC522::STATUS_OK)
+      _pcd.PICC_Reselect(uid);
+    else if (memcmp(&buffer[6], &_dataFrames[trailer][6], 4) != 0)
+      result = MFRC522::STATUS_ERROR;
+  }
+  _status[trailer] = result;
+}
+
+void MFRC522Provisioner::ProvisionPages(MFRC522::Uid *uid) {
+  uint8_t pages[MAX_BLOCKS];
+  uint8_t count = 0;
+  for (uint16_t page = 0; page < MAX_BLOCKS; page++) {
+    if (IsPresent(page))
+      pages[count++] = page;
+  }
+  if (count == 0)
+    return;
+
+  bool session = true;
+  WriteBlocks(uid, pages, count, 0, &session);
+  if (!_verify)
+    return;
+
+  _verifyPage = pages[0];
+  MFRC522::StatusCode result = _pcd.MIFARE_UltralightReadPages(
+      pages[0], pages[count - 1] - pages[0] + 1,
+      callback(this, &MFRC522Provisioner::VerifyPages), _fastRead);
+  if (result == MFRC522::STATUS_OK)
+    return;
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (pages[i] >= _verifyPage && _status[pages[i]] == MFRC522::STATUS_OK)
+      _status[pages[i]] = result;
+  }
+  _pcd.PICC_Reselect(uid);
+}
+
+bool MFRC522Provisioner::VerifyPages(const uint8_t *data, uint16_t length) {
+  for (uint16_t i = 0; i + 4 <= length && _verifyPage < MAX_BLOCKS;
+       i += 4, _verifyPage++) {
+    if (IsPresent(_verifyPage) &&
+        _status[_verifyPage] == MFRC522::STATUS_OK &&
+        memcmp(&data[i], &_dataFrames[_verifyPage][2], 4) != 0)
+      _status[_verifyPage] = MFRC522::STATUS_ERROR;
+  }
+  return true;
+}
+
+// Blocks go out in chains of up to MAX_CHAIN frames. A block the card
+// refuses ends its session, so the card is reselected (and the sector
+// opened again) before the rest.
+void MFRC522Provisioner::WriteBlocks(MFRC522::Uid *uid, const uint8_t *blocks,
+                                     uint8_t count, uint8_t trailer,
+                                     bool *session) {
+  bool classic = _type == IMAGE_CLASSIC;
+  uint8_t framesPerBlock = classic ? 2 : 1;
+  uint8_t next = 0;
+
+  while (next < count) {
+    if (!*session) {
+      MFRC522::StatusCode result =
+          classic ? Authenticate(uid, trailer, _transportKey.keyByte,
+                                 _transportCommand)
+                  : _pcd.PICC_Reselect(uid);
+      if (result != MFRC522::STATUS_OK) {
+        Fail(&blocks[next], count - next, result);
+        return;
+      }
+      *session = true;
+    }
+
+    MFRC522::MIFARE_Frame frames[MAX_CHAIN];
+    uint8_t frameCount = 0;
+    for (uint8_t i = next;
+         i < count && frameCount + framesPerBlock <= MAX_CHAIN; i++) {
+      uint8_t block = blocks[i];
+      if (classic) {
+        MFRC522::MIFARE_Frame command = {_commandFrames[block], 4,
+                                         MFRC522::TIMEOUT_MIFARE_US, false};
+        MFRC522::MIFARE_Frame data = {_dataFrames[block], 18,
+                                      MFRC522::TIMEOUT_MIFARE_WRITE_US, false};
+        frames[frameCount++] = command;
+        frames[frameCount++] = data;
+      } else {
+        MFRC522::MIFARE_Frame write = {_dataFrames[block], 8,
+                                       MFRC522::TIMEOUT_MIFARE_WRITE_US, false};
+        frames[frameCount++] = write;
+      }
+    }
+
+    uint8_t acked;
+    MFRC522::StatusCode result =
+        _pcd.PCD_MIFARE_TransceiveChain(frames, frameCount, &acked);
+    for (uint8_t i = 0; i < acked / framesPerBlock; i++) {
+      _status[blocks[next++]] = MFRC522::STATUS_OK;
+    }
+    if (result != MFRC522::STATUS_OK) {
+      _status[blocks[next++]] = result;
+      *session = false;
+      if (classic)
+        _pcd.PICC_Reselect(uid);
+    }
+  }
+}
+
+void MFRC522Provisioner::Fail(const uint8_t *blocks, uint8_t count,
+                              MFRC522::StatusCode result) {
+  for (uint8_t i = 0; i < count; i++) {
+    _status[blocks[i]] = result;
+  }
+}
+
+// A failed authentication leaves the card unresponsive until reselected.
+MFRC522::StatusCode MFRC522Provisioner::Authenticate(MFRC522::Uid *uid,
+                                                     uint8_t trailer,
+                                                     const uint8_t *key,
+                                                     uint8_t command) {
+  MFRC522::MIFARE_Key authKey;
+  memcpy(authKey.keyByte, key, sizeof(authKey.keyByte));
+
+  _stats.authentications++;
+  MFRC522::StatusCode result =
+      _pcd.PCD_Authenticate(command, trailer, &authKey, uid);
+  if (result != MFRC522::STATUS_OK)
+    _pcd.PICC_Reselect(uid);
+  return result;
+}
+
+const MFRC522Provisioner::Stats &MFRC522Provisioner::GetStats() const {
+  return _stats;
+}
+
+uint32_t MFRC522Provisioner::GetCardsPerMinute() const {
+  if (_stats.busyUs == 0)
+    return 0;
+  return (uint64_t)_stats.cards * 60000000 / _stats.busyUs;
+}
+
+void MFRC522Provisioner::ResetStats() { memset(&_stats, 0, sizeof(_stats)); }
@@ -0,0 +1,91 @@
+#ifndef MFRC522PROVISIONER_H
+#define MFRC522PROVISIONER_H
+
+#include "mbed.h"
+#include "MFRC522.h"
+
+// Writes one card image to a batch of MIFARE Classic or Ultralight/NTAG
+// cards. The image is encoded once: every block or page is kept as its
+// WRITE frames with CRC_A, so a card costs no CRC work at all. A Classic
+// sector is opened with one authentication, its data blocks go out as one
+// ACK chain (PCD_MIFARE_TransceiveChain) and are read back under the same
+// session; the trailer is written last and checked by authenticating with
+// its new key A. Ultralight pages are chained the same way and read back
+// with FAST_READ. A block that fails is reported and the card is reselected
+// to carry on with the rest.
+class MFRC522Provisioner {
+public:
+    static const uint16_t MAX_BLOCKS = 256;
+    static const uint8_t MAX_SECTORS = 40;
+
+    struct Stats {
+        uint32_t cards;
+        uint32_t failedCards;
+        uint32_t blocksWritten;
+        uint32_t blocksFailed;
+        uint32_t authentications;
+        uint64_t busyUs;
+    };
+
+    MFRC522Provisioner(MFRC522 &pcd);
+
+    void Clear();
+    // Key that opens the sectors of a blank card; the trailers of the image
+    // take effect only after the sector has been written.
+    void SetTransportKey(const MFRC522::MIFARE_Key &key, uint8_t command = MFRC522::PICC_CMD_MF_AUTH_KEY_A);
+    // An image holds Classic blocks or Ultralight pages, not both. Block 0
+    // and pages 0-1 hold the UID and are refused.
+    bool SetBlock(uint8_t blockAddr, const uint8_t *data);
+    bool SetValueBlock(uint8_t blockAddr, int32_t value);
+    // Access conditions per block group as C1 C2 C3 in bits 2-0.
+    bool SetSectorTrailer(uint8_t sector, const MFRC522::MIFARE_Key &keyA, const MFRC522::MIFARE_Key &keyB, uint8_t g0, uint8_t g1, uint8_t g2, uint8_t g3);
+    bool SetPage(uint8_t page, const uint8_t *data);
+    void SetVerify(bool verify);
+    // Plain Ultralight has no FAST_READ; pages are then read back with READ.
+    void SetFastRead(bool fastRead);
+
+    // The card must be selected. blockStatus, indexed by block or page
+    // address, receives the result of every block in the image and is left
+    // alone elsewhere. Returns STATUS_OK or the first failure.
+    MFRC522::StatusCode Provision(MFRC522::Uid *uid, MFRC522::StatusCode *blockStatus = NULL);
+
+    const Stats &GetStats() const;
+    uint32_t GetCardsPerMinute() const;
+    void ResetStats();
+
+private:
+    enum ImageType {
+        IMAGE_EMPTY,
+        IMAGE_CLASSIC,
+        IMAGE_ULTRALIGHT
+    };
+
+    bool IsPresent(uint16_t block) const { return (_present[block / 32] >> (block % 32)) & 1; }
+    bool Claim(ImageType type);
+    void ProvisionSector(MFRC522::Uid *uid, uint8_t sector);
+    void ProvisionPages(MFRC522::Uid *uid);
+    MFRC522::StatusCode Authenticate(MFRC522::Uid *uid, uint8_t trailer, const uint8_t *key, uint8_t command);
+    void WriteBlocks(MFRC522::Uid *uid, const uint8_t *blocks, uint8_t count, uint8_t trailer, bool *session);
+    void Fail(const uint8_t *blocks, uint8_t count, MFRC522::StatusCode result);
+    bool VerifyPages(const uint8_t *data, uint16_t length);
+
+    MFRC522 &_pcd;
+    ImageType _type;
+    uint32_t _present[MAX_BLOCKS / 32];
+    // Classic: the WRITE command frame and the data frame, each with CRC_A.
+    // Ultralight: the whole 8 byte WRITE frame in _dataFrames.
+    uint8_t _commandFrames[MAX_BLOCKS][4];
+    uint8_t _dataFrames[MAX_BLOCKS][18];
+    MFRC522::MIFARE_Key _transportKey;
+    uint8_t _transportCommand;
+    bool _verify;
+    bool _fastRead;
+
+    MFRC522::StatusCode _status[MAX_BLOCKS];
+    uint16_t _verifyPage;
+    Stats _stats;
+
+    static const uint8_t MAX_CHAIN = 30;                // the data blocks of a 4K sector, two frames each
+};
+
+#endif
@@ -0,0 +1,227 @@
+#include "MFRC522Purse.h"
+
+namespace {
+
+uint8_t SectorOf(uint8_t block) {
+  return block < 128 ? block / 4 : 32 + (block - 128) / 16;
+}
+
+} // namespace
+
+MFRC522Purse::MFRC522Purse(MFRC522 &pcd)
+    : _pcd(pcd), _valueBlock(0), _backupBlock(0), _trailer(0),
+      _command(MFRC522::PICC_CMD_MF_AUTH_KEY_A), _recoveries(0),
+      _lastTransactionUs(0) {
+  memset(_key.keyByte, 0xFF, sizeof(_key.keyByte));
+}
+
+bool MFRC522Purse::Configure(uint8_t valueBlock, uint8_t backupBlock,
+                             const MFRC522::MIFARE_Key &key, uint8_t command) {
+  uint8_t sector = SectorOf(valueBlock);
+  uint8_t trailer = MFRC522::MIFARE_GetSectorFirstBlock(sector) +
+                    MFRC522::MIFARE_GetSectorBlockCount(sector) - 1;
+  if (valueBlock == 0 || backupBlock == 0 || valueBlock == backupBlock ||
+      SectorOf(backupBlock) != sector || valueBlock == trailer ||
+      backupBlock == trailer)
+    return false;
+
+  _valueBlock = valueBlock;
+  _backupBlock = backupBlock;
+  _trailer = trailer;
+  _key = key;
+  _command = command;
+  return true;
+}
+
+// The backup gets the same address byte as the value block, because
+// TRANSFER copies it from the block the transfer buffer was loaded from.
+MFRC522::StatusCode MFRC522Purse::Format(MFRC522::Uid *uid, int32_t balance) {
+  if (uid == NULL || _trailer == 0 || balance < 0)
+    return MFRC522::STATUS_INVALID;
+
+  MFRC522::StatusCode status = Open(uid);
+  if (status != MFRC522::STATUS_OK)
+    return status;
+
+  uint8_t buffer[16];
+  MFRC522::MIFARE_MakeValueBlock(buffer, balance, _valueBlock);
+  status = _pcd.MIFARE_Write(_backupBlock, buffer, sizeof(buffer));
+  if (status == MFRC522::STATUS_OK)
+    status = _pcd.MIFARE_Write(_valueBlock, buffer, sizeof(buffer));
+  return Finish(uid, status);
+}
+
+MFRC522::StatusCode MFRC522Purse::GetBalance(MFRC522::Uid *uid,
+                                             int32_t *balance) {
+  if (uid == NULL || balance == NULL || _trailer == 0)
+    return MFRC522::STATUS_INVALID;
+
+  MFRC522::StatusCode status = Open(uid);
+  if (status != MFRC522::STATUS_OK)
+    return status;
+
+  return Finish(uid, ReadBalance(balance));
+}
+
+MFRC522::StatusCode MFRC522Purse::Debit(MFRC522::Uid *uid, int32_t amount,
+                                        int32_t *balance) {
+  return Apply(uid, MFRC522::PICC_CMD_MF_DECREMENT, amount, balance);
+}
+
+MFRC522::StatusCode MFRC522Purse::Credit(MFRC522::Uid *uid, int32_t amount,
+                                         int32_t *balance) {
+  return Apply(uid, MFRC522::PICC_CMD_MF_INCREMENT, amount, balance);
+}
+
+uint32_t MFRC522Purse::GetRecoveryCount() const { return _recoveries; }
+
+uint32_t MFRC522Purse::GetLastTransactionUs() const {
+  return _lastTransactionUs;
+}
+
+void MFRC522Purse::ResetCounters() {
+  _recoveries = 0;
+  _lastTransactionUs = 0;
+}
+
+// The backup is refreshed before the value block changes, so at any point
+// one of them holds a valid balance: the old one until the final TRANSFER,
+// the new one after it.
+MFRC522::StatusCode MFRC522Purse::Apply(MFRC522::Uid *uid, uint8_t command,
+                                        int32_t amount, int32_t *balance) {
+  if (uid == NULL || amount < 0 || _trailer == 0)
+    return MFRC522::STATUS_INVALID;
+
+  uint64_t start = _pcd.PCD_GetTimeUs();
+  MFRC522::StatusCode status = Open(uid);
+  if (status != MFRC522::STATUS_OK)
+    return status;
+
+  int32_t current;
+  status = ReadBalance(&current);
+  if (status != MFRC522::STATUS_OK)
+    return Finish(uid, status);
+  if (balance)
+    *balance = current;
+
+  int64_t target = command == MFRC522::PICC_CMD_MF_DECREMENT
+                       ? (int64_t)current - amount
+                       : (int64_t)current + amount;
+  if (target < 0 || target > INT32_MAX)
+    return MFRC522::STATUS_INVALID;
+
+  uint8_t restore[4];
+  uint8_t zero[6];
+  uint8_t backup[4];
+  uint8_t change[4];
+  uint8_t operand[6];
+  uint8_t transfer[4];
+  MakeFrame(restore, MFRC522::PICC_CMD_MF_RESTORE, _valueBlock);
+  MakeOperand(zero, 0);
+  MakeFrame(backup, MFRC522::PICC_CMD_MF_TRANSFER, _backupBlock);
+  MakeFrame(change, command, _valueBlock);
+  MakeOperand(operand, amount);
+  MakeFrame(transfer, MFRC522::PICC_CMD_MF_TRANSFER, _valueBlock);
+
+  MFRC522::MIFARE_Frame frames[6] = {
+      {restore, sizeof(restore), MFRC522::TIMEOUT_MIFARE_US, false},
+      {zero, sizeof(zero), MFRC522::TIMEOUT_MIFARE_OPERAND_US, true},
+      {backup, sizeof(backup), MFRC522::TIMEOUT_MIFARE_WRITE_US, false},
+      {change, sizeof(change), MFRC522::TIMEOUT_MIFARE_US, false},
+      {operand, sizeof(operand), MFRC522::TIMEOUT_MIFARE_OPERAND_US, true},
+      {transfer, sizeof(transfer), MFRC522::TIMEOUT_MIFARE_WRITE_US, false}};
+  uint8_t acked;
+  status = _pcd.PCD_MIFARE_TransceiveChain(frames, 6, &acked);
+
+  // Only the last TRANSFER touches the value block. If its ACK was lost the
+  // write may still have happened, so the card is asked while it is here.
+  // It may still be in its session, and then the first WUPA only ends it.
+  if (status != MFRC522::STATUS_OK && acked == 5 &&
+      (_pcd.PICC_Reselect(uid) == MFRC522::STATUS_OK ||
+       _pcd.PICC_Reselect(uid) == MFRC522::STATUS_OK) &&
+      Open(uid) == MFRC522::STATUS_OK) {
+    int32_t after;
+    if (ReadBalance(&after) == MFRC522::STATUS_OK && after == target)
+      status = MFRC522::STATUS_OK;
+  }
+
+  if (status == MFRC522::STATUS_OK && balance)
+    *balance = target;
+  _lastTransactionUs = _pcd.PCD_GetTimeUs() - start;
+  return Finish(uid, status);
+}
+
+MFRC522::StatusCode MFRC522Purse::Open(MFRC522::Uid *uid) {
+  MFRC522::StatusCode status =
+      _pcd.PCD_Authenticate(_command, _trailer, &_key, uid);
+  if (status != MFRC522::STATUS_OK)
+    _pcd.PICC_Reselect(uid);
+  return status;
+}
+
+MFRC522::StatusCode MFRC522Purse::ReadValue(uint8_t block, int32_t *value,
+                                            bool *valid) {
+  uint8_t buffer[18];
+  uint8_t size = sizeof(buffer);
+  MFRC522::StatusCode status = _pcd.MIFARE_Read(block, buffer, &size);
+  if (status == MFRC522::STATUS_OK)
+    *valid = MFRC522::MIFARE_ParseValueBlock(buffer, value);
+  return status;
+}
+
+MFRC522::StatusCode MFRC522Purse::ReadBalance(int32_t *balance) {
+  bool valid;
+  MFRC522::StatusCode status = ReadValue(_valueBlock, balance, &valid);
+  if (status != MFRC522::STATUS_OK || valid)
+    return status;
+  return Rollback(balance);
+}
+
+// The card copies the backup over a torn value block with RESTORE and
+// TRANSFER, which also brings back its address byte.
+MFRC522::StatusCode MFRC522Purse::Rollback(int32_t *balance) {
+  bool valid;
+  MFRC522::StatusCode status = ReadValue(_backupBlock, balance, &valid);
+  if (status != MFRC522::STATUS_OK)
+    return status;
+  if (!valid)
+    return MFRC522::STATUS_ERROR;
+
+  uint8_t restore[4];
+  uint8_t zero[6];
+  uint8_t transfer[4];
+  MakeFrame(restore, MFRC522::PICC_CMD_MF_RESTORE, _backupBlock);
+  MakeOperand(zero, 0);
+  MakeFrame(transfer, MFRC522::PICC_CMD_MF_TRANSFER, _valueBlock);
+
+  MFRC522::MIFARE_Frame frames[3] = {
+      {restore, sizeof(restore), MFRC522::TIMEOUT_MIFARE_US, false},
+      {zero, sizeof(zero), MFRC522::TIMEOUT_MIFARE_OPERAND_US, true},
+      {transfer, sizeof(transfer), MFRC522::TIMEOUT_MIFARE_WRITE_US, false}};
+  status = _pcd.PCD_MIFARE_TransceiveChain(frames, 3);
+  if (status == MFRC522::STATUS_OK)
+    _recoveries++;
+  return status;
+}
+
+// A failed frame drops the card out of its session.
+MFRC522::StatusCode MFRC522Purse::Finish(MFRC522::Uid *uid,
+                                         MFRC522::StatusCode status) {
+  if (status != MFRC522::STATUS_OK && status != MFRC522::STATUS_INVALID)
+    _pcd.PICC_Reselect(uid);
+  return status;
+}
+
+void MFRC522Purse::MakeFrame(uint8_t *frame, uint8_t command,
+                             uint8_t blockAddr) {
+  frame[0] = command;
+  frame[1] = blockAddr;
+  MFRC522::CalculateCRC_A(frame, 2, &frame[2]);
+}
+
+void MFRC522Purse::MakeOperand(uint8_t *frame, int32_t operand) {
+  for (uint8_t i = 0; i < 4; i++) {
+    frame[i] = (uint32_t)operand >> (8 * i);
+  }
+  MFRC522::CalculateCRC_A(frame, 4, &frame[4]);
+}
@@ -0,0 +1,55 @@
+#ifndef MFRC522PURSE_H
+#define MFRC522PURSE_H
+
+#include "mbed.h"
+#include "MFRC522.h"
+
+// Debit and credit on a MIFARE Classic value block, guarded by a backup
+// value block in the same sector. One authentication and one READ, then a
+// single ACK chain: RESTORE the value into the backup, and DECREMENT or
+// INCREMENT it in place. A tear while the value block is written leaves it
+// invalid and it is rolled back from the backup at the next access; a tear
+// while the backup is written leaves the value untouched.
+class MFRC522Purse {
+public:
+    MFRC522Purse(MFRC522 &pcd);
+
+    // Both blocks must be data blocks of one sector, opened by key.
+    bool Configure(uint8_t valueBlock, uint8_t backupBlock, const MFRC522::MIFARE_Key &key, uint8_t command = MFRC522::PICC_CMD_MF_AUTH_KEY_A);
+
+    // The card must be selected. Every call authenticates the sector and
+    // leaves the card authenticated, or reselected after a failure.
+    MFRC522::StatusCode Format(MFRC522::Uid *uid, int32_t balance);
+    MFRC522::StatusCode GetBalance(MFRC522::Uid *uid, int32_t *balance);
+    // *balance receives the new balance, or after a failure the balance the
+    // card held before: if the card was pulled mid-way, a GetBalance at the
+    // next tap that differs from it means the transaction went through.
+    // STATUS_INVALID if the balance would go below zero or overflow.
+    MFRC522::StatusCode Debit(MFRC522::Uid *uid, int32_t amount, int32_t *balance = NULL);
+    MFRC522::StatusCode Credit(MFRC522::Uid *uid, int32_t amount, int32_t *balance = NULL);
+
+    uint32_t GetRecoveryCount() const;
+    uint32_t GetLastTransactionUs() const;
+    void ResetCounters();
+
+private:
+    MFRC522::StatusCode Apply(MFRC522::Uid *uid, uint8_t command, int32_t amount, int32_t *balance);
+    MFRC522::StatusCode Open(MFRC522::Uid *uid);
+    MFRC522::StatusCode ReadValue(uint8_t block, int32_t *value, bool *valid);
+    MFRC522::StatusCode ReadBalance(int32_t *balance);
+    MFRC522::StatusCode Rollback(int32_t *balance);
+    MFRC522::StatusCode Finish(MFRC522::Uid *uid, MFRC522::StatusCode status);
+    static void MakeFrame(uint8_t *frame, uint8_t command, uint8_t blockAddr);
+    static void MakeOperand(uint8_t *frame, int32_t operand);
+
+    MFRC522 &_pcd;
+    uint8_t _valueBlock;
+    uint8_t _backupBlock;
+    uint8_t _trailer;
+    MFRC522::MIFARE_Key _key;
+    uint8_t _command;
+    uint32_t _recoveries;
+    uint32_t _lastTransactionUs;
+};
+
+#endif
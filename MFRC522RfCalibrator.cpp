@@ -0,0 +1,193 @@
+#include "MFRC522RfCalibrator.h"
+
+namespace {
+
+// Receiver gain 18, 23, 33, 38, 43 and 48 dB.
+const uint8_t RX_GAINS[] = {0x00, 0x10, 0x40, 0x50, 0x60, 0x70};
+// MinLevel 4 to 12 with the reset CollLevel.
+const uint8_t RX_THRESHOLDS[] = {0x44, 0x64, 0x84, 0x94, 0xA4, 0xC4};
+// Stronger channel with and without freezing it, I and Q combined, and a
+// shorter receiver time constant.
+const uint8_t DEMODS[] = {0x4D, 0x0D, 0x8D, 0x49};
+// Carrier conductance of the p-driver.
+const uint8_t CW_CONDUCTANCES[] = {0x3F, 0x30, 0x20, 0x10};
+
+struct Sweep {
+  const uint8_t *values;
+  uint8_t count;
+};
+
+// The carrier first, since it sets both what the card gets and what the
+// receiver hears, then the receiver from its gain to the decoder.
+const Sweep SWEEPS[] = {
+    {CW_CONDUCTANCES, sizeof(CW_CONDUCTANCES)},
+    {RX_GAINS, sizeof(RX_GAINS)},
+    {RX_THRESHOLDS, sizeof(RX_THRESHOLDS)},
+    {DEMODS, sizeof(DEMODS)}};
+const uint8_t SWEEP_COUNT = sizeof(SWEEPS) / sizeof(SWEEPS[0]);
+
+} // namespace
+
+MFRC522RfCalibrator::MFRC522RfCalibrator(MFRC522 &pcd)
+    : _pcd(pcd), _trials(DEFAULT_TRIALS), _readBlock(0),
+      _command(MFRC522::PICC_CMD_MF_AUTH_KEY_A), _tried(0) {
+  memset(_key.keyByte, 0xFF, sizeof(_key.keyByte));
+  memset(&_profile, 0, sizeof(_profile));
+  memset(&_score, 0, sizeof(_score));
+  memset(&_baseline, 0, sizeof(_baseline));
+}
+
+void MFRC522RfCalibrator::SetTrials(uint8_t trials) {
+  _trials = trials ? trials : 1;
+}
+
+void MFRC522RfCalibrator::SetReadBlock(uint8_t blockAddr,
+                                       const MFRC522::MIFARE_Key &key,
+                                       uint8_t command) {
+  _readBlock = blockAddr;
+  _key = key;
+  _command = command;
+}
+
+// Coordinate descent: each setting is swept with the others at their best
+// values, and the sweep is repeated while it still finds something better.
+MFRC522::StatusCode MFRC522RfCalibrator::Calibrate() {
+  Profile best = ReadProfile();
+  Score bestScore;
+  Measure(&bestScore);
+  _baseline = bestScore;
+  _tried = 1;
+
+  for (uint8_t pass = 0; pass < CALIBRATION_PASSES; pass++) {
+    bool changed = false;
+    for (uint8_t i = 0; i < SWEEP_COUNT; i++) {
+      for (uint8_t j = 0; j < SWEEPS[i].count; j++) {
+        Profile candidate = best;
+        if (*Setting(&candidate, i) == SWEEPS[i].values[j])
+          continue;
+
+        *Setting(&candidate, i) = SWEEPS[i].values[j];
+        Apply(candidate);
+        Score score;
+        Measure(&score);
+        _tried++;
+        if (IsBetter(score, bestScore)) {
+          best = candidate;
+          bestScore = score;
+          changed = true;
+        }
+      }
+      Apply(best);
+    }
+    if (!changed)
+      break;
+  }
+
+  _profile = best;
+  _score = bestScore;
+  return bestScore.successes ? MFRC522::STATUS_OK : MFRC522::STATUS_TIMEOUT;
+}
+
+void MFRC522RfCalibrator::Measure(Score *score) {
+  uint32_t errors = CountErrors();
+  uint64_t totalUs = 0;
+  score->trials = _trials;
+  score->successes = 0;
+  for (uint8_t i = 0; i < _trials; i++) {
+    uint32_t us;
+    if (Trial(&us)) {
+      score->successes++;
+      totalUs += us;
+    }
+  }
+  score->errors = CountErrors() - errors;
+  score->averageUs = score->successes ? totalUs / score->successes : 0;
+}
+
+void MFRC522RfCalibrator::Apply(const Profile &profile) {
+  _pcd.PCD_SetAntennaGain(profile.rxGain);
+  _pcd.PCD_WriteRegister(MFRC522::RxThresholdReg, profile.rxThreshold);
+  _pcd.PCD_WriteRegister(MFRC522::DemodReg, profile.demod);
+  _pcd.PCD_WriteRegister(MFRC522::CWGsPReg, profile.cwGsP);
+}
+
+MFRC522RfCalibrator::Profile MFRC522RfCalibrator::ReadProfile() {
+  Profile profile;
+  profile.rxGain = _pcd.PCD_GetAntennaGain();
+  profile.rxThreshold = _pcd.PCD_ReadRegister(MFRC522::RxThresholdReg);
+  profile.demod = _pcd.PCD_ReadRegister(MFRC522::DemodReg);
+  profile.cwGsP = _pcd.PCD_ReadRegister(MFRC522::CWGsPReg);
+  return profile;
+}
+
+const MFRC522RfCalibrator::Profile &MFRC522RfCalibrator::GetProfile() const {
+  return _profile;
+}
+
+const MFRC522RfCalibrator::Score &MFRC522RfCalibrator::GetScore() const {
+  return _score;
+}
+
+const MFRC522RfCalibrator::Score &
+MFRC522RfCalibrator::GetBaselineScore() const {
+  return _baseline;
+}
+
+uint16_t MFRC522RfCalibrator::GetProfilesTried() const { return _tried; }
+
+// The field reset puts the card back to IDLE whatever the last trial left
+// it in, so every trial starts from the same state as a fresh tap.
+bool MFRC522RfCalibrator::Trial(uint32_t *us) {
+  _pcd.PCD_StopCrypto1();
+  _pcd.PCD_AntennaOff();
+  _pcd.PCD_DelayUs(FIELD_OFF_US);
+  _pcd.PCD_AntennaOn();
+  _pcd.PCD_DelayUs(FIELD_SETTLE_US);
+
+  uint64_t start = _pcd.PCD_GetTimeUs();
+  MFRC522::Uid uid;
+  bool ok = _pcd.PICC_IsNewCardPresent() &&
+            _pcd.PICC_Select(&uid) == MFRC522::STATUS_OK;
+  if (ok && _readBlock) {
+    uint8_t buffer[18];
+    uint8_t size = sizeof(buffer);
+    ok = _pcd.PCD_Authenticate(_command, _readBlock, &_key, &uid) ==
+             MFRC522::STATUS_OK &&
+         _pcd.MIFARE_Read(_readBlock, buffer, &size) == MFRC522::STATUS_OK;
+  }
+  *us = _pcd.PCD_GetTimeUs() - start;
+  _pcd.PCD_StopCrypto1();
+  return ok;
+}
+
+// On equal successes the failed exchanges must drop by a quarter, so two
+// equally bad profiles do not trade places on noise.
+bool MFRC522RfCalibrator::IsBetter(const Score &a, const Score &b) {
+  if (a.successes != b.successes)
+    return a.successes > b.successes;
+  if (a.errors != b.errors)
+    return a.errors + a.errors / 4 < b.errors;
+  return a.averageUs < b.averageUs;
+}
+
+uint8_t *MFRC522RfCalibrator::Setting(Profile *profile, uint8_t index) {
+  switch (index) {
+  case 0:
+    return &profile->cwGsP;
+  case 1:
+    return &profile->rxGain;
+  case 2:
+    return &profile->rxThreshold;
+  default:
+    return &profile->demod;
+  }
+}
+
+uint32_t MFRC522RfCalibrator::CountErrors() const {
+  uint32_t errors = 0;
+  for (uint8_t status = MFRC522::STATUS_ERROR;
+       status < MFRC522::STATUS_CODE_COUNT; status++) {
+    errors += _pcd.PCD_GetStatusCount((MFRC522::StatusCode)status);
+  }
+  return errors;
+}
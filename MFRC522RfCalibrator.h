@@ -0,0 +1,73 @@
+#ifndef MFRC522RFCALIBRATOR_H
+#define MFRC522RFCALIBRATOR_H
+
+#include "mbed.h"
+#include "MFRC522.h"
+
+// Tunes the receiver to the antenna it is mounted with, against a reference
+// card held on the reader. The receiver gain, RxThresholdReg, DemodReg and
+// CWGsPReg are swept one at a time from the best profile so far. Every
+// candidate runs a number of trials: a field reset, REQA and SELECT, and
+// optionally an authenticated READ. Profiles are ranked by successful trials,
+// then by failed exchanges in the PCD status counters, then by latency.
+class MFRC522RfCalibrator {
+public:
+    static const uint8_t DEFAULT_TRIALS = 16;
+
+    struct Profile {
+        uint8_t rxGain;         // RFCfgReg bits 6-4, as PCD_SetAntennaGain takes it
+        uint8_t rxThreshold;
+        uint8_t demod;
+        uint8_t cwGsP;
+    };
+
+    struct Score {
+        uint8_t trials;
+        uint8_t successes;
+        uint32_t errors;        // exchanges that ended in anything but STATUS_OK
+        uint32_t averageUs;     // of the successful trials
+    };
+
+    MFRC522RfCalibrator(MFRC522 &pcd);
+
+    void SetTrials(uint8_t trials);
+    // Adds an authenticated READ of the block to every trial. Classic only.
+    void SetReadBlock(uint8_t blockAddr, const MFRC522::MIFARE_Key &key, uint8_t command = MFRC522::PICC_CMD_MF_AUTH_KEY_A);
+
+    // The reference card must stay in the field throughout. Leaves the best
+    // profile applied; STATUS_TIMEOUT if the card never answered.
+    MFRC522::StatusCode Calibrate();
+    // Scores whatever the chip is set to now.
+    void Measure(Score *score);
+    void Apply(const Profile &profile);
+    Profile ReadProfile();
+
+    const Profile &GetProfile() const;
+    const Score &GetScore() const;
+    // The score of the settings Calibrate started from.
+    const Score &GetBaselineScore() const;
+    uint16_t GetProfilesTried() const;
+
+private:
+    bool Trial(uint32_t *us);
+    static bool IsBetter(const Score &a, const Score &b);
+    static uint8_t *Setting(Profile *profile, uint8_t index);
+    uint32_t CountErrors() const;
+
+    MFRC522 &_pcd;
+    uint8_t _trials;
+    uint8_t _readBlock;
+    MFRC522::MIFARE_Key _key;
+    uint8_t _command;
+
+    Profile _profile;
+    Score _score;
+    Score _baseline;
+    uint16_t _tried;
+
+    static const uint8_t CALIBRATION_PASSES = 2;
+    static const uint32_t FIELD_OFF_US = 1000;              // card loses power and forgets its state
+    static const uint32_t FIELD_SETTLE_US = 5100;           // ISO/IEC 14443-3 guard time after field on
+};
+
+#endif
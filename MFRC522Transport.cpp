@@ -0,0 +1,77 @@
+#include "MFRC522Transport.h"
+
+bool MFRC522Transport::TransferAsync(const uint8_t *, uint8_t *, uint8_t,
+                                     Callback<void(bool)>) {
+  return false;
+}
+
+bool MFRC522Transport::SetFrequency(uint32_t) { return false; }
+
+bool MFRC522Transport::HasIrq() const { return false; }
+
+void MFRC522Transport::ClearIrq() {}
+
+bool MFRC522Transport::WaitForIrq(uint32_t) { return false; }
+
+MFRC522SpiTransport::MFRC522SpiTransport(PinName mosi, PinName miso,
+                                         PinName sclk, PinName cs,
+                                         PinName reset, PinName irq)
+    : _spi(mosi, miso, sclk), _cs(cs), _reset(reset), _irq(NULL) {
+  _spi.format(8, 0);
+  _spi.frequency(DEFAULT_FREQUENCY);
+#if DEVICE_SPI_ASYNCH
+  _spi.set_dma_usage(DMA_USAGE_OPPORTUNISTIC);
+#endif
+  _cs = 1;
+  _reset = 1;
+  _timer.start();
+
+  if (irq != NC) {
+    _irq = new InterruptIn(irq);
+    _irq->fall(callback(this, &MFRC522SpiTransport::IrqHandler));
+  }
+}
+
+MFRC522SpiTransport::~MFRC522SpiTransport() { delete _irq; }
+
+bool MFRC522SpiTransport::TransferAsync(const uint8_t *tx, uint8_t *rx,
+                                        uint8_t length,
+                                        Callback<void(bool)> done) {
+#if DEVICE_SPI_ASYNCH
+  _asyncDone = done;
+  return _spi.transfer(tx, length, rx, length,
+                       callback(this, &MFRC522SpiTransport::TransferDone),
+                       SPI_EVENT_COMPLETE | SPI_EVENT_ERROR) == 0;
+#else
+  return false;
+#endif
+}
+
+#if DEVICE_SPI_ASYNCH
+void MFRC522SpiTransport::TransferDone(int event) {
+  _asyncDone(!(event & SPI_EVENT_ERROR));
+}
+#endif
+
+bool MFRC522SpiTransport::SetFrequency(uint32_t hz) {
+  _spi.frequency(hz);
+  return true;
+}
+
+void MFRC522SpiTransport::SetResetLine(bool active) { _reset = active ? 0 : 1; }
+
+void MFRC522SpiTransport::DelayUs(uint32_t us) { wait_us(us); }
+
+uint64_t MFRC522SpiTransport::GetTimeUs() {
+  return _timer.read_high_resolution_us();
+}
+
+bool MFRC522SpiTransport::HasIrq() const { return _irq != NULL; }
+
+void MFRC522SpiTransport::ClearIrq() { _irqFlags.clear(IRQ_FLAG); }
+
+bool MFRC522SpiTransport::WaitForIrq(uint32_t timeoutMs) {
+  return !(_irqFlags.wait_any(IRQ_FLAG, timeoutMs) & osFlagsError);
+}
+
+void MFRC522SpiTransport::IrqHandler() { _irqFlags.set(IRQ_FLAG); }
@@ -0,0 +1,67 @@
+#ifndef MFRC522TRANSPORT_H
+#define MFRC522TRANSPORT_H
+
+#include "mbed.h"
+
+// Everything MFRC522 needs from the outside world: SPI frames, the reset and
+// IRQ lines, and a clock. MFRC522SpiTransport drives the real chip; the
+// simulator in sim/ implements the same interface on a host.
+class MFRC522Transport {
+public:
+    virtual ~MFRC522Transport() {}
+
+    virtual void Select() = 0;
+    virtual void Deselect() = 0;
+    virtual void Transfer(const uint8_t *tx, uint8_t *rx, uint8_t length) = 0;
+    virtual bool TransferAsync(const uint8_t *tx, uint8_t *rx, uint8_t length, Callback<void(bool)> done);
+    // Returns false if the clock cannot be changed.
+    virtual bool SetFrequency(uint32_t hz);
+    virtual void SetResetLine(bool active) = 0;
+    virtual void DelayUs(uint32_t us) = 0;
+    virtual uint64_t GetTimeUs() = 0;
+
+    virtual bool HasIrq() const;
+    virtual void ClearIrq();
+    virtual bool WaitForIrq(uint32_t timeoutMs);
+};
+
+// Final, so MFRC522T<MFRC522SpiTransport> calls it directly; the per-frame
+// calls are defined here to be inlined into the register accessors.
+class MFRC522SpiTransport final : public MFRC522Transport {
+public:
+    static const uint32_t DEFAULT_FREQUENCY = 1000000;
+
+    MFRC522SpiTransport(PinName mosi, PinName miso, PinName sclk, PinName cs, PinName reset, PinName irq = NC);
+    virtual ~MFRC522SpiTransport();
+
+    virtual void Select() { _cs = 0; }
+    virtual void Deselect() { _cs = 1; }
+    virtual void Transfer(const uint8_t *tx, uint8_t *rx, uint8_t length) { _spi.write((const char *)tx, length, (char *)rx, rx ? length : 0); }
+    virtual bool TransferAsync(const uint8_t *tx, uint8_t *rx, uint8_t length, Callback<void(bool)> done);
+    virtual bool SetFrequency(uint32_t hz);
+    virtual void SetResetLine(bool active);
+    virtual void DelayUs(uint32_t us);
+    virtual uint64_t GetTimeUs();
+
+    virtual bool HasIrq() const;
+    virtual void ClearIrq();
+    virtual bool WaitForIrq(uint32_t timeoutMs);
+
+private:
+    void IrqHandler();
+#if DEVICE_SPI_ASYNCH
+    void TransferDone(int event);
+#endif
+
+    SPI _spi;
+    DigitalOut _cs;
+    DigitalOut _reset;
+    InterruptIn *_irq;
+    EventFlags _irqFlags;
+    Timer _timer;
+    Callback<void(bool)> _asyncDone;
+
+    static const uint32_t IRQ_FLAG = 0x01;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "NdefParser.h"
+
+NdefParser::NdefParser() { Reset(); }
+
+// The record callback is kept, so a parser can be reused across taps.
+void NdefParser::Reset() {
+  _state = STATE_TLV_TYPE;
+  _tlvType = TLV_NULL;
+  _tlvRemaining = 0;
+  _shortRecord = false;
+  _hasId = false;
+  _idLength = 0;
+  _lengthBytes = 0;
+  _fieldLength = 0;
+  _fieldOffset = 0;
+  _recordCount = 0;
+  memset(&_record, 0, sizeof(_record));
+}
+
+bool NdefParser::Feed(const uint8_t *data, uint16_t length) {
+  for (uint16_t i = 0; i < length && !IsDone(); i++) {
+    Consume(data[i]);
+  }
+  return !IsDone();
+}
+
+void NdefParser::SetRecordCallback(Callback<bool(const Record &)> callback) {
+  _onRecord = callback;
+}
+
+NdefParser::State NdefParser::GetState() const { return _state; }
+
+bool NdefParser::IsDone() const {
+  return _state == STATE_DONE || _state == STATE_ERROR;
+}
+
+bool NdefParser::HasError() const { return _state == STATE_ERROR; }
+
+uint8_t NdefParser::GetRecordCount() const { return _recordCount; }
+
+const NdefParser::Record &NdefParser::GetRecord() const { return _record; }
+
+void NdefParser::Consume(uint8_t value) {
+  if (_state >= STATE_RECORD_FLAGS) {
+    _tlvRemaining--;
+  }
+
+  switch (_state) {
+  case STATE_TLV_TYPE:
+    if (value == TLV_TERMINATOR) {
+      _state = STATE_DONE;
+    } else if (value != TLV_NULL) {
+      _tlvType = value;
+      _state = STATE_TLV_LENGTH;
+    }
+    return;
+  case STATE_TLV_LENGTH:
+    if (value == 0xFF) {
+      _state = STATE_TLV_LENGTH_HIGH;
+      return;
+    }
+    _tlvRemaining = value;
+    BeginTlvValue();
+    return;
+  case STATE_TLV_LENGTH_HIGH:
+    _tlvRemaining = value << 8;
+    _state = STATE_TLV_LENGTH_LOW;
+    return;
+  case STATE_TLV_LENGTH_LOW:
+    _tlvRemaining |= value;
+    BeginTlvValue();
+    return;
+  case STATE_TLV_SKIP:
+    if (--_tlvRemaining == 0)
+      _state = STATE_TLV_TYPE;
+    return;
+  case STATE_RECORD_FLAGS:
+    memset(&_record, 0, sizeof(_record));
+    _record.tnf = value & 0x07;
+    _record.messageBegin = value & 0x80;
+    _record.messageEnd = value & 0x40;
+    _shortRecord = value & 0x10;
+    _hasId = value & 0x08;
+    _idLength = 0;
+    _state = STATE_RECORD_TYPE_LENGTH;
+    break;
+  case STATE_RECORD_TYPE_LENGTH:
+    _record.typeLength = value;
+    _lengthBytes = _shortRecord ? 1 : 4;
+    _state = STATE_RECORD_PAYLOAD_LENGTH;
+    break;
+  case STATE_RECORD_PAYLOAD_LENGTH:
+    _record.payloadLength = (_record.payloadLength << 8) | value;
+    if (--_lengthBytes)
+      break;
+    if (_hasId)
+      _state = STATE_RECORD_ID_LENGTH;
+    else
+      BeginField(STATE_RECORD_TYPE);
+    break;
+  case STATE_RECORD_ID_LENGTH:
+    _idLength = value;
+    BeginField(STATE_RECORD_TYPE);
+    break;
+  case STATE_RECORD_TYPE:
+  case STATE_RECORD_ID:
+  case STATE_RECORD_PAYLOAD:
+    if (_state == STATE_RECORD_TYPE && _fieldOffset < MAX_TYPE_LENGTH)
+      _record.type[_fieldOffset] = value;
+    if (_state == STATE_RECORD_PAYLOAD && _fieldOffset < MAX_PAYLOAD_LENGTH)
+      _record.payload[_fieldOffset] = value;
+    if (++_fieldOffset == _fieldLength)
+      BeginField((State)(_state + 1));
+    break;
+  case STATE_DONE:
+  case STATE_ERROR:
+  default:
+    return;
+  }
+
+  // A record must end exactly where its NDEF message TLV ends.
+  if (_tlvRemaining == 0 && !IsDone())
+    _state = STATE_ERROR;
+}
+
+void NdefParser::BeginTlvValue() {
+  if (_tlvType != TLV_NDEF_MESSAGE)
+    _state = _tlvRemaining ? STATE_TLV_SKIP : STATE_TLV_TYPE;
+  else
+    _state = _tlvRemaining ? STATE_RECORD_FLAGS : STATE_DONE;
+}
+
+// Moves on to the first non-empty field from the given one, finishing the
+// record after the payload.
+void NdefParser::BeginField(State field) {
+  for (; field <= STATE_RECORD_PAYLOAD; field = (State)(field + 1)) {
+    if (field == STATE_RECORD_TYPE)
+      _fieldLength = _record.typeLength;
+    else if (field == STATE_RECORD_ID)
+      _fieldLength = _idLength;
+    else
+      _fieldLength = _record.payloadLength;
+
+    if (_fieldLength) {
+      _state = field;
+      _fieldOffset = 0;
+      return;
+    }
+  }
+  FinishRecord();
+}
+
+void NdefParser::FinishRecord() {
+  _recordCount++;
+  bool more = !_onRecord || _onRecord(_record);
+  if (!more || _record.messageEnd || _tlvRemaining == 0)
+    _state = STATE_DONE;
+  else
+    _state = STATE_RECORD_FLAGS;
+}
+
+bool NdefParser::IsTextRecord(const Record &record) {
+  return record.tnf == TNF_WELL_KNOWN && record.typeLength == 1 &&
+         record.type[0] == 'T' && record.payloadLength > 0;
+}
+
+// Copies the UTF-8 text of an RTD Text record without its language code.
+// Returns false for other records and for UTF-16 text.
+bool NdefParser::GetText(const Record &record, char *text, uint8_t size) {
+  if (!IsTextRecord(record) || size == 0 || (record.payload[0] & 0x80))
+    return false;
+
+  uint32_t start = 1 + (record.payload[0] & 0x3F);
+  uint32_t end = record.payloadLength < MAX_PAYLOAD_LENGTH
+                     ? record.payloadLength
+                     : MAX_PAYLOAD_LENGTH;
+  uint8_t length = 0;
+  for (uint32_t i = start; i < end && length < size - 1; i++) {
+    text[length++] = record.payload[i];
+  }
+  text[length] = '\0';
+  return true;
+}
@@ -0,0 +1,86 @@
+#ifndef NDEFPARSER_H
+#define NDEFPARSER_H
+
+#include "mbed.h"
+
+// Incremental parser for the TLV area of a Type 2 tag (Ultralight, NTAG).
+// Bytes are fed in as pages arrive and each NDEF record is reported as soon
+// as its payload is complete. Feed() returns false once nothing more needs
+// to be read: after the last record of the message, a terminator TLV, a
+// malformed TLV, or when the record callback returns false.
+class NdefParser {
+public:
+    static const uint8_t MAX_TYPE_LENGTH = 16;
+    static const uint8_t MAX_PAYLOAD_LENGTH = 128;
+
+    static const uint8_t TLV_NULL = 0x00;
+    static const uint8_t TLV_NDEF_MESSAGE = 0x03;
+    static const uint8_t TLV_TERMINATOR = 0xFE;
+
+    static const uint8_t TNF_WELL_KNOWN = 0x01;
+
+    enum State {
+        STATE_TLV_TYPE,
+        STATE_TLV_LENGTH,
+        STATE_TLV_LENGTH_HIGH,
+        STATE_TLV_LENGTH_LOW,
+        STATE_TLV_SKIP,
+        STATE_RECORD_FLAGS,
+        STATE_RECORD_TYPE_LENGTH,
+        STATE_RECORD_PAYLOAD_LENGTH,
+        STATE_RECORD_ID_LENGTH,
+        STATE_RECORD_TYPE,
+        STATE_RECORD_ID,
+        STATE_RECORD_PAYLOAD,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    // Type and payload keep their first MAX_*_LENGTH bytes; the lengths are
+    // the ones on the tag.
+    struct Record {
+        uint8_t tnf;
+        bool messageBegin;
+        bool messageEnd;
+        uint8_t typeLength;
+        uint8_t type[MAX_TYPE_LENGTH];
+        uint32_t payloadLength;
+        uint8_t payload[MAX_PAYLOAD_LENGTH];
+    };
+
+    NdefParser();
+
+    void Reset();
+    bool Feed(const uint8_t *data, uint16_t length);
+    void SetRecordCallback(Callback<bool(const Record &)> callback);
+
+    State GetState() const;
+    bool IsDone() const;
+    bool HasError() const;
+    uint8_t GetRecordCount() const;
+    const Record &GetRecord() const;
+
+    static bool IsTextRecord(const Record &record);
+    static bool GetText(const Record &record, char *text, uint8_t size);
+
+private:
+    void Consume(uint8_t value);
+    void BeginTlvValue();
+    void BeginField(State field);
+    void FinishRecord();
+
+    State _state;
+    uint8_t _tlvType;
+    uint16_t _tlvRemaining;
+    bool _shortRecord;
+    bool _hasId;
+    uint8_t _idLength;
+    uint8_t _lengthBytes;
+    uint32_t _fieldLength;
+    uint32_t _fieldOffset;
+    Record _record;
+    uint8_t _recordCount;
+    Callback<bool(const Record &)> _onRecord;
+};
+
+#endif
@@ -3,8 +3,14 @@
 
 #include "GUI.h"
 #include "cy8ckit_028_tft.h"
+#include "DisplayLabel.h"
+#include "DisplayRefresh.h"
+#include "LCDConf.h"
 #include "mbed.h"
 #include "MFRC522.h"
+#include "MFRC522PollScheduler.h"
+#include "MFRC522PresenceTracker.h"
+#include "MFRC522RfCalibrator.h"
 #include <MQTTClientMbedOs.h>
 #include <cstdint>
 
@@ -12,7 +18,9 @@
 
 #define RFID_TOPIC "rfid/card"
 
-MFRC522 rfid(P8_0, P8_1, P8_2, P8_3, P8_4);
+MFRC522 rfid(P8_0, P8_1, P8_2, P8_3, P8_4, MBED_CONF_APP_RFID_IRQ_PIN);
+MFRC522PollScheduler poller(rfid);
+MFRC522PresenceTracker tracker(rfid);
 
 WiFiInterface *wifi;
 DigitalOut statusLed(LED1);
@@ -24,51 +32,144 @@ DigitalOut lightsB(LED5);
 #define LEDON 0
 #define LEDOFF 1
 
+const char *displayTitle = "RFID Reader System";
+const GUI_FONT *displayTitleFont = GUI_FONT_16B_1;
+
+// Paints everything on the screen that falls in area: the background, the
+// title and the labels.
+void Display_Draw(const GUI_RECT &area) {
+    GUI_SetBkColor(GUI_BLACK);
+    GUI_ClearRect(area.x0, area.y0, area.x1, area.y1);
+    if (area.y0 < GUI_GetYSizeOfFont(displayTitleFont)) {
+        GUI_SetFont(displayTitleFont);
+        GUI_SetColor(GUI_WHITE);
+        GUI_SetTextAlign(GUI_TA_HCENTER);
+        GUI_DispStringAt(displayTitle, LCD_GetXSize() / 2, 0);
+        GUI_SetTextAlign(GUI_TA_LEFT);
+    }
+    DisplayLabel::DrawAll(area);
+}
+
+DisplayRefresh refresh(Display_Draw, MBED_CONF_APP_DISPLAY_BAND_BYTES);
+
+DisplayLabel statusLabel(refresh, "status", 0, 40, GUI_FONT_16B_1, GUI_WHITE);
+DisplayLabel uidLabel(refresh, "uid", 0, 80, GUI_FONT_16B_1, GUI_GREEN);
+DisplayLabel typeLabel(refresh, "type", 0, 100, GUI_FONT_16B_1, GUI_GREEN);
+DisplayLabel mqttLabel(refresh, "mqtt", 0, 140, GUI_FONT_13B_1, GUI_YELLOW);
+DisplayLabel countLabel(refresh, "count", 0, 180, GUI_FONT_16B_1, GUI_CYAN);
+
 void Display_Init(void) {
     GUI_Init();
-    GUI_SetFont(GUI_FONT_16B_1);
-    GUI_SetColor(GUI_WHITE);
-    GUI_SetBkColor(GUI_BLACK);
-    GUI_Clear();
-    GUI_SetTextAlign(GUI_TA_HCENTER);
-    GUI_DispStringAt("RFID Reader System", 160, 0);
+    unsigned accel = LCDConf_GetAccel();
+    if (!(accel & LCDCONF_ACCEL_FILLRECT)) {
+        printf("Display: driver kept its own rectangle fill\n");
+    }
+    if (!(accel & LCDCONF_ACCEL_DRAWBMP_16BPP)) {
+        printf("Display: driver kept its own bitmap drawing\n");
+    }
+    refresh.InvalidateAll();
+    refresh.Flush();
+}
+
+void Display_SetTitle(const char* title, const GUI_FONT *font) {
+    int height = GUI_GetYSizeOfFont(displayTitleFont);
+    if (GUI_GetYSizeOfFont(font) > height) {
+        height = GUI_GetYSizeOfFont(font);
+    }
+    displayTitle = title;
+    displayTitleFont = font;
+    refresh.Invalidate(0, 0, LCD_GetXSize() - 1, height - 1);
 }
 
+// The status and MQTT lines flush the display. The card and count lines are
+// always followed by a status line, so all three go out in one flush.
 void Display_ShowStatus(const char* status) {
-    GUI_SetFont(GUI_FONT_16B_1);
-    GUI_SetColor(GUI_WHITE);
-    GUI_DispStringAt("                                        ", 0, 40);
-    GUI_DispStringAt(status, 0, 40);
+    statusLabel.SetText(status);
+    refresh.Flush();
 }
 
 void Display_ShowCard(const char* uid, const char* cardType) {
     char buffer[64];
-    GUI_SetFont(GUI_FONT_16B_1);
-    GUI_SetColor(GUI_GREEN);
-    
-    GUI_DispStringAt("                                        ", 0, 80);
     sprintf(buffer, "UID: %s", uid);
-    GUI_DispStringAt(buffer, 0, 80);
-    
-    GUI_DispStringAt("                                        ", 0, 100);
-    GUI_DispStringAt(cardType, 0, 100);
+    uidLabel.SetText(buffer);
+    typeLabel.SetText(cardType);
 }
 
 void Display_ShowMQTT(const char* status) {
-    GUI_SetFont(GUI_FONT_13B_1);
-    GUI_SetColor(GUI_YELLOW);
-    GUI_DispStringAt("                                        ", 0, 140);
-    GUI_DispStringAt(status, 0, 140);
+    mqttLabel.SetText(status);
+    refresh.Flush();
 }
 
 void Display_ShowCount(uint32_t count) {
     char buffer[32];
-    GUI_SetFont(GUI_FONT_16B_1);
-    GUI_SetColor(GUI_CYAN);
     sprintf(buffer, "Cards scanned: %lu", count);
-    GUI_DispStringAt("                                        ", 0, 180);
-    GUI_DispStringAt(buffer, 0, 180);
+    countLabel.SetText(buffer);
+}
+
+#if MBED_CONF_APP_DISPLAY_STATS
+void Display_PrintStats(void) {
+    printf("Display: %lu flushes, %lu rects, %lu bands (%lu direct), %lu pixels\n",
+           refresh.GetFlushes(), refresh.GetRects(), refresh.GetBands(),
+           refresh.GetDirect(), refresh.GetPixels());
+    printf("emWin pool peak: %lu of %lu bytes, band budget %lu bytes\n",
+           refresh.GetPoolPeak(), refresh.GetPoolSize(), refresh.GetBandBytes());
 }
+#endif
+
+#if MBED_CONF_APP_TFT_BENCHMARK
+// Pixels per second for full-screen clears, small rectangles and a bitmap
+// blit, all through emWin so the LCDConf handlers are what gets measured.
+// Leaves the whole screen to be drawn again.
+void Display_Benchmark(void) {
+    static U16 pixels[32 * 32];
+    static const GUI_BITMAP bitmap = {
+        32, 32, 32 * 2, 16, (const U8 *)pixels, NULL, GUI_DRAW_BMPM565
+    };
+    int xSize = LCD_GetXSize();
+    int ySize = LCD_GetYSize();
+    Timer timer;
+    int us;
+
+    for (int i = 0; i < 32 * 32; i++) {
+        pixels[i] = i * 0x0841;
+    }
+    timer.start();
+
+    timer.reset();
+    for (int i = 0; i < 10; i++) {
+        GUI_SetBkColor(i & 1 ? GUI_BLUE : GUI_BLACK);
+        GUI_Clear();
+    }
+    us = timer.read_us();
+    printf("Full-screen clear: %d us, %lu pixels/s\n", us / 10,
+           (unsigned long)(10ULL * xSize * ySize * 1000000 / us));
+
+    timer.reset();
+    for (int i = 0; i < 200; i++) {
+        int x = (i * 37) % (xSize - 16);
+        int y = (i * 23) % (ySize - 16);
+        GUI_SetColor(i * 0x010203);
+        GUI_FillRect(x, y, x + 15, y + 15);
+    }
+    us = timer.read_us();
+    printf("16x16 fill: %d us, %lu pixels/s\n", us / 200,
+           (unsigned long)(200ULL * 16 * 16 * 1000000 / us));
+
+    if (!(LCDConf_GetAccel() & LCDCONF_ACCEL_DRAWBMP_16BPP)) {
+        printf("32x32 blit: not measured, driver kept its own bitmap drawing\n");
+    } else {
+        timer.reset();
+        for (int i = 0; i < 50; i++) {
+            GUI_DrawBitmap(&bitmap, (i * 41) % (xSize - 32), (i * 29) % (ySize - 32));
+        }
+        us = timer.read_us();
+        printf("32x32 blit: %d us, %lu pixels/s\n", us / 50,
+               (unsigned long)(50ULL * 32 * 32 * 1000000 / us));
+    }
+
+    refresh.InvalidateAll();
+}
+#endif
 
 void printHex(uint8_t *buffer, uint8_t bufferSize) {
     for (uint8_t i = 0; i < bufferSize; i++) {
@@ -133,6 +234,9 @@ int main() {
     printf("\n=== MFRC522 RFID Reader with Display ===\n\n");
     
     Display_Init();
+#if MBED_CONF_APP_TFT_BENCHMARK
+    Display_Benchmark();
+#endif
     Display_ShowStatus("Initializing...");
     
     lightsR = LEDOFF;
@@ -140,6 +244,28 @@ int main() {
     lightsB = LEDOFF;
     
     rfid.PCD_Init();
+    if (rfid.PCD_CalibrateSpiClock() == MFRC522::STATUS_OK) {
+        printf("RFID SPI clock: %lu Hz\n", rfid.PCD_GetSpiFrequency());
+    } else {
+        printf("WARNING: RFID SPI check failed at the lowest clock\n");
+    }
+    
+#if MBED_CONF_APP_RFID_CALIBRATE
+    printf("Hold a reference card on the reader to calibrate...\n");
+    Display_ShowStatus("Hold reference card");
+    while (!rfid.PICC_IsNewCardPresent()) {
+        wait_us(100000);
+    }
+    MFRC522RfCalibrator calibrator(rfid);
+    if (calibrator.Calibrate() == MFRC522::STATUS_OK) {
+        const MFRC522RfCalibrator::Profile &profile = calibrator.GetProfile();
+        printf("RF profile: gain 0x%02X threshold 0x%02X demod 0x%02X CWGsP 0x%02X, %u/%u taps\n",
+               profile.rxGain, profile.rxThreshold, profile.demod, profile.cwGsP,
+               calibrator.GetScore().successes, calibrator.GetScore().trials);
+    } else {
+        printf("WARNING: RF calibration found no working profile\n");
+    }
+#endif
     printf("RFID Reader initialized\n");
     Display_ShowStatus("RFID initialized");
     
@@ -230,14 +356,13 @@ int main() {
     
     wait_us(1000000);
     
-    GUI_Clear();
-    GUI_SetFont(GUI_FONT_20B_1);
-    GUI_SetColor(GUI_WHITE);
-    GUI_SetTextAlign(GUI_TA_HCENTER);
-    GUI_DispStringAt("RFID Reader Ready", 160, 0);
-    GUI_SetTextAlign(GUI_TA_LEFT);
-    Display_ShowStatus("Waiting for card...");
+    DisplayLabel::ResetAll();
+    Display_SetTitle("RFID Reader Ready", GUI_FONT_20B_1);
     Display_ShowCount(0);
+    Display_ShowStatus("Waiting for card...");
+#if MBED_CONF_APP_DISPLAY_STATS
+    Display_PrintStats();
+#endif
     
     printf("\n=== Ready to scan RFID cards ===\n");
     printf("Place a card near the reader...\n\n");
@@ -248,24 +373,38 @@ int main() {
     while (1) {
         statusLed = !statusLed;
         
-        if (!rfid.PICC_IsNewCardPresent()) {
-            wait_us(100000);
+        if (tracker.IsTracking()) {
+            if (tracker.Poll() != MFRC522PresenceTracker::EVENT_REMOVED) {
+                wait_us(tracker.GetDelayUs());
+                continue;
+            }
+            printf("Card removed: %s\n", lastUid);
+            lastUid[0] = '\0';
+            cardDetectedLed = 0;
+            lightsB = LEDOFF;
+            Display_ShowStatus("Waiting for card...");
+            poller.CardDone();
+            continue;
+        }
+        
+        if (!poller.Poll()) {
+            wait_us(poller.GetDelayUs());
             continue;
         }
         
         if (!rfid.PICC_ReadCardSerial()) {
-            wait_us(100000);
+            poller.CardDone();
             continue;
         }
         
         cardDetectedLed = 1;
         lightsB = LEDON;
-        cardCount++;
         
         char uidString[32];
         getUidString(rfid.uid.uidByte, rfid.uid.size, uidString);
         
-        if (strcmp(uidString, lastUid) != 0) {
+        if (tracker.Track(rfid.uid) == MFRC522PresenceTracker::EVENT_ARRIVED) {
+            cardCount++;
             printf("\n--- Card #%lu Detected ---\n", cardCount);
             printf("UID: ");
             printHex(rfid.uid.uidByte, rfid.uid.size);
@@ -281,6 +420,9 @@ int main() {
             Display_ShowCard(uidString, typeName);
             Display_ShowCount(cardCount);
             Display_ShowStatus("Card detected!");
+#if MBED_CONF_APP_DISPLAY_STATS
+            Display_PrintStats();
+#endif
             
             strcpy(lastUid, uidString);
             
@@ -311,11 +453,6 @@ int main() {
         rfid.PICC_HaltA();
         rfid.PCD_StopCrypto1();
         
-        wait_us(500000);
-        cardDetectedLed = 0;
-        lightsB = LEDOFF;
-        Display_ShowStatus("Waiting for card...");
-        
         if (mqttConnected) {
             client.yield(100);
         }
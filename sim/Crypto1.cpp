@@ -0,0 +1,82 @@
+#include "Crypto1.h"
+
+#define LF_POLY_ODD 0x29CE5C
+#define LF_POLY_EVEN 0x870804
+
+Crypto1::Crypto1() : _odd(0), _even(0) {}
+
+void Crypto1::Init(const uint8_t *key) {
+  uint64_t k = 0;
+  for (uint8_t i = 0; i < 6; i++) {
+    k = (k << 8) | key[i];
+  }
+
+  _odd = 0;
+  _even = 0;
+  for (int8_t i = 47; i > 0; i -= 2) {
+    _odd = (_odd << 1) | ((k >> ((i - 1) ^ 7)) & 1);
+    _even = (_even << 1) | ((k >> (i ^ 7)) & 1);
+  }
+}
+
+uint8_t Crypto1::Bit(uint8_t in, bool encrypted) {
+  uint8_t out = Filter(_odd);
+  uint32_t feed = (encrypted ? out : 0) ^ (in ? 1 : 0);
+  feed ^= LF_POLY_ODD & _odd;
+  feed ^= LF_POLY_EVEN & _even;
+  _even = (_even << 1) | Parity(feed);
+
+  uint32_t t = _odd;
+  _odd = _even;
+  _even = t;
+  return out;
+}
+
+uint8_t Crypto1::Byte(uint8_t in, bool encrypted) {
+  uint8_t out = 0;
+  for (uint8_t i = 0; i < 8; i++) {
+    out |= Bit((in >> i) & 1, encrypted) << i;
+  }
+  return out;
+}
+
+uint32_t Crypto1::Word(uint32_t in, bool encrypted) {
+  uint32_t out = 0;
+  for (uint8_t i = 0; i < 32; i++) {
+    out |= (uint32_t)Bit((in >> (i ^ 24)) & 1, encrypted) << (i ^ 24);
+  }
+  return out;
+}
+
+void Crypto1::Crypt(uint8_t *data, uint16_t bits) {
+  for (uint16_t i = 0; i < bits; i++) {
+    data[i / 8] ^= Bit(0, false) << (i % 8);
+  }
+}
+
+uint32_t Crypto1::PrngSuccessor(uint32_t x, uint32_t n) {
+  x = ((x >> 8) & 0xFF00FF) | ((x & 0xFF00FF) << 8);
+  x = (x >> 16) | (x << 16);
+  while (n--) {
+    x = (x >> 1) | (((x >> 16) ^ (x >> 18) ^ (x >> 19) ^ (x >> 21)) << 31);
+  }
+  x = ((x >> 8) & 0xFF00FF) | ((x & 0xFF00FF) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+uint8_t Crypto1::Filter(uint32_t x) {
+  uint32_t f;
+  f = (0xF22C0 >> (x & 0xF)) & 16;
+  f |= (0x6C9C0 >> ((x >> 4) & 0xF)) & 8;
+  f |= (0x3C8B0 >> ((x >> 8) & 0xF)) & 4;
+  f |= (0x1E458 >> ((x >> 12) & 0xF)) & 2;
+  f |= (0x0D938 >> ((x >> 16) & 0xF)) & 1;
+  return (0xEC57E80A >> f) & 1;
+}
+
+uint8_t Crypto1::Parity(uint32_t x) {
+  x ^= x >> 16;
+  x ^= x >> 8;
+  x ^= x >> 4;
+  return (0x6996 >> (x & 0xF)) & 1;
+}
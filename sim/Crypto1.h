@@ -0,0 +1,29 @@
+#ifndef CRYPTO1_H
+#define CRYPTO1_H
+
+#include <stdint.h>
+
+// MIFARE Classic stream cipher: 48-bit LFSR split into odd and even halves
+// with the two-layer non-linear filter. Words are big endian on the air, the
+// same convention the card nonces use.
+class Crypto1 {
+public:
+    Crypto1();
+
+    void Init(const uint8_t *key);
+    uint8_t Bit(uint8_t in, bool encrypted);
+    uint8_t Byte(uint8_t in, bool encrypted);
+    uint32_t Word(uint32_t in, bool encrypted);
+    void Crypt(uint8_t *data, uint16_t bits);
+
+    static uint32_t PrngSuccessor(uint32_t x, uint32_t n);
+
+private:
+    static uint8_t Filter(uint32_t x);
+    static uint8_t Parity(uint32_t x);
+
+    uint32_t _odd;
+    uint32_t _even;
+};
+
+#endif
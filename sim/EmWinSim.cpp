@@ -0,0 +1,463 @@
+#include "EmWinSim.h"
+
+#include <ctype.h>
+#include <string.h>
+
+const GUI_FONT GUI_Font13B_1 = {13, 3, 7, 8, 7, 4};
+const GUI_FONT GUI_Font16B_1 = {16, 4, 9, 10, 8, 5};
+const GUI_FONT GUI_Font20B_1 = {20, 5, 11, 12, 10, 6};
+
+namespace {
+
+// The emWin drawing context, one for the whole application as in emWin.
+struct Context {
+  const GUI_FONT *font;
+  GUI_COLOR color;
+  GUI_COLOR bkColor;
+  int textAlign;
+  int drawMode;
+};
+
+Context context;
+
+void ResetContext() {
+  context.font = GUI_FONT_16B_1;
+  context.color = GUI_WHITE;
+  context.bkColor = GUI_BLACK;
+  context.textAlign = GUI_TA_LEFT;
+  context.drawMode = GUI_DM_NORMAL;
+}
+
+bool IsGlyphPixel(U16 c, int x, int y) {
+  return c != ' ' && (c * 7 + x * 3 + y * 5) % 4 == 0;
+}
+
+} // namespace
+
+EmWinSim &EmWinSim::Get() {
+  static EmWinSim emWin;
+  return emWin;
+}
+
+const GUI_DEVICE_API GUIDRV_FlexColor_API = {0};
+const LCD_API_COLOR_CONV LCD_API_ColorConv_M565 = {16};
+const GUI_BITMAP_METHODS GUI_BitmapMethodsM565 = {16};
+
+EmWinSim::EmWinSim() : _poolSize(DEFAULT_POOL_BYTES) {
+  SetSize(DEFAULT_X_SIZE, DEFAULT_Y_SIZE);
+}
+
+void EmWinSim::SetSize(int xSize, int ySize) {
+  _xSize = xSize;
+  _ySize = ySize;
+  _panel.assign(xSize * ySize, 0);
+  _clipRect = NULL;
+  SetClipRect(NULL);
+  _memdevs.clear();
+  _selected = 0;
+  _poolUsed = POOL_BASE_BYTES;
+  _logging = false;
+  _log.clear();
+  _fillRect = NULL;
+  _drawBitmap16 = NULL;
+  _refused = 0;
+  _orientation = 0;
+  _portApi = false;
+  _driverFills = 0;
+  _driverBitmaps = 0;
+  ResetContext();
+  ResetCounters();
+}
+
+void EmWinSim::SetPoolSize(I32 bytes) { _poolSize = bytes; }
+
+void EmWinSim::RefuseDevFunc(int idFunc) { _refused |= 1u << idFunc; }
+
+// GUICC_M565: red in the top five bits. GUI_COLOR is 0xBBGGRR.
+U16 EmWinSim::ColorToIndex(GUI_COLOR color) {
+  return (U16)(((color & 0xF8) << 8) | ((color & 0xFC00) >> 5) |
+               ((color & 0xF80000) >> 19));
+}
+
+void EmWinSim::BeginUpdate() {
+  _log.clear();
+  _logging = true;
+}
+
+void EmWinSim::EndUpdate() {
+  _logging = false;
+  for (size_t i = 0; i < _log.size(); i++) {
+    if (_panel[_log[i].index] != _log[i].pixel)
+      _transients++;
+  }
+  _log.clear();
+}
+
+U16 EmWinSim::GetPixel(int x, int y) const {
+  return _panel[y * _xSize + x];
+}
+
+uint64_t EmWinSim::GetChecksum() const {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < _panel.size(); i++)
+    hash = (hash ^ _panel[i]) * 1099511628211ull;
+  return hash;
+}
+
+void EmWinSim::ResetCounters() {
+  _busBytes = 0;
+  _windows = 0;
+  _transients = 0;
+}
+
+// Every primitive on the panel opens a window, even one that the clip
+// rectangle hides.
+void EmWinSim::Primitive() {
+  if (_selected)
+    return;
+  _busBytes += 11;
+  _windows++;
+}
+
+void EmWinSim::Put(int x, int y, U16 pixel) {
+  if (_selected) {
+    Memdev &memdev = _memdevs[_selected - 1];
+    if (x < memdev.x0 || y < memdev.y0 || x >= memdev.x0 + memdev.xSize ||
+        y >= memdev.y0 + memdev.ySize)
+      return;
+    memdev.pixels[(y - memdev.y0) * memdev.xSize + x - memdev.x0] = pixel;
+    return;
+  }
+  if (x < _clip.x0 || x > _clip.x1 || y < _clip.y0 || y > _clip.y1)
+    return;
+  _busBytes += 2;
+  PanelWrite(x, y, pixel);
+}
+
+U16 EmWinSim::Peek(int x, int y) const {
+  if (_selected) {
+    const Memdev &memdev = _memdevs[_selected - 1];
+    if (x < memdev.x0 || y < memdev.y0 || x >= memdev.x0 + memdev.xSize ||
+        y >= memdev.y0 + memdev.ySize)
+      return 0;
+    return memdev.pixels[(y - memdev.y0) * memdev.xSize + x - memdev.x0];
+  }
+  if (x < 0 || y < 0 || x >= _xSize || y >= _ySize)
+    return 0;
+  return _panel[y * _xSize + x];
+}
+
+const GUI_RECT *EmWinSim::SetClipRect(const GUI_RECT *rect) {
+  const GUI_RECT *previous = _clipRect;
+  _clipRect = rect;
+  if (rect) {
+    _clip = *rect;
+  } else {
+    _clip.x0 = 0;
+    _clip.y0 = 0;
+    _clip.x1 = _xSize - 1;
+    _clip.y1 = _ySize - 1;
+  }
+  return previous;
+}
+
+// A new device holds no defined content, as in emWin, so a draw function
+// that misses a pixel shows up on the panel.
+GUI_MEMDEV_Handle EmWinSim::CreateMemdev(int x0, int y0, int xSize,
+                                         int ySize) {
+  I32 bytes = xSize * ySize * 2 + MEMDEV_HEADER_BYTES;
+  if (_poolUsed + bytes > _poolSize)
+    return 0;
+
+  _poolUsed += bytes;
+  Memdev memdev = {x0, y0, xSize, ySize,
+                   std::vector<U16>(xSize * ySize, 0xDEAD)};
+  _memdevs.push_back(memdev);
+  return (GUI_MEMDEV_Handle)_memdevs.size();
+}
+
+GUI_MEMDEV_Handle EmWinSim::SelectMemdev(GUI_MEMDEV_Handle memdev) {
+  GUI_MEMDEV_Handle previous = _selected;
+  _selected = memdev;
+  return previous;
+}
+
+void EmWinSim::CopyMemdev(GUI_MEMDEV_Handle handle) {
+  const Memdev &memdev = _memdevs[handle - 1];
+  _busBytes += 11;
+  _windows++;
+  for (int y = 0; y < memdev.ySize; y++) {
+    for (int x = 0; x < memdev.xSize; x++) {
+      _busBytes += 2;
+      PanelWrite(memdev.x0 + x, memdev.y0 + y,
+                 memdev.pixels[y * memdev.xSize + x]);
+    }
+  }
+}
+
+void EmWinSim::DeleteMemdev(GUI_MEMDEV_Handle handle) {
+  Memdev &memdev = _memdevs[handle - 1];
+  _poolUsed -= memdev.xSize * memdev.ySize * 2 + MEMDEV_HEADER_BYTES;
+  memdev.pixels.clear();
+  if (_selected == handle)
+    _selected = 0;
+}
+
+void EmWinSim::FillRect(int x0, int y0, int x1, int y1, U16 pixel) {
+  (_fillRect ? _fillRect : DriverFillRect)(0, x0, y0, x1, y1, pixel);
+}
+
+// A memory device draws bitmaps itself; on the panel the routine set with
+// LCD_SetDevFunc takes them, or the driver's own path, which is counted.
+void EmWinSim::DrawBitmap(int x, int y, const GUI_BITMAP &bitmap) {
+  const U16 *pixels = (const U16 *)bitmap.pData;
+  if (_drawBitmap16 && !_selected) {
+    ((DrawBitmap16Function *)_drawBitmap16)(0, x, y, pixels, bitmap.XSize,
+                                            bitmap.YSize, bitmap.BytesPerLine);
+    return;
+  }
+
+  if (!_selected)
+    _driverBitmaps++;
+  Primitive();
+  for (int j = 0; j < bitmap.YSize; j++) {
+    for (int i = 0; i < bitmap.XSize; i++)
+      Put(x + i, y + j, pixels[j * bitmap.BytesPerLine / 2 + i]);
+  }
+}
+
+int EmWinSim::SetDevFunc(int idFunc, void (*function)(void)) {
+  if (_refused & (1u << idFunc))
+    return 1;
+
+  switch (idFunc) {
+  case LCD_DEVFUNC_FILLRECT:
+    _fillRect = (FillRectFunction *)function;
+    return 0;
+  case LCD_DEVFUNC_DRAWBMP_16BPP:
+    _drawBitmap16 = function;
+    return 0;
+  default:
+    return 1;
+  }
+}
+
+void (*EmWinSim::GetDevFunc(int idFunc))(void) {
+  switch (idFunc) {
+  case LCD_DEVFUNC_FILLRECT:
+    return (void (*)(void))(_fillRect ? _fillRect : DriverFillRect);
+  case LCD_DEVFUNC_DRAWBMP_16BPP:
+    return _drawBitmap16;
+  default:
+    return NULL;
+  }
+}
+
+// The generic FlexColor fill. An XOR fill inverts what is there.
+void EmWinSim::DriverFillRect(int LayerIndex, int x0, int y0, int x1, int y1,
+                              U32 PixelIndex) {
+  GUI_USE_PARA(LayerIndex);
+  EmWinSim &emWin = Get();
+  emWin._driverFills++;
+  emWin.Primitive();
+  for (int y = y0; y <= y1; y++) {
+    for (int x = x0; x <= x1; x++) {
+      if (GUI_GetDrawMode() & GUI_DM_XOR)
+        emWin.Put(x, y, emWin.Peek(x, y) ^ 0xFFFF);
+      else
+        emWin.Put(x, y, (U16)PixelIndex);
+    }
+  }
+}
+
+void EmWinSim::PanelWrite(int x, int y, U16 pixel) {
+  if (x < 0 || y < 0 || x >= _xSize || y >= _ySize)
+    return;
+  _panel[y * _xSize + x] = pixel;
+  if (_logging) {
+    Write write = {y * _xSize + x, pixel};
+    _log.push_back(write);
+  }
+}
+
+void GUI_Init(void) { EmWinSim::Get().SetSize(LCD_GetXSize(), LCD_GetYSize()); }
+
+void GUI_Delay(int ms) { GUI_USE_PARA(ms); }
+
+const GUI_FONT *GUI_SetFont(const GUI_FONT *font) {
+  const GUI_FONT *previous = context.font;
+  context.font = font;
+  return previous;
+}
+
+const GUI_FONT *GUI_GetFont(void) { return context.font; }
+
+GUI_COLOR GUI_SetColor(GUI_COLOR color) {
+  GUI_COLOR previous = context.color;
+  context.color = color;
+  return previous;
+}
+
+GUI_COLOR GUI_GetColor(void) { return context.color; }
+
+GUI_COLOR GUI_SetBkColor(GUI_COLOR color) {
+  GUI_COLOR previous = context.bkColor;
+  context.bkColor = color;
+  return previous;
+}
+
+GUI_COLOR GUI_GetBkColor(void) { return context.bkColor; }
+
+int GUI_SetTextMode(int mode) {
+  GUI_USE_PARA(mode);
+  return GUI_TM_NORMAL;
+}
+
+int GUI_SetTextAlign(int align) {
+  int previous = context.textAlign;
+  context.textAlign = align;
+  return previous;
+}
+
+int GUI_SetDrawMode(int mode) {
+  int previous = context.drawMode;
+  context.drawMode = mode;
+  return previous;
+}
+
+int GUI_GetDrawMode(void) { return context.drawMode; }
+
+int GUI_GetCharDistX(U16 c) {
+  const GUI_FONT *font = context.font;
+  if (c == ' ')
+    return font->space;
+  if (isdigit(c))
+    return font->digit;
+  if (isupper(c))
+    return font->upper;
+  if (islower(c))
+    return font->lower;
+  return font->other;
+}
+
+int GUI_GetYSizeOfFont(const GUI_FONT *font) { return font->YSize; }
+
+void GUI_DispCharAt(U16 c, int x, int y) {
+  EmWinSim &emWin = EmWinSim::Get();
+  emWin.Primitive();
+  int width = GUI_GetCharDistX(c);
+  U16 color = EmWinSim::ColorToIndex(context.color);
+  U16 bkColor = EmWinSim::ColorToIndex(context.bkColor);
+  for (int j = 0; j < context.font->YSize; j++) {
+    for (int i = 0; i < width; i++)
+      emWin.Put(x + i, y + j, IsGlyphPixel(c, i, j) ? color : bkColor);
+  }
+}
+
+void GUI_DispStringAt(const char *s, int x, int y) {
+  if (context.textAlign == GUI_TA_HCENTER) {
+    int width = 0;
+    for (const char *c = s; *c; c++)
+      width += GUI_GetCharDistX((U8)*c);
+    x -= width / 2;
+  }
+  for (; *s; s++) {
+    GUI_DispCharAt((U8)*s, x, y);
+    x += GUI_GetCharDistX((U8)*s);
+  }
+}
+
+void GUI_Clear(void) { GUI_ClearRect(0, 0, LCD_GetXSize() - 1, LCD_GetYSize() - 1); }
+
+// Clearing draws the background colour whatever the draw mode.
+void GUI_ClearRect(int x0, int y0, int x1, int y1) {
+  int mode = GUI_SetDrawMode(GUI_DM_NORMAL);
+  EmWinSim::Get().FillRect(x0, y0, x1, y1,
+                           EmWinSim::ColorToIndex(context.bkColor));
+  GUI_SetDrawMode(mode);
+}
+
+void GUI_FillRect(int x0, int y0, int x1, int y1) {
+  EmWinSim::Get().FillRect(x0, y0, x1, y1,
+                           EmWinSim::ColorToIndex(context.color));
+}
+
+void GUI_DrawBitmap(const GUI_BITMAP *pBM, int x0, int y0) {
+  EmWinSim::Get().DrawBitmap(x0, y0, *pBM);
+}
+
+const GUI_RECT *GUI_SetClipRect(const GUI_RECT *rect) {
+  return EmWinSim::Get().SetClipRect(rect);
+}
+
+int LCD_GetXSize(void) { return EmWinSim::Get().GetXSize(); }
+
+int LCD_GetYSize(void) { return EmWinSim::Get().GetYSize(); }
+
+int LCD_SetSizeEx(int LayerIndex, int xSize, int ySize) {
+  GUI_USE_PARA(LayerIndex);
+  GUI_USE_PARA(xSize);
+  GUI_USE_PARA(ySize);
+  return 0;
+}
+
+int LCD_SetVSizeEx(int LayerIndex, int xSize, int ySize) {
+  return LCD_SetSizeEx(LayerIndex, xSize, ySize);
+}
+
+int LCD_SetDevFunc(int LayerIndex, int IdFunc, void (*pDriverFunc)(void)) {
+  GUI_USE_PARA(LayerIndex);
+  return EmWinSim::Get().SetDevFunc(IdFunc, pDriverFunc);
+}
+
+void (*LCD_GetDevFunc(int LayerIndex, int IdFunc))(void) {
+  GUI_USE_PARA(LayerIndex);
+  return EmWinSim::Get().GetDevFunc(IdFunc);
+}
+
+GUI_DEVICE *GUI_DEVICE_CreateAndLink(const GUI_DEVICE_API *pDeviceAPI,
+                                     const LCD_API_COLOR_CONV *pColorConvAPI,
+                                     U16 Flags, int LayerIndex) {
+  static GUI_DEVICE device;
+  GUI_USE_PARA(Flags);
+  GUI_USE_PARA(LayerIndex);
+  device.pDeviceAPI = pDeviceAPI;
+  device.pColorConvAPI = pColorConvAPI;
+  return &device;
+}
+
+void GUIDRV_FlexColor_Config(GUI_DEVICE *pDevice, CONFIG_FLEXCOLOR *pConfig) {
+  GUI_USE_PARA(pDevice);
+  EmWinSim::Get().Configure(*pConfig);
+}
+
+void GUIDRV_FlexColor_SetFunc(GUI_DEVICE *pDevice, GUI_PORT_API *pHW_API,
+                              int Controller, int Mode) {
+  GUI_USE_PARA(pDevice);
+  GUI_USE_PARA(Controller);
+  GUI_USE_PARA(Mode);
+  if (pHW_API->pfWrite8_A0 && pHW_API->pfWrite8_A1 && pHW_API->pfWriteM8_A1)
+    EmWinSim::Get().SetPortApi();
+}
+
+GUI_MEMDEV_Handle GUI_MEMDEV_CreateEx(int x0, int y0, int xSize, int ySize,
+                                      int flags) {
+  GUI_USE_PARA(flags);
+  return EmWinSim::Get().CreateMemdev(x0, y0, xSize, ySize);
+}
+
+GUI_MEMDEV_Handle GUI_MEMDEV_Select(GUI_MEMDEV_Handle memdev) {
+  return EmWinSim::Get().SelectMemdev(memdev);
+}
+
+void GUI_MEMDEV_CopyToLCD(GUI_MEMDEV_Handle memdev) {
+  EmWinSim::Get().CopyMemdev(memdev);
+}
+
+void GUI_MEMDEV_Delete(GUI_MEMDEV_Handle memdev) {
+  EmWinSim::Get().DeleteMemdev(memdev);
+}
+
+I32 GUI_ALLOC_GetNumUsedBytes(void) { return EmWinSim::Get().GetPoolUsed(); }
+
+I32 GUI_ALLOC_GetNumFreeBytes(void) { return EmWinSim::Get().GetPoolFree(); }
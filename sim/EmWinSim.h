@@ -0,0 +1,121 @@
+#ifndef EMWINSIM_H
+#define EMWINSIM_H
+
+#include "GUI.h"
+#include "GUIDRV_FlexColor.h"
+
+#include <vector>
+
+// Host model of emWin on the CY8CKIT-028-TFT, behind the GUI_ functions in
+// sim/host/GUI.h. Drawing goes to a model of the panel, or to the selected
+// memory device, as GUICC_M565 pixel indices. The panel is charged bus bytes
+// as GUIDRV_FlexColor writes them: an 11 byte CASET/RASET/RAMWR window per
+// primitive drawn on the panel or memory device copied to it, and 2 bytes
+// per pixel. Glyphs are cells of a fixed pattern in the text colour on the
+// background colour. Memory devices take 2 bytes per pixel plus a header
+// from a pool of SetPoolSize bytes, part of which emWin itself holds.
+//
+// Rectangle fills and clears go through LCD_DEVFUNC_FILLRECT: a routine set
+// with LCD_SetDevFunc, or the driver's own fill, which is counted. Bitmaps
+// drawn on the panel go through LCD_DEVFUNC_DRAWBMP_16BPP the same way.
+// GUI_Init resets the model; it does not run LCD_X_Config.
+class EmWinSim {
+public:
+    typedef void FillRectFunction(int LayerIndex, int x0, int y0, int x1, int y1, U32 PixelIndex);
+    typedef void DrawBitmap16Function(int LayerIndex, int x, int y, U16 const *p, int xSize, int ySize, int BytesPerLine);
+
+    static const int DEFAULT_X_SIZE = 320;
+    static const int DEFAULT_Y_SIZE = 240;
+    static const I32 DEFAULT_POOL_BYTES = 32768;
+    static const I32 POOL_BASE_BYTES = 3000;        // emWin's own allocations
+    static const I32 MEMDEV_HEADER_BYTES = 64;
+
+    static EmWinSim &Get();
+
+    // Clears the panel, the drawing context and the device functions, and
+    // frees every memory device.
+    void SetSize(int xSize, int ySize);
+    void SetPoolSize(I32 bytes);
+    // LCD_SetDevFunc fails for this function from now on.
+    void RefuseDevFunc(int idFunc);
+
+    static U16 ColorToIndex(GUI_COLOR color);
+
+    // While an update is open, every panel write is logged. Writes that the
+    // panel no longer shows at EndUpdate were seen only for a moment, and are
+    // counted as transient pixels.
+    void BeginUpdate();
+    void EndUpdate();
+
+    U16 GetPixel(int x, int y) const;
+    uint64_t GetChecksum() const;
+    int GetOrientation() const { return _orientation; }
+    bool HasPortApi() const { return _portApi; }
+    uint32_t GetDriverFills() const { return _driverFills; }
+    uint32_t GetDriverBitmaps() const { return _driverBitmaps; }
+    uint32_t GetBusBytes() const { return _busBytes; }
+    uint32_t GetWindows() const { return _windows; }
+    uint32_t GetTransients() const { return _transients; }
+    void ResetCounters();
+
+    // For the GUI_ functions: a primitive about to draw, its pixels, and
+    // what is under one of them in the panel or the selected memory device.
+    void Primitive();
+    void Put(int x, int y, U16 pixel);
+    U16 Peek(int x, int y) const;
+    const GUI_RECT *SetClipRect(const GUI_RECT *rect);
+    void FillRect(int x0, int y0, int x1, int y1, U16 pixel);
+    void DrawBitmap(int x, int y, const GUI_BITMAP &bitmap);
+    int SetDevFunc(int idFunc, void (*function)(void));
+    void (*GetDevFunc(int idFunc))(void);
+    void Configure(const CONFIG_FLEXCOLOR &config) { _orientation = config.Orientation; }
+    void SetPortApi() { _portApi = true; }
+    GUI_MEMDEV_Handle CreateMemdev(int x0, int y0, int xSize, int ySize);
+    GUI_MEMDEV_Handle SelectMemdev(GUI_MEMDEV_Handle memdev);
+    void CopyMemdev(GUI_MEMDEV_Handle memdev);
+    void DeleteMemdev(GUI_MEMDEV_Handle memdev);
+    int GetXSize() const { return _xSize; }
+    int GetYSize() const { return _ySize; }
+    I32 GetPoolUsed() const { return _poolUsed; }
+    I32 GetPoolFree() const { return _poolSize - _poolUsed; }
+
+private:
+    struct Memdev {
+        int x0, y0, xSize, ySize;
+        std::vector<U16> pixels;
+    };
+    struct Write {
+        int index;
+        U16 pixel;
+    };
+
+    EmWinSim();
+    void PanelWrite(int x, int y, U16 pixel);
+    static FillRectFunction DriverFillRect;
+
+    int _xSize;
+    int _ySize;
+    std::vector<U16> _panel;
+    GUI_RECT _clip;
+    const GUI_RECT *_clipRect;
+    std::vector<Memdev> _memdevs;
+    GUI_MEMDEV_Handle _selected;
+    I32 _poolSize;
+    I32 _poolUsed;
+
+    FillRectFunction *_fillRect;
+    void (*_drawBitmap16)(void);
+    uint32_t _refused;
+    int _orientation;
+    bool _portApi;
+    uint32_t _driverFills;
+    uint32_t _driverBitmaps;
+
+    bool _logging;
+    std::vector<Write> _log;
+    uint32_t _busBytes;
+    uint32_t _windows;
+    uint32_t _transients;
+};
+
+#endif
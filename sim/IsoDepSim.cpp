@@ -0,0 +1,248 @@
+#include "IsoDepSim.h"
+
+#include <string.h>
+
+namespace {
+
+const uint8_t CMD_RATS = 0xE0;
+const uint8_t CMD_PPS = 0xD0;
+
+const uint8_t PCB_I_BLOCK = 0x02;
+const uint8_t PCB_R_ACK = 0xA2;
+const uint8_t PCB_S_DESELECT = 0xC2;
+const uint8_t PCB_S_WTX = 0xF2;
+const uint8_t PCB_CHAINING = 0x10;
+const uint8_t PCB_NAK = 0x10;
+const uint8_t PCB_CID = 0x08;
+const uint8_t PCB_NAD = 0x04;
+const uint8_t PCB_BLOCK_NUMBER = 0x01;
+
+const uint8_t INS_SELECT = 0xA4;
+const uint8_t INS_READ_BINARY = 0xB0;
+const uint8_t INS_UPDATE_BINARY = 0xD6;
+
+const uint16_t FSD_TABLE[9] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+uint16_t PutStatus(uint8_t *response, uint16_t length, uint16_t status) {
+  response[length] = status >> 8;
+  response[length + 1] = status & 0xFF;
+  return length + 2;
+}
+
+} // namespace
+
+IsoDepSim::IsoDepSim(const uint8_t *uid, uint8_t uidSize, uint8_t ta1,
+                     uint8_t fsci, uint8_t fwi)
+    : PiccSim(uid, uidSize, uidSize == 4 ? 0x0004 : 0x0344, 0x20), _ta1(ta1),
+      _fsci(fsci), _fwi(fwi), _protocolActive(false), _ppsAllowed(false),
+      _cid(0), _useCid(false), _fsd(FSD_TABLE[2]), _blockNumber(1),
+      _commandLength(0), _responseLength(0), _responseOffset(0),
+      _wtxPending(false), _processingCycles(0), _dropCount(0) {
+  for (uint16_t i = 0; i < FILE_SIZE; i++) {
+    _file[i] = i * 7 + (i >> 8);
+  }
+}
+
+bool IsoDepSim::Receive(const Frame &request, Frame *response) {
+  if (!PiccSim::Receive(request, response))
+    return false;
+  if (_dropCount == 0)
+    return true;
+  _dropCount--;
+  response->bits = 0;
+  return false;
+}
+
+bool IsoDepSim::Process(const Frame &request, Frame *response) {
+  // A corrupt frame is ignored without leaving the protocol.
+  if (!CheckCRC(request))
+    return _protocolActive;
+
+  const uint8_t *data = request.data;
+  uint16_t length = request.bits / 8 - 2;
+  if (!_protocolActive)
+    return Activate(data, length, response);
+  if (_ppsAllowed && (data[0] & 0xF0) == CMD_PPS)
+    return Pps(data, length, response);
+  _ppsAllowed = false;
+
+  uint8_t pcb = data[0];
+  uint8_t offset = 1;
+  _useCid = pcb & PCB_CID;
+  if (_useCid) {
+    if (length < 2 || (data[1] & 0x0F) != _cid)
+      return true;
+    offset++;
+  }
+
+  if ((pcb & 0xE2) == PCB_I_BLOCK) {
+    if (pcb & PCB_NAD)
+      offset++;
+    if (length < offset ||
+        _commandLength + length - offset > (uint16_t)sizeof(_command))
+      return true;
+    _blockNumber ^= 1;
+    memcpy(&_command[_commandLength], &data[offset], length - offset);
+    _commandLength += length - offset;
+    if (pcb & PCB_CHAINING) {
+      SendBlock(response, PCB_R_ACK | _blockNumber, NULL, 0);
+      return true;
+    }
+
+    _responseLength = ProcessApdu(_command, _commandLength, _response);
+    _responseOffset = 0;
+    _commandLength = 0;
+    if (_processingCycles > FrameWaitCycles()) {
+      uint8_t wtxm = (_processingCycles + FrameWaitCycles() - 1) /
+                     FrameWaitCycles();
+      _wtxPending = true;
+      SendBlock(response, PCB_S_WTX, &wtxm, 1);
+      return true;
+    }
+    SendChunk(response, _processingCycles);
+    return true;
+  }
+
+  if ((pcb & 0xE6) == PCB_R_ACK) {
+    uint8_t blockNumber = pcb & PCB_BLOCK_NUMBER;
+    if (blockNumber == _blockNumber) {
+      *response = _lastBlock;
+      return true;
+    }
+    if (pcb & PCB_NAK) {
+      SendBlock(response, PCB_R_ACK | _blockNumber, NULL, 0);
+      return true;
+    }
+    _blockNumber ^= 1;
+    if (_responseOffset < _responseLength)
+      SendChunk(response);
+    return true;
+  }
+
+  if ((pcb & 0xF7) == PCB_S_WTX) {
+    if (_wtxPending) {
+      _wtxPending = false;
+      SendChunk(response, _processingCycles);
+    }
+    return true;
+  }
+
+  if ((pcb & 0xF7) == PCB_S_DESELECT) {
+    SendBlock(response, PCB_S_DESELECT, NULL, 0);
+    Halt();
+    return true;
+  }
+  return true;
+}
+
+// Leaving ACTIVE also drops back to 106 kbit/s in both directions.
+void IsoDepSim::Deactivate() {
+  _rxSpeed = 0;
+  _txSpeed = 0;
+  _protocolActive = false;
+  _ppsAllowed = false;
+  _commandLength = 0;
+  _responseLength = 0;
+  _responseOffset = 0;
+  _wtxPending = false;
+}
+
+bool IsoDepSim::Activate(const uint8_t *data, uint16_t length,
+                         Frame *response) {
+  if (length != 2 || data[0] != CMD_RATS || (data[1] & 0x0F) == 0x0F)
+    return false;
+
+  uint8_t fsdi = data[1] >> 4;
+  _fsd = FSD_TABLE[fsdi < 8 ? fsdi : 8];
+  _cid = data[1] & 0x0F;
+  _blockNumber = 1;
+  _protocolActive = true;
+  _ppsAllowed = true;
+
+  uint8_t ats[6] = {6, (uint8_t)(0x70 | _fsci), _ta1, (uint8_t)(_fwi << 4),
+                    0x02, 0x80};
+  SetBytes(response, ats, sizeof(ats));
+  AppendCRC(response);
+  return true;
+}
+
+// The PPS answer still goes out at the old rate; the new one applies to
+// the next frame in each direction.
+bool IsoDepSim::Pps(const uint8_t *data, uint16_t length, Frame *response) {
+  _ppsAllowed = false;
+  if (length != 3 || (data[0] & 0x0F) != _cid || data[1] != 0x11)
+    return true;
+
+  uint8_t dri = data[2] & 0x03;
+  uint8_t dsi = (data[2] >> 2) & 0x03;
+  bool same = dri == dsi;
+  if ((dri && !(_ta1 & (1 << (dri - 1)))) ||
+      (dsi && !(_ta1 & (0x08 << dsi))) || ((_ta1 & 0x80) && !same))
+    return true;
+
+  SetBytes(response, data, 1);
+  AppendCRC(response);
+  _rxSpeed = dri;
+  _txSpeed = dsi;
+  return true;
+}
+
+void IsoDepSim::SendBlock(Frame *response, uint8_t pcb, const uint8_t *inf,
+                          uint16_t infLength, uint32_t delayCycles) {
+  uint16_t length = 0;
+  response->data[length++] = pcb | (_useCid ? PCB_CID : 0);
+  if (_useCid)
+    response->data[length++] = _cid;
+  if (infLength)
+    memcpy(&response->data[length], inf, infLength);
+  response->bits = (length + infLength) * 8;
+  response->delayCycles = delayCycles;
+  AppendCRC(response);
+  _lastBlock = *response;
+}
+
+// Sends the next part of the pending response, chained if the rest does not
+// fit in a frame of the reader's FSD.
+void IsoDepSim::SendChunk(Frame *response, uint32_t delayCycles) {
+  uint16_t room = _fsd - 3 - (_useCid ? 1 : 0);
+  uint16_t chunk = _responseLength - _responseOffset;
+  bool chaining = chunk > room;
+  if (chaining)
+    chunk = room;
+
+  uint8_t pcb = PCB_I_BLOCK | _blockNumber | (chaining ? PCB_CHAINING : 0);
+  SendBlock(response, pcb, &_response[_responseOffset], chunk, delayCycles);
+  _responseOffset += chunk;
+}
+
+uint16_t IsoDepSim::ProcessApdu(const uint8_t *apdu, uint16_t length,
+                                uint8_t *response) {
+  if (length < 4)
+    return PutStatus(response, 0, 0x6700);
+
+  uint16_t offset = ((uint16_t)apdu[2] << 8) | apdu[3];
+  switch (apdu[1]) {
+  case INS_SELECT:
+    return PutStatus(response, 0, 0x9000);
+  case INS_READ_BINARY: {
+    uint16_t count = length > 4 && apdu[4] ? apdu[4] : 256;
+    if (offset >= FILE_SIZE)
+      return PutStatus(response, 0, 0x6B00);
+    if (count > FILE_SIZE - offset)
+      count = FILE_SIZE - offset;
+    memcpy(response, &_file[offset], count);
+    return PutStatus(response, count, 0x9000);
+  }
+  case INS_UPDATE_BINARY: {
+    uint16_t count = length > 4 ? apdu[4] : 0;
+    if (length != 5 + count)
+      return PutStatus(response, 0, 0x6700);
+    if (offset + count > FILE_SIZE)
+      return PutStatus(response, 0, 0x6B00);
+    memcpy(&_file[offset], &apdu[5], count);
+    return PutStatus(response, 0, 0x9000);
+  }
+  default:
+    return PutStatus(response, 0, 0x6D00);
+  }
+}
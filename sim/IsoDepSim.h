@@ -0,0 +1,63 @@
+#ifndef ISODEPSIM_H
+#define ISODEPSIM_H
+
+#include "PiccSim.h"
+
+// ISO/IEC 14443-4 card: RATS/ATS, PPS, I-block chaining in both directions,
+// R(ACK)/R(NAK) recovery, S(WTX) for commands slower than FWT and
+// S(DESELECT). The application is one binary file read and written with
+// READ BINARY and UPDATE BINARY; subclasses can replace ProcessApdu().
+class IsoDepSim : public PiccSim {
+public:
+    static const uint16_t FILE_SIZE = 4096;
+    static const uint16_t MAX_APDU = 512;
+
+    // ta1 is the bit rate byte of the ATS, fsci and fwi its frame size and
+    // frame waiting time integers.
+    IsoDepSim(const uint8_t *uid, uint8_t uidSize = 7, uint8_t ta1 = 0x77, uint8_t fsci = 8, uint8_t fwi = 7);
+
+    uint8_t *GetFile() { return _file; }
+    bool IsProtocolActive() const { return _protocolActive; }
+    uint8_t GetRxSpeed() const { return _rxSpeed; }
+    uint8_t GetTxSpeed() const { return _txSpeed; }
+    void SetProcessingCycles(uint32_t cycles) { _processingCycles = cycles; }
+    // Drops the next n answers, as if they were lost on air.
+    void DropAnswers(uint8_t count) { _dropCount = count; }
+
+    virtual bool Receive(const Frame &request, Frame *response);
+
+protected:
+    virtual bool Process(const Frame &request, Frame *response);
+    virtual void Deactivate();
+    // Returns the response length including the status word.
+    virtual uint16_t ProcessApdu(const uint8_t *apdu, uint16_t length, uint8_t *response);
+
+private:
+    bool Activate(const uint8_t *data, uint16_t length, Frame *response);
+    bool Pps(const uint8_t *data, uint16_t length, Frame *response);
+    void SendBlock(Frame *response, uint8_t pcb, const uint8_t *inf, uint16_t infLength, uint32_t delayCycles = 0);
+    void SendChunk(Frame *response, uint32_t delayCycles = 0);
+    uint32_t FrameWaitCycles() const { return (uint32_t)4096 << _fwi; }
+
+    uint8_t _ta1;
+    uint8_t _fsci;
+    uint8_t _fwi;
+    bool _protocolActive;
+    bool _ppsAllowed;
+    uint8_t _cid;
+    bool _useCid;
+    uint16_t _fsd;
+    uint8_t _blockNumber;
+    uint8_t _command[MAX_APDU];
+    uint16_t _commandLength;
+    uint8_t _response[MAX_APDU];
+    uint16_t _responseLength;
+    uint16_t _responseOffset;
+    bool _wtxPending;
+    uint32_t _processingCycles;
+    uint8_t _dropCount;
+    Frame _lastBlock;
+    uint8_t _file[FILE_SIZE];
+};
+
+#endif
@@ -0,0 +1,862 @@
+#include "MFRC522Sim.h"
+
+#include "MFRC522.h"
+
+#include <string.h>
+
+namespace {
+
+const uint8_t DEFAULT_REGISTERS[64] = {
+    0x00, 0x20, 0x80, 0x00, 0x14, 0x00, 0x00, 0x21, // 0x00
+    0x00, 0x00, 0x00, 0x08, 0x10, 0x00, 0xA0, 0x00, // 0x08
+    0x00, 0x3F, 0x00, 0x00, 0x80, 0x00, 0x10, 0x84, // 0x10
+    0x84, 0x4D, 0x00, 0x00, 0x62, 0x00, 0x00, 0xEB, // 0x18
+    0x00, 0xFF, 0xFF, 0x00, 0x26, 0x00, 0x48, 0x88, // 0x20
+    0x20, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x28
+    0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x40, 0x92, // 0x30
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x38
+};
+
+const uint16_t CRC_PRESETS[4] = {0x0000, 0x6363, 0xA671, 0xFFFF};
+
+// What the digital self-test of a version 2.0 chip leaves in the FIFO.
+const uint8_t SELF_TEST_RESULT[64] = {
+    0x00, 0xEB, 0x66, 0xBA, 0x57, 0xBF, 0x23, 0x95, 0xD0, 0xE3, 0x0D,
+    0x3D, 0x27, 0x89, 0x5C, 0xDE, 0x9D, 0x3B, 0xA7, 0x00, 0x21, 0x5B,
+    0x89, 0x82, 0x51, 0x3A, 0xEB, 0x02, 0x0C, 0xA5, 0x00, 0x49, 0x7C,
+    0x84, 0x4D, 0xB3, 0xCC, 0xD2, 0x1B, 0x81, 0x5D, 0x48, 0x76, 0xD5,
+    0x71, 0x61, 0x21, 0xA9, 0x86, 0x96, 0x83, 0x38, 0xCF, 0x9D, 0x5B,
+    0x6D, 0xDC, 0x15, 0xBA, 0x3E, 0x7D, 0x95, 0x3B, 0x2F};
+const uint8_t SELF_TEST_ENABLE = 0x09;
+const uint8_t MEM_BUFFER_SIZE = 25;
+
+// Receiver gain of RFCfgReg RxGain in dB, and the levels of the link model.
+const int8_t RX_GAIN_DB[8] = {18, 23, 18, 23, 33, 38, 43, 48};
+const int16_t THRESHOLD_BASE_DB = 40;
+const int16_t THRESHOLD_STEP_DB = 4;
+const int16_t SATURATION_DB = 100;
+
+// ComIrqReg, DivIrqReg and ErrorReg bits.
+const uint8_t IRQ_TX = 0x40;
+const uint8_t IRQ_RX = 0x20;
+const uint8_t IRQ_IDLE = 0x10;
+const uint8_t IRQ_HI_ALERT = 0x08;
+const uint8_t IRQ_LO_ALERT = 0x04;
+const uint8_t IRQ_ERR = 0x02;
+const uint8_t IRQ_TIMER = 0x01;
+const uint8_t IRQ_CRC = 0x04;
+const uint8_t ERR_BUFFER_OVFL = 0x10;
+const uint8_t ERR_COLL = 0x08;
+const uint8_t ERR_CRC = 0x04;
+const uint8_t ERR_PROTOCOL = 0x01;
+
+const uint8_t STATUS2_CRYPTO1_ON = 0x08;
+
+uint8_t GetBit(const uint8_t *data, uint16_t bit) {
+  return (data[bit / 8] >> (bit % 8)) & 1;
+}
+
+void PutBit(uint8_t *data, uint16_t bit, uint8_t value) {
+  if (value)
+    data[bit / 8] |= 1 << (bit % 8);
+  else
+    data[bit / 8] &= ~(1 << (bit % 8));
+}
+
+uint32_t GetWord(const uint8_t *data) {
+  return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+         ((uint32_t)data[2] << 8) | data[3];
+}
+
+void PutWord(uint8_t *data, uint32_t value) {
+  data[0] = value >> 24;
+  data[1] = value >> 16;
+  data[2] = value >> 8;
+  data[3] = value;
+}
+
+} // namespace
+
+MFRC522Sim::MFRC522Sim(uint32_t spiHz)
+    : _cycles(0), _spiHz(spiHz), _spiLimit(0), _spiRemainder(0),
+      _frameOverhead(FRAME_OVERHEAD_CYCLES), _asyncFailure(ASYNC_OK),
+      _asyncOkTransfers(0), _frameStart(false),
+      _frameRead(false), _frameAddress(0), _random(0x2545F491),
+      _rfLink(false), _signalDb(0), _noiseDb(0), _noise(0x1B873593),
+      _cardCount(0), _irqConnected(true), _irqPin(true), _irqLatched(false),
+      _fieldOnSince(0) {
+  memset(_regs, 0, sizeof(_regs));
+  _hardPowerDown = false;
+  Reset();
+  ResetCounters();
+}
+
+bool MFRC522Sim::AddCard(PiccSim *card) {
+  if (_cardCount == MAX_CARDS)
+    return false;
+
+  _cards[_cardCount].card = card;
+  _cards[_cardCount].readyAt = _cycles + POWER_UP_CYCLES;
+  _cardCount++;
+  if (IsFieldOn())
+    card->PowerOn();
+  return true;
+}
+
+void MFRC522Sim::RemoveCard(PiccSim *card) {
+  for (uint8_t i = 0; i < _cardCount; i++) {
+    if (_cards[i].card == card) {
+      card->PowerOff();
+      _cards[i] = _cards[--_cardCount];
+      return;
+    }
+  }
+}
+
+void MFRC522Sim::SetIrqConnected(bool connected) { _irqConnected = connected; }
+
+void MFRC522Sim::SetSpiFrequency(uint32_t hz) { _spiHz = hz; }
+
+void MFRC522Sim::SetSpiLimit(uint32_t hz) { _spiLimit = hz; }
+
+void MFRC522Sim::SetAsyncFailure(AsyncFailure failure, uint32_t okTransfers) {
+  _asyncFailure = failure;
+  _asyncOkTransfers = okTransfers;
+}
+
+void MFRC522Sim::SetFrameOverheadCycles(uint32_t cycles) {
+  _frameOverhead = cycles;
+}
+
+void MFRC522Sim::SetRfLink(int8_t signalDb, int8_t noiseDb) {
+  _rfLink = true;
+  _signalDb = signalDb;
+  _noiseDb = noiseDb;
+}
+
+bool MFRC522Sim::IsFieldOn() const {
+  return !_hardPowerDown && (_regs[MFRC522::TxControlReg] & 0x03) &&
+         !(_regs[MFRC522::CommandReg] & 0x10);
+}
+
+uint64_t MFRC522Sim::GetFieldOnCycles() const {
+  return _fieldOnCycles + (IsFieldOn() ? _cycles - _fieldOnSince : 0);
+}
+
+void MFRC522Sim::ResetCounters() {
+  _airCycles = 0;
+  _fieldOnCycles = 0;
+  _fieldOnSince = _cycles;
+  _spiFrames = 0;
+  _spiBytes = 0;
+  _rfFrames = 0;
+  _underruns = 0;
+  _overruns = 0;
+}
+
+void MFRC522Sim::Select() {
+  _cycles += _frameOverhead;
+  Update();
+  _frameStart = true;
+  _spiFrames++;
+}
+
+void MFRC522Sim::Deselect() { _frameStart = false; }
+
+void MFRC522Sim::Transfer(const uint8_t *tx, uint8_t *rx, uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    _spiRemainder += 8 * CARRIER_HZ;
+    _cycles += _spiRemainder / _spiHz;
+    _spiRemainder %= _spiHz;
+    Update();
+
+    // The first byte of a frame is an address; in a read frame every
+    // following byte returns the register addressed by the byte before it.
+    uint8_t out = 0;
+    if (_frameStart) {
+      _frameRead = tx[i] & 0x80;
+      _frameAddress = (tx[i] >> 1) & 0x3F;
+      _frameStart = false;
+    } else if (_frameRead) {
+      out = ReadRegister(_frameAddress);
+      _frameAddress = (tx[i] >> 1) & 0x3F;
+    } else {
+      WriteRegister(_frameAddress, tx[i]);
+    }
+    // Past the limit of the wiring MISO is sampled a bit late.
+    if (_spiLimit && _spiHz > _spiLimit)
+      out = (out >> 1) | (i & 1 ? 0x80 : 0x00);
+    if (rx)
+      rx[i] = out;
+  }
+  _spiBytes += length;
+}
+
+bool MFRC522Sim::TransferAsync(const uint8_t *tx, uint8_t *rx, uint8_t length,
+                               Callback<void(bool)> done) {
+  if (_asyncFailure != ASYNC_OK && _asyncOkTransfers == 0) {
+    if (_asyncFailure == ASYNC_REFUSED)
+      return false;
+    done(false);
+    return true;
+  }
+
+  if (_asyncOkTransfers)
+    _asyncOkTransfers--;
+  Transfer(tx, rx, length);
+  done(true);
+  return true;
+}
+
+bool MFRC522Sim::SetFrequency(uint32_t hz) {
+  SetSpiFrequency(hz);
+  return true;
+}
+
+void MFRC522Sim::SetResetLine(bool active) {
+  bool wasOn = IsFieldOn();
+  if (_hardPowerDown && !active)
+    Reset();
+  _hardPowerDown = active;
+  UpdateField(wasOn);
+}
+
+void MFRC522Sim::DelayUs(uint32_t us) {
+  _cycles += (uint64_t)us * CARRIER_HZ / 1000000;
+  Update();
+}
+
+uint64_t MFRC522Sim::GetTimeUs() { return CyclesToUs(_cycles); }
+
+bool MFRC522Sim::HasIrq() const { return _irqConnected; }
+
+void MFRC522Sim::ClearIrq() { _irqLatched = false; }
+
+bool MFRC522Sim::WaitForIrq(uint32_t timeoutMs) {
+  uint64_t deadline = _cycles + (uint64_t)timeoutMs * (CARRIER_HZ / 1000);
+  Update();
+  while (!_irqLatched) {
+    uint64_t next = deadline;
+    for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+      if (_eventPending[i] && _eventAt[i] < next)
+        next = _eventAt[i];
+    }
+    if (next > _cycles)
+      _cycles = next;
+    Update();
+    if (next == deadline)
+      break;
+  }
+
+  bool fired = _irqLatched;
+  _irqLatched = false;
+  return fired;
+}
+
+void MFRC522Sim::Reset() {
+  bool wasOn = IsFieldOn();
+  memcpy(_regs, DEFAULT_REGISTERS, sizeof(_regs));
+  _fifoLevel = 0;
+  _crcReady = false;
+  _crcResult = 0xFFFF;
+  for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+    _eventPending[i] = false;
+  }
+  _timerStart = 0;
+  _timerStop = 0;
+  _txLate = false;
+  UpdateField(wasOn);
+  UpdateIrqPin();
+}
+
+uint8_t MFRC522Sim::ReadRegister(uint8_t reg) {
+  if (_hardPowerDown)
+    return 0;
+
+  switch (reg) {
+  case MFRC522::FIFODataReg: {
+    if (_fifoLevel == 0)
+      return 0;
+    uint8_t value = _fifo[0];
+    memmove(_fifo, &_fifo[1], --_fifoLevel);
+    UpdateAlerts();
+    UpdateIrqPin();
+    return value;
+  }
+  case MFRC522::FIFOLevelReg:
+    return _fifoLevel;
+  case MFRC522::Status1Reg: {
+    uint8_t level = _fifoLevel;
+    uint8_t water = _regs[MFRC522::WaterLevelReg] & 0x3F;
+    return (_crcReady && _crcResult == 0 ? 0x40 : 0) |
+           (_crcReady ? 0x20 : 0) | (IsIrqActive() ? 0x10 : 0) |
+           (IsTimerRunning() ? 0x08 : 0) |
+           (FIFO_SIZE - level <= water ? 0x02 : 0) | (level <= water ? 0x01 : 0);
+  }
+  case MFRC522::TCounterValueRegH:
+    return TimerCounter() >> 8;
+  case MFRC522::TCounterValueRegL:
+    return TimerCounter() & 0xFF;
+  default:
+    return _regs[reg];
+  }
+}
+
+void MFRC522Sim::WriteRegister(uint8_t reg, uint8_t value) {
+  if (_hardPowerDown)
+    return;
+
+  bool wasOn = IsFieldOn();
+  switch (reg) {
+  case MFRC522::CommandReg:
+    ExecuteCommand(value);
+    break;
+  case MFRC522::ComIrqReg:
+  case MFRC522::DivIrqReg:
+    if (value & 0x80)
+      _regs[reg] |= value & 0x7F;
+    else
+      _regs[reg] &= ~value;
+    break;
+  case MFRC522::FIFODataReg: {
+    uint8_t command = _regs[MFRC522::CommandReg] & 0x0F;
+    if (_txLate && (command == MFRC522::PCD_Transceive ||
+                    command == MFRC522::PCD_Transmit))
+      _underruns++;
+    PushFifo(value);
+    break;
+  }
+  case MFRC522::FIFOLevelReg:
+    if (value & 0x80) {
+      _fifoLevel = 0;
+      _regs[MFRC522::ErrorReg] &= ~ERR_BUFFER_OVFL;
+      UpdateAlerts();
+    }
+    break;
+  case MFRC522::BitFramingReg:
+    _regs[reg] = value;
+    if ((value & 0x80) &&
+        (_regs[MFRC522::CommandReg] & 0x0F) == MFRC522::PCD_Transceive)
+      StartTransmission();
+    break;
+  case MFRC522::ControlReg:
+    if (value & 0x80)
+      StopTimer(_cycles);
+    if (value & 0x40)
+      StartTimer(_cycles);
+    break;
+  case MFRC522::Status2Reg:
+    _regs[reg] = (_regs[reg] & 0x37) | (value & 0xC0) |
+                 (_regs[reg] & value & STATUS2_CRYPTO1_ON);
+    break;
+  case MFRC522::CollReg:
+    _regs[reg] = (_regs[reg] & 0x7F) | (value & 0x80);
+    break;
+  case MFRC522::ErrorReg:
+  case MFRC522::Status1Reg:
+  case MFRC522::TCounterValueRegH:
+  case MFRC522::TCounterValueRegL:
+  case MFRC522::VersionReg:
+    break;
+  default:
+    _regs[reg] = value;
+    break;
+  }
+  UpdateField(wasOn);
+  UpdateIrqPin();
+}
+
+void MFRC522Sim::ExecuteCommand(uint8_t value) {
+  uint8_t command = value & 0x0F;
+  if (command == MFRC522::PCD_NoCmdChange)
+    command = _regs[MFRC522::CommandReg] & 0x0F;
+  _regs[MFRC522::CommandReg] = (value & 0x30) | command;
+  _txLate = false;
+
+  switch (command) {
+  case MFRC522::PCD_Idle:
+    _eventPending[EVENT_TX] = false;
+    _eventPending[EVENT_RX] = false;
+    _eventPending[EVENT_CRC] = false;
+    _eventPending[EVENT_AUTH] = false;
+    _eventPending[EVENT_TX_BYTE] = false;
+    _eventPending[EVENT_RX_BYTE] = false;
+    break;
+  case MFRC522::PCD_SoftReset:
+    Reset();
+    break;
+  case MFRC522::PCD_Mem: {
+    uint8_t count = _fifoLevel < MEM_BUFFER_SIZE ? _fifoLevel : MEM_BUFFER_SIZE;
+    _fifoLevel -= count;
+    memmove(_fifo, &_fifo[count], _fifoLevel);
+    UpdateAlerts();
+    FinishCommand();
+    break;
+  }
+  case MFRC522::PCD_CalcCRC:
+    StartCRC();
+    break;
+  case MFRC522::PCD_Transmit:
+    StartTransmission();
+    break;
+  case MFRC522::PCD_MFAuthent:
+    StartAuthentication();
+    break;
+  case MFRC522::PCD_Transceive:
+  case MFRC522::PCD_Receive:
+    break;
+  default:
+    FinishCommand();
+    break;
+  }
+}
+
+void MFRC522Sim::FinishCommand() {
+  _regs[MFRC522::CommandReg] &= 0xF0;
+  _regs[MFRC522::ComIrqReg] |= IRQ_IDLE;
+}
+
+void MFRC522Sim::PushFifo(uint8_t value) {
+  if (_fifoLevel == FIFO_SIZE) {
+    _overruns++;
+    _regs[MFRC522::ErrorReg] |= ERR_BUFFER_OVFL;
+    _regs[MFRC522::ComIrqReg] |= IRQ_ERR;
+    return;
+  }
+  _fifo[_fifoLevel++] = value;
+  UpdateAlerts();
+}
+
+void MFRC522Sim::UpdateAlerts() {
+  uint8_t water = _regs[MFRC522::WaterLevelReg] & 0x3F;
+  if (FIFO_SIZE - _fifoLevel <= water)
+    _regs[MFRC522::ComIrqReg] |= IRQ_HI_ALERT;
+  if (_fifoLevel <= water)
+    _regs[MFRC522::ComIrqReg] |= IRQ_LO_ALERT;
+}
+
+void MFRC522Sim::UpdateField(bool wasOn) {
+  bool on = IsFieldOn();
+  if (on == wasOn)
+    return;
+
+  if (on) {
+    _fieldOnSince = _cycles;
+    for (uint8_t i = 0; i < _cardCount; i++) {
+      _cards[i].card->PowerOn();
+      _cards[i].readyAt = _cycles + POWER_UP_CYCLES;
+    }
+  } else {
+    _fieldOnCycles += _cycles - _fieldOnSince;
+    _regs[MFRC522::Status2Reg] &= ~STATUS2_CRYPTO1_ON;
+    for (uint8_t i = 0; i < _cardCount; i++) {
+      _cards[i].card->PowerOff();
+    }
+  }
+}
+
+bool MFRC522Sim::IsIrqActive() const {
+  return (_regs[MFRC522::ComIEnReg] & _regs[MFRC522::ComIrqReg] & 0x7F) ||
+         (_regs[MFRC522::DivIEnReg] & _regs[MFRC522::DivIrqReg] & 0x14);
+}
+
+void MFRC522Sim::UpdateIrqPin() {
+  // IRqInv in ComIEnReg makes the pin active low.
+  bool irq = IsIrqActive();
+  bool pin = (_regs[MFRC522::ComIEnReg] & 0x80) ? !irq : irq;
+  if (_irqPin && !pin)
+    _irqLatched = true;
+  _irqPin = pin;
+}
+
+void MFRC522Sim::Update() {
+  while (true) {
+    int8_t next = -1;
+    for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+      if (_eventPending[i] && _eventAt[i] <= _cycles &&
+          (next < 0 || _eventAt[i] < _eventAt[next]))
+        next = i;
+    }
+    if (next < 0)
+      return;
+
+    _eventPending[next] = false;
+    ApplyEvent((Event)next, _eventAt[next]);
+    UpdateIrqPin();
+  }
+}
+
+void MFRC522Sim::Schedule(Event event, uint64_t at) {
+  _eventPending[event] = true;
+  _eventAt[event] = at;
+}
+
+void MFRC522Sim::ApplyEvent(Event event, uint64_t at) {
+  switch (event) {
+  case EVENT_TX:
+    _regs[MFRC522::ComIrqReg] |= IRQ_TX;
+    if ((_regs[MFRC522::CommandReg] & 0x0F) == MFRC522::PCD_Transmit)
+      FinishCommand();
+    break;
+  case EVENT_RX:
+    DeliverResponse();
+    break;
+  case EVENT_TIMER:
+    _regs[MFRC522::ComIrqReg] |= IRQ_TIMER;
+    if (_regs[MFRC522::TModeReg] & 0x10)
+      StartTimer(at);
+    else
+      _timerStop = at;
+    break;
+  case EVENT_CRC:
+    _regs[MFRC522::CRCResultRegH] = _crcResult >> 8;
+    _regs[MFRC522::CRCResultRegL] = _crcResult & 0xFF;
+    _regs[MFRC522::DivIrqReg] |= IRQ_CRC;
+    _crcReady = true;
+    break;
+  case EVENT_AUTH:
+    if (_authOk) {
+      _regs[MFRC522::Status2Reg] |= STATUS2_CRYPTO1_ON;
+    } else {
+      _regs[MFRC522::ErrorReg] |= ERR_PROTOCOL;
+      _regs[MFRC522::ComIrqReg] |= IRQ_ERR;
+    }
+    FinishCommand();
+    break;
+  case EVENT_TX_BYTE:
+    SendNextByte(at);
+    break;
+  case EVENT_RX_BYTE:
+    ReceiveNextByte();
+    break;
+  default:
+    break;
+  }
+}
+
+void MFRC522Sim::StartTransmission() {
+  _txFrame.bits = 0;
+  _txFrame.speed = (_regs[MFRC522::TxModeReg] >> 4) & 0x07;
+  _txStart = _cycles;
+  _regs[MFRC522::ErrorReg] &=
+      ~(ERR_COLL | ERR_CRC | ERR_PROTOCOL | 0x02 /* ParityErr */);
+  _rxAlign = (_regs[MFRC522::BitFramingReg] >> 4) & 0x07;
+  SendNextByte(_cycles);
+}
+
+// The transmitter takes the next byte when the previous one has gone out;
+// finding the FIFO empty ends the frame.
+void MFRC522Sim::SendNextByte(uint64_t at) {
+  uint16_t length = _txFrame.bits / 8;
+  if (_fifoLevel == 0 || length + 2 > PiccSim::MAX_FRAME_BYTES) {
+    FinishTransmission();
+    return;
+  }
+
+  _txFrame.data[length] = _fifo[0];
+  memmove(_fifo, &_fifo[1], --_fifoLevel);
+  _txFrame.bits += 8;
+  UpdateAlerts();
+  Schedule(EVENT_TX_BYTE, at + ByteCycles(_txFrame.speed));
+}
+
+void MFRC522Sim::FinishTransmission() {
+  PiccSim::Frame &request = _txFrame;
+  uint8_t txLastBits = _regs[MFRC522::BitFramingReg] & 0x07;
+  if (txLastBits && request.bits)
+    request.bits -= 8 - txLastBits;
+  if ((_regs[MFRC522::TxModeReg] & 0x80) && request.bits % 8 == 0)
+    PiccSim::AppendCRC(&request);
+  _txLate = true;
+
+  bool crypto = _regs[MFRC522::Status2Reg] & STATUS2_CRYPTO1_ON;
+  if (crypto)
+    _crypto.Crypt(request.data, request.bits);
+
+  uint64_t time = _txStart;
+  bool answered = Exchange(&request, &_rxFrame, &_rxCollision, &time);
+  if (answered) {
+    if (crypto)
+      _crypto.Crypt(_rxFrame.data, _rxFrame.bits);
+    _rxEnd = time;
+    PrepareResponse(time - FrameCycles(_rxFrame.bits, _rxFrame.speed));
+    Schedule(EVENT_RX, time);
+  }
+}
+
+void MFRC522Sim::StartAuthentication() {
+  _regs[MFRC522::ErrorReg] &= ~(ERR_COLL | ERR_CRC | ERR_PROTOCOL | 0x02);
+  if (_fifoLevel < 12) {
+    _fifoLevel = 0;
+    _authOk = false;
+    Schedule(EVENT_AUTH, _cycles);
+    return;
+  }
+
+  uint8_t params[12];
+  memcpy(params, _fifo, 12);
+  _fifoLevel = 0;
+  UpdateAlerts();
+
+  PiccSim::Frame request;
+  PiccSim::Frame response;
+  int16_t collision;
+  uint64_t time = _cycles;
+  request.data[0] = params[0];
+  request.data[1] = params[1];
+  request.bits = 16;
+  request.speed = (_regs[MFRC522::TxModeReg] >> 4) & 0x07;
+  PiccSim::AppendCRC(&request);
+
+  // Nested authentication: the AUTH command travels inside the running
+  // session and the card encrypts its nonce with the new key.
+  bool nested = _regs[MFRC522::Status2Reg] & STATUS2_CRYPTO1_ON;
+  if (nested)
+    _crypto.Crypt(request.data, request.bits);
+  _regs[MFRC522::Status2Reg] &= ~STATUS2_CRYPTO1_ON;
+
+  if (!Exchange(&request, &response, &collision, &time) ||
+      response.bits != 32 || collision >= 0)
+    return;
+
+  uint32_t uid = GetWord(&params[8]);
+  uint32_t nt = GetWord(response.data);
+  _crypto.Init(&params[2]);
+  if (nested)
+    nt ^= _crypto.Word(uid ^ nt, true);
+  else
+    _crypto.Word(uid ^ nt, false);
+
+  _random = _random * 1103515245 + 12345;
+  uint32_t nr = _random;
+  PutWord(request.data, nr ^ _crypto.Word(nr, false));
+  PutWord(&request.data[4],
+          Crypto1::PrngSuccessor(nt, 64) ^ _crypto.Word(0, false));
+  request.bits = 64;
+  if (!Exchange(&request, &response, &collision, &time) ||
+      response.bits != 32 || collision >= 0)
+    return;
+
+  uint32_t at = GetWord(response.data) ^ _crypto.Word(0, false);
+  _authOk = at == Crypto1::PrngSuccessor(nt, 96);
+  Schedule(EVENT_AUTH, time);
+}
+
+// With the self-test enabled the coprocessor fills the FIFO with the test
+// result instead and keeps running until it is stopped.
+void MFRC522Sim::StartCRC() {
+  if ((_regs[MFRC522::AutoTestReg] & 0x0F) == SELF_TEST_ENABLE) {
+    memcpy(_fifo, SELF_TEST_RESULT, FIFO_SIZE);
+    _fifoLevel = FIFO_SIZE;
+    UpdateAlerts();
+    return;
+  }
+
+  uint16_t crc = CRC_PRESETS[_regs[MFRC522::ModeReg] & 0x03];
+  for (uint8_t i = 0; i < _fifoLevel; i++) {
+    crc ^= _fifo[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+  }
+
+  _crcResult = crc;
+  _crcReady = false;
+  Schedule(EVENT_CRC, _cycles + 8 * (_fifoLevel + 1));
+  _fifoLevel = 0;
+  UpdateAlerts();
+}
+
+// Lays the answer out as it will appear in the FIFO and schedules its bytes
+// for the times they finish arriving.
+void MFRC522Sim::PrepareResponse(uint64_t rxStart) {
+  PiccSim::Frame &frame = _rxFrame;
+  _rxErrors = 0;
+
+  if ((_regs[MFRC522::RxModeReg] & 0x80) && _rxCollision < 0) {
+    if (!PiccSim::CheckCRC(frame))
+      _rxErrors |= ERR_CRC;
+    else
+      frame.bits -= 16;
+  }
+
+  memset(_rxBytes, 0, sizeof(_rxBytes));
+  bool valuesAfterColl = _regs[MFRC522::CollReg] & 0x80;
+  for (uint16_t i = 0; i < frame.bits; i++) {
+    bool cleared =
+        _rxCollision >= 0 && i >= _rxCollision && !valuesAfterColl;
+    PutBit(_rxBytes, _rxAlign + i, cleared ? 0 : GetBit(frame.data, i));
+  }
+  _rxByteCount = (_rxAlign + frame.bits + 7) / 8;
+  _rxBytesPushed = 0;
+  _rxStart = rxStart;
+  ScheduleReceivedByte();
+}
+
+void MFRC522Sim::ReceiveNextByte() {
+  PushFifo(_rxBytes[_rxBytesPushed++]);
+  ScheduleReceivedByte();
+}
+
+// Start bit, then nine bit times per byte including parity. Bytes that would
+// complete with the end of frame are left to DeliverResponse().
+void MFRC522Sim::ScheduleReceivedByte() {
+  if (_rxBytesPushed == _rxByteCount)
+    return;
+
+  uint8_t speed = _rxFrame.speed;
+  uint64_t next = _rxStart + (128 >> speed) +
+                  (_rxBytesPushed + 1) * ByteCycles(speed);
+  if (next < _rxEnd)
+    Schedule(EVENT_RX_BYTE, next);
+}
+
+void MFRC522Sim::DeliverResponse() {
+  _eventPending[EVENT_RX_BYTE] = false;
+  while (_rxBytesPushed < _rxByteCount) {
+    PushFifo(_rxBytes[_rxBytesPushed++]);
+  }
+
+  uint16_t bits = _rxAlign + _rxFrame.bits;
+  _regs[MFRC522::ControlReg] = (_regs[MFRC522::ControlReg] & 0xF8) | (bits % 8);
+  if (_rxCollision >= 0) {
+    uint16_t position = _rxAlign + _rxCollision + 1;
+    _rxErrors |= ERR_COLL;
+    _regs[MFRC522::CollReg] = (_regs[MFRC522::CollReg] & 0x80) |
+                              (position > 32 ? 0x20 : (position & 0x1F));
+  } else {
+    _regs[MFRC522::CollReg] |= 0x20;
+  }
+
+  _regs[MFRC522::ErrorReg] |= _rxErrors;
+  _regs[MFRC522::ComIrqReg] |= IRQ_RX | (_rxErrors ? IRQ_ERR : 0);
+}
+
+bool MFRC522Sim::Exchange(PiccSim::Frame *request, PiccSim::Frame *response,
+                          int16_t *collision, uint64_t *time) {
+  uint64_t txEnd = *time + FrameCycles(request->bits, request->speed);
+  _airCycles += txEnd - *time;
+  _rfFrames++;
+  *time = txEnd;
+  *collision = -1;
+  response->bits = 0;
+
+  uint8_t rxSpeed = (_regs[MFRC522::RxModeReg] >> 4) & 0x07;
+  uint8_t responders = 0;
+  uint32_t delay = 0;
+  if (IsFieldOn()) {
+    PiccSim::Frame answer;
+    for (uint8_t i = 0; i < _cardCount; i++) {
+      if (_cards[i].readyAt > txEnd ||
+          !_cards[i].card->Receive(*request, &answer) || answer.bits == 0 ||
+          answer.speed != rxSpeed)
+        continue;
+
+      if (responders++ == 0)
+        *response = answer;
+      else
+        Merge(response, answer, collision);
+      if (answer.delayCycles > delay)
+        delay = answer.delayCycles;
+    }
+  }
+
+  if (responders > 0 && _rfLink && !ApplyRfLink(response))
+    responders = 0;
+
+  if (_regs[MFRC522::TModeReg] & 0x80)
+    StartTimer(txEnd);
+  Schedule(EVENT_TX, txEnd);
+  if (responders == 0)
+    return false;
+
+  // Frame delay time: 1236/fc after a byte oriented frame, 1172/fc after a
+  // bit oriented one, plus whatever the card needs to process the command.
+  uint64_t rxStart = txEnd + (request->bits % 8 ? 1172 : 1236) + delay;
+  StopTimer(rxStart);
+  *time = rxStart + FrameCycles(response->bits, response->speed);
+  _airCycles += *time - txEnd;
+  return true;
+}
+
+// Returns false if the answer is lost; a garbled one gets a bit flipped.
+bool MFRC522Sim::ApplyRfLink(PiccSim::Frame *response) {
+  int16_t gainDb = RX_GAIN_DB[(_regs[MFRC522::RFCfgReg] >> 4) & 0x07];
+  int16_t carrierDb = -(0x3F - (_regs[MFRC522::CWGsPReg] & 0x3F)) / 6;
+  int16_t iqDb = (_regs[MFRC522::DemodReg] >> 6) == 0x02 ? 3 : 0;
+  int16_t signal = _signalDb + gainDb + carrierDb + iqDb;
+  int16_t noise = _noiseDb + gainDb + 2 * carrierDb;
+  int16_t threshold =
+      THRESHOLD_BASE_DB +
+      THRESHOLD_STEP_DB * (_regs[MFRC522::RxThresholdReg] >> 4);
+  if (signal < threshold)
+    return false;
+
+  uint16_t percent = noise >= threshold ? 50 : 0;
+  if (signal > SATURATION_DB)
+    percent += 10 * (signal - SATURATION_DB);
+  _noise = _noise * 1103515245 + 12345;
+  if ((_noise >> 16) % 100 < percent && response->bits > 0) {
+    uint16_t bit = (_noise >> 8) % response->bits;
+    PutBit(response->data, bit, !GetBit(response->data, bit));
+  }
+  return true;
+}
+
+void MFRC522Sim::Merge(PiccSim::Frame *response, const PiccSim::Frame &answer,
+                       int16_t *collision) {
+  uint16_t bits = response->bits > answer.bits ? response->bits : answer.bits;
+  for (uint16_t i = 0; i < bits; i++) {
+    uint8_t a = i < response->bits ? GetBit(response->data, i) : 0;
+    uint8_t b = i < answer.bits ? GetBit(answer.data, i) : 0;
+    if (i < response->bits && i < answer.bits && a != b &&
+        (*collision < 0 || i < *collision))
+      *collision = i;
+    PutBit(response->data, i, a | b);
+  }
+  response->bits = bits;
+}
+
+uint64_t MFRC522Sim::FrameCycles(uint16_t bits, uint8_t speed) {
+  if (bits == 0)
+    return 0;
+  // Start bit, data, one parity bit per complete byte and end of frame.
+  return (uint64_t)(bits + bits / 8 + 2) * (128 >> speed);
+}
+
+uint64_t MFRC522Sim::TimerTickCycles() const {
+  uint16_t prescaler =
+      ((_regs[MFRC522::TModeReg] & 0x0F) << 8) | _regs[MFRC522::TPrescalerReg];
+  return (_regs[MFRC522::DemodReg] & 0x10) ? 2 * prescaler + 2
+                                           : 2 * prescaler + 1;
+}
+
+uint16_t MFRC522Sim::TimerReload() const {
+  return (_regs[MFRC522::TReloadRegH] << 8) | _regs[MFRC522::TReloadRegL];
+}
+
+void MFRC522Sim::StartTimer(uint64_t at) {
+  _timerStart = at;
+  _timerStop = UINT64_MAX;
+  Schedule(EVENT_TIMER, at + (TimerReload() + 1) * TimerTickCycles());
+}
+
+void MFRC522Sim::StopTimer(uint64_t at) {
+  if (_eventPending[EVENT_TIMER] && at < _eventAt[EVENT_TIMER]) {
+    _eventPending[EVENT_TIMER] = false;
+    _timerStop = at;
+  }
+}
+
+bool MFRC522Sim::IsTimerRunning() const {
+  return _cycles >= _timerStart && _cycles < _timerStop &&
+         (!_eventPending[EVENT_TIMER] || _cycles < _eventAt[EVENT_TIMER]);
+}
+
+uint16_t MFRC522Sim::TimerCounter() const {
+  if (_cycles < _timerStart)
+    return TimerReload();
+  uint64_t end = _cycles < _timerStop ? _cycles : _timerStop;
+  uint64_t ticks = (end - _timerStart) / TimerTickCycles();
+  return ticks > TimerReload() ? 0 : TimerReload() - ticks;
+}
@@ -0,0 +1,191 @@
+#ifndef MFRC522SIM_H
+#define MFRC522SIM_H
+
+#include "MFRC522Transport.h"
+#include "Crypto1.h"
+#include "PiccSim.h"
+
+// Register level model of the MFRC522 behind MFRC522Transport, so the
+// unmodified driver runs on a host against simulated cards. Time is counted
+// in 13.56 MHz carrier cycles: every SPI byte costs eight clocks at the
+// configured SPI frequency, every RF frame its bit time on air, and command
+// completion, the timer and the IRQ pin are scheduled against that clock.
+// The FIFO is drained one byte per nine bit times while a frame goes out and
+// the frame ends when it runs dry; received bytes enter it as they arrive.
+// A late refill counts as an underrun and a full FIFO as an overrun.
+class MFRC522Sim : public MFRC522Transport {
+public:
+    static const uint32_t CARRIER_HZ = 13560000;
+    static const uint8_t MAX_CARDS = 8;
+    static const uint8_t FIFO_SIZE = 64;
+    static const uint32_t POWER_UP_CYCLES = 13560;      // 1 ms card power up
+    static const uint32_t FRAME_OVERHEAD_CYCLES = 27;   // 2 us per CS frame
+
+    enum AsyncFailure {
+        ASYNC_OK,
+        ASYNC_REFUSED,                                  // TransferAsync returns false, as without DEVICE_SPI_ASYNCH
+        ASYNC_ABORTED                                   // nothing reaches the chip, done(false)
+    };
+
+    MFRC522Sim(uint32_t spiHz = 1000000);
+
+    bool AddCard(PiccSim *card);
+    void RemoveCard(PiccSim *card);
+    void SetIrqConnected(bool connected);
+    void SetSpiFrequency(uint32_t hz);
+    // Reads above this SPI clock come back corrupted, as over long wires.
+    void SetSpiLimit(uint32_t hz);
+    void SetFrameOverheadCycles(uint32_t cycles);
+    // Asynchronous transfers fail this way once the next okTransfers of them
+    // have gone through.
+    void SetAsyncFailure(AsyncFailure failure, uint32_t okTransfers = 0);
+    // Rough receiver model for a detuned antenna, off until set. The card
+    // signal and the carrier noise are scaled by the receiver gain and the
+    // carrier conductance (noise twice as steeply) and compared with the
+    // MinLevel threshold: a signal below it is lost, noise above it garbles
+    // half the frames, and past the saturation level frames start to clip.
+    // Combining I and Q in DemodReg adds 3 dB of signal.
+    void SetRfLink(int8_t signalDb, int8_t noiseDb);
+
+    uint8_t PeekRegister(uint8_t reg) const { return _regs[reg & 0x3F]; }
+    bool IsFieldOn() const;
+    uint64_t GetCycles() const { return _cycles; }
+    uint64_t GetAirCycles() const { return _airCycles; }
+    uint64_t GetFieldOnCycles() const;
+    uint32_t GetSpiFrames() const { return _spiFrames; }
+    uint32_t GetSpiBytes() const { return _spiBytes; }
+    uint32_t GetRfFrames() const { return _rfFrames; }
+    uint32_t GetUnderruns() const { return _underruns; }
+    uint32_t GetOverruns() const { return _overruns; }
+    void ResetCounters();
+
+    static uint64_t CyclesToUs(uint64_t cycles) { return cycles * 1000000 / CARRIER_HZ; }
+
+    virtual void Select();
+    virtual void Deselect();
+    virtual void Transfer(const uint8_t *tx, uint8_t *rx, uint8_t length);
+    virtual bool TransferAsync(const uint8_t *tx, uint8_t *rx, uint8_t length, Callback<void(bool)> done);
+    virtual bool SetFrequency(uint32_t hz);
+    virtual void SetResetLine(bool active);
+    virtual void DelayUs(uint32_t us);
+    virtual uint64_t GetTimeUs();
+
+    virtual bool HasIrq() const;
+    virtual void ClearIrq();
+    virtual bool WaitForIrq(uint32_t timeoutMs);
+
+private:
+    enum Event {
+        EVENT_TX,
+        EVENT_RX,
+        EVENT_TIMER,
+        EVENT_CRC,
+        EVENT_AUTH,
+        EVENT_TX_BYTE,
+        EVENT_RX_BYTE,
+        EVENT_COUNT
+    };
+
+    struct CardSlot {
+        PiccSim *card;
+        uint64_t readyAt;
+    };
+
+    void Reset();
+    uint8_t ReadRegister(uint8_t reg);
+    void WriteRegister(uint8_t reg, uint8_t value);
+    void ExecuteCommand(uint8_t value);
+    void FinishCommand();
+    void PushFifo(uint8_t value);
+    void UpdateAlerts();
+    void UpdateField(bool wasOn);
+    bool IsIrqActive() const;
+    void UpdateIrqPin();
+
+    void Update();
+    void Schedule(Event event, uint64_t at);
+    void ApplyEvent(Event event, uint64_t at);
+
+    void StartTransmission();
+    void SendNextByte(uint64_t at);
+    void FinishTransmission();
+    void PrepareResponse(uint64_t rxStart);
+    void ReceiveNextByte();
+    void ScheduleReceivedByte();
+    void StartAuthentication();
+    void StartCRC();
+    void DeliverResponse();
+    bool Exchange(PiccSim::Frame *request, PiccSim::Frame *response, int16_t *collision, uint64_t *time);
+    void Merge(PiccSim::Frame *response, const PiccSim::Frame &answer, int16_t *collision);
+    bool ApplyRfLink(PiccSim::Frame *response);
+    static uint64_t FrameCycles(uint16_t bits, uint8_t speed);
+    static uint64_t ByteCycles(uint8_t speed) { return 9 * (128 >> speed); }
+
+    uint64_t TimerTickCycles() const;
+    uint16_t TimerReload() const;
+    void StartTimer(uint64_t at);
+    void StopTimer(uint64_t at);
+    bool IsTimerRunning() const;
+    uint16_t TimerCounter() const;
+
+    uint8_t _regs[64];
+    uint8_t _fifo[FIFO_SIZE];
+    uint8_t _fifoLevel;
+    bool _hardPowerDown;
+    bool _crcReady;
+    uint16_t _crcResult;
+
+    uint64_t _cycles;
+    uint32_t _spiHz;
+    uint32_t _spiLimit;
+    uint32_t _spiRemainder;
+    uint32_t _frameOverhead;
+    AsyncFailure _asyncFailure;
+    uint32_t _asyncOkTransfers;
+    bool _frameStart;
+    bool _frameRead;
+    uint8_t _frameAddress;
+
+    bool _eventPending[EVENT_COUNT];
+    uint64_t _eventAt[EVENT_COUNT];
+    uint64_t _timerStart;
+    uint64_t _timerStop;
+
+    PiccSim::Frame _txFrame;
+    uint64_t _txStart;
+    bool _txLate;
+    PiccSim::Frame _rxFrame;
+    int16_t _rxCollision;
+    uint8_t _rxAlign;
+    uint8_t _rxErrors;
+    uint8_t _rxBytes[PiccSim::MAX_FRAME_BYTES + 1];
+    uint16_t _rxByteCount;
+    uint16_t _rxBytesPushed;
+    uint64_t _rxStart;
+    uint64_t _rxEnd;
+    bool _authOk;
+    Crypto1 _crypto;
+    uint32_t _random;
+    bool _rfLink;
+    int8_t _signalDb;
+    int8_t _noiseDb;
+    uint32_t _noise;
+
+    CardSlot _cards[MAX_CARDS];
+    uint8_t _cardCount;
+
+    bool _irqConnected;
+    bool _irqPin;
+    bool _irqLatched;
+
+    uint64_t _airCycles;
+    uint64_t _fieldOnCycles;
+    uint64_t _fieldOnSince;
+    uint32_t _spiFrames;
+    uint32_t _spiBytes;
+    uint32_t _rfFrames;
+    uint32_t _underruns;
+    uint32_t _overruns;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+const uint8_t CMD_AUTH_KEY_A = 0x60;
+const uint8_t CMD_AUTH_KEY_B = 0x61;
+const uint8_t CMD_READ = 0x30;
+const uint8_t CMD_WRITE = 0xA0;
+const uint8_t CMD_DECREMENT = 0xC0;
+const uint8_t CMD_INCREMENT = 0xC1;
+const uint8_t CMD_RESTORE = 0xC2;
+const uint8_t CMD_TRANSFER = 0xB0;
+
+const uint8_t NAK_INVALID = 0x4;
+const uint8_t NAK_CRC = 0x5;
+
+const uint8_t DEFAULT_TRAILER[16] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                     0xFF, 0x07, 0x80, 0x69, 0xFF, 0xFF,
+                                     0xFF, 0xFF, 0xFF, 0xFF};
+
+uint32_t GetWord(const uint8_t *data) {
+  return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+         ((uint32_t)data[2] << 8) | data[3];
+}
+
+void PutWord(uint8_t *data, uint32_t value) {
+  data[0] = value >> 24;
+  data[1] = value >> 16;
+  data[2] = value >> 8;
+  data[3] = value;
+}
+
+} // namespace
+
+MifareClassicSim::MifareClassicSim(const uint8_t *uid, uint8_t uidSize,
+                                   bool is4K)
+    : PiccSim(uid, uidSize, (uidSize == 4 ? 0x0000 : 0x0040) | (is4K ? 2 : 4),
+              is4K ? 0x18 : 0x08),
+      _blockCount(is4K ? 256 : 64), _cryptoActive(false), _authSector(0),
+      _nonce(0x01200145), _nt(0), _pending(PENDING_NONE), _pendingCommand(0),
+      _pendingBlock(0), _transferValue(0), _transferAddr(0),
+      _transferValid(false) {
+  memset(_blocks, 0, sizeof(_blocks));
+  for (uint16_t block = 0; block < _blockCount; block++) {
+    if (TrailerOf(block) == block)
+      memcpy(_blocks[block], DEFAULT_TRAILER, 16);
+  }
+
+  memcpy(_blocks[0], uid, uidSize);
+  if (uidSize == 4) {
+    _blocks[0][4] = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+    _blocks[0][5] = GetSak();
+    _blocks[0][6] = is4K ? 0x02 : 0x04;
+  } else {
+    _blocks[0][7] = GetSak();
+    _blocks[0][8] = is4K ? 0x42 : 0x44;
+  }
+}
+
+void MifareClassicSim::ReadBlock(uint8_t block, uint8_t *data) const {
+  memcpy(data, _blocks[block], 16);
+}
+
+void MifareClassicSim::WriteBlock(uint8_t block, const uint8_t *data) {
+  memcpy(_blocks[block], data, 16);
+}
+
+uint8_t MifareClassicSim::SectorOf(uint8_t block) {
+  return block < 128 ? block / 4 : 32 + (block - 128) / 16;
+}
+
+uint8_t MifareClassicSim::TrailerOf(uint8_t block) {
+  return block < 128 ? block | 0x03 : block | 0x0F;
+}
+
+bool MifareClassicSim::Receive(const Frame &request, Frame *response) {
+  if (GetState() != STATE_ACTIVE ||
+      (!_cryptoActive && _pending != PENDING_AUTH))
+    return PiccSim::Receive(request, response);
+
+  response->bits = 0;
+  response->speed = _txSpeed;
+  response->delayCycles = 0;
+
+  if (_pending == PENDING_AUTH) {
+    if (VerifyReader(request, response))
+      return true;
+    Leave();
+    return false;
+  }
+
+  Frame plain = request;
+  _crypto.Crypt(plain.data, plain.bits);
+  if (_pending == PENDING_NONE && plain.bits == 32 &&
+      (plain.data[0] == CMD_AUTH_KEY_A || plain.data[0] == CMD_AUTH_KEY_B) &&
+      CheckCRC(plain)) {
+    if (Authenticate(plain, response))
+      return true;
+    Leave();
+    return false;
+  }
+
+  if (!PiccSim::Receive(plain, response))
+    return false;
+  _crypto.Crypt(response->data, response->bits);
+  return true;
+}
+
+bool MifareClassicSim::Process(const Frame &request, Frame *response) {
+  if (_pending != PENDING_NONE)
+    return CompletePending(request, response);
+
+  if (!CheckCRC(request)) {
+    Nak(response, NAK_CRC);
+    return false;
+  }
+
+  uint8_t command = request.data[0];
+  uint8_t block = request.data[1];
+  if (request.bits != 32)
+    return false;
+  if (command == CMD_AUTH_KEY_A || command == CMD_AUTH_KEY_B)
+    return Authenticate(request, response);
+  if (!_cryptoActive)
+    return false;
+
+  if (block >= _blockCount || SectorOf(block) != _authSector) {
+    Nak(response, NAK_INVALID);
+    return false;
+  }
+
+  int32_t value;
+  switch (command) {
+  case CMD_READ:
+    SetBytes(response, _blocks[block], 16);
+    if (TrailerOf(block) == block)
+      memset(response->data, 0, 6);
+    AppendCRC(response);
+    return true;
+  case CMD_WRITE:
+    if (block == 0) {
+      Nak(response, NAK_INVALID);
+      return false;
+    }
+    _pending = PENDING_WRITE;
+    _pendingBlock = block;
+    Ack(response);
+    return true;
+  case CMD_DECREMENT:
+  case CMD_INCREMENT:
+  case CMD_RESTORE:
+    if (!ReadValue(block, &value)) {
+      Nak(response, NAK_INVALID);
+      return false;
+    }
+    _pending = PENDING_VALUE;
+    _pendingCommand = command;
+    _pendingBlock = block;
+    Ack(response);
+    return true;
+  case CMD_TRANSFER:
+    if (!_transferValid || block == 0 || TrailerOf(block) == block) {
+      Nak(response, NAK_INVALID);
+      return false;
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+      uint8_t byte = (uint32_t)_transferValue >> (8 * i);
+      _blocks[block][i] = byte;
+      _blocks[block][4 + i] = ~byte;
+      _blocks[block][8 + i] = byte;
+    }
+    _blocks[block][12] = _transferAddr;
+    _blocks[block][13] = ~_transferAddr;
+    _blocks[block][14] = _transferAddr;
+    _blocks[block][15] = ~_transferAddr;
+    Ack(response, WRITE_CYCLES);
+    return true;
+  default:
+    return false;
+  }
+}
+
+void MifareClassicSim::Deactivate() {
+  _cryptoActive = false;
+  _pending = PENDING_NONE;
+  _transferValid = false;
+}
+
+bool MifareClassicSim::Authenticate(const Frame &request, Frame *response) {
+  uint8_t block = request.data[1];
+  if (block >= _blockCount)
+    return false;
+
+  const uint8_t *trailer = _blocks[TrailerOf(block)];
+  bool nested = _cryptoActive;
+  _cryptoActive = false;
+  _nt = NextNonce();
+  _crypto.Init(request.data[0] == CMD_AUTH_KEY_A ? trailer : &trailer[10]);
+
+  uint32_t keystream = _crypto.Word(GetWord(GetUid()) ^ _nt, false);
+  PutWord(response->data, nested ? _nt ^ keystream : _nt);
+  response->bits = 32;
+  _pending = PENDING_AUTH;
+  _authSector = SectorOf(block);
+  return true;
+}
+
+bool MifareClassicSim::VerifyReader(const Frame &request, Frame *response) {
+  _pending = PENDING_NONE;
+  if (request.bits != 64)
+    return false;
+
+  _crypto.Word(GetWord(request.data), true);
+  uint32_t ar = GetWord(&request.data[4]) ^ _crypto.Word(0, false);
+  if (ar != Crypto1::PrngSuccessor(_nt, 64))
+    return false;
+
+  uint32_t at = Crypto1::PrngSuccessor(_nt, 96) ^ _crypto.Word(0, false);
+  PutWord(response->data, at);
+  response->bits = 32;
+  _cryptoActive = true;
+  return true;
+}
+
+bool MifareClassicSim::CompletePending(const Frame &request,
+                                       Frame *response) {
+  Pending pending = _pending;
+  _pending = PENDING_NONE;
+  if (!CheckCRC(request)) {
+    Nak(response, NAK_CRC);
+    return false;
+  }
+
+  uint16_t length = request.bits / 8 - 2;
+  if (pending == PENDING_WRITE) {
+    if (length != 16) {
+      Nak(response, NAK_INVALID);
+      return false;
+    }
+    memcpy(_blocks[_pendingBlock], request.data, 16);
+    Ack(response, WRITE_CYCLES);
+    return true;
+  }
+
+  // The operand of a value command is never acknowledged.
+  int32_t value;
+  if (length != 4 || !ReadValue(_pendingBlock, &value))
+    return false;
+  int32_t operand = (int32_t)((uint32_t)request.data[0] |
+                              ((uint32_t)request.data[1] << 8) |
+                              ((uint32_t)request.data[2] << 16) |
+                              ((uint32_t)request.data[3] << 24));
+  if (_pendingCommand == CMD_INCREMENT)
+    value += operand;
+  else if (_pendingCommand == CMD_DECREMENT)
+    value -= operand;
+  _transferValue = value;
+  _transferAddr = _blocks[_pendingBlock][12];
+  _transferValid = true;
+  return true;
+}
+
+bool MifareClassicSim::ReadValue(uint8_t block, int32_t *value) const {
+  const uint8_t *data = _blocks[block];
+  for (uint8_t i = 0; i < 4; i++) {
+    if (data[i] != data[8 + i] || data[i] != (uint8_t)~data[4 + i])
+      return false;
+  }
+  if (data[12] != data[14] || data[13] != data[15] ||
+      data[12] != (uint8_t)~data[13])
+    return false;
+
+  *value = (int32_t)((uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                     ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+  return true;
+}
+
+uint32_t MifareClassicSim::NextNonce() {
+  _nonce = Crypto1::PrngSuccessor(_nonce, 160);
+  return _nonce;
+}
@@ -0,0 +1,61 @@
+#ifndef MIFARECLASSICSIM_H
+#define MIFARECLASSICSIM_H
+
+#include "Crypto1.h"
+#include "PiccSim.h"
+
+// MIFARE Classic 1K/4K: three pass Crypto1 authentication (including nested
+// authentication inside an encrypted session), READ, WRITE and the value
+// block commands with their transfer buffer. Every frame after
+// authentication is encrypted in both directions. Access conditions are not
+// enforced beyond hiding key A when a sector trailer is read.
+class MifareClassicSim : public PiccSim {
+public:
+    static const uint32_t WRITE_CYCLES = 33900;     // 2.5 ms EEPROM write
+
+    MifareClassicSim(const uint8_t *uid, uint8_t uidSize = 4, bool is4K = false);
+
+    virtual bool Receive(const Frame &request, Frame *response);
+
+    uint16_t GetBlockCount() const { return _blockCount; }
+    void ReadBlock(uint8_t block, uint8_t *data) const;
+    void WriteBlock(uint8_t block, const uint8_t *data);
+    bool IsAuthenticated() const { return _cryptoActive; }
+
+    static uint8_t SectorOf(uint8_t block);
+    static uint8_t TrailerOf(uint8_t block);
+
+protected:
+    virtual bool Process(const Frame &request, Frame *response);
+    virtual void Deactivate();
+
+private:
+    enum Pending {
+        PENDING_NONE,
+        PENDING_AUTH,
+        PENDING_WRITE,
+        PENDING_VALUE
+    };
+
+    bool Authenticate(const Frame &request, Frame *response);
+    bool VerifyReader(const Frame &request, Frame *response);
+    bool CompletePending(const Frame &request, Frame *response);
+    bool ReadValue(uint8_t block, int32_t *value) const;
+    uint32_t NextNonce();
+
+    uint8_t _blocks[256][16];
+    uint16_t _blockCount;
+    Crypto1 _crypto;
+    bool _cryptoActive;
+    uint8_t _authSector;
+    uint32_t _nonce;
+    uint32_t _nt;
+    Pending _pending;
+    uint8_t _pendingCommand;
+    uint8_t _pendingBlock;
+    int32_t _transferValue;
+    uint8_t _transferAddr;
+    bool _transferValid;
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "PiccSim.h"
+
+#include <string.h>
+
+namespace {
+
+const uint8_t CMD_REQA = 0x26;
+const uint8_t CMD_WUPA = 0x52;
+const uint8_t CMD_CT = 0x88;
+const uint8_t CMD_HLTA = 0x50;
+const uint8_t SEL_CODES[3] = {0x93, 0x95, 0x97};
+
+uint8_t GetBit(const uint8_t *data, uint16_t bit) {
+  return (data[bit / 8] >> (bit % 8)) & 1;
+}
+
+void PutBit(uint8_t *data, uint16_t bit, uint8_t value) {
+  if (value)
+    data[bit / 8] |= 1 << (bit % 8);
+  else
+    data[bit / 8] &= ~(1 << (bit % 8));
+}
+
+uint16_t CrcA(const uint8_t *data, uint16_t length) {
+  uint16_t crc = 0x6363;
+  for (uint16_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+  }
+  return crc;
+}
+
+} // namespace
+
+PiccSim::PiccSim(const uint8_t *uid, uint8_t uidSize, uint16_t atqa,
+                 uint8_t sak)
+    : _rxSpeed(0), _txSpeed(0), _uidSize(uidSize), _atqa(atqa), _sak(sak),
+      _state(STATE_POWER_OFF), _level(0), _halted(false) {
+  memset(_uid, 0, sizeof(_uid));
+  memcpy(_uid, uid, uidSize);
+}
+
+void PiccSim::PowerOn() {
+  if (_state != STATE_POWER_OFF)
+    return;
+  _state = STATE_IDLE;
+  _halted = false;
+  _rxSpeed = 0;
+  _txSpeed = 0;
+}
+
+void PiccSim::PowerOff() {
+  if (_state == STATE_ACTIVE)
+    Deactivate();
+  _state = STATE_POWER_OFF;
+}
+
+bool PiccSim::Receive(const Frame &request, Frame *response) {
+  response->bits = 0;
+  response->speed = _txSpeed;
+  response->delayCycles = 0;
+
+  if (_state == STATE_POWER_OFF || request.speed != _rxSpeed)
+    return false;
+
+  if (request.bits == 7) {
+    uint8_t command = request.data[0] & 0x7F;
+    bool wake = command == CMD_WUPA && _state == STATE_HALT;
+    if ((command == CMD_REQA || command == CMD_WUPA) &&
+        (_state == STATE_IDLE || wake)) {
+      _state = STATE_READY;
+      _halted = wake;
+      _level = 0;
+      uint8_t atqa[2] = {(uint8_t)(_atqa & 0xFF), (uint8_t)(_atqa >> 8)};
+      SetBytes(response, atqa, 2);
+      return true;
+    }
+    if (_state == STATE_READY || _state == STATE_ACTIVE)
+      Leave();
+    return false;
+  }
+
+  switch (_state) {
+  case STATE_READY:
+    if (request.bits >= 16 && request.data[0] == SEL_CODES[_level]) {
+      if (request.data[1] == 0x70 ? Select(request, response)
+                                  : Anticollision(request, response))
+        return true;
+      // A card whose UID does not match the known bits just stays silent.
+      if (request.data[1] != 0x70 && request.bits == 16 + KnownBits(request))
+        return false;
+    }
+    Leave();
+    return false;
+  case STATE_ACTIVE:
+    if (request.bits == 32 && request.data[0] == CMD_HLTA &&
+        request.data[1] == 0x00 && CheckCRC(request)) {
+      Halt();
+      return false;
+    }
+    if (!Process(request, response))
+      Leave();
+    return response->bits != 0;
+  default:
+    return false;
+  }
+}
+
+bool PiccSim::Select(const Frame &request, Frame *response) {
+  uint8_t cln[5];
+  CascadeLevel(_level, cln);
+  if (request.bits != 72 || !CheckCRC(request) ||
+      memcmp(&request.data[2], cln, 5) != 0)
+    return false;
+
+  bool last = _level + 1 == CascadeLevels();
+  uint8_t sak = last ? _sak : 0x04;
+  SetBytes(response, &sak, 1);
+  AppendCRC(response);
+  if (last)
+    _state = STATE_ACTIVE;
+  else
+    _level++;
+  return true;
+}
+
+bool PiccSim::Anticollision(const Frame &request, Frame *response) {
+  uint16_t known = KnownBits(request);
+  if (known >= 40 || request.bits != 16 + known)
+    return false;
+
+  uint8_t cln[5];
+  CascadeLevel(_level, cln);
+  for (uint16_t i = 0; i < known; i++) {
+    if (GetBit(&request.data[2], i) != GetBit(cln, i))
+      return false;
+  }
+
+  memset(response->data, 0, 5);
+  for (uint16_t i = known; i < 40; i++) {
+    PutBit(response->data, i - known, GetBit(cln, i));
+  }
+  response->bits = 40 - known;
+  return true;
+}
+
+uint16_t PiccSim::KnownBits(const Frame &request) {
+  uint8_t bytes = request.data[1] >> 4;
+  uint8_t extra = request.data[1] & 0x0F;
+  if (bytes < 2 || bytes > 6 || extra > 7)
+    return 0xFFFF;
+  return (bytes - 2) * 8 + extra;
+}
+
+uint8_t PiccSim::CascadeLevels() const {
+  return _uidSize == 4 ? 1 : (_uidSize == 7 ? 2 : 3);
+}
+
+void PiccSim::CascadeLevel(uint8_t level, uint8_t *cln) const {
+  bool lastLevel = level + 1 == CascadeLevels();
+  uint8_t offset = level * 3;
+  if (lastLevel) {
+    memcpy(cln, &_uid[offset], 4);
+  } else {
+    cln[0] = CMD_CT;
+    memcpy(&cln[1], &_uid[offset], 3);
+  }
+  cln[4] = cln[0] ^ cln[1] ^ cln[2] ^ cln[3];
+}
+
+bool PiccSim::Process(const Frame &, Frame *) { return false; }
+
+void PiccSim::Leave() {
+  if (_state == STATE_ACTIVE)
+    Deactivate();
+  _state = _halted ? STATE_HALT : STATE_IDLE;
+}
+
+void PiccSim::Halt() {
+  if (_state == STATE_ACTIVE)
+    Deactivate();
+  _state = STATE_HALT;
+}
+
+void PiccSim::AppendCRC(Frame *frame) {
+  uint16_t length = frame->bits / 8;
+  uint16_t crc = CrcA(frame->data, length);
+  frame->data[length] = crc & 0xFF;
+  frame->data[length + 1] = crc >> 8;
+  frame->bits += 16;
+}
+
+bool PiccSim::CheckCRC(const Frame &frame) {
+  if (frame.bits % 8 || frame.bits < 24)
+    return false;
+  uint16_t length = frame.bits / 8 - 2;
+  uint16_t crc = CrcA(frame.data, length);
+  return frame.data[length] == (crc & 0xFF) &&
+         frame.data[length + 1] == (crc >> 8);
+}
+
+void PiccSim::Ack(Frame *response, uint32_t delayCycles) {
+  response->data[0] = 0x0A;
+  response->bits = 4;
+  response->delayCycles = delayCycles;
+}
+
+void PiccSim::Nak(Frame *response, uint8_t code) {
+  response->data[0] = code & 0x0F;
+  response->bits = 4;
+}
+
+void PiccSim::SetBytes(Frame *frame, const uint8_t *data, uint16_t length) {
+  memcpy(frame->data, data, length);
+  frame->bits = length * 8;
+}
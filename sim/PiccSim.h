@@ -0,0 +1,77 @@
+#ifndef PICCSIM_H
+#define PICCSIM_H
+
+#include <stdint.h>
+
+// An ISO/IEC 14443-3 type A card as seen from the air interface: the
+// IDLE/READY/ACTIVE/HALT state machine with cascaded anticollision for 4, 7
+// and 10 byte UIDs. Frames carry a bit count so short frames and split
+// anticollision frames are represented exactly; parity is not modelled.
+// Subclasses add the application layer in Process().
+class PiccSim {
+public:
+    static const uint16_t MAX_FRAME_BYTES = 272;
+
+    enum State {
+        STATE_POWER_OFF,
+        STATE_IDLE,
+        STATE_READY,
+        STATE_ACTIVE,
+        STATE_HALT
+    };
+
+    struct Frame {
+        uint8_t data[MAX_FRAME_BYTES];
+        uint16_t bits;
+        uint8_t speed;          // 0 = 106 kbit/s, 1 = 212, 2 = 424, 3 = 848
+        uint32_t delayCycles;   // Processing time before the answer, in 1/fc
+    };
+
+    PiccSim(const uint8_t *uid, uint8_t uidSize, uint16_t atqa, uint8_t sak);
+    virtual ~PiccSim() {}
+
+    void PowerOn();
+    void PowerOff();
+    virtual bool Receive(const Frame &request, Frame *response);
+
+    State GetState() const { return _state; }
+    const uint8_t *GetUid() const { return _uid; }
+    uint8_t GetUidSize() const { return _uidSize; }
+    uint8_t GetSak() const { return _sak; }
+
+    static void AppendCRC(Frame *frame);
+    static bool CheckCRC(const Frame &frame);
+
+protected:
+    // Called for every frame other than HLTA received in ACTIVE state.
+    // Returning false drops the card back to IDLE, or HALT if it was woken
+    // from there.
+    virtual bool Process(const Frame &request, Frame *response);
+    virtual void Deactivate() {}
+
+    void Leave();
+    void Halt();
+    static void Ack(Frame *response, uint32_t delayCycles = 0);
+    static void Nak(Frame *response, uint8_t code);
+    static void SetBytes(Frame *frame, const uint8_t *data, uint16_t length);
+
+    uint8_t _rxSpeed;
+    uint8_t _txSpeed;
+
+private:
+    uint8_t CascadeLevels() const;
+    void CascadeLevel(uint8_t level, uint8_t *cln) const;
+    bool Select(const Frame &request, Frame *response);
+    bool Anticollision(const Frame &request, Frame *response);
+    static uint16_t KnownBits(const Frame &request);
+
+    uint8_t _uid[10];
+    uint8_t _uidSize;
+    uint16_t _atqa;
+    uint8_t _sak;
+    State _state;
+    uint8_t _level;
+    bool _halted;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "TftBusSim.h"
+
+#include <string.h>
+
+namespace {
+
+const uint8_t CONTROL_PORT = 12;
+const uint32_t NWR_BIT = 0x01;
+const uint32_t DC_BIT = 0x02;
+const uint32_t NRD_BIT = 0x08;
+
+} // namespace
+
+TftBusSim &TftBusSim::Get() {
+  static TftBusSim bus;
+  return bus;
+}
+
+TftBusSim::TftBusSim() {
+  memset(_out, 0, sizeof(_out));
+  _out[CONTROL_PORT] = NWR_BIT | NRD_BIT;
+  _readData = NULL;
+  _readLength = 0;
+  Reset();
+}
+
+void TftBusSim::Set(uint8_t port, uint32_t mask) {
+  uint32_t before = _out[port];
+  _out[port] |= mask;
+  _writes++;
+  if (port == CONTROL_PORT)
+    ControlChanged(before);
+}
+
+void TftBusSim::Clear(uint8_t port, uint32_t mask) {
+  uint32_t before = _out[port];
+  _out[port] &= ~mask;
+  _writes++;
+  if (port == CONTROL_PORT)
+    ControlChanged(before);
+}
+
+void TftBusSim::Invert(uint8_t port, uint32_t mask) {
+  uint32_t before = _out[port];
+  _out[port] ^= mask;
+  _writes++;
+  if (port == CONTROL_PORT)
+    ControlChanged(before);
+}
+
+uint32_t TftBusSim::Read(uint8_t port) {
+  _reads++;
+  if (_out[CONTROL_PORT] & NRD_BIT)
+    return _out[port];
+
+  uint8_t value = _readPulses < _readLength ? _readData[_readPulses] : 0;
+  switch (port) {
+  case 9:
+    return (_out[9] & ~0x37u) | (value & 0x07) | ((value & 0x18) << 1);
+  case 0:
+    return (_out[0] & ~0x04u) | ((value & 0x20) >> 3);
+  case 13:
+    return (_out[13] & ~0x03u) | ((value & 0xC0) >> 6);
+  default:
+    return _out[port];
+  }
+}
+
+void TftBusSim::SetReadData(const uint8_t *data, uint32_t length) {
+  _readData = data;
+  _readLength = length;
+  _readPulses = 0;
+}
+
+// P9[2:0] carry bits 2-0, P9[5:4] bits 4-3, P0[2] bit 5, P13[1:0] bits 7-6.
+uint8_t TftBusSim::GetDataBus() const {
+  return (_out[9] & 0x07) | ((_out[9] & 0x30) >> 1) | ((_out[0] & 0x04) << 3) |
+         ((_out[13] & 0x03) << 6);
+}
+
+void TftBusSim::Reset() {
+  _writes = 0;
+  _reads = 0;
+  _readPulses = 0;
+  _bytes = 0;
+}
+
+// Both strobes act on their rising edge: NWR latches the byte written, NRD
+// moves on to the next byte to return.
+void TftBusSim::ControlChanged(uint32_t before) {
+  uint32_t rising = ~before & _out[CONTROL_PORT];
+  if (rising & NRD_BIT)
+    _readPulses++;
+  if (!(rising & NWR_BIT))
+    return;
+
+  if (_bytes < MAX_LOG) {
+    _log[_bytes].value = GetDataBus();
+    _log[_bytes].dc = _out[CONTROL_PORT] & DC_BIT;
+  }
+  _bytes++;
+}
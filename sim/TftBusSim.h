@@ -0,0 +1,61 @@
+#ifndef TFTBUSSIM_H
+#define TFTBUSSIM_H
+
+#include <stdint.h>
+
+// Host model of the GPIO ports behind the CY8CKIT-028-TFT i8080 bus, in
+// place of the PSoC 6 OUT_SET, OUT_CLR, OUT_INV and IN registers. Every
+// register access is counted, and the byte on the data pins is decoded with
+// the DC level on each rising NWR edge, so a harness can check what the panel
+// received and how many port operations each pixel cost. While NRD is low the
+// panel drives the next byte queued with SetReadData onto the data pins.
+class TftBusSim {
+public:
+    static const uint8_t PORT_COUNT = 16;
+    static const uint32_t MAX_LOG = 4096;
+
+    struct Byte {
+        uint8_t value;
+        bool dc;                // 0 for a command, 1 for data
+    };
+
+    static TftBusSim &Get();
+
+    void Set(uint8_t port, uint32_t mask);
+    void Clear(uint8_t port, uint32_t mask);
+    void Invert(uint8_t port, uint32_t mask);
+    uint32_t Read(uint8_t port);
+    // Bytes the panel returns, one per NRD pulse; 0 once they run out.
+    void SetReadData(const uint8_t *data, uint32_t length);
+
+    uint32_t GetPort(uint8_t port) const { return _out[port]; }
+    uint8_t GetDataBus() const;
+    // Register accesses since the last Reset.
+    uint32_t GetWrites() const { return _writes; }
+    uint32_t GetReads() const { return _reads; }
+    uint32_t GetReadPulses() const { return _readPulses; }
+    // Bytes latched, and the first MAX_LOG of them.
+    uint32_t GetByteCount() const { return _bytes; }
+    const Byte &GetByte(uint32_t index) const { return _log[index]; }
+    void Reset();
+
+private:
+    TftBusSim();
+    void ControlChanged(uint32_t before);
+
+    uint32_t _out[PORT_COUNT];
+    uint32_t _writes;
+    uint32_t _reads;
+    uint32_t _readPulses;
+    uint32_t _bytes;
+    Byte _log[MAX_LOG];
+    const uint8_t *_readData;
+    uint32_t _readLength;
+};
+
+#define TFT_PORT_SET(port, mask)    TftBusSim::Get().Set(port, mask)
+#define TFT_PORT_CLR(port, mask)    TftBusSim::Get().Clear(port, mask)
+#define TFT_PORT_INV(port, mask)    TftBusSim::Get().Invert(port, mask)
+#define TFT_PORT_READ(port)         TftBusSim::Get().Read(port)
+
+#endif
@@ -0,0 +1,148 @@
+#include "UltralightSim.h"
+
+#include <string.h>
+
+namespace {
+
+const uint8_t CMD_GET_VERSION = 0x60;
+const uint8_t CMD_READ = 0x30;
+const uint8_t CMD_FAST_READ = 0x3A;
+const uint8_t CMD_COMPAT_WRITE = 0xA0;
+const uint8_t CMD_WRITE = 0xA2;
+
+const uint8_t NAK_INVALID = 0x0;
+const uint8_t NAK_CRC = 0x1;
+
+struct ModelInfo {
+  uint8_t pages;
+  uint8_t ccSize;
+  uint8_t versionSize;
+};
+
+const ModelInfo MODELS[] = {
+    {16, 0x06, 0x00},
+    {45, 0x12, 0x0F},
+    {135, 0x3E, 0x11},
+    {231, 0x6D, 0x13},
+};
+
+} // namespace
+
+UltralightSim::UltralightSim(const uint8_t *uid, Model model)
+    : PiccSim(uid, 7, 0x0044, 0x00), _model(model),
+      _pageCount(MODELS[model].pages), _compatWritePage(-1) {
+  memset(_pages, 0, sizeof(_pages));
+
+  _pages[0][0] = uid[0];
+  _pages[0][1] = uid[1];
+  _pages[0][2] = uid[2];
+  _pages[0][3] = 0x88 ^ uid[0] ^ uid[1] ^ uid[2];
+  memcpy(_pages[1], &uid[3], 4);
+  _pages[2][0] = uid[3] ^ uid[4] ^ uid[5] ^ uid[6];
+  _pages[2][1] = 0x48;
+  if (IsNtag()) {
+    _pages[3][0] = 0xE1;
+    _pages[3][1] = 0x10;
+    _pages[3][2] = MODELS[model].ccSize;
+  }
+}
+
+void UltralightSim::ReadPage(uint8_t page, uint8_t *data) const {
+  memcpy(data, _pages[page], 4);
+}
+
+void UltralightSim::WritePage(uint8_t page, const uint8_t *data) {
+  memcpy(_pages[page], data, 4);
+}
+
+bool UltralightSim::Process(const Frame &request, Frame *response) {
+  if (!CheckCRC(request)) {
+    Nak(response, NAK_CRC);
+    return false;
+  }
+
+  uint16_t length = request.bits / 8 - 2;
+  if (_compatWritePage >= 0) {
+    uint8_t page = _compatWritePage;
+    _compatWritePage = -1;
+    if (length != 16) {
+      Nak(response, NAK_INVALID);
+      return false;
+    }
+    return Write(page, request.data, response);
+  }
+
+  uint8_t command = request.data[0];
+  if (command == CMD_READ && length == 2) {
+    uint8_t page = request.data[1];
+    if (page >= _pageCount) {
+      Nak(response, NAK_INVALID);
+      return false;
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+      memcpy(&response->data[i * 4], _pages[(page + i) % _pageCount], 4);
+    }
+    response->bits = 16 * 8;
+    AppendCRC(response);
+    return true;
+  }
+
+  if (command == CMD_FAST_READ && length == 3 && IsNtag()) {
+    uint8_t start = request.data[1];
+    uint8_t end = request.data[2];
+    uint16_t bytes = (end - start + 1) * 4;
+    if (start > end || end >= _pageCount || bytes + 2 > MAX_FRAME_BYTES) {
+      Nak(response, NAK_INVALID);
+      return false;
+    }
+    memcpy(response->data, _pages[start], bytes);
+    response->bits = bytes * 8;
+    AppendCRC(response);
+    return true;
+  }
+
+  if (command == CMD_WRITE && length == 6)
+    return Write(request.data[1], &request.data[2], response);
+
+  if (command == CMD_COMPAT_WRITE && length == 2) {
+    if (request.data[1] < 2 || request.data[1] >= _pageCount) {
+      Nak(response, NAK_INVALID);
+      return false;
+    }
+    _compatWritePage = request.data[1];
+    Ack(response);
+    return true;
+  }
+
+  if (command == CMD_GET_VERSION && length == 1 && IsNtag()) {
+    uint8_t version[8] = {0x00, 0x04, 0x04, 0x02,
+                          0x01, 0x00, MODELS[_model].versionSize, 0x03};
+    SetBytes(response, version, sizeof(version));
+    AppendCRC(response);
+    return true;
+  }
+
+  return false;
+}
+
+void UltralightSim::Deactivate() { _compatWritePage = -1; }
+
+bool UltralightSim::Write(uint8_t page, const uint8_t *data, Frame *response) {
+  if (page < 2 || page >= _pageCount) {
+    Nak(response, NAK_INVALID);
+    return false;
+  }
+
+  if (page == 2) {
+    _pages[2][2] |= data[2];
+    _pages[2][3] |= data[3];
+  } else if (page == 3) {
+    for (uint8_t i = 0; i < 4; i++) {
+      _pages[3][i] |= data[i];
+    }
+  } else {
+    memcpy(_pages[page], data, 4);
+  }
+  Ack(response, WRITE_CYCLES);
+  return true;
+}
@@ -0,0 +1,41 @@
+#ifndef ULTRALIGHTSIM_H
+#define ULTRALIGHTSIM_H
+
+#include "PiccSim.h"
+
+// MIFARE Ultralight and NTAG21x: 4 byte pages, READ, WRITE and COMPATIBILITY
+// WRITE, plus GET_VERSION and FAST_READ on the NTAG models. Lock bits and
+// password protection are not enforced.
+class UltralightSim : public PiccSim {
+public:
+    enum Model {
+        MODEL_ULTRALIGHT,
+        MODEL_NTAG213,
+        MODEL_NTAG215,
+        MODEL_NTAG216
+    };
+
+    static const uint16_t MAX_PAGES = 231;
+    static const uint32_t WRITE_CYCLES = 55600;     // 4.1 ms EEPROM write
+
+    UltralightSim(const uint8_t *uid, Model model = MODEL_ULTRALIGHT);
+
+    uint8_t GetPageCount() const { return _pageCount; }
+    void ReadPage(uint8_t page, uint8_t *data) const;
+    void WritePage(uint8_t page, const uint8_t *data);
+
+protected:
+    virtual bool Process(const Frame &request, Frame *response);
+    virtual void Deactivate();
+
+private:
+    bool IsNtag() const { return _model != MODEL_ULTRALIGHT; }
+    bool Write(uint8_t page, const uint8_t *data, Frame *response);
+
+    Model _model;
+    uint8_t _pageCount;
+    uint8_t _pages[MAX_PAGES][4];
+    int16_t _compatWritePage;
+};
+
+#endif
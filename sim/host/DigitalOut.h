@@ -0,0 +1,2 @@
+// The mbed OS header of the same name; the host shim has it all in mbed.h.
+#include "mbed.h"
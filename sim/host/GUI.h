@@ -0,0 +1,109 @@
+#ifndef SIM_HOST_GUI_H
+#define SIM_HOST_GUI_H
+
+// The part of the emWin API the display code uses, implemented by
+// sim/EmWinSim.cpp on a model of the panel and the emWin pool.
+
+#include "GUI_Type.h"
+
+#define GUI_USE_PARA(para) (void)(para)
+
+#define GUI_BLACK       0x000000u
+#define GUI_BLUE        0xFF0000u
+#define GUI_GREEN       0x00FF00u
+#define GUI_RED         0x0000FFu
+#define GUI_CYAN        0xFFFF00u
+#define GUI_YELLOW      0x00FFFFu
+#define GUI_WHITE       0xFFFFFFu
+
+#define GUI_TM_NORMAL   0
+#define GUI_TA_LEFT     0
+#define GUI_TA_HCENTER  2
+#define GUI_DM_NORMAL   0
+#define GUI_DM_XOR      1
+
+#define GUI_MEMDEV_NOTRANS 1
+
+#define GUI_MIRROR_X    (1 << 0)
+#define GUI_MIRROR_Y    (1 << 1)
+#define GUI_SWAP_XY     (1 << 2)
+
+#define LCD_DEVFUNC_FILLRECT        0x0D
+#define LCD_DEVFUNC_DRAWBMP_16BPP   0x11
+
+#define LCD_X_INITCONTROLLER        0x01
+
+typedef int GUI_MEMDEV_Handle;
+
+// Only GUICC_M565 bitmaps, drawn with GUI_DRAW_BMPM565.
+typedef struct {
+    int BitsPerPixel;
+} GUI_BITMAP_METHODS;
+
+typedef struct {
+    U16 XSize;
+    U16 YSize;
+    U16 BytesPerLine;
+    U16 BitsPerPixel;
+    const U8 *pData;
+    const void *pPal;
+    const GUI_BITMAP_METHODS *pMethods;
+} GUI_BITMAP;
+
+extern const GUI_BITMAP_METHODS GUI_BitmapMethodsM565;
+#define GUI_DRAW_BMPM565 (&GUI_BitmapMethodsM565)
+
+extern const GUI_FONT GUI_Font13B_1;
+extern const GUI_FONT GUI_Font16B_1;
+extern const GUI_FONT GUI_Font20B_1;
+#define GUI_FONT_13B_1 (&GUI_Font13B_1)
+#define GUI_FONT_16B_1 (&GUI_Font16B_1)
+#define GUI_FONT_20B_1 (&GUI_Font20B_1)
+
+void GUI_Init(void);
+void GUI_Delay(int ms);
+
+const GUI_FONT *GUI_SetFont(const GUI_FONT *font);
+const GUI_FONT *GUI_GetFont(void);
+GUI_COLOR GUI_SetColor(GUI_COLOR color);
+GUI_COLOR GUI_GetColor(void);
+GUI_COLOR GUI_SetBkColor(GUI_COLOR color);
+GUI_COLOR GUI_GetBkColor(void);
+int GUI_SetTextMode(int mode);
+int GUI_SetTextAlign(int align);
+int GUI_SetDrawMode(int mode);
+int GUI_GetDrawMode(void);
+
+int GUI_GetCharDistX(U16 c);
+int GUI_GetYSizeOfFont(const GUI_FONT *font);
+void GUI_DispCharAt(U16 c, int x, int y);
+void GUI_DispStringAt(const char *s, int x, int y);
+
+void GUI_Clear(void);
+void GUI_ClearRect(int x0, int y0, int x1, int y1);
+void GUI_FillRect(int x0, int y0, int x1, int y1);
+const GUI_RECT *GUI_SetClipRect(const GUI_RECT *rect);
+void GUI_DrawBitmap(const GUI_BITMAP *pBM, int x0, int y0);
+
+int LCD_GetXSize(void);
+int LCD_GetYSize(void);
+int LCD_SetSizeEx(int LayerIndex, int xSize, int ySize);
+int LCD_SetVSizeEx(int LayerIndex, int xSize, int ySize);
+// Returns 0 once set, 1 if the driver refuses the function. Before a custom
+// routine is set, LCD_GetDevFunc hands out the driver's own fill.
+int LCD_SetDevFunc(int LayerIndex, int IdFunc, void (*pDriverFunc)(void));
+void (*LCD_GetDevFunc(int LayerIndex, int IdFunc))(void);
+
+// Supplied by LCDConf.
+void LCD_X_Config(void);
+int LCD_X_DisplayDriver(unsigned LayerIndex, unsigned Cmd, void *pData);
+
+GUI_MEMDEV_Handle GUI_MEMDEV_CreateEx(int x0, int y0, int xSize, int ySize, int flags);
+GUI_MEMDEV_Handle GUI_MEMDEV_Select(GUI_MEMDEV_Handle memdev);
+void GUI_MEMDEV_CopyToLCD(GUI_MEMDEV_Handle memdev);
+void GUI_MEMDEV_Delete(GUI_MEMDEV_Handle memdev);
+
+I32 GUI_ALLOC_GetNumUsedBytes(void);
+I32 GUI_ALLOC_GetNumFreeBytes(void);
+
+#endif
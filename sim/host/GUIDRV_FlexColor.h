@@ -0,0 +1,49 @@
+#ifndef SIM_HOST_GUIDRV_FLEXCOLOR_H
+#define SIM_HOST_GUIDRV_FLEXCOLOR_H
+
+// The GUIDRV_FlexColor configuration calls, recorded by sim/EmWinSim.cpp.
+
+#include "GUI.h"
+
+typedef struct {
+    int DeviceClassIndex;
+} GUI_DEVICE_API;
+
+typedef struct {
+    int BitsPerPixel;
+} LCD_API_COLOR_CONV;
+
+typedef struct {
+    const GUI_DEVICE_API *pDeviceAPI;
+    const LCD_API_COLOR_CONV *pColorConvAPI;
+} GUI_DEVICE;
+
+extern const GUI_DEVICE_API GUIDRV_FlexColor_API;
+extern const LCD_API_COLOR_CONV LCD_API_ColorConv_M565;
+#define GUIDRV_FLEXCOLOR (&GUIDRV_FlexColor_API)
+#define GUICC_M565 (&LCD_API_ColorConv_M565)
+
+typedef struct {
+    int FirstSEG;
+    int FirstCOM;
+    int Orientation;
+    U16 RegEntryMode;
+    int NumDummyReads;
+} CONFIG_FLEXCOLOR;
+
+typedef struct {
+    void (*pfWrite8_A0)(U8 Data);
+    void (*pfWrite8_A1)(U8 Data);
+    void (*pfWriteM8_A1)(U8 *pData, int NumItems);
+    U8 (*pfRead8_A1)(void);
+    void (*pfReadM8_A1)(U8 *pData, int NumItems);
+} GUI_PORT_API;
+
+#define GUIDRV_FLEXCOLOR_F66709     66709
+#define GUIDRV_FLEXCOLOR_M16C0B8    1
+
+GUI_DEVICE *GUI_DEVICE_CreateAndLink(const GUI_DEVICE_API *pDeviceAPI, const LCD_API_COLOR_CONV *pColorConvAPI, U16 Flags, int LayerIndex);
+void GUIDRV_FlexColor_Config(GUI_DEVICE *pDevice, CONFIG_FLEXCOLOR *pConfig);
+void GUIDRV_FlexColor_SetFunc(GUI_DEVICE *pDevice, GUI_PORT_API *pHW_API, int Controller, int Mode);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef SIM_HOST_GUI_TYPE_H
+#define SIM_HOST_GUI_TYPE_H
+
+// The emWin basic types the portable display code uses.
+
+#include <stdint.h>
+
+typedef int8_t I8;
+typedef uint8_t U8;
+typedef int16_t I16;
+typedef uint16_t U16;
+typedef int32_t I32;
+typedef uint32_t U32;
+
+typedef U32 GUI_COLOR;
+
+typedef struct {
+    I16 x0, y0, x1, y1;
+} GUI_RECT;
+
+// Glyph advances by character class in place of real font data.
+typedef struct {
+    U8 YSize;
+    U8 space, digit, upper, lower, other;
+} GUI_FONT;
+
+#endif
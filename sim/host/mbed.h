@@ -0,0 +1,153 @@
+#ifndef SIM_HOST_MBED_H
+#define SIM_HOST_MBED_H
+
+// Just enough of the mbed OS 5 API for the portable sources to compile on a
+// host. Nothing here touches hardware: MFRC522SpiTransport builds against it
+// but moves no data, and the harnesses plug MFRC522Sim in instead. The TFT
+// driver drives its bus through sim/TftBusSim.h rather than these classes.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+
+typedef enum {
+    P0_2, P8_0, P8_1, P8_2, P8_3, P8_4,
+    P9_0, P9_1, P9_2, P9_4, P9_5,
+    P12_0, P12_1, P12_2, P12_3,
+    P13_0, P13_1,
+    LED1, LED2, LED3, LED4, LED5,
+    NC = -1
+} PinName;
+
+#define DEVICE_SPI_ASYNCH 1
+#define SPI_EVENT_ERROR (1 << 1)
+#define SPI_EVENT_COMPLETE (1 << 2)
+#define osFlagsError 0x80000000U
+#define osWaitForever 0xFFFFFFFFU
+
+typedef enum {
+    DMA_USAGE_NEVER,
+    DMA_USAGE_OPPORTUNISTIC,
+    DMA_USAGE_ALWAYS
+} DMAUsage;
+
+namespace mbed {
+
+template <typename F> class Callback;
+
+template <typename R, typename... A>
+class Callback<R(A...)> {
+public:
+    Callback() {}
+    Callback(R (*function)(A...)) : _function(function) {}
+    template <typename T>
+    Callback(T *object, R (T::*method)(A...))
+        : _function([object, method](A... args) { return (object->*method)(args...); }) {}
+    template <typename F>
+    Callback(F function) : _function(function) {}
+
+    R operator()(A... args) const { return _function(args...); }
+    explicit operator bool() const { return (bool)_function; }
+
+private:
+    std::function<R(A...)> _function;
+};
+
+template <typename T, typename R, typename... A>
+Callback<R(A...)> callback(T *object, R (T::*method)(A...))
+{
+    return Callback<R(A...)>(object, method);
+}
+
+class SPI {
+public:
+    SPI(PinName, PinName, PinName, PinName = NC) {}
+    void format(int, int = 0) {}
+    void frequency(int) {}
+    int set_dma_usage(DMAUsage) { return 0; }
+    int write(int) { return 0; }
+    int write(const char *, int, char *rx, int rxLength)
+    {
+        if (rx)
+            memset(rx, 0, rxLength);
+        return rxLength;
+    }
+    template <typename T>
+    int transfer(const T *, int, T *, int, const Callback<void(int)> &, int = SPI_EVENT_COMPLETE) { return -1; }
+};
+
+class DigitalOut {
+public:
+    DigitalOut(PinName, int value = 0) : _value(value) {}
+    void write(int value) { _value = value; }
+    int read() { return _value; }
+    DigitalOut &operator=(int value) { _value = value; return *this; }
+    operator int() { return _value; }
+
+private:
+    int _value;
+};
+
+// Direction changes are counted: each one is an mbed call on the target, so
+// the TFT harnesses add them to the port operations of a bus transfer.
+class DigitalInOut {
+public:
+    DigitalInOut(PinName) : _value(0) {}
+    void input() { DirectionChanges()++; }
+    void output() { DirectionChanges()++; }
+    void write(int value) { _value = value; }
+    int read() { return _value; }
+    DigitalInOut &operator=(int value) { _value = value; return *this; }
+    operator int() { return _value; }
+
+    static uint32_t &DirectionChanges()
+    {
+        static uint32_t changes;
+        return changes;
+    }
+
+private:
+    int _value;
+};
+
+class InterruptIn {
+public:
+    InterruptIn(PinName) {}
+    void rise(Callback<void()>) {}
+    void fall(Callback<void()>) {}
+    int read() { return 1; }
+};
+
+class Timer {
+public:
+    void start() {}
+    void stop() {}
+    void reset() {}
+    int read_us() { return 0; }
+    int read_ms() { return 0; }
+    uint64_t read_high_resolution_us() { return 0; }
+};
+
+} // namespace mbed
+
+namespace rtos {
+
+class EventFlags {
+public:
+    uint32_t set(uint32_t flags) { return flags; }
+    uint32_t clear(uint32_t flags = 0x7FFFFFFF) { return flags; }
+    uint32_t wait_any(uint32_t, uint32_t = osWaitForever, bool = true) { return osFlagsError; }
+};
+
+} // namespace rtos
+
+using namespace mbed;
+using namespace rtos;
+
+inline void wait_us(int) {}
+inline void wait_ms(int) {}
+inline void wait_ns(unsigned int) {}
+
+#endif
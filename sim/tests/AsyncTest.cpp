@@ -0,0 +1,122 @@
+// MFRC522Async through init, select, authenticate and read, checking that
+// no Poll blocks for longer than its own SPI frames.
+
+#include "Check.h"
+#include "MFRC522Async.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+// The main loop spends 100 us elsewhere between polls.
+const uint32_t LOOP_US = 100;
+
+struct Stats {
+  uint32_t polls;
+  uint64_t longestUs;
+  uint64_t totalUs;
+};
+
+void Run(MFRC522Sim &sim, MFRC522Async &async, Stats *stats) {
+  uint64_t start = sim.GetTimeUs();
+  stats->polls = 0;
+  stats->longestUs = 0;
+  for (;;) {
+    uint64_t before = sim.GetTimeUs();
+    bool busy = async.Poll();
+    uint64_t spent = sim.GetTimeUs() - before;
+    stats->polls++;
+    if (spent > stats->longestUs)
+      stats->longestUs = spent;
+    if (!busy)
+      break;
+    sim.DelayUs(LOOP_US);
+  }
+  stats->totalUs = sim.GetTimeUs() - start;
+}
+
+void Print(const char *name, const Stats &stats) {
+  printf("  %-16s %4u polls, longest %4llu us, %6llu us in all\n", name,
+         stats.polls, (unsigned long long)stats.longestUs,
+         (unsigned long long)stats.totalUs);
+}
+
+} // namespace
+
+int main() {
+  MFRC522Sim sim;
+  uint8_t uid[4] = {0x10, 0x20, 0x30, 0x40};
+  MifareClassicSim classic(uid);
+  sim.AddCard(&classic);
+  MFRC522 rfid(&sim);
+  MFRC522Async async(rfid);
+
+  int completions = 0;
+  MFRC522::StatusCode completed = MFRC522::STATUS_ERROR;
+  async.SetCompletionCallback([&](MFRC522::StatusCode status) {
+    completions++;
+    completed = status;
+  });
+
+  printf("MFRC522Async at 1 MHz SPI, %u us of other work per loop\n",
+         LOOP_US);
+  Stats stats;
+  CHECK(async.StartInit());
+  CHECK(!async.StartIsNewCardPresent());
+  Run(sim, async, &stats);
+  Print("init", stats);
+  CHECK(async.GetStatus() == MFRC522::STATUS_OK);
+  // The 50 ms reset waits are deadlines, not sleeps.
+  CHECK(stats.longestUs < 1000);
+  sim.DelayUs(5000);
+
+  CHECK(async.StartIsNewCardPresent());
+  Run(sim, async, &stats);
+  Print("REQA", stats);
+  CHECK(async.GetStatus() == MFRC522::STATUS_OK);
+  CHECK(stats.longestUs < 1000);
+
+  CHECK(async.StartReadCardSerial());
+  Run(sim, async, &stats);
+  Print("select", stats);
+  CHECK(async.GetStatus() == MFRC522::STATUS_OK);
+  CHECK(rfid.uid.size == 4 && memcmp(rfid.uid.uidByte, uid, 4) == 0);
+  CHECK(stats.longestUs < 1000);
+
+  MFRC522::MIFARE_Key key;
+  memset(key.keyByte, 0xFF, sizeof(key.keyByte));
+  CHECK(async.StartAuthenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 4, &key,
+                                &rfid.uid));
+  Run(sim, async, &stats);
+  Print("authenticate", stats);
+  CHECK(async.GetStatus() == MFRC522::STATUS_OK);
+  CHECK(stats.longestUs < 1000);
+
+  uint8_t buffer[18];
+  uint8_t size = sizeof(buffer);
+  CHECK(async.StartRead(4, buffer, &size));
+  Run(sim, async, &stats);
+  Print("read block", stats);
+  CHECK(async.GetStatus() == MFRC522::STATUS_OK && size == 18);
+  CHECK(stats.longestUs < 1000);
+
+  // The blocking API reads the same block once the operation is over.
+  uint8_t check[18];
+  size = sizeof(check);
+  CHECK(rfid.MIFARE_Read(4, check, &size) == MFRC522::STATUS_OK);
+  CHECK(memcmp(buffer, check, 16) == 0);
+  CHECK(completions == 5 && completed == MFRC522::STATUS_OK);
+
+  // With the card gone REQA ends in a timeout, still without blocking.
+  rfid.PICC_HaltA();
+  rfid.PCD_StopCrypto1();
+  sim.RemoveCard(&classic);
+  CHECK(async.StartIsNewCardPresent());
+  Run(sim, async, &stats);
+  Print("REQA, no card", stats);
+  CHECK(async.GetStatus() == MFRC522::STATUS_TIMEOUT);
+  CHECK(stats.longestUs < 1000);
+  return CheckResult();
+}
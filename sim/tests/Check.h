@@ -0,0 +1,26 @@
+#ifndef SIM_TESTS_CHECK_H
+#define SIM_TESTS_CHECK_H
+
+#include <stdio.h>
+
+// Failed checks are printed and counted; main returns CheckResult() so ctest
+// sees the outcome. Figures go to stdout next to the checks.
+static int checkFailures = 0;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);              \
+      checkFailures++;                                                         \
+    }                                                                          \
+  } while (0)
+
+static inline int CheckResult() {
+  if (checkFailures)
+    printf("%d checks failed\n", checkFailures);
+  else
+    printf("all checks passed\n");
+  return checkFailures != 0;
+}
+
+#endif
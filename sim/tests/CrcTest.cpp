@@ -0,0 +1,77 @@
+// The host CRC_A against the reference values and the chip's coprocessor,
+// and the SPI traffic it saves on a select and a block read.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+// SPI bytes for REQA, select, authenticate and read with the given CRC
+// path.
+uint32_t SessionBytes(bool hardwareCrc) {
+  MFRC522Sim sim;
+  uint8_t uid[4] = {0x10, 0x20, 0x30, 0x40};
+  MifareClassicSim classic(uid);
+  sim.AddCard(&classic);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  rfid.PCD_SetHardwareCRC(hardwareCrc);
+
+  uint32_t bytes = sim.GetSpiBytes();
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  MFRC522::MIFARE_Key key;
+  memset(key.keyByte, 0xFF, sizeof(key.keyByte));
+  CHECK(rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 4, &key,
+                              &rfid.uid) == MFRC522::STATUS_OK);
+  uint8_t buffer[18];
+  uint8_t size = sizeof(buffer);
+  CHECK(rfid.MIFARE_Read(4, buffer, &size) == MFRC522::STATUS_OK);
+  return sim.GetSpiBytes() - bytes;
+}
+
+} // namespace
+
+int main() {
+  // ISO 14443-3 annex B: HLTA is 50 00 57 CD, and 00 00 gives A0 1E.
+  uint8_t hlta[2] = {0x50, 0x00};
+  uint8_t zeros[2] = {0x00, 0x00};
+  uint8_t crc[2];
+  MFRC522::CalculateCRC_A(hlta, 2, crc);
+  CHECK(crc[0] == 0x57 && crc[1] == 0xCD);
+  MFRC522::CalculateCRC_A(zeros, 2, crc);
+  CHECK(crc[0] == 0xA0 && crc[1] == 0x1E);
+
+  // Every length the FIFO can hold, on pseudo-random data.
+  MFRC522Sim sim;
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  rfid.PCD_SetHardwareCRC(true);
+  uint8_t data[64];
+  uint32_t seed = 1;
+  int mismatches = 0;
+  for (uint8_t length = 1; length <= sizeof(data); length++) {
+    for (uint8_t i = 0; i < length; i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = seed >> 16;
+    }
+    uint8_t chip[2];
+    CHECK(rfid.PCD_CalculateCRC(data, length, chip) == MFRC522::STATUS_OK);
+    MFRC522::CalculateCRC_A(data, length, crc);
+    if (memcmp(chip, crc, 2) != 0)
+      mismatches++;
+  }
+  CHECK(mismatches == 0);
+
+  uint32_t host = SessionBytes(false);
+  uint32_t chip = SessionBytes(true);
+  printf("select, auth, read at 1 MHz SPI: %u SPI bytes with the host CRC, "
+         "%u with the coprocessor\n",
+         host, chip);
+  CHECK(host < chip);
+  return CheckResult();
+}
@@ -0,0 +1,161 @@
+// PICC_Inventory on simulated multi-card fields: selects that fail are
+// retried until the card is read or the retries run out, and the rate in
+// cards per second for trays of 1 to 8 cards.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+#include "UltralightSim.h"
+
+#include <string.h>
+
+namespace {
+
+// A 4-byte UID card that loses the answer to its first SELECT, or to every
+// one. With dropSak the card still goes ACTIVE and only the SAK is lost;
+// otherwise the SELECT never reaches it and it stays READY.
+class FlakyCard : public MifareClassicSim {
+public:
+  FlakyCard(const uint8_t *uid, bool dropSak, bool always = false)
+      : MifareClassicSim(uid), _dropSak(dropSak), _always(always),
+        _dropped(0) {}
+
+  virtual bool Receive(const Frame &request, Frame *response) {
+    bool select = GetState() == STATE_READY && request.bits == 72 &&
+                  request.data[1] == 0x70 &&
+                  memcmp(&request.data[2], GetUid(), 4) == 0;
+    if (!select || (_dropped && !_always))
+      return MifareClassicSim::Receive(request, response);
+
+    _dropped++;
+    if (_dropSak)
+      MifareClassicSim::Receive(request, response);
+    response->bits = 0;
+    return false;
+  }
+
+  uint32_t GetDropped() const { return _dropped; }
+
+private:
+  bool _dropSak;
+  bool _always;
+  uint32_t _dropped;
+};
+
+bool Contains(const MFRC522::Uid *uids, uint8_t count, const PiccSim &card) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (uids[i].size == card.GetUidSize() &&
+        memcmp(uids[i].uidByte, card.GetUid(), uids[i].size) == 0)
+      return true;
+  }
+  return false;
+}
+
+// Three cards, one of them flaky. The inventory selects them in the order
+// 1, 2, 0, always taking the '1' branch of a collision.
+void Retry(uint8_t flakyIndex, bool dropSak) {
+  uint8_t uids[3][4] = {{0x10, 0x20, 0x30, 0x40},
+                        {0x11, 0x20, 0x30, 0x40},
+                        {0x10, 0x21, 0x30, 0x40}};
+  MFRC522Sim sim;
+  MifareClassicSim *cards[3];
+  for (uint8_t i = 0; i < 3; i++) {
+    cards[i] = i == flakyIndex ? new FlakyCard(uids[i], dropSak)
+                               : new MifareClassicSim(uids[i]);
+    sim.AddCard(cards[i]);
+  }
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+
+  MFRC522::Uid found[4];
+  uint8_t count = 0;
+  CHECK(rfid.PICC_Inventory(found, 4, &count) == MFRC522::STATUS_OK);
+  CHECK(count == 3);
+  for (uint8_t i = 0; i < 3; i++)
+    CHECK(Contains(found, count, *cards[i]));
+  CHECK(static_cast<FlakyCard *>(cards[flakyIndex])->GetDropped() == 1);
+  for (uint8_t i = 0; i < 3; i++)
+    delete cards[i];
+}
+
+// A card that never completes a select is reported, not left out.
+void Failure() {
+  uint8_t good[4] = {0x10, 0x20, 0x30, 0x40};
+  uint8_t bad[4] = {0x11, 0x20, 0x30, 0x40};
+  MFRC522Sim sim;
+  MifareClassicSim card(good);
+  FlakyCard flaky(bad, false, true);
+  sim.AddCard(&card);
+  sim.AddCard(&flaky);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+
+  MFRC522::Uid found[4];
+  uint8_t count = 0;
+  CHECK(rfid.PICC_Inventory(found, 4, &count) != MFRC522::STATUS_OK);
+  CHECK(count == 1 && Contains(found, count, card));
+}
+
+// Trays of 1 to 8 cards, a third each with 4, 7 and 10 byte UIDs, drawn
+// from a fixed seed. The rate counts the whole inventory, from WUPA to the
+// REQA that finds the field empty.
+void Benchmark() {
+  printf("Inventory at 1 MHz SPI, IRQ line connected\n");
+  const uint8_t trays[] = {1, 2, 4, 8};
+  uint32_t seed = 7;
+  for (uint8_t cards : trays) {
+    MFRC522Sim sim;
+    PiccSim *tray[MFRC522Sim::MAX_CARDS];
+    for (uint8_t i = 0; i < cards; i++) {
+      uint8_t uid[10];
+      for (uint8_t j = 0; j < sizeof(uid); j++) {
+        seed = seed * 1103515245 + 12345;
+        uid[j] = seed >> 16;
+      }
+      if (i % 3 == 0) {
+        uid[0] &= 0x7F; // not the cascade tag 0x88
+        tray[i] = new MifareClassicSim(uid);
+      } else if (i % 3 == 1) {
+        uid[0] = 0x04;
+        tray[i] = new UltralightSim(uid, UltralightSim::MODEL_NTAG213);
+      } else {
+        tray[i] = new PiccSim(uid, 10, 0x0084, 0x20);
+      }
+      sim.AddCard(tray[i]);
+    }
+    MFRC522 rfid(&sim);
+    rfid.PCD_Init();
+    sim.DelayUs(5000);
+
+    MFRC522::Uid found[MFRC522Sim::MAX_CARDS];
+    uint8_t count = 0;
+    uint64_t start = sim.GetTimeUs();
+    uint32_t bytes = sim.GetSpiBytes();
+    CHECK(rfid.PICC_Inventory(found, MFRC522Sim::MAX_CARDS, &count) ==
+          MFRC522::STATUS_OK);
+    uint64_t elapsed = sim.GetTimeUs() - start;
+    CHECK(count == cards);
+    for (uint8_t i = 0; i < cards; i++)
+      CHECK(Contains(found, count, *tray[i]));
+    printf("  %u cards: %6llu us, %5u SPI bytes, %4llu cards/s\n", cards,
+           (unsigned long long)elapsed, sim.GetSpiBytes() - bytes,
+           (unsigned long long)(cards * 1000000ULL / elapsed));
+    for (uint8_t i = 0; i < cards; i++)
+      delete tray[i];
+  }
+}
+
+} // namespace
+
+int main() {
+  for (uint8_t i = 0; i < 3; i++) {
+    Retry(i, false);
+    Retry(i, true);
+  }
+  Failure();
+  Benchmark();
+  return CheckResult();
+}
@@ -0,0 +1,122 @@
+// How often the driver reads the interrupt request registers while it
+// waits for a command, with the IRQ line connected and without.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+// Counts reads of ComIrqReg and DivIrqReg as they cross the bus, decoding
+// frames the same way the simulator does.
+class CountingSim : public MFRC522Sim {
+public:
+  CountingSim() : _start(false), _read(false), _irqReads(0) {}
+
+  virtual void Select() {
+    MFRC522Sim::Select();
+    _start = true;
+  }
+
+  virtual void Transfer(const uint8_t *tx, uint8_t *rx, uint8_t length) {
+    for (uint8_t i = 0; i < length; i++) {
+      if (_start) {
+        _read = tx[i] & 0x80;
+        _start = false;
+      }
+      if (_read)
+        Count(tx[i]);
+    }
+    MFRC522Sim::Transfer(tx, rx, length);
+  }
+
+  uint32_t GetIrqReads() const { return _irqReads; }
+  void ResetIrqReads() { _irqReads = 0; }
+
+private:
+  void Count(uint8_t address) {
+    if (address == MFRC522::ReadAddress(MFRC522::ComIrqReg) ||
+        address == MFRC522::ReadAddress(MFRC522::DivIrqReg))
+      _irqReads++;
+  }
+
+  bool _start;
+  bool _read;
+  uint32_t _irqReads;
+};
+
+struct Result {
+  uint32_t irqReads;
+  uint32_t spiBytes;
+  uint64_t timeUs;
+};
+
+// REQA, select, authenticate and read one block, then a REQA into an empty
+// field that has to run into the chip timer.
+void Run(bool irq, Result *card, Result *empty) {
+  CountingSim sim;
+  sim.SetIrqConnected(irq);
+  uint8_t uid[4] = {0x10, 0x20, 0x30, 0x40};
+  MifareClassicSim classic(uid);
+  sim.AddCard(&classic);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+
+  sim.ResetIrqReads();
+  uint32_t bytes = sim.GetSpiBytes();
+  uint64_t time = sim.GetTimeUs();
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  MFRC522::MIFARE_Key key;
+  memset(key.keyByte, 0xFF, sizeof(key.keyByte));
+  CHECK(rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 4, &key,
+                              &rfid.uid) == MFRC522::STATUS_OK);
+  uint8_t buffer[18];
+  uint8_t size = sizeof(buffer);
+  CHECK(rfid.MIFARE_Read(4, buffer, &size) == MFRC522::STATUS_OK);
+  card->irqReads = sim.GetIrqReads();
+  card->spiBytes = sim.GetSpiBytes() - bytes;
+  card->timeUs = sim.GetTimeUs() - time;
+
+  rfid.PICC_HaltA();
+  rfid.PCD_StopCrypto1();
+  sim.RemoveCard(&classic);
+  sim.ResetIrqReads();
+  bytes = sim.GetSpiBytes();
+  time = sim.GetTimeUs();
+  CHECK(!rfid.PICC_IsNewCardPresent());
+  empty->irqReads = sim.GetIrqReads();
+  empty->spiBytes = sim.GetSpiBytes() - bytes;
+  empty->timeUs = sim.GetTimeUs() - time;
+}
+
+void Print(const char *name, const Result &result) {
+  printf("  %-22s %5u IRQ register reads %6u SPI bytes %6llu us\n", name,
+         result.irqReads, result.spiBytes,
+         (unsigned long long)result.timeUs);
+}
+
+} // namespace
+
+int main() {
+  Result irqCard, irqEmpty, polledCard, polledEmpty;
+  Run(true, &irqCard, &irqEmpty);
+  Run(false, &polledCard, &polledEmpty);
+
+  printf("IRQ line connected, 1 MHz SPI\n");
+  Print("select, auth, read", irqCard);
+  Print("REQA, empty field", irqEmpty);
+  printf("IRQ registers polled, 1 MHz SPI\n");
+  Print("select, auth, read", polledCard);
+  Print("REQA, empty field", polledEmpty);
+
+  // With the line connected each command reads ComIrqReg once when it
+  // wakes, instead of once per loop turn.
+  CHECK(irqCard.irqReads * 4 < polledCard.irqReads);
+  CHECK(irqEmpty.irqReads <= 2);
+  CHECK(irqCard.spiBytes < polledCard.spiBytes);
+  return CheckResult();
+}
@@ -0,0 +1,153 @@
+// MFRC522IsoDep against IsoDepSim at every bit rate, with and without a
+// CID: READ BINARY of the 4 KB file, command chaining, waiting time
+// extensions, lost answers and DESELECT. An ATS cut short after T0 is read
+// with its interface bytes at their defaults.
+
+#include "Check.h"
+#include "IsoDepSim.h"
+#include "MFRC522.h"
+#include "MFRC522IsoDep.h"
+#include "MFRC522Sim.h"
+
+#include <string.h>
+
+namespace {
+
+// A card whose ATS can be cut to TL and T0, with T0 still announcing TA(1).
+class ShortAtsCard : public IsoDepSim {
+public:
+  ShortAtsCard(const uint8_t *uid) : IsoDepSim(uid), _short(false) {}
+
+  void SetShortAts(bool cut) { _short = cut; }
+
+protected:
+  virtual bool Process(const Frame &request, Frame *response) {
+    bool rats = !IsProtocolActive() && request.data[0] == 0xE0;
+    bool result = IsoDepSim::Process(request, response);
+    if (rats && _short && response->bits) {
+      uint8_t ats[2] = {2, 0x78};
+      SetBytes(response, ats, sizeof(ats));
+      AppendCRC(response);
+    }
+    return result;
+  }
+
+private:
+  bool _short;
+};
+
+// The second activation gets a 2 byte ATS whose T0 claims TA(1). The bit
+// rates of the first ATS must not be taken for it, so no PPS goes out.
+void ShortAts() {
+  MFRC522Sim sim(4000000);
+  uint8_t uid[7] = {0x04, 1, 2, 3, 4, 5, 7};
+  ShortAtsCard card(uid);
+  sim.AddCard(&card);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  MFRC522IsoDep isoDep(rfid);
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  CHECK(isoDep.Activate(0, MFRC522IsoDep::BITRATE_424) == MFRC522::STATUS_OK);
+  CHECK(isoDep.GetTxBitRate() == MFRC522IsoDep::BITRATE_424);
+  CHECK(isoDep.Deselect() == MFRC522::STATUS_OK);
+
+  card.SetShortAts(true);
+  uint8_t atqa[2];
+  uint8_t size = sizeof(atqa);
+  CHECK(rfid.PICC_WakeupA(atqa, &size) == MFRC522::STATUS_OK);
+  CHECK(rfid.PICC_ReadCardSerial());
+  CHECK(isoDep.Activate(0, MFRC522IsoDep::BITRATE_424) == MFRC522::STATUS_OK);
+  CHECK(isoDep.GetTxBitRate() == MFRC522IsoDep::BITRATE_106 &&
+        isoDep.GetRxBitRate() == MFRC522IsoDep::BITRATE_106);
+  CHECK(card.GetRxSpeed() == 0 && card.GetTxSpeed() == 0);
+}
+
+void Run(uint8_t cid, MFRC522IsoDep::BitRate rate) {
+  MFRC522Sim sim(4000000);
+  uint8_t uid[7] = {0x04, 1, 2, 3, 4, 5, 6};
+  IsoDepSim card(uid);
+  sim.AddCard(&card);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  CHECK(MFRC522::PICC_GetType(rfid.uid.sak) == PICC_TYPE_ISO_14443_4);
+
+  MFRC522IsoDep isoDep(rfid);
+  CHECK(isoDep.Activate(cid, rate) == MFRC522::STATUS_OK);
+  CHECK(isoDep.GetTxBitRate() == rate && isoDep.GetRxBitRate() == rate);
+  CHECK(card.GetRxSpeed() == rate && card.GetTxSpeed() == rate);
+
+  uint8_t select[] = {0x00, 0xA4, 0x04, 0x00, 0x02, 0x3F, 0x00};
+  uint8_t response[300];
+  uint16_t length = sizeof(response);
+  CHECK(isoDep.Transceive(select, sizeof(select), response, &length) ==
+            MFRC522::STATUS_OK &&
+        length == 2 && response[0] == 0x90);
+
+  uint64_t start = sim.GetTimeUs();
+  bool ok = true;
+  for (uint16_t offset = 0; offset < 4096; offset += 256) {
+    uint8_t read[] = {0x00, 0xB0, (uint8_t)(offset >> 8), (uint8_t)offset,
+                      0x00};
+    length = sizeof(response);
+    ok = ok &&
+         isoDep.Transceive(read, sizeof(read), response, &length) ==
+             MFRC522::STATUS_OK &&
+         length == 258 && memcmp(response, card.GetFile() + offset, 256) == 0;
+  }
+  CHECK(ok);
+  uint64_t elapsed = sim.GetTimeUs() - start;
+  printf("  CID %u, %3u kbit/s: 4096 bytes in %5.1f ms, %4.1f kB/s\n", cid,
+         106 << rate, elapsed / 1000.0, 4096.0 * 1000 / elapsed);
+
+  // A 200-byte UPDATE BINARY goes out chained.
+  uint8_t update[205] = {0x00, 0xD6, 0x01, 0x00, 200};
+  for (uint8_t i = 0; i < 200; i++)
+    update[5 + i] = 0xA5 ^ i;
+  length = sizeof(response);
+  CHECK(isoDep.Transceive(update, sizeof(update), response, &length) ==
+            MFRC522::STATUS_OK &&
+        length == 2 && response[0] == 0x90);
+  CHECK(memcmp(card.GetFile() + 256, update + 5, 200) == 0);
+
+  // A slow command asks for more time once.
+  card.SetProcessingCycles(3000000);
+  uint8_t read16[] = {0x00, 0xB0, 0x00, 0x00, 16};
+  length = sizeof(response);
+  CHECK(isoDep.Transceive(read16, sizeof(read16), response, &length) ==
+            MFRC522::STATUS_OK &&
+        length == 18 && isoDep.GetWtxCount() == 1);
+  card.SetProcessingCycles(0);
+
+  // One and two lost answers are recovered with R(NAK).
+  for (uint8_t drops = 1; drops <= 2; drops++) {
+    card.DropAnswers(drops);
+    uint8_t read[] = {0x00, 0xB0, 0x00, 0x00, 0x00};
+    length = sizeof(response);
+    CHECK(isoDep.Transceive(read, sizeof(read), response, &length) ==
+              MFRC522::STATUS_OK &&
+          length == 258 && memcmp(response, card.GetFile(), 256) == 0);
+  }
+  CHECK(isoDep.GetRetryCount() >= 3);
+
+  CHECK(isoDep.Deselect() == MFRC522::STATUS_OK &&
+        card.GetState() == PiccSim::STATE_HALT);
+  CHECK(!rfid.PICC_IsNewCardPresent());
+  uint8_t atqa[2];
+  uint8_t size = sizeof(atqa);
+  CHECK(rfid.PICC_WakeupA(atqa, &size) == MFRC522::STATUS_OK);
+}
+
+} // namespace
+
+int main() {
+  printf("READ BINARY Le 256, 4 MHz SPI, IRQ line connected\n");
+  for (uint8_t cid = 0; cid < 2; cid++) {
+    for (uint8_t rate = 0; rate < 4; rate++)
+      Run(cid ? 3 : 0, (MFRC522IsoDep::BitRate)rate);
+  }
+  ShortAts();
+  return CheckResult();
+}
@@ -0,0 +1,130 @@
+// MFRC522KeyDictionary against a naive try-every-key loop on a 1K card
+// whose sectors 0-7 open with key A of the fourth key and sectors 8-15
+// with key B of the sixth.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522KeyDictionary.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+const uint8_t KEYS = 6;
+const uint8_t SECTORS = 16;
+
+MFRC522::MIFARE_Key keys[KEYS];
+
+void SetUp(MifareClassicSim &card) {
+  for (uint8_t k = 0; k < KEYS; k++)
+    memset(keys[k].keyByte, 0x10 * (k + 1), sizeof(keys[k].keyByte));
+  for (uint8_t sector = 0; sector < SECTORS; sector++) {
+    uint8_t trailer[16];
+    card.ReadBlock(sector * 4 + 3, trailer);
+    if (sector < 8) {
+      memcpy(trailer, keys[3].keyByte, 6);
+      memset(trailer + 10, 0x99, 6);
+    } else {
+      memset(trailer, 0x77, 6);
+      memcpy(trailer + 10, keys[5].keyByte, 6);
+    }
+    card.WriteBlock(sector * 4 + 3, trailer);
+  }
+}
+
+// Wakes and selects the card again, as a new tap would.
+bool Tap(MFRC522 &rfid) {
+  rfid.PICC_HaltA();
+  rfid.PCD_StopCrypto1();
+  uint8_t atqa[2];
+  uint8_t size = sizeof(atqa);
+  return rfid.PICC_WakeupA(atqa, &size) == MFRC522::STATUS_OK &&
+         rfid.PICC_ReadCardSerial();
+}
+
+} // namespace
+
+int main() {
+  MFRC522Sim sim(4000000);
+  uint8_t uid[4] = {0xAB, 0xCD, 0x12, 0x34};
+  MifareClassicSim card(uid);
+  SetUp(card);
+  sim.AddCard(&card);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  printf("16 sectors of a 1K card, 6 keys, 4 MHz SPI\n");
+
+  // Every key as A, then as B, with a halt, WUPA and select per failure.
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  uint32_t attempts = 0;
+  uint64_t start = sim.GetTimeUs();
+  for (uint8_t sector = 0; sector < SECTORS; sector++) {
+    bool ok = false;
+    for (uint8_t k = 0; k < KEYS && !ok; k++) {
+      for (uint8_t type = 0; type < 2 && !ok; type++) {
+        attempts++;
+        uint8_t command = type ? MFRC522::PICC_CMD_MF_AUTH_KEY_B
+                               : MFRC522::PICC_CMD_MF_AUTH_KEY_A;
+        ok = rfid.PCD_Authenticate(command, sector * 4 + 3, &keys[k],
+                                   &rfid.uid) == MFRC522::STATUS_OK;
+        if (!ok)
+          CHECK(Tap(rfid));
+      }
+    }
+    CHECK(ok);
+  }
+  printf("  naive loop          %3u auths %7.1f ms\n", attempts,
+         (sim.GetTimeUs() - start) / 1000.0);
+
+  MFRC522KeyDictionary dictionary(rfid);
+  for (uint8_t k = 0; k < KEYS; k++)
+    CHECK(dictionary.AddKey(keys[k]));
+  for (uint8_t tap = 0; tap < 2; tap++) {
+    CHECK(Tap(rfid));
+    dictionary.ResetCounters();
+    start = sim.GetTimeUs();
+    for (uint8_t sector = 0; sector < SECTORS; sector++) {
+      uint8_t command = 0;
+      CHECK(dictionary.Authenticate(&rfid.uid, sector, NULL, &command) ==
+            MFRC522::STATUS_OK);
+      CHECK(command == (sector < 8 ? MFRC522::PICC_CMD_MF_AUTH_KEY_A
+                                   : MFRC522::PICC_CMD_MF_AUTH_KEY_B));
+      uint8_t buffer[18];
+      uint8_t size = sizeof(buffer);
+      CHECK(rfid.MIFARE_Read(sector * 4, buffer, &size) ==
+            MFRC522::STATUS_OK);
+    }
+    printf("  dictionary, %s %3u auths %7.1f ms, %u reselects\n",
+           tap ? "repeat" : "first ", dictionary.GetAttemptCount(),
+           (sim.GetTimeUs() - start) / 1000.0,
+           dictionary.GetReselectCount());
+    if (tap)
+      CHECK(dictionary.GetAttemptCount() == SECTORS);
+  }
+
+  // A sector no key opens fails, and the card is still usable after it.
+  uint8_t trailer[16];
+  card.ReadBlock(7, trailer);
+  memset(trailer, 0x42, 6);
+  memset(trailer + 10, 0x42, 6);
+  card.WriteBlock(7, trailer);
+  CHECK(Tap(rfid));
+  CHECK(dictionary.Authenticate(&rfid.uid, 1) == MFRC522::STATUS_TIMEOUT);
+  CHECK(dictionary.Authenticate(&rfid.uid, 2) == MFRC522::STATUS_OK);
+
+  // Eight other cards push this one out of the cache; it then needs the
+  // search again.
+  for (uint8_t i = 0; i < 8; i++) {
+    MFRC522::Uid other = rfid.uid;
+    other.uidByte[0] = i;
+    dictionary.Authenticate(&other, 0);
+  }
+  CHECK(Tap(rfid));
+  dictionary.ResetCounters();
+  CHECK(dictionary.Authenticate(&rfid.uid, 9) == MFRC522::STATUS_OK);
+  CHECK(dictionary.GetAttemptCount() > 1);
+  return CheckResult();
+}
@@ -0,0 +1,170 @@
+// DisplayLabel against the status lines as main drew them before: 40 spaces
+// and then the whole text on every call. Bus bytes per update on the emWin
+// model, with the labels refreshed through DisplayRefresh at the app's
+// default band budget as main does, and checks that what the labels leave on
+// the panel is exactly what a full redraw draws.
+
+#include "Check.h"
+#include "DisplayLabel.h"
+#include "DisplayRefresh.h"
+#include "EmWinSim.h"
+
+#include <stdio.h>
+
+namespace {
+
+const uint32_t BAND_BYTES = 10240;      // display-band-bytes in mbed_app.json
+const char *SPACES = "                                        ";
+
+const char *title = "RFID Reader System";
+
+// main's draw function.
+void Draw(const GUI_RECT &area) {
+  GUI_SetBkColor(GUI_BLACK);
+  GUI_ClearRect(area.x0, area.y0, area.x1, area.y1);
+  if (area.y0 < GUI_GetYSizeOfFont(GUI_FONT_16B_1)) {
+    GUI_SetFont(GUI_FONT_16B_1);
+    GUI_SetColor(GUI_WHITE);
+    GUI_SetTextAlign(GUI_TA_HCENTER);
+    GUI_DispStringAt(title, LCD_GetXSize() / 2, 0);
+    GUI_SetTextAlign(GUI_TA_LEFT);
+  }
+  DisplayLabel::DrawAll(area);
+}
+
+DisplayRefresh refresh(Draw, BAND_BYTES);
+DisplayLabel statusLabel(refresh, "status", 0, 40, GUI_FONT_16B_1, GUI_WHITE);
+DisplayLabel uidLabel(refresh, "uid", 0, 80, GUI_FONT_16B_1, GUI_GREEN);
+DisplayLabel typeLabel(refresh, "type", 0, 100, GUI_FONT_16B_1, GUI_GREEN);
+DisplayLabel mqttLabel(refresh, "mqtt", 0, 140, GUI_FONT_13B_1, GUI_YELLOW);
+DisplayLabel countLabel(refresh, "count", 0, 180, GUI_FONT_16B_1, GUI_CYAN);
+
+// The status lines as main drew them before the labels.
+void OldLine(const GUI_FONT *font, GUI_COLOR color, int y, const char *text) {
+  GUI_SetFont(font);
+  GUI_SetColor(color);
+  GUI_DispStringAt(SPACES, 0, y);
+  GUI_DispStringAt(text, 0, y);
+}
+
+struct Update {
+  const char *name;
+  const char *label;      // NULL for a card, which sets uid and type
+  const char *text;
+  const char *type;
+  const char *from;       // set first and not counted, if not NULL
+};
+
+const Update UPDATES[] = {
+    {"status -> Card detected!", "status", "Card detected!", NULL, NULL},
+    {"card A shown", NULL, "UID: 04A1B2C3", "MIFARE 1KB", NULL},
+    {"count 0 -> 1", "count", "Cards scanned: 1", NULL, NULL},
+    {"MQTT -> Sent to MQTT", "mqtt", "Sent to MQTT", NULL, NULL},
+    {"status -> Waiting...", "status", "Waiting for card...", NULL, NULL},
+    {"status -> Card detected!", "status", "Card detected!", NULL, NULL},
+    {"next card, same type", NULL, "UID: 04A1B2D7", "MIFARE 1KB", NULL},
+    {"count 1 -> 2", "count", "Cards scanned: 2", NULL, NULL},
+    {"MQTT text unchanged", "mqtt", "Sent to MQTT", NULL, NULL},
+    {"count 9 -> 10", "count", "Cards scanned: 10", NULL, "Cards scanned: 9"},
+    {"status unchanged", "status", "Card detected!", NULL, NULL},
+};
+const int UPDATE_COUNT = sizeof(UPDATES) / sizeof(UPDATES[0]);
+
+void Old(const Update &update) {
+  if (!update.label) {
+    OldLine(GUI_FONT_16B_1, GUI_GREEN, 80, update.text);
+    OldLine(GUI_FONT_16B_1, GUI_GREEN, 100, update.type);
+  } else if (strcmp(update.label, "mqtt") == 0) {
+    OldLine(GUI_FONT_13B_1, GUI_YELLOW, 140, update.text);
+  } else if (strcmp(update.label, "count") == 0) {
+    OldLine(GUI_FONT_16B_1, GUI_CYAN, 180, update.text);
+  } else {
+    OldLine(GUI_FONT_16B_1, GUI_WHITE, 40, update.text);
+  }
+}
+
+void New(const Update &update) {
+  if (!update.label) {
+    uidLabel.SetText(update.text);
+    typeLabel.SetText(update.type);
+  } else {
+    DisplayLabel::Find(update.label)->SetText(update.text);
+  }
+  refresh.Flush();
+}
+
+// The same labels drawn from scratch on a fresh panel.
+uint64_t FullRedraw() {
+  EmWinSim::Get().SetSize(320, 240);
+  refresh.InvalidateAll();
+  refresh.Flush();
+  return EmWinSim::Get().GetChecksum();
+}
+
+} // namespace
+
+int main() {
+  EmWinSim &emWin = EmWinSim::Get();
+  uint32_t before[UPDATE_COUNT], after[UPDATE_COUNT];
+
+  GUI_Init();
+  GUI_Clear();
+  GUI_SetTextAlign(GUI_TA_HCENTER);
+  GUI_DispStringAt(title, LCD_GetXSize() / 2, 0);
+  GUI_SetTextAlign(GUI_TA_LEFT);
+  OldLine(GUI_FONT_16B_1, GUI_WHITE, 40, "Waiting for card...");
+  OldLine(GUI_FONT_16B_1, GUI_CYAN, 180, "Cards scanned: 0");
+  OldLine(GUI_FONT_13B_1, GUI_YELLOW, 140, "MQTT connected!");
+  for (int i = 0; i < UPDATE_COUNT; i++) {
+    if (UPDATES[i].from)
+      Old({NULL, "count", UPDATES[i].from, NULL, NULL});
+    uint32_t start = emWin.GetBusBytes();
+    Old(UPDATES[i]);
+    before[i] = emWin.GetBusBytes() - start;
+  }
+
+  GUI_Init();
+  statusLabel.SetText("Waiting for card...");
+  countLabel.SetText("Cards scanned: 0");
+  mqttLabel.SetText("MQTT connected!");
+  refresh.InvalidateAll();
+  refresh.Flush();
+  for (int i = 0; i < UPDATE_COUNT; i++) {
+    if (UPDATES[i].from) {
+      countLabel.SetText(UPDATES[i].from);
+      refresh.Flush();
+    }
+    uint32_t start = emWin.GetBusBytes();
+    New(UPDATES[i]);
+    after[i] = emWin.GetBusBytes() - start;
+  }
+  uint64_t retained = emWin.GetChecksum();
+  CHECK(retained == FullRedraw());
+
+  printf("Bus bytes per update\n");
+  printf("  %-26s %7s %7s\n", "update", "before", "after");
+  uint32_t totalBefore = 0, totalAfter = 0;
+  for (int i = 0; i < UPDATE_COUNT; i++) {
+    printf("  %-26s %7u %7u\n", UPDATES[i].name, before[i], after[i]);
+    totalBefore += before[i];
+    totalAfter += after[i];
+    CHECK(after[i] <= before[i]);
+  }
+  printf("  %-26s %7u %7u\n", "total", totalBefore, totalAfter);
+  // Unchanged text sends nothing.
+  CHECK(after[8] == 0 && after[10] == 0);
+
+  // A colour change redraws every glyph; ResetAll empties every label.
+  uint32_t glyphs = statusLabel.GetGlyphsDrawn();
+  statusLabel.SetColor(GUI_GREEN);
+  refresh.Flush();
+  CHECK(statusLabel.GetGlyphsDrawn() - glyphs == strlen("Card detected!"));
+  CHECK(DisplayLabel::Find("mqtt") == &mqttLabel);
+  CHECK(DisplayLabel::Find("none") == NULL);
+  DisplayLabel::ResetAll();
+  refresh.Flush();
+  CHECK(strcmp(countLabel.GetText(), "") == 0);
+  retained = emWin.GetChecksum();
+  CHECK(retained == FullRedraw());
+  return CheckResult();
+}
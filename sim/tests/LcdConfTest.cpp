@@ -0,0 +1,215 @@
+// LCDConf on the emWin model: the fill and blit handlers it registers, XOR
+// fills through the driver's own fill, the generic paths it keeps when the
+// driver refuses a handler, and the window it sends checked against a model
+// of the ST7789 frame memory addressing under the MADCTL it sets.
+
+#include "Check.h"
+#include "EmWinSim.h"
+#include "LCDConf.h"
+#include "TftBusSim.h"
+#include "cy8ckit_028_tft.h"
+
+#include <vector>
+
+namespace {
+
+const int PANEL_COLUMNS = 240;
+const int PANEL_ROWS = 320;
+
+// The ST7789 frame memory as the panel's columns and rows. CASET and RASET
+// bound the column and page counters, RAMWR writes pixels from the top left
+// of the window. MADCTL MV exchanges the counters; MX and MY then mirror the
+// panel's columns and rows.
+class Panel {
+public:
+  Panel() : gram(PANEL_COLUMNS * PANEL_ROWS, 0), _madctl(0), _command(0) {}
+
+  void Decode(const TftBusSim &bus) {
+    uint32_t count = bus.GetByteCount();
+    CHECK(count <= TftBusSim::MAX_LOG);
+    for (uint32_t i = 0; i < count && i < TftBusSim::MAX_LOG; i++)
+      Byte(bus.GetByte(i));
+  }
+
+  uint8_t GetMadctl() const { return _madctl; }
+
+  std::vector<U16> gram;
+
+private:
+  void Byte(const TftBusSim::Byte &byte) {
+    if (!byte.dc) {
+      _command = byte.value;
+      _count = 0;
+      if (_command == 0x2C) {
+        _column = _window[0];
+        _page = _window[2];
+      }
+      return;
+    }
+    switch (_command) {
+    case 0x36:
+      _madctl = byte.value;
+      break;
+    case 0x2A:
+    case 0x2B:
+      _address[_count % 4] = byte.value;
+      if (++_count == 4) {
+        int at = _command == 0x2A ? 0 : 2;
+        _window[at] = (_address[0] << 8) | _address[1];
+        _window[at + 1] = (_address[2] << 8) | _address[3];
+      }
+      break;
+    case 0x2C:
+      if (_count++ % 2 == 0) {
+        _high = byte.value;
+        break;
+      }
+      Write((U16)((_high << 8) | byte.value));
+      break;
+    }
+  }
+
+  void Write(U16 pixel) {
+    int column = _madctl & 0x20 ? _page : _column;
+    int row = _madctl & 0x20 ? _column : _page;
+    if (_madctl & 0x40)
+      column = PANEL_COLUMNS - 1 - column;
+    if (_madctl & 0x80)
+      row = PANEL_ROWS - 1 - row;
+    if (column >= 0 && column < PANEL_COLUMNS && row >= 0 && row < PANEL_ROWS)
+      gram[row * PANEL_COLUMNS + column] = pixel;
+    if (++_column > _window[1]) {
+      _column = _window[0];
+      _page++;
+    }
+  }
+
+  uint8_t _madctl;
+  uint8_t _command;
+  int _count;
+  uint8_t _address[4];
+  int _window[4];
+  int _column;
+  int _page;
+  uint8_t _high;
+};
+
+// Where emWin's orientation puts a logical pixel on the panel: GUI_SWAP_XY
+// exchanges the axes, GUI_MIRROR_X and GUI_MIRROR_Y then mirror the panel's
+// columns and rows. GUI_MIRROR_Y | GUI_SWAP_XY is GUI_ROTATION_CCW.
+void Physical(int orientation, int x, int y, int *column, int *row) {
+  *column = orientation & GUI_SWAP_XY ? y : x;
+  *row = orientation & GUI_SWAP_XY ? x : y;
+  if (orientation & GUI_MIRROR_X)
+    *column = PANEL_COLUMNS - 1 - *column;
+  if (orientation & GUI_MIRROR_Y)
+    *row = PANEL_ROWS - 1 - *row;
+}
+
+void Configure() {
+  GUI_Init();
+  LCD_X_Config();
+}
+
+void CheckOrientation(uint8_t madctl) {
+  EmWinSim &emWin = EmWinSim::Get();
+  TftBusSim &bus = TftBusSim::Get();
+  const GUI_RECT rects[] = {
+      {0, 0, 15, 15}, {300, 200, 319, 239}, {100, 7, 104, 9}, {0, 230, 3, 239}};
+  const GUI_COLOR colors[] = {GUI_RED, GUI_GREEN, GUI_BLUE, GUI_YELLOW};
+  for (int i = 0; i < 4; i++) {
+    const GUI_RECT &rect = rects[i];
+    Panel panel;
+    U16 index = EmWinSim::ColorToIndex(colors[i]);
+    bus.Reset();
+    DisplayIntf_Write8_A0(0x36);
+    DisplayIntf_Write8_A1(madctl);
+    GUI_SetColor(colors[i]);
+    GUI_FillRect(rect.x0, rect.y0, rect.x1, rect.y1);
+    panel.Decode(bus);
+
+    std::vector<U16> expected(PANEL_COLUMNS * PANEL_ROWS, 0);
+    for (int y = rect.y0; y <= rect.y1; y++) {
+      for (int x = rect.x0; x <= rect.x1; x++) {
+        int column, row;
+        Physical(emWin.GetOrientation(), x, y, &column, &row);
+        expected[row * PANEL_COLUMNS + column] = index;
+      }
+    }
+    CHECK(panel.gram == expected);
+  }
+}
+
+} // namespace
+
+int main() {
+  EmWinSim &emWin = EmWinSim::Get();
+  TftBusSim &bus = TftBusSim::Get();
+
+  Configure();
+  CHECK(emWin.HasPortApi());
+  CHECK(emWin.GetOrientation() == (GUI_MIRROR_Y | GUI_SWAP_XY));
+  CHECK(LCDConf_GetAccel() ==
+        (LCDCONF_ACCEL_FILLRECT | LCDCONF_ACCEL_DRAWBMP_16BPP));
+
+  // The MADCTL the controller initialisation sends last is the one in force.
+  bus.Reset();
+  CHECK(LCD_X_DisplayDriver(0, LCD_X_INITCONTROLLER, NULL) == 0);
+  Panel init;
+  init.Decode(bus);
+  printf("MADCTL 0x%02X for GUI_MIRROR_Y | GUI_SWAP_XY\n", init.GetMadctl());
+  CHECK(init.GetMadctl() == 0xA0);
+  CheckOrientation(init.GetMadctl());
+
+  // Normal fills go to the bus through one window, not to the driver.
+  uint32_t driverFills = emWin.GetDriverFills();
+  bus.Reset();
+  GUI_SetColor(GUI_WHITE);
+  GUI_FillRect(10, 10, 19, 19);
+  GUI_ClearRect(10, 10, 19, 19);
+  CHECK(bus.GetByteCount() == 2 * (11 + 200));
+  CHECK(emWin.GetDriverFills() == driverFills);
+
+  // XOR fills go to the driver's fill and leave the handler in place.
+  GUI_SetColor(GUI_BLACK);
+  GUI_FillRect(0, 0, 3, 3);
+  GUI_SetDrawMode(GUI_DM_XOR);
+  bus.Reset();
+  GUI_FillRect(0, 0, 1, 1);
+  CHECK(bus.GetByteCount() == 0);
+  CHECK(emWin.GetDriverFills() == driverFills + 1);
+  GUI_SetDrawMode(GUI_DM_NORMAL);
+  GUI_FillRect(0, 0, 1, 1);
+  CHECK(bus.GetByteCount() == 11 + 8);
+  CHECK(emWin.GetDriverFills() == driverFills + 1);
+  printf("XOR fill: driver fill, handler still registered\n");
+
+  // GUI_DrawBitmap of an M565 bitmap reaches the blit handler: one window.
+  static U16 pixels[32 * 32];
+  const GUI_BITMAP bitmap = {32, 32, 32 * 2, 16, (const U8 *)pixels, NULL,
+                             GUI_DRAW_BMPM565};
+  bus.Reset();
+  GUI_DrawBitmap(&bitmap, 40, 50);
+  CHECK(bus.GetByteCount() == 11 + 32 * 32 * 2);
+  CHECK(emWin.GetDriverBitmaps() == 0);
+
+  // A driver that refuses a handler keeps its generic path.
+  GUI_Init();
+  emWin.RefuseDevFunc(LCD_DEVFUNC_FILLRECT);
+  LCD_X_Config();
+  CHECK(LCDConf_GetAccel() == LCDCONF_ACCEL_DRAWBMP_16BPP);
+  bus.Reset();
+  GUI_FillRect(0, 0, 9, 9);
+  CHECK(bus.GetByteCount() == 0);
+  CHECK(emWin.GetDriverFills() == 1);
+  GUI_Init();
+  emWin.RefuseDevFunc(LCD_DEVFUNC_DRAWBMP_16BPP);
+  LCD_X_Config();
+  CHECK(LCDConf_GetAccel() == LCDCONF_ACCEL_FILLRECT);
+  bus.Reset();
+  GUI_DrawBitmap(&bitmap, 40, 50);
+  CHECK(bus.GetByteCount() == 0);
+  CHECK(emWin.GetDriverBitmaps() == 1);
+  printf("Refused handlers: generic paths kept, LCDConf_GetAccel reports it\n");
+  return CheckResult();
+}
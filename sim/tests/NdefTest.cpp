@@ -0,0 +1,146 @@
+// MIFARE_UltralightReadNdef and NdefParser on an NTAG213 holding a badge
+// text record, against reading the whole user area.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "NdefParser.h"
+#include "UltralightSim.h"
+
+#include <string.h>
+
+namespace {
+
+void Store(UltralightSim &tag, const uint8_t *data, int length) {
+  uint8_t buffer[256] = {0};
+  memcpy(buffer, data, length);
+  for (int page = 0; page * 4 < length + 4; page++)
+    tag.WritePage(4 + page, &buffer[page * 4]);
+}
+
+// A lock control TLV, then an NDEF message with a text record and, with
+// extra, a 100-byte URI record after it.
+int Build(uint8_t *out, const char *text, bool extra) {
+  uint8_t record[200];
+  int r = 0;
+  int length = strlen(text);
+  record[r++] = extra ? 0x91 : 0xD1;
+  record[r++] = 1;
+  record[r++] = 3 + length;
+  record[r++] = 'T';
+  record[r++] = 2;
+  record[r++] = 'e';
+  record[r++] = 'n';
+  memcpy(&record[r], text, length);
+  r += length;
+  if (extra) {
+    record[r++] = 0x51;
+    record[r++] = 1;
+    record[r++] = 100;
+    record[r++] = 'U';
+    record[r++] = 4;
+    memset(&record[r], 'a', 99);
+    r += 99;
+  }
+
+  int n = 0;
+  const uint8_t lockControl[] = {0x01, 0x03, 0xA0, 0x0C, 0x34};
+  memcpy(out, lockControl, sizeof(lockControl));
+  n += sizeof(lockControl);
+  out[n++] = 0x03;
+  out[n++] = r;
+  memcpy(&out[n], record, r);
+  n += r;
+  out[n++] = 0xFE;
+  return n;
+}
+
+struct StopAtText {
+  int seen;
+  bool Record(const NdefParser::Record &record) {
+    seen++;
+    return !NdefParser::IsTextRecord(record);
+  }
+};
+
+} // namespace
+
+int main() {
+  MFRC522Sim sim(4000000);
+  uint8_t uid[7] = {0x04, 1, 2, 3, 4, 5, 6};
+  UltralightSim tag(uid, UltralightSim::MODEL_NTAG213);
+  uint8_t message[256];
+  Store(tag, message, Build(message, "Badge 00042", false));
+  sim.AddCard(&tag);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  printf("NTAG213, 4 MHz SPI\n");
+
+  // The 36 user pages, four per READ and fifteen per FAST_READ.
+  uint64_t start = sim.GetTimeUs();
+  for (uint8_t page = 4; page < 40; page += 4) {
+    uint8_t buffer[18];
+    uint8_t size = sizeof(buffer);
+    CHECK(rfid.MIFARE_Read(page, buffer, &size) == MFRC522::STATUS_OK);
+  }
+  printf("  user area, READ       %5.2f ms\n",
+         (sim.GetTimeUs() - start) / 1000.0);
+  start = sim.GetTimeUs();
+  for (uint8_t page = 4; page < 40; page += 15) {
+    uint8_t end = page + 14 > 39 ? 39 : page + 14;
+    uint8_t buffer[64];
+    uint8_t size = sizeof(buffer);
+    CHECK(rfid.MIFARE_UltralightFastRead(page, end, buffer, &size) ==
+              MFRC522::STATUS_OK &&
+          size == (end - page + 1) * 4 + 2);
+  }
+  printf("  user area, FAST_READ  %5.2f ms\n",
+         (sim.GetTimeUs() - start) / 1000.0);
+
+  NdefParser parser;
+  char text[40];
+  start = sim.GetTimeUs();
+  uint32_t frames = sim.GetRfFrames();
+  CHECK(rfid.MIFARE_UltralightReadNdef(&parser) == MFRC522::STATUS_OK);
+  printf("  NDEF, FAST_READ       %5.2f ms, %u RF frames\n",
+         (sim.GetTimeUs() - start) / 1000.0, sim.GetRfFrames() - frames);
+  CHECK(parser.IsDone() && !parser.HasError() &&
+        parser.GetRecordCount() == 1);
+  CHECK(NdefParser::GetText(parser.GetRecord(), text, sizeof(text)) &&
+        strcmp(text, "Badge 00042") == 0);
+  start = sim.GetTimeUs();
+  CHECK(rfid.MIFARE_UltralightReadNdef(&parser, false) == MFRC522::STATUS_OK);
+  printf("  NDEF, READ            %5.2f ms\n",
+         (sim.GetTimeUs() - start) / 1000.0);
+  CHECK(NdefParser::GetText(parser.GetRecord(), text, sizeof(text)) &&
+        strcmp(text, "Badge 00042") == 0);
+
+  // The callback stops the read once the text record is in.
+  Store(tag, message, Build(message, "Badge 7", true));
+  StopAtText stop = {0};
+  parser.SetRecordCallback(callback(&stop, &StopAtText::Record));
+  start = sim.GetTimeUs();
+  CHECK(rfid.MIFARE_UltralightReadNdef(&parser) == MFRC522::STATUS_OK);
+  printf("  NDEF, stop at text    %5.2f ms\n",
+         (sim.GetTimeUs() - start) / 1000.0);
+  CHECK(stop.seen == 1 && parser.IsDone());
+  parser.SetRecordCallback(Callback<bool(const NdefParser::Record &)>());
+  CHECK(rfid.MIFARE_UltralightReadNdef(&parser) == MFRC522::STATUS_OK);
+  CHECK(parser.GetRecordCount() == 2 &&
+        parser.GetRecord().payloadLength == 100 &&
+        parser.GetRecord().type[0] == 'U');
+
+  // The three-byte TLV length form, fed in pieces, and a record running
+  // past the end of its TLV.
+  uint8_t tlv[] = {0x03, 0xFF, 0x00, 0x04, 0xD1, 0x01, 0x05, 'T'};
+  NdefParser pieces;
+  CHECK(!pieces.Feed(tlv, sizeof(tlv)) && pieces.HasError());
+  tlv[3] = 9;
+  pieces.Reset();
+  uint8_t rest[] = {0x02, 'e', 'n', 'h', 'i'};
+  CHECK(pieces.Feed(tlv, sizeof(tlv)) && !pieces.Feed(rest, sizeof(rest)) &&
+        !pieces.HasError() && pieces.GetRecordCount() == 1);
+  return CheckResult();
+}
@@ -0,0 +1,242 @@
+// MFRC522PollScheduler against a fixed 100 ms polling loop on replayed
+// traffic: two busy periods with a tap every few seconds around a quiet
+// spell of ten minutes. Reports detect latency, field duty and probes.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522PollScheduler.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+const int MAX_TAPS = 400;
+// A tap further than this from the previous one counts as a quiet one.
+const uint64_t QUIET_GAP_US = 20000000;
+
+struct Tap {
+  uint64_t at;
+  uint64_t dwell;
+};
+
+Tap taps[MAX_TAPS];
+int tapCount;
+
+uint32_t seed = 12345;
+uint32_t Random(uint32_t range) {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % range;
+}
+
+void MakeTraffic() {
+  uint64_t t = 2000000;
+  tapCount = 0;
+  // 90 s busy, a tap every 1.2 to 3.7 s.
+  while (t < 92000000) {
+    taps[tapCount++] = {t, 300000 + Random(400000)};
+    t += 1200000 + Random(2500000);
+  }
+  // Ten minutes with six taps.
+  for (int i = 0; i < 6; i++) {
+    t += 60000000 + Random(60000000);
+    taps[tapCount++] = {t, 400000};
+  }
+  // 60 s busy again.
+  uint64_t end = t + 60000000;
+  t += 5000000;
+  while (t < end) {
+    taps[tapCount++] = {t, 300000 + Random(400000)};
+    t += 1200000 + Random(2500000);
+  }
+}
+
+// The simulator with cards coming and going as the traffic says.
+class Field {
+public:
+  Field() : _sim(4000000), _rfid(&_sim), _next(0), _present(-1), _leaveAt(0) {
+    _rfid.PCD_Init();
+  }
+  ~Field() {
+    if (_present >= 0)
+      _sim.RemoveCard(_cards[_present]);
+    for (int i = 0; i < _next; i++)
+      delete _cards[i];
+  }
+
+  MFRC522Sim &Sim() { return _sim; }
+  MFRC522 &Rfid() { return _rfid; }
+  int Present() const { return _present; }
+
+  void Update() {
+    uint64_t now = _sim.GetTimeUs();
+    if (_present >= 0 && now >= _leaveAt) {
+      _sim.RemoveCard(_cards[_present]);
+      _present = -1;
+    }
+    if (_present < 0 && _next < tapCount && now >= taps[_next].at) {
+      uint8_t uid[4] = {0xC0, (uint8_t)(_next >> 8), (uint8_t)_next, 0x11};
+      _cards[_next] = new MifareClassicSim(uid);
+      _sim.AddCard(_cards[_next]);
+      _present = _next;
+      _leaveAt = taps[_next].at + taps[_next].dwell;
+      _next++;
+    }
+  }
+
+  // Lets time pass, stopping at every arrival and departure.
+  void Wait(uint64_t us) {
+    uint64_t until = _sim.GetTimeUs() + us;
+    while (_sim.GetTimeUs() < until) {
+      uint64_t now = _sim.GetTimeUs();
+      uint64_t event = _present >= 0       ? _leaveAt
+                       : _next < tapCount ? taps[_next].at
+                                          : UINT64_MAX;
+      uint64_t step = until - now;
+      if (event > now && event - now < step)
+        step = event - now;
+      _sim.DelayUs(event <= now ? 1 : step);
+      Update();
+    }
+  }
+
+private:
+  MFRC522Sim _sim;
+  MFRC522 _rfid;
+  MifareClassicSim *_cards[MAX_TAPS];
+  int _next;
+  int _present;
+  uint64_t _leaveAt;
+};
+
+struct Result {
+  double busyAverage, busyMax, quietAverage, quietMax;
+  double fieldPercent;
+  int detected;
+  uint32_t probes;
+};
+
+// settleUs 0 runs the fixed loop: PICC_IsNewCardPresent every 100 ms with
+// the field always on.
+Result Run(uint32_t settleUs) {
+  Field field;
+  MFRC522 &rfid = field.Rfid();
+  MFRC522PollScheduler scheduler(rfid);
+  bool scheduled = settleUs != 0;
+  if (scheduled)
+    scheduler.SetFieldSettle(settleUs);
+  field.Sim().ResetCounters();
+
+  uint64_t end = taps[tapCount - 1].at + 5000000;
+  int last = -1;
+  int busy = 0, quiet = 0;
+  uint32_t probes = 0;
+  Result result = {};
+  while (field.Sim().GetTimeUs() < end) {
+    field.Update();
+    bool card;
+    if (scheduled) {
+      card = scheduler.Poll();
+      if (!card) {
+        field.Wait(scheduler.GetDelayUs());
+        continue;
+      }
+    } else {
+      probes++;
+      card = rfid.PICC_IsNewCardPresent();
+      if (!card) {
+        field.Wait(100000);
+        continue;
+      }
+    }
+
+    int tap = field.Present();
+    if (rfid.PICC_ReadCardSerial() && tap >= 0 && tap != last) {
+      last = tap;
+      double latency = (field.Sim().GetTimeUs() - taps[tap].at) / 1000.0;
+      if (tap > 0 && taps[tap].at - taps[tap - 1].at > QUIET_GAP_US) {
+        result.quietAverage += latency;
+        quiet++;
+        if (latency > result.quietMax)
+          result.quietMax = latency;
+      } else {
+        result.busyAverage += latency;
+        busy++;
+        if (latency > result.busyMax)
+          result.busyMax = latency;
+      }
+      result.detected++;
+    }
+    rfid.PICC_HaltA();
+    rfid.PCD_StopCrypto1();
+    if (scheduled)
+      scheduler.CardDone();
+    field.Wait(500000);
+  }
+
+  result.busyAverage /= busy;
+  result.quietAverage /= quiet;
+  result.fieldPercent = 100.0 *
+                        MFRC522Sim::CyclesToUs(field.Sim().GetFieldOnCycles()) /
+                        end;
+  result.probes = scheduled ? scheduler.GetProbeCount() : probes;
+  if (scheduled) {
+    // The scheduler's own bookkeeping agrees with the chip.
+    double own = 100.0 * scheduler.GetFieldOnUs() / end;
+    CHECK(own > result.fieldPercent - 1 && own < result.fieldPercent + 1);
+  }
+  return result;
+}
+
+void Print(const char *name, const Result &result) {
+  printf("  %-18s busy %5.1f / %5.1f ms, quiet %5.1f / %5.1f ms, field on "
+         "%5.1f%%, %5u probes, %d of %d taps\n",
+         name, result.busyAverage, result.busyMax, result.quietAverage,
+         result.quietMax, result.fieldPercent, result.probes, result.detected,
+         tapCount);
+}
+
+// PCD_Init leaves the antenna on; the first Poll probes at once instead of
+// switching it on again and waiting out the guard time.
+void FirstPoll() {
+  MFRC522Sim sim(4000000);
+  MFRC522 rfid(&sim);
+  MFRC522PollScheduler scheduler(rfid);
+  uint8_t uid[4] = {1, 2, 3, 4};
+  MifareClassicSim card(uid);
+  sim.AddCard(&card);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  CHECK(sim.IsFieldOn());
+  CHECK(scheduler.Poll());
+  CHECK(scheduler.GetProbeCount() == 1);
+
+  // Without a card the field goes off after the probe.
+  rfid.PICC_HaltA();
+  sim.RemoveCard(&card);
+  MFRC522PollScheduler idle(rfid);
+  CHECK(!idle.Poll() && idle.GetProbeCount() == 1);
+  CHECK(!idle.IsActive() && !sim.IsFieldOn());
+}
+
+} // namespace
+
+int main() {
+  FirstPoll();
+  MakeTraffic();
+  printf("%d taps over %.0f s, detect latency average / max\n", tapCount,
+         taps[tapCount - 1].at / 1e6);
+  Result fixed = Run(0);
+  Print("fixed 100 ms", fixed);
+  Result guard = Run(MFRC522PollScheduler::DEFAULT_FIELD_SETTLE_US);
+  Print("scheduler, 5.1 ms", guard);
+  Result short_ = Run(1500);
+  Print("scheduler, 1.5 ms", short_);
+
+  CHECK(fixed.detected == tapCount && guard.detected == tapCount &&
+        short_.detected == tapCount);
+  CHECK(guard.busyAverage < fixed.busyAverage);
+  CHECK(guard.fieldPercent < fixed.fieldPercent);
+  return CheckResult();
+}
@@ -0,0 +1,113 @@
+// MFRC522PresenceTracker over 40 dwell periods of 1-3 s with 4 and 7 byte
+// UIDs, a second card in the field in every fourth: checks per second, the
+// cost of one check against WUPA with full anticollision, and how long after
+// the card leaves the removal is reported.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522PresenceTracker.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+namespace {
+
+typedef MFRC522PresenceTracker Tracker;
+
+const int ROUNDS = 40;
+
+} // namespace
+
+int main() {
+  MFRC522Sim sim(4000000);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  uint8_t uid4[4] = {1, 2, 3, 4};
+  uint8_t uid7[7] = {0x04, 5, 6, 7, 8, 9, 10};
+  uint8_t uidOther[4] = {9, 9, 9, 9};
+  MifareClassicSim card4(uid4, 4), card7(uid7, 7), other(uidOther, 4);
+  Tracker tracker(rfid);
+
+  uint32_t random = 7;
+  uint32_t checks = 0, check4 = 0, check7 = 0;
+  uint64_t dwell = 0;
+  double latencySum = 0, latencyMax = 0;
+  int removals = 0;
+  for (int round = 0; round < ROUNDS; round++) {
+    MifareClassicSim *card = round & 1 ? &card7 : &card4;
+    bool second = round % 4 == 0;
+    sim.AddCard(card);
+    sim.DelayUs(5000);
+    CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+    CHECK(tracker.Track(rfid.uid) == Tracker::EVENT_ARRIVED);
+    CHECK(tracker.Track(rfid.uid) == Tracker::EVENT_NONE);
+    rfid.PICC_HaltA();
+    rfid.PCD_StopCrypto1();
+    if (second)
+      sim.AddCard(&other);
+
+    random = random * 1103515245 + 12345;
+    uint64_t start = sim.GetTimeUs();
+    uint64_t leave = start + 1000000 + (random >> 8) % 2000000;
+    uint64_t removedAt = 0;
+    uint32_t checksBefore = tracker.GetCheckCount();
+    while (true) {
+      uint64_t now = sim.GetTimeUs();
+      if (!removedAt && now >= leave) {
+        sim.RemoveCard(card);
+        if (second)
+          sim.RemoveCard(&other);
+        removedAt = now;
+      }
+      Tracker::Event event = tracker.Poll();
+      if (event == Tracker::EVENT_REMOVED)
+        break;
+      // Anything else while the card is still there is a false removal.
+      CHECK(event == Tracker::EVENT_NONE);
+      if (!removedAt && tracker.GetCheckCount() > checksBefore)
+        (round & 1 ? check7 : check4) = tracker.GetLastCheckUs();
+      uint32_t delay = tracker.GetDelayUs();
+      now = sim.GetTimeUs();
+      if (!removedAt && now + delay > leave)
+        delay = now < leave ? leave - now : 0;
+      sim.DelayUs(delay ? delay : 1);
+    }
+    CHECK(removedAt != 0);
+    double latency = (sim.GetTimeUs() - removedAt) / 1000.0;
+    latencySum += latency;
+    if (latency > latencyMax)
+      latencyMax = latency;
+    checks += tracker.GetCheckCount() - checksBefore;
+    dwell += removedAt - start;
+    removals++;
+  }
+  printf("Presence tracking, %d dwell periods, %.0f s in total\n", ROUNDS,
+         dwell / 1e6);
+  printf("  %u checks (%.0f per s), check %.1f ms (4 byte UID) "
+         "%.1f ms (7 byte UID)\n",
+         checks, checks / (dwell / 1e6), check4 / 1000.0, check7 / 1000.0);
+  printf("  removal reported %.1f ms after the card left on average, "
+         "%.1f ms at most\n",
+         latencySum / removals, latencyMax);
+
+  // For comparison: confirming the halted card with WUPA and anticollision.
+  sim.AddCard(&card7);
+  sim.DelayUs(5000);
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  rfid.PICC_HaltA();
+  uint64_t start = sim.GetTimeUs();
+  uint8_t atqa[2];
+  uint8_t atqaSize = sizeof(atqa);
+  CHECK(rfid.PICC_WakeupA(atqa, &atqaSize) == MFRC522::STATUS_OK &&
+        rfid.PICC_ReadCardSerial());
+  rfid.PICC_HaltA();
+  uint64_t full = sim.GetTimeUs() - start;
+  tracker.Track(rfid.uid);
+  sim.DelayUs(30000);
+  tracker.Poll();
+  CHECK(tracker.IsTracking());
+  CHECK(tracker.GetLastCheckUs() < full);
+  printf("  7 byte UID: WUPA + anticollision + HaltA %.1f ms, "
+         "tracker check %.1f ms\n",
+         full / 1000.0, tracker.GetLastCheckUs() / 1000.0);
+  return CheckResult();
+}
@@ -0,0 +1,261 @@
+// MFRC522Provisioner writing and verifying a full 1K image and a full
+// NTAG215 image, against the same work done with one driver call per
+// block, and the per-block report when a sector refuses the transport key.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Provisioner.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+#include "UltralightSim.h"
+
+#include <string.h>
+
+namespace {
+
+const MFRC522::MIFARE_Key KEY_A = {{0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5}};
+const MFRC522::MIFARE_Key KEY_B = {{0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5}};
+const MFRC522::MIFARE_Key TRANSPORT_KEY = {
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}};
+const int CARDS = 10;
+const int TAGS = 5;
+
+uint8_t image[64][16];
+
+// One block the way a caller would write it before the provisioner: the
+// WRITE command and the data frame as separate exchanges, each with its
+// CRC from the coprocessor.
+MFRC522::StatusCode WriteBlock(MFRC522 &rfid, uint8_t block,
+                               uint8_t *data) {
+  uint8_t command[2] = {MFRC522::PICC_CMD_MF_WRITE, block};
+  rfid.PCD_SetTimeout(MFRC522::TIMEOUT_MIFARE_US);
+  MFRC522::StatusCode result = rfid.PCD_MIFARE_Transceive(command, 2);
+  if (result != MFRC522::STATUS_OK)
+    return result;
+  rfid.PCD_SetTimeout(MFRC522::TIMEOUT_MIFARE_WRITE_US);
+  return rfid.PCD_MIFARE_Transceive(data, 16);
+}
+
+// Per sector: authenticate with the transport key, write and read back
+// each data block, write the trailer, and check it under the new key A.
+int WriteCardPerCall(MFRC522 &rfid) {
+  int bad = 0;
+  for (uint8_t sector = 0; sector < 16; sector++) {
+    uint8_t trailer = sector * 4 + 3;
+    MFRC522::MIFARE_Key key = TRANSPORT_KEY;
+    if (rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, trailer, &key,
+                              &rfid.uid) != MFRC522::STATUS_OK)
+      bad++;
+    for (uint8_t block = sector * 4; block <= trailer; block++) {
+      if (block == 0)
+        continue;
+      if (WriteBlock(rfid, block, image[block]) != MFRC522::STATUS_OK)
+        bad++;
+      if (block == trailer)
+        continue;
+      uint8_t buffer[18];
+      uint8_t size = sizeof(buffer);
+      if (rfid.MIFARE_Read(block, buffer, &size) != MFRC522::STATUS_OK ||
+          memcmp(buffer, image[block], 16) != 0)
+        bad++;
+    }
+    key = KEY_A;
+    if (rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, trailer, &key,
+                              &rfid.uid) != MFRC522::STATUS_OK)
+      bad++;
+    uint8_t buffer[18];
+    uint8_t size = sizeof(buffer);
+    if (rfid.MIFARE_Read(trailer, buffer, &size) != MFRC522::STATUS_OK ||
+        memcmp(buffer + 6, image[trailer] + 6, 4) != 0)
+      bad++;
+  }
+  return bad;
+}
+
+int Classic(uint32_t spiHz, bool perCall) {
+  MFRC522Sim sim(spiHz);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  if (perCall)
+    rfid.PCD_SetHardwareCRC(true);
+
+  MFRC522Provisioner provisioner(rfid);
+  for (uint8_t block = 1; block < 64; block++) {
+    if ((block & 3) == 3) {
+      provisioner.SetSectorTrailer(block / 4, KEY_A, KEY_B, 0, 0, 0, 3);
+      memcpy(image[block], KEY_A.keyByte, 6);
+      MFRC522::MIFARE_SetAccessBits(&image[block][6], 0, 0, 0, 3);
+      image[block][9] = 0x69;
+      memcpy(&image[block][10], KEY_B.keyByte, 6);
+    } else if (block == 9) {
+      MFRC522::MIFARE_MakeValueBlock(image[block], 1000, block);
+      provisioner.SetValueBlock(block, 1000);
+    } else {
+      for (uint8_t i = 0; i < 16; i++)
+        image[block][i] = block * 7 + i;
+      provisioner.SetBlock(block, image[block]);
+    }
+  }
+
+  uint64_t busy = 0;
+  int bad = 0;
+  for (int n = 0; n < CARDS; n++) {
+    uint8_t uid[4] = {0x10, 0x20, 0x30, (uint8_t)n};
+    MifareClassicSim card(uid);
+    sim.AddCard(&card);
+    sim.DelayUs(5000);
+    if (!rfid.PICC_IsNewCardPresent() || !rfid.PICC_ReadCardSerial()) {
+      bad++;
+      sim.RemoveCard(&card);
+      continue;
+    }
+    uint64_t start = sim.GetTimeUs();
+    if (perCall)
+      bad += WriteCardPerCall(rfid);
+    else if (provisioner.Provision(&rfid.uid) != MFRC522::STATUS_OK)
+      bad++;
+    busy += sim.GetTimeUs() - start;
+
+    for (uint8_t block = 1; block < 64; block++) {
+      uint8_t data[16];
+      card.ReadBlock(block, data);
+      if (memcmp(data, image[block], 16) != 0)
+        bad++;
+    }
+    rfid.PICC_HaltA();
+    rfid.PCD_StopCrypto1();
+    sim.RemoveCard(&card);
+  }
+  printf("  1K, %-11s %5u kHz SPI: %5.1f ms per card, %3.0f cards/min\n",
+         perCall ? "per call" : "provisioner", spiHz / 1000,
+         busy / 1000.0 / CARDS, 60e6 * CARDS / busy);
+  return bad;
+}
+
+int Ultralight(uint32_t spiHz, bool perCall) {
+  MFRC522Sim sim(spiHz);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+
+  MFRC522Provisioner provisioner(rfid);
+  uint8_t pages[130][4];
+  for (uint8_t page = 4; page < 130; page++) {
+    for (uint8_t i = 0; i < 4; i++)
+      pages[page][i] = page ^ (i * 0x55);
+    provisioner.SetPage(page, pages[page]);
+  }
+
+  uint64_t busy = 0;
+  int bad = 0;
+  for (int n = 0; n < TAGS; n++) {
+    uint8_t uid[7] = {0x04, 1, 2, 3, 4, 5, (uint8_t)n};
+    UltralightSim tag(uid, UltralightSim::MODEL_NTAG215);
+    sim.AddCard(&tag);
+    sim.DelayUs(5000);
+    if (!rfid.PICC_IsNewCardPresent() || !rfid.PICC_ReadCardSerial()) {
+      bad++;
+      sim.RemoveCard(&tag);
+      continue;
+    }
+    uint64_t start = sim.GetTimeUs();
+    if (perCall) {
+      for (uint8_t page = 4; page < 130; page++) {
+        if (rfid.MIFARE_UltralightWrite(page, pages[page], 4) !=
+            MFRC522::STATUS_OK)
+          bad++;
+      }
+      for (uint8_t page = 4; page < 130; page += 4) {
+        uint8_t buffer[18];
+        uint8_t size = sizeof(buffer);
+        if (rfid.MIFARE_Read(page, buffer, &size) != MFRC522::STATUS_OK)
+          bad++;
+      }
+    } else if (provisioner.Provision(&rfid.uid) != MFRC522::STATUS_OK) {
+      bad++;
+    }
+    busy += sim.GetTimeUs() - start;
+
+    for (uint8_t page = 4; page < 130; page++) {
+      uint8_t data[4];
+      tag.ReadPage(page, data);
+      if (memcmp(data, pages[page], 4) != 0)
+        bad++;
+    }
+    rfid.PICC_HaltA();
+    sim.RemoveCard(&tag);
+  }
+  printf("  NTAG215, %-11s %5u kHz SPI: %5.1f ms per tag\n",
+         perCall ? "per call" : "provisioner", spiHz / 1000,
+         busy / 1000.0 / TAGS);
+  return bad;
+}
+
+// Sector 5 already carries other keys: its blocks fail, the rest of the
+// card is written.
+void Failure() {
+  MFRC522Sim sim(4000000);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  MFRC522Provisioner provisioner(rfid);
+  for (uint8_t block = 1; block < 64; block++) {
+    if ((block & 3) == 3) {
+      provisioner.SetSectorTrailer(block / 4, KEY_A, KEY_B, 0, 0, 0, 1);
+    } else {
+      uint8_t data[16];
+      for (uint8_t i = 0; i < 16; i++)
+        data[i] = block + i;
+      provisioner.SetBlock(block, data);
+    }
+  }
+
+  uint8_t uid[4] = {1, 2, 3, 4};
+  MifareClassicSim card(uid);
+  uint8_t trailer[16];
+  memset(trailer, 0x11, sizeof(trailer));
+  trailer[6] = 0xFF;
+  trailer[7] = 0x07;
+  trailer[8] = 0x80;
+  trailer[9] = 0x69;
+  card.WriteBlock(23, trailer);
+  sim.AddCard(&card);
+  sim.DelayUs(5000);
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+
+  MFRC522::StatusCode status[256];
+  for (uint16_t i = 0; i < 256; i++)
+    status[i] = MFRC522::STATUS_OK;
+  CHECK(provisioner.Provision(&rfid.uid, status) != MFRC522::STATUS_OK);
+  for (uint8_t block = 1; block < 64; block++) {
+    if (block >= 20 && block < 24)
+      CHECK(status[block] != MFRC522::STATUS_OK);
+    else
+      CHECK(status[block] == MFRC522::STATUS_OK);
+  }
+  const MFRC522Provisioner::Stats &stats = provisioner.GetStats();
+  CHECK(stats.cards == 1 && stats.failedCards == 1 &&
+        stats.blocksFailed == 4 && stats.blocksWritten == 59);
+
+  // Block 0 holds the UID, and an image is Classic or Ultralight.
+  CHECK(!provisioner.SetBlock(0, trailer));
+  CHECK(!provisioner.SetPage(4, trailer));
+}
+
+} // namespace
+
+int main() {
+  printf("Write and verify, IRQ line connected\n");
+  const uint32_t speeds[] = {1000000, 4000000};
+  for (uint32_t hz : speeds) {
+    CHECK(Classic(hz, true) == 0);
+    CHECK(Classic(hz, false) == 0);
+  }
+  for (uint32_t hz : speeds) {
+    CHECK(Ultralight(hz, true) == 0);
+    CHECK(Ultralight(hz, false) == 0);
+  }
+  Failure();
+  return CheckResult();
+}
@@ -0,0 +1,208 @@
+// MFRC522Purse debit latency, and tears injected at every frame of a debit:
+// whatever happens, the card keeps a valid value block holding the old or
+// the new balance.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Purse.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+const MFRC522::MIFARE_Key TRANSPORT_KEY = {
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}};
+const uint8_t VALUE_BLOCK = 4;
+const uint8_t BACKUP_BLOCK = 5;
+const int DEBITS = 50;
+
+// Answers normally until frame budget, then tears there.
+class TearCard : public MifareClassicSim {
+public:
+  enum Mode {
+    TEAR_NONE,
+    TEAR_AFTER,  // frame processed, answer lost, card gone
+    TEAR_BEFORE, // card gone before the frame
+    TEAR_EEPROM, // frame processed, write torn, card gone
+    TEAR_ANSWER  // only the answer to the frame lost
+  };
+
+  explicit TearCard(const uint8_t *uid)
+      : MifareClassicSim(uid), _mode(TEAR_NONE), _budget(0), _count(0),
+        _torn(0) {}
+
+  void Arm(Mode mode, int budget, uint8_t tornBlock) {
+    _mode = mode;
+    _budget = budget;
+    _count = 0;
+    _torn = tornBlock;
+  }
+
+  virtual bool Receive(const Frame &request, Frame *response) {
+    if (_mode == TEAR_NONE)
+      return MifareClassicSim::Receive(request, response);
+    int frame = _count++;
+    if (frame < _budget)
+      return MifareClassicSim::Receive(request, response);
+    if (frame > _budget) {
+      return _mode == TEAR_ANSWER &&
+             MifareClassicSim::Receive(request, response);
+    }
+    if (_mode == TEAR_BEFORE)
+      return false;
+    MifareClassicSim::Receive(request, response);
+    if (_mode == TEAR_EEPROM) {
+      uint8_t data[16];
+      ReadBlock(_torn, data);
+      data[0] ^= 0x5A;
+      data[13] ^= 0x01;
+      WriteBlock(_torn, data);
+    }
+    response->bits = 0;
+    return false;
+  }
+
+private:
+  Mode _mode;
+  int _budget;
+  int _count;
+  uint8_t _torn;
+};
+
+// Takes the card out of the field and puts it back.
+bool Tap(MFRC522Sim &sim, MFRC522 &rfid, PiccSim *card) {
+  rfid.PCD_StopCrypto1();
+  sim.RemoveCard(card);
+  sim.AddCard(card);
+  sim.DelayUs(5000);
+  return rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial();
+}
+
+void Latency(uint32_t spiHz) {
+  MFRC522Sim sim(spiHz);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  uint8_t uid[4] = {9, 8, 7, 6};
+  MifareClassicSim card(uid);
+  sim.AddCard(&card);
+  sim.DelayUs(5000);
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+
+  MFRC522Purse purse(rfid);
+  CHECK(purse.Configure(VALUE_BLOCK, BACKUP_BLOCK, TRANSPORT_KEY));
+  CHECK(purse.Format(&rfid.uid, 100000) == MFRC522::STATUS_OK);
+  uint64_t total = 0;
+  int32_t balance = 0;
+  uint32_t frames = sim.GetRfFrames();
+  for (int i = 0; i < DEBITS; i++) {
+    CHECK(purse.Debit(&rfid.uid, 7, &balance) == MFRC522::STATUS_OK);
+    total += purse.GetLastTransactionUs();
+  }
+  frames = sim.GetRfFrames() - frames;
+  CHECK(balance == 100000 - 7 * DEBITS);
+  int32_t read;
+  CHECK(purse.GetBalance(&rfid.uid, &read) == MFRC522::STATUS_OK &&
+        read == balance);
+  CHECK(purse.Credit(&rfid.uid, 1000, &balance) == MFRC522::STATUS_OK &&
+        balance == 100650);
+  CHECK(purse.Debit(&rfid.uid, 200000, &balance) == MFRC522::STATUS_INVALID);
+
+  // The same backed-up debit with one value command per call.
+  MFRC522::MIFARE_Key key = TRANSPORT_KEY;
+  uint64_t start = sim.GetTimeUs();
+  for (int i = 0; i < DEBITS; i++) {
+    CHECK(rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 7, &key,
+                                &rfid.uid) == MFRC522::STATUS_OK);
+    int32_t value;
+    CHECK(rfid.MIFARE_GetValue(VALUE_BLOCK, &value) == MFRC522::STATUS_OK);
+    CHECK(rfid.MIFARE_Restore(VALUE_BLOCK) == MFRC522::STATUS_OK);
+    CHECK(rfid.MIFARE_Transfer(BACKUP_BLOCK) == MFRC522::STATUS_OK);
+    CHECK(rfid.MIFARE_Decrement(VALUE_BLOCK, 7) == MFRC522::STATUS_OK);
+    CHECK(rfid.MIFARE_Transfer(VALUE_BLOCK) == MFRC522::STATUS_OK);
+  }
+  uint64_t perCall = sim.GetTimeUs() - start;
+  int32_t value;
+  CHECK(rfid.MIFARE_GetValue(VALUE_BLOCK, &value) == MFRC522::STATUS_OK &&
+        value == 100650 - 7 * DEBITS);
+  printf("  %5u kHz SPI: debit %5.1f ms over %u RF frames, per call "
+         "%5.1f ms\n",
+         spiHz / 1000, total / 1000.0 / DEBITS, frames / DEBITS,
+         perCall / 1000.0 / DEBITS);
+}
+
+void Tears() {
+  MFRC522Sim sim(4000000);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  uint8_t uid[4] = {1, 2, 3, 4};
+  TearCard card(uid);
+  sim.AddCard(&card);
+  sim.DelayUs(5000);
+  MFRC522Purse purse(rfid);
+  CHECK(purse.Configure(VALUE_BLOCK, BACKUP_BLOCK, TRANSPORT_KEY));
+  CHECK(Tap(sim, rfid, &card));
+  CHECK(purse.Format(&rfid.uid, 1000) == MFRC522::STATUS_OK);
+
+  int32_t expected = 1000;
+  int cases = 0, committed = 0;
+  for (int mode = TearCard::TEAR_AFTER; mode <= TearCard::TEAR_ANSWER;
+       mode++) {
+    for (int frame = 0; frame < 9; frame++) {
+      // Frames 5 and 8 are the transfers to the backup and value blocks.
+      if (mode == TearCard::TEAR_EEPROM && frame != 5 && frame != 8)
+        continue;
+      CHECK(Tap(sim, rfid, &card));
+      card.Arm((TearCard::Mode)mode, frame,
+               frame == 5 ? BACKUP_BLOCK : VALUE_BLOCK);
+      int32_t balance = -1;
+      MFRC522::StatusCode result = purse.Debit(&rfid.uid, 10, &balance);
+      card.Arm(TearCard::TEAR_NONE, 0, 0);
+      if (result == MFRC522::STATUS_OK)
+        CHECK(balance == expected - 10);
+
+      CHECK(Tap(sim, rfid, &card));
+      int32_t now;
+      CHECK(purse.GetBalance(&rfid.uid, &now) == MFRC522::STATUS_OK);
+      CHECK(now == expected || now == expected - 10);
+      if (result == MFRC522::STATUS_OK)
+        CHECK(now == expected - 10);
+      uint8_t data[16];
+      int32_t stored;
+      card.ReadBlock(VALUE_BLOCK, data);
+      CHECK(MFRC522::MIFARE_ParseValueBlock(data, &stored) && stored == now);
+      if (now != expected)
+        committed++;
+      expected = now;
+      cases++;
+
+      // The purse carries on.
+      CHECK(purse.Debit(&rfid.uid, 1, &balance) == MFRC522::STATUS_OK &&
+            balance == expected - 1);
+      expected--;
+    }
+  }
+  printf("  %d tear cases: %d committed, %d left unchanged, %u backup restores\n",
+         cases, committed, cases - committed, purse.GetRecoveryCount());
+  CHECK(cases == 29);
+
+  // With both blocks destroyed there is nothing to recover.
+  uint8_t junk[16] = {1};
+  card.WriteBlock(VALUE_BLOCK, junk);
+  card.WriteBlock(BACKUP_BLOCK, junk);
+  CHECK(Tap(sim, rfid, &card));
+  int32_t balance;
+  CHECK(purse.GetBalance(&rfid.uid, &balance) == MFRC522::STATUS_ERROR);
+}
+
+} // namespace
+
+int main() {
+  printf("Backed-up debit, IRQ line connected\n");
+  const uint32_t speeds[] = {1000000, 4000000, 10000000};
+  for (uint32_t hz : speeds)
+    Latency(hz);
+  Tears();
+  return CheckResult();
+}
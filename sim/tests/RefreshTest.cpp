@@ -0,0 +1,253 @@
+// DisplayRefresh on the emWin model: main's boot, ready screen and three
+// cards at a small band budget, the app's default, and straight to the
+// panel. Bus bytes, windows and transient pixels (drawn and overwritten
+// within one update, so seen half drawn) for each, with checks that what is
+// left on the panel is exactly what a full redraw draws. Then the parts
+// taken from the display size, on a portrait panel, and a label with its
+// own background colour.
+
+#include "Check.h"
+#include "DisplayLabel.h"
+#include "DisplayRefresh.h"
+#include "EmWinSim.h"
+
+#include <stdio.h>
+
+namespace {
+
+const char *title;
+const GUI_FONT *titleFont;
+
+// main's draw function.
+void Draw(const GUI_RECT &area) {
+  GUI_SetBkColor(GUI_BLACK);
+  GUI_ClearRect(area.x0, area.y0, area.x1, area.y1);
+  if (area.y0 < GUI_GetYSizeOfFont(titleFont)) {
+    GUI_SetFont(titleFont);
+    GUI_SetColor(GUI_WHITE);
+    GUI_SetTextAlign(GUI_TA_HCENTER);
+    GUI_DispStringAt(title, LCD_GetXSize() / 2, 0);
+    GUI_SetTextAlign(GUI_TA_LEFT);
+  }
+  DisplayLabel::DrawAll(area);
+}
+
+DisplayRefresh refresh(Draw, 0);
+DisplayLabel statusLabel(refresh, "status", 0, 40, GUI_FONT_16B_1, GUI_WHITE);
+DisplayLabel uidLabel(refresh, "uid", 0, 80, GUI_FONT_16B_1, GUI_GREEN);
+DisplayLabel typeLabel(refresh, "type", 0, 100, GUI_FONT_16B_1, GUI_GREEN);
+DisplayLabel mqttLabel(refresh, "mqtt", 0, 140, GUI_FONT_13B_1, GUI_YELLOW);
+DisplayLabel countLabel(refresh, "count", 0, 180, GUI_FONT_16B_1, GUI_CYAN);
+
+// main's Display_ functions.
+void SetTitle(const char *text, const GUI_FONT *font) {
+  int height = GUI_GetYSizeOfFont(titleFont);
+  if (GUI_GetYSizeOfFont(font) > height)
+    height = GUI_GetYSizeOfFont(font);
+  title = text;
+  titleFont = font;
+  refresh.Invalidate(0, 0, LCD_GetXSize() - 1, height - 1);
+}
+
+void ShowStatus(const char *text) {
+  statusLabel.SetText(text);
+  refresh.Flush();
+}
+
+void ShowMQTT(const char *text) {
+  mqttLabel.SetText(text);
+  refresh.Flush();
+}
+
+void ShowCard(const char *uid, const char *type, unsigned count) {
+  char buffer[64];
+  sprintf(buffer, "UID: %s", uid);
+  uidLabel.SetText(buffer);
+  typeLabel.SetText(type);
+  sprintf(buffer, "Cards scanned: %u", count);
+  countLabel.SetText(buffer);
+  ShowStatus("Card detected!");
+}
+
+void Boot() {
+  GUI_Init();
+  title = "RFID Reader System";
+  titleFont = GUI_FONT_16B_1;
+  DisplayLabel::ResetAll();
+  refresh.InvalidateAll();
+  refresh.Flush();
+}
+
+void Ready() {
+  DisplayLabel::ResetAll();
+  SetTitle("RFID Reader Ready", GUI_FONT_20B_1);
+  countLabel.SetText("Cards scanned: 0");
+  ShowStatus("Waiting for card...");
+}
+
+void Status0() { ShowStatus("Initializing..."); }
+void Status1() { ShowStatus("RFID initialized"); }
+void Status2() { ShowStatus("Connecting to brackenhillc..."); }
+void Status3() { ShowStatus("WiFi connected!"); }
+void Connected() { ShowMQTT("MQTT connected!"); }
+void Card1() { ShowCard("04A1B2C3", "MIFARE 1KB", 1); }
+void Card2() { ShowCard("04A1B2D7", "MIFARE 1KB", 2); }
+void Card3() { ShowCard("7F0011223344AA", "MIFARE Ultralight", 3); }
+void Sent() { ShowMQTT("Sent to MQTT"); }
+void Waiting() { ShowStatus("Waiting for card..."); }
+
+// One update per call main makes; the card cycle is the second card with
+// the MQTT and waiting lines that follow it.
+void (*const STEPS[])() = {Boot,  Status0, Status1, Status2, Status3,
+                           Connected, Ready, Card1, Sent, Waiting,
+                           Card2, Sent, Waiting, Card3, Sent, Waiting};
+const int STEP_COUNT = sizeof(STEPS) / sizeof(STEPS[0]);
+const int CYCLE_START = 10;
+const int CYCLE_END = 13;
+
+struct Result {
+  uint32_t bytes;
+  uint32_t windows;
+  uint32_t transients;
+  uint32_t cycleBytes;
+  uint32_t cycleTransients;
+};
+
+uint64_t FullRedraw() {
+  EmWinSim::Get().SetSize(LCD_GetXSize(), LCD_GetYSize());
+  refresh.InvalidateAll();
+  refresh.Flush();
+  return EmWinSim::Get().GetChecksum();
+}
+
+Result Run(uint32_t bandBytes) {
+  EmWinSim &emWin = EmWinSim::Get();
+  Result result;
+  refresh.SetBandBytes(bandBytes);
+  emWin.SetSize(EmWinSim::DEFAULT_X_SIZE, EmWinSim::DEFAULT_Y_SIZE);
+  emWin.ResetCounters();
+  uint32_t bytes = 0, transients = 0;
+  for (int i = 0; i < STEP_COUNT; i++) {
+    if (i == CYCLE_START) {
+      bytes = emWin.GetBusBytes();
+      transients = emWin.GetTransients();
+    } else if (i == CYCLE_END) {
+      result.cycleBytes = emWin.GetBusBytes() - bytes;
+      result.cycleTransients = emWin.GetTransients() - transients;
+    }
+    emWin.BeginUpdate();
+    STEPS[i]();
+    emWin.EndUpdate();
+  }
+  result.bytes = emWin.GetBusBytes();
+  result.windows = emWin.GetWindows();
+  result.transients = emWin.GetTransients();
+  uint64_t retained = emWin.GetChecksum();
+  CHECK(retained == FullRedraw());
+  return result;
+}
+
+// The leftmost and rightmost title pixels that are not background.
+void TitleExtent(int *left, int *right) {
+  EmWinSim &emWin = EmWinSim::Get();
+  U16 black = EmWinSim::ColorToIndex(GUI_BLACK);
+  *left = LCD_GetXSize();
+  *right = -1;
+  for (int y = 0; y < GUI_GetYSizeOfFont(titleFont); y++) {
+    for (int x = 0; x < LCD_GetXSize(); x++) {
+      if (emWin.GetPixel(x, y) != black) {
+        *left = x < *left ? x : *left;
+        *right = x > *right ? x : *right;
+      }
+    }
+  }
+}
+
+// Pixels of a label's line that are neither its text nor its background.
+int Foreign(int y, int height, GUI_COLOR color, GUI_COLOR bkColor) {
+  EmWinSim &emWin = EmWinSim::Get();
+  int count = 0;
+  for (int j = y; j < y + height; j++) {
+    for (int x = 0; x < LCD_GetXSize(); x++) {
+      U16 pixel = emWin.GetPixel(x, j);
+      if (pixel != EmWinSim::ColorToIndex(color) &&
+          pixel != EmWinSim::ColorToIndex(bkColor))
+        count++;
+    }
+  }
+  return count;
+}
+
+} // namespace
+
+int main() {
+  EmWinSim &emWin = EmWinSim::Get();
+
+  const uint32_t BUDGETS[] = {2048, 10240, 0};
+  Result results[3];
+  printf("Boot, ready screen and three cards\n");
+  printf("  %-12s %8s %8s %10s %12s %10s\n", "band bytes", "bytes", "windows",
+         "transient", "card cycle", "transient");
+  for (int i = 0; i < 3; i++) {
+    results[i] = Run(BUDGETS[i]);
+    printf("  %-12u %8u %8u %10u %12u %10u\n", BUDGETS[i], results[i].bytes,
+           results[i].windows, results[i].transients, results[i].cycleBytes,
+           results[i].cycleTransients);
+  }
+  // Bands reach the panel finished; a bigger budget takes fewer windows.
+  CHECK(results[0].transients == 0 && results[1].transients == 0);
+  CHECK(results[2].transients > 0);
+  CHECK(results[1].windows < results[0].windows);
+  CHECK(results[1].bytes < results[2].bytes);
+
+  // On a portrait panel the title is centred on its width, and rectangles
+  // merge only when they waste less than one of its lines.
+  refresh.SetBandBytes(10240);
+  for (int portrait = 0; portrait < 2; portrait++) {
+    int xSize = portrait ? 240 : 320;
+    int ySize = portrait ? 320 : 240;
+    emWin.SetSize(xSize, ySize);
+    title = "RFID Reader System";
+    titleFont = GUI_FONT_16B_1;
+    refresh.InvalidateAll();
+    refresh.Flush();
+    int left, right;
+    TitleExtent(&left, &right);
+    printf("%dx%d: title at %d..%d\n", xSize, ySize, left, right);
+    CHECK(right > left);
+    CHECK(left + right - (xSize - 1) <= 4 && (xSize - 1) - (left + right) <= 4);
+
+    // Two 2 pixel strips 149 lines apart waste 298 pixels when merged.
+    uint32_t rects = refresh.GetRects();
+    refresh.Invalidate(0, 0, 1, 0);
+    refresh.Invalidate(0, 150, 1, 150);
+    refresh.Flush();
+    CHECK(refresh.GetRects() - rects == (portrait ? 2u : 1u));
+  }
+
+  // A label on a coloured background paints its whole line in it: past the
+  // end of its text, after shorter text, and when empty.
+  emWin.SetSize(EmWinSim::DEFAULT_X_SIZE, EmWinSim::DEFAULT_Y_SIZE);
+  {
+    DisplayLabel alert(refresh, "alert", 0, 200, GUI_FONT_16B_1, GUI_WHITE,
+                       GUI_BLUE);
+    int height = GUI_GetYSizeOfFont(GUI_FONT_16B_1);
+    refresh.InvalidateAll();
+    refresh.Flush();
+    CHECK(Foreign(200, height, GUI_WHITE, GUI_BLUE) == 0);
+    alert.SetText("Card removed too early");
+    refresh.Flush();
+    CHECK(Foreign(200, height, GUI_WHITE, GUI_BLUE) == 0);
+    alert.SetText("Retry");
+    refresh.Flush();
+    CHECK(Foreign(200, height, GUI_WHITE, GUI_BLUE) == 0);
+    alert.Reset();
+    refresh.SetBandBytes(0);
+    refresh.Flush();
+    CHECK(Foreign(200, height, GUI_WHITE, GUI_BLUE) == 0);
+    uint64_t retained = emWin.GetChecksum();
+    CHECK(retained == FullRedraw());
+    printf("Label on blue: line kept blue past its text and when empty\n");
+  }
+  return CheckResult();
+}
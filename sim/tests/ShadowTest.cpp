@@ -0,0 +1,149 @@
+// The register shadow: SPI bytes each PICC_IsNewCardPresent costs with the
+// shadow on and off, the hits and misses of the registers every poll
+// rewrites, and checks that no read or skipped write is served from a value
+// the chip no longer holds: after PCD_Reset, for the status bits of CollReg,
+// for StartSend in BitFramingReg, and after a multi-byte write.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+const int POLLS = 100;
+
+const uint8_t POLLED[] = {MFRC522::TxModeReg, MFRC522::RxModeReg,
+                          MFRC522::ModWidthReg, MFRC522::CollReg,
+                          MFRC522::BitFramingReg};
+const char *POLLED_NAMES[] = {"TxModeReg", "RxModeReg", "ModWidthReg",
+                              "CollReg", "BitFramingReg"};
+const int POLLED_COUNT = sizeof(POLLED) / sizeof(POLLED[0]);
+
+// Bytes per poll of an empty field, after one poll to settle the shadow.
+uint32_t PollBytes(bool shadow, uint32_t *hits, uint32_t *misses) {
+  MFRC522Sim sim;
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  rfid.PCD_SetRegisterShadow(shadow);
+  CHECK(!rfid.PICC_IsNewCardPresent());
+  rfid.PCD_ResetSpiCounters();
+  rfid.PCD_ResetShadowCounters();
+  uint32_t rfFrames = sim.GetRfFrames();
+  for (int i = 0; i < POLLS; i++)
+    CHECK(!rfid.PICC_IsNewCardPresent());
+  // Every poll still sends its REQA.
+  CHECK(sim.GetRfFrames() - rfFrames == POLLS);
+  for (int i = 0; i < POLLED_COUNT; i++) {
+    hits[i] = rfid.PCD_GetShadowHits(POLLED[i]);
+    misses[i] = rfid.PCD_GetShadowMisses(POLLED[i]);
+  }
+  return rfid.PCD_GetSpiByteCount() / POLLS;
+}
+
+void Polling() {
+  uint32_t hits[2][POLLED_COUNT], misses[2][POLLED_COUNT];
+  uint32_t off = PollBytes(false, hits[0], misses[0]);
+  uint32_t on = PollBytes(true, hits[1], misses[1]);
+  printf("SPI bytes per PICC_IsNewCardPresent, empty field\n");
+  printf("  shadow off %4u\n  shadow on  %4u\n", off, on);
+  printf("Shadow hits and misses over %d polls\n", POLLS);
+  for (int i = 0; i < POLLED_COUNT; i++) {
+    printf("  %-14s %4u hits %4u misses\n", POLLED_NAMES[i], hits[1][i],
+           misses[1][i]);
+    CHECK(hits[0][i] == 0 && misses[0][i] == 0);
+  }
+  CHECK(on < off);
+  // The mode registers are rewritten with the same value every poll, and
+  // clearing ValuesAfterColl is read and written from the shadow. The REQA
+  // framing and its StartSend write always go out.
+  for (int i = 0; i < 3; i++)
+    CHECK(hits[1][i] == POLLS && misses[1][i] == 0);
+  CHECK(hits[1][3] == 2 * POLLS && misses[1][3] == 0);
+  CHECK(hits[1][4] == 0 && misses[1][4] == 2 * POLLS);
+}
+
+// Writes a register and checks that it reached the chip, or was skipped
+// because the chip already held the value.
+void Write(MFRC522Sim &sim, MFRC522 &rfid, uint8_t reg, uint8_t value,
+           bool skipped) {
+  uint32_t frames = sim.GetSpiFrames();
+  rfid.PCD_WriteRegister(reg, value);
+  CHECK(sim.GetSpiFrames() - frames == (skipped ? 0u : 1u));
+  CHECK(sim.PeekRegister(reg) == value);
+}
+
+// Reads a register and checks it against the chip, and whether it cost a
+// frame.
+void Read(MFRC522Sim &sim, MFRC522 &rfid, uint8_t reg, bool shadowed) {
+  uint32_t frames = sim.GetSpiFrames();
+  CHECK(rfid.PCD_ReadRegister(reg) == sim.PeekRegister(reg));
+  CHECK(sim.GetSpiFrames() - frames == (shadowed ? 0u : 1u));
+}
+
+void Staleness() {
+  MFRC522Sim sim;
+  uint8_t uid1[4] = {0x11, 0x22, 0x33, 0x44};
+  uint8_t uid2[4] = {0x11, 0x22, 0x3B, 0x45};
+  MifareClassicSim card1(uid1), card2(uid2);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+
+  // PCD_Reset returns the chip to its defaults: nothing written before it
+  // is skipped after it, and reads go to the chip once.
+  Write(sim, rfid, MFRC522::TxModeReg, 0x80, false);
+  Write(sim, rfid, MFRC522::TxModeReg, 0x80, true);
+  Read(sim, rfid, MFRC522::ModeReg, true);
+  rfid.PCD_Reset();
+  CHECK(sim.PeekRegister(MFRC522::TxModeReg) != 0x80);
+  Read(sim, rfid, MFRC522::ModeReg, false);
+  Read(sim, rfid, MFRC522::ModeReg, true);
+  Write(sim, rfid, MFRC522::TxModeReg, 0x80, false);
+  rfid.PCD_Init();
+
+  // CollReg: the chip sets the collision position; reads always see it,
+  // while the ValuesAfterColl write is still skipped when unchanged.
+  sim.AddCard(&card1);
+  sim.AddCard(&card2);
+  sim.DelayUs(5000);
+  CHECK(rfid.PICC_IsNewCardPresent());
+  CHECK(rfid.PICC_ReadCardSerial());
+  uint32_t hits = rfid.PCD_GetShadowHits(MFRC522::CollReg);
+  Read(sim, rfid, MFRC522::CollReg, false);
+  Read(sim, rfid, MFRC522::CollReg, false);
+  CHECK(rfid.PCD_GetShadowHits(MFRC522::CollReg) == hits);
+  CHECK((sim.PeekRegister(MFRC522::CollReg) & 0x7F) != 0);
+  rfid.PCD_ClearRegisterBitMask(MFRC522::CollReg, 0x80);
+  CHECK(!(sim.PeekRegister(MFRC522::CollReg) & 0x80));
+
+  // BitFramingReg: after an exchange the shadow holds the StartSend write,
+  // and clearing it goes out even though the chip reads back as written.
+  Read(sim, rfid, MFRC522::BitFramingReg, false);
+  CHECK(sim.PeekRegister(MFRC522::BitFramingReg) & 0x80);
+  uint32_t frames = sim.GetSpiFrames();
+  rfid.PCD_ClearRegisterBitMask(MFRC522::BitFramingReg, 0x80);
+  CHECK(sim.GetSpiFrames() - frames == 1);
+  CHECK(!(sim.PeekRegister(MFRC522::BitFramingReg) & 0x80));
+  rfid.PCD_SetRegisterBitMask(MFRC522::BitFramingReg, 0x80);
+  CHECK(sim.PeekRegister(MFRC522::BitFramingReg) & 0x80);
+
+  // A multi-byte write leaves its last byte in the register.
+  uint8_t widths[3] = {0x10, 0x20, 0x30};
+  rfid.PCD_WriteRegister(MFRC522::ModWidthReg, sizeof(widths), widths);
+  CHECK(sim.PeekRegister(MFRC522::ModWidthReg) == 0x30);
+  Read(sim, rfid, MFRC522::ModWidthReg, true);
+  Write(sim, rfid, MFRC522::ModWidthReg, 0x30, true);
+  Write(sim, rfid, MFRC522::ModWidthReg, 0x26, false);
+  printf("Shadow matches the chip after PCD_Reset, collisions, StartSend "
+         "and multi-byte writes\n");
+}
+
+} // namespace
+
+int main() {
+  Polling();
+  Staleness();
+  return CheckResult();
+}
@@ -0,0 +1,163 @@
+// The unmodified driver against MFRC522Sim: select, authenticate, read and
+// write on each card model, with the IRQ line connected and without, and
+// the SPI and air cost of each step.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+#include "UltralightSim.h"
+
+#include <string.h>
+
+namespace {
+
+struct Cost {
+  MFRC522Sim *sim;
+  uint64_t time;
+  uint64_t air;
+  uint32_t bytes;
+
+  explicit Cost(MFRC522Sim *s) : sim(s) { Start(); }
+  void Start() {
+    time = sim->GetTimeUs();
+    air = sim->GetAirCycles();
+    bytes = sim->GetSpiBytes();
+  }
+  void Print(const char *step) {
+    printf("  %-18s %5u SPI bytes %6llu us air %6llu us total\n", step,
+           sim->GetSpiBytes() - bytes,
+           (unsigned long long)MFRC522Sim::CyclesToUs(sim->GetAirCycles() -
+                                                      air),
+           (unsigned long long)(sim->GetTimeUs() - time));
+    Start();
+  }
+};
+
+void Classic(bool irq) {
+  printf("MIFARE Classic 1K, 4-byte UID, IRQ %s, 1 MHz SPI\n",
+         irq ? "connected" : "polled");
+  MFRC522Sim sim;
+  sim.SetIrqConnected(irq);
+  uint8_t uid[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+  MifareClassicSim card(uid);
+  sim.AddCard(&card);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  CHECK(rfid.PCD_ReadRegister(MFRC522::VersionReg) == 0x92);
+  CHECK(sim.IsFieldOn());
+
+  Cost cost(&sim);
+  CHECK(rfid.PICC_IsNewCardPresent());
+  cost.Print("REQA");
+  CHECK(rfid.PICC_ReadCardSerial());
+  cost.Print("select");
+  CHECK(rfid.uid.size == 4 && memcmp(rfid.uid.uidByte, uid, 4) == 0 &&
+        rfid.uid.sak == 0x08);
+
+  MFRC522::MIFARE_Key key;
+  memset(key.keyByte, 0xFF, sizeof(key.keyByte));
+  CHECK(rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 7, &key,
+                              &rfid.uid) == MFRC522::STATUS_OK);
+  cost.Print("authenticate");
+  uint8_t buffer[18];
+  uint8_t size = sizeof(buffer);
+  CHECK(rfid.MIFARE_Read(4, buffer, &size) == MFRC522::STATUS_OK &&
+        size == 18);
+  cost.Print("read block");
+  uint8_t data[16];
+  for (uint8_t i = 0; i < sizeof(data); i++)
+    data[i] = i * 3;
+  CHECK(rfid.MIFARE_Write(5, data, 16) == MFRC522::STATUS_OK);
+  cost.Print("write block");
+  size = sizeof(buffer);
+  CHECK(rfid.MIFARE_Read(5, buffer, &size) == MFRC522::STATUS_OK &&
+        memcmp(buffer, data, 16) == 0);
+
+  // Nested authentication into sector 2, and its trailer as the card
+  // returns it: key A hidden, default access bits.
+  CHECK(rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_B, 8, &key,
+                              &rfid.uid) == MFRC522::STATUS_OK);
+  size = sizeof(buffer);
+  CHECK(rfid.MIFARE_Read(11, buffer, &size) == MFRC522::STATUS_OK &&
+        buffer[0] == 0 && buffer[6] == 0xFF && buffer[7] == 0x07);
+
+  // A block outside the authenticated sector is refused.
+  size = sizeof(buffer);
+  CHECK(rfid.MIFARE_Read(4, buffer, &size) == MFRC522::STATUS_MIFARE_NACK);
+  rfid.PCD_StopCrypto1();
+
+  // HLTA silences the card until WUPA.
+  uint8_t atqa[2];
+  size = sizeof(atqa);
+  CHECK(rfid.PICC_WakeupA(atqa, &size) == MFRC522::STATUS_OK);
+  CHECK(rfid.PICC_ReadCardSerial());
+  rfid.PICC_HaltA();
+  CHECK(card.GetState() == PiccSim::STATE_HALT);
+  CHECK(!rfid.PICC_IsNewCardPresent());
+  size = sizeof(atqa);
+  CHECK(rfid.PICC_WakeupA(atqa, &size) == MFRC522::STATUS_OK);
+  CHECK(rfid.PICC_ReadCardSerial());
+
+  // A wrong key gets no answer to the card's challenge.
+  MFRC522::MIFARE_Key wrong;
+  memset(wrong.keyByte, 0x12, sizeof(wrong.keyByte));
+  cost.Start();
+  CHECK(rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 7, &wrong,
+                              &rfid.uid) == MFRC522::STATUS_TIMEOUT);
+  cost.Print("wrong key");
+}
+
+void Ultralight() {
+  printf("NTAG213, 7-byte UID\n");
+  MFRC522Sim sim;
+  uint8_t uid[7] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+  UltralightSim tag(uid, UltralightSim::MODEL_NTAG213);
+  sim.AddCard(&tag);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+
+  Cost cost(&sim);
+  CHECK(rfid.PICC_IsNewCardPresent());
+  CHECK(rfid.PICC_ReadCardSerial());
+  cost.Print("REQA and select");
+  CHECK(rfid.uid.size == 7 && memcmp(rfid.uid.uidByte, uid, 7) == 0 &&
+        rfid.uid.sak == 0x00);
+  uint8_t buffer[18];
+  uint8_t size = sizeof(buffer);
+  CHECK(rfid.MIFARE_Read(0, buffer, &size) == MFRC522::STATUS_OK);
+  cost.Print("read 4 pages");
+  // Page 0 carries the first UID bytes, page 3 the NTAG213 capability
+  // container.
+  CHECK(buffer[0] == 0x04 && buffer[12] == 0xE1);
+}
+
+void TenByteUid() {
+  printf("ISO 14443-4 card, 10-byte UID\n");
+  MFRC522Sim sim;
+  uint8_t uid[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  PiccSim card(uid, sizeof(uid), 0x0084, 0x20);
+  sim.AddCard(&card);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+
+  Cost cost(&sim);
+  CHECK(rfid.PICC_IsNewCardPresent());
+  CHECK(rfid.PICC_ReadCardSerial());
+  cost.Print("REQA and select");
+  CHECK(rfid.uid.size == 10 && memcmp(rfid.uid.uidByte, uid, 10) == 0 &&
+        rfid.uid.sak == 0x20);
+}
+
+} // namespace
+
+int main() {
+  Classic(true);
+  Classic(false);
+  Ultralight();
+  TenByteUid();
+  return CheckResult();
+}
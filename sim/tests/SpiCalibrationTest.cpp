@@ -0,0 +1,72 @@
+// PCD_CalibrateSpiClock against wiring that corrupts reads above a given
+// SPI clock: the chosen clock, what it buys per register read and per 1K
+// card read, and the error when even the slowest clock fails.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+void Run(uint32_t limitHz, uint32_t expectedHz,
+         MFRC522::StatusCode expected) {
+  MFRC522Sim sim(1000000);
+  sim.SetSpiLimit(limitHz);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+
+  uint64_t start = sim.GetTimeUs();
+  MFRC522::StatusCode result = rfid.PCD_CalibrateSpiClock();
+  uint64_t calibration = sim.GetTimeUs() - start;
+  CHECK(result == expected);
+  CHECK(rfid.PCD_GetSpiFrequency() == expectedHz);
+  if (limitHz)
+    printf("  limit %4.1f MHz:", limitHz / 1e6);
+  else
+    printf("  no limit:      ");
+  if (result != MFRC522::STATUS_OK) {
+    printf(" no clock works, calibration %3llu ms\n",
+           (unsigned long long)calibration / 1000);
+    return;
+  }
+  CHECK(rfid.PCD_PerformSelfTest());
+
+  uint8_t uid[4] = {1, 2, 3, 4};
+  MifareClassicSim card(uid);
+  sim.AddCard(&card);
+  sim.DelayUs(5000);
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  MFRC522::MIFARE_Key key;
+  memset(key.keyByte, 0xFF, sizeof(key.keyByte));
+  static uint8_t data[1024];
+  MFRC522::StatusCode status[64];
+  start = sim.GetTimeUs();
+  CHECK(rfid.MIFARE_ReadCard(&rfid.uid, PICC_TYPE_MIFARE_1K, &key, data,
+                             status) == MFRC522::STATUS_OK);
+  uint64_t card1K = sim.GetTimeUs() - start;
+
+  start = sim.GetTimeUs();
+  for (int i = 0; i < 1000; i++)
+    rfid.PCD_ReadRegister(MFRC522::VersionReg);
+  double read = (sim.GetTimeUs() - start) / 1000.0;
+  printf(" %2u MHz, register read %4.1f us, 1K card read %3llu ms, "
+         "calibration %3llu ms\n",
+         rfid.PCD_GetSpiFrequency() / 1000000, read,
+         (unsigned long long)card1K / 1000,
+         (unsigned long long)calibration / 1000);
+}
+
+} // namespace
+
+int main() {
+  printf("SPI clock calibration from 1 MHz\n");
+  Run(0, 10000000, MFRC522::STATUS_OK);
+  Run(7000000, 6000000, MFRC522::STATUS_OK);
+  Run(3000000, 2000000, MFRC522::STATUS_OK);
+  Run(1500000, 1000000, MFRC522::STATUS_OK);
+  Run(500000, 0, MFRC522::STATUS_ERROR);
+  return CheckResult();
+}
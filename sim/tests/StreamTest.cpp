@@ -0,0 +1,86 @@
+// Frames longer than the FIFO streamed through the water level alerts:
+// 4 KB of READ BINARY and a 255-byte UPDATE BINARY at every bit rate and
+// several SPI clocks, with no underrun or overrun, and a bus too slow for
+// the air that fails with an error instead of bad data.
+
+#include "Check.h"
+#include "IsoDepSim.h"
+#include "MFRC522.h"
+#include "MFRC522IsoDep.h"
+#include "MFRC522Sim.h"
+
+#include <string.h>
+
+namespace {
+
+// Returns the number of failed transfers; *faults receives the FIFO
+// underruns and overruns.
+int Run(uint32_t spiHz, bool irq, uint8_t rate, uint32_t *faults) {
+  MFRC522Sim sim(spiHz);
+  sim.SetIrqConnected(irq);
+  uint8_t uid[7] = {0x04, 1, 2, 3, 4, 5, 6};
+  IsoDepSim card(uid);
+  sim.AddCard(&card);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  if (!rfid.PICC_IsNewCardPresent() || !rfid.PICC_ReadCardSerial())
+    return -1;
+  MFRC522IsoDep isoDep(rfid);
+  if (isoDep.Activate(0, (MFRC522IsoDep::BitRate)rate) != MFRC522::STATUS_OK)
+    return -1;
+
+  sim.ResetCounters();
+  uint8_t response[300];
+  uint16_t length;
+  int failed = 0;
+  uint64_t start = sim.GetTimeUs();
+  for (uint16_t offset = 0; offset < 4096; offset += 256) {
+    uint8_t read[] = {0x00, 0xB0, (uint8_t)(offset >> 8), (uint8_t)offset,
+                      0x00};
+    length = sizeof(response);
+    if (isoDep.Transceive(read, sizeof(read), response, &length) !=
+            MFRC522::STATUS_OK ||
+        length != 258 || memcmp(response, card.GetFile() + offset, 256) != 0)
+      failed++;
+  }
+  uint64_t elapsed = sim.GetTimeUs() - start;
+
+  // One 255-byte I-block.
+  uint8_t update[255] = {0x00, 0xD6, 0x02, 0x00, 250};
+  for (uint8_t i = 0; i < 250; i++)
+    update[5 + i] = i ^ 0x3C;
+  length = sizeof(response);
+  if (isoDep.Transceive(update, sizeof(update), response, &length) !=
+          MFRC522::STATUS_OK ||
+      length != 2 || memcmp(card.GetFile() + 512, update + 5, 250) != 0)
+    failed++;
+
+  *faults = sim.GetUnderruns() + sim.GetOverruns();
+  printf("  %5u kHz %-6s %3u kbit/s: 4096 bytes in %5.1f ms, %u underruns, "
+         "%u overruns, %u retries, %d failed\n",
+         spiHz / 1000, irq ? "IRQ" : "polled", 106 << rate, elapsed / 1000.0,
+         sim.GetUnderruns(), sim.GetOverruns(), isoDep.GetRetryCount(),
+         failed);
+  return failed;
+}
+
+} // namespace
+
+int main() {
+  printf("READ BINARY Le 256 and UPDATE BINARY of 250 bytes\n");
+  const uint32_t speeds[] = {1000000, 4000000, 10000000};
+  for (uint8_t rate = 0; rate < 4; rate++) {
+    for (uint32_t hz : speeds) {
+      for (uint8_t irq = 0; irq < 2; irq++) {
+        uint32_t faults;
+        CHECK(Run(hz, irq, rate, &faults) == 0 && faults == 0);
+      }
+    }
+  }
+
+  // At 250 kHz the bus cannot keep up with 848 kbit/s.
+  uint32_t faults;
+  CHECK(Run(250000, true, 3, &faults) > 0 && faults > 0);
+  return CheckResult();
+}
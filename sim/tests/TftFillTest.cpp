@@ -0,0 +1,129 @@
+// Rectangle fills and bitmap blits through one ST7789 address window:
+// port operations per pixel against a window per line and the line through
+// DisplayIntf_WriteM8_A1, as the generic FlexColor path sends them, and a
+// decode check of the commands and pixels the panel receives.
+
+#include "Check.h"
+#include "TftBusSim.h"
+#include "cy8ckit_028_tft.h"
+
+namespace {
+
+uint32_t Ops() {
+  TftBusSim &bus = TftBusSim::Get();
+  return bus.GetWrites() + bus.GetReads();
+}
+
+void WriteAddress(U8 command, int start, int end) {
+  U8 data[4] = {(U8)(start >> 8), (U8)start, (U8)(end >> 8), (U8)end};
+  DisplayIntf_Write8_A0(command);
+  DisplayIntf_WriteM8_A1(data, sizeof(data));
+}
+
+void FillPerLine(int x0, int y0, int x1, int y1, U16 pixel) {
+  static U8 line[640];
+  int width = x1 - x0 + 1;
+  for (int i = 0; i < width; i++) {
+    line[2 * i] = pixel >> 8;
+    line[2 * i + 1] = pixel & 0xFF;
+  }
+  for (int y = y0; y <= y1; y++) {
+    WriteAddress(0x2A, x0, x1);
+    WriteAddress(0x2B, y, y);
+    DisplayIntf_Write8_A0(0x2C);
+    DisplayIntf_WriteM8_A1(line, 2 * width);
+  }
+}
+
+// CASET x0..x1, RASET y0..y1 and RAMWR, as commands and data.
+void CheckWindow(int x0, int y0, int x1, int y1) {
+  TftBusSim &bus = TftBusSim::Get();
+  const U8 expected[11] = {0x2A, (U8)(x0 >> 8), (U8)x0, (U8)(x1 >> 8),
+                           (U8)x1, 0x2B, (U8)(y0 >> 8), (U8)y0,
+                           (U8)(y1 >> 8), (U8)y1, 0x2C};
+  for (int i = 0; i < 11; i++) {
+    bool command = i == 0 || i == 5 || i == 10;
+    CHECK(bus.GetByte(i).value == expected[i] &&
+          bus.GetByte(i).dc == !command);
+  }
+}
+
+void CheckDecode() {
+  static U16 bitmap[40 * 32];
+  for (int i = 0; i < 40 * 32; i++)
+    bitmap[i] = i * 0x0841;
+  TftBusSim &bus = TftBusSim::Get();
+
+  bus.Reset();
+  DisplayIntf_FillRect(300, 200, 309, 203, 0xABCD);
+  CHECK(bus.GetByteCount() == 11 + 80);
+  CheckWindow(300, 200, 309, 203);
+  for (int i = 0; i < 80; i++)
+    CHECK(bus.GetByte(11 + i).value == (i & 1 ? 0xCD : 0xAB) &&
+          bus.GetByte(11 + i).dc);
+
+  bus.Reset();
+  DisplayIntf_FillRect(0, 0, 2, 0, 0x4242);
+  CHECK(bus.GetByteCount() == 11 + 6);
+  for (int i = 0; i < 6; i++)
+    CHECK(bus.GetByte(11 + i).value == 0x42);
+
+  // An empty rectangle sends nothing.
+  bus.Reset();
+  DisplayIntf_FillRect(5, 5, 4, 5, 0x1234);
+  CHECK(bus.GetByteCount() == 0);
+
+  // Rows bytesPerLine apart, high byte first.
+  bus.Reset();
+  DisplayIntf_DrawBitmap16(1, 2, 3, 2, bitmap, 40 * 2);
+  CHECK(bus.GetByteCount() == 11 + 12);
+  CheckWindow(1, 2, 3, 3);
+  for (int row = 0; row < 2; row++) {
+    for (int i = 0; i < 3; i++) {
+      U16 pixel = bitmap[row * 40 + i];
+      int at = 11 + (row * 3 + i) * 2;
+      CHECK(bus.GetByte(at).value == pixel >> 8 &&
+            bus.GetByte(at + 1).value == (pixel & 0xFF));
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  struct {
+    const char *name;
+    int width, height;
+    U16 pixel;
+  } fills[] = {
+      {"clear black", 320, 240, 0x0000},
+      {"clear blue", 320, 240, 0x001F},
+      {"clear grey", 320, 240, 0x8410},
+      {"16x16 colour", 16, 16, 0x1F3A},
+      {"4x4 colour", 4, 4, 0x1F3A},
+  };
+  printf("Port operations per pixel\n");
+  printf("  %-14s %9s %7s\n", "", "per line", "window");
+  for (auto &fill : fills) {
+    int pixels = fill.width * fill.height;
+    uint32_t start = Ops();
+    FillPerLine(0, 0, fill.width - 1, fill.height - 1, fill.pixel);
+    double perLine = (double)(Ops() - start) / pixels;
+    start = Ops();
+    DisplayIntf_FillRect(0, 0, fill.width - 1, fill.height - 1, fill.pixel);
+    double window = (double)(Ops() - start) / pixels;
+    printf("  %-14s %9.2f %7.2f\n", fill.name, perLine, window);
+    CHECK(window <= perLine);
+  }
+
+  static U16 bitmap[32 * 40];
+  for (int i = 0; i < 32 * 40; i++)
+    bitmap[i] = i * 0x0841;
+  uint32_t start = Ops();
+  DisplayIntf_DrawBitmap16(10, 10, 32, 32, bitmap, 40 * 2);
+  printf("  %-14s %9s %7.2f\n", "32x32 blit", "",
+         (double)(Ops() - start) / (32 * 32));
+
+  CheckDecode();
+  return CheckResult();
+}
@@ -0,0 +1,89 @@
+// Reading from the CY8CKIT-028-TFT data bus: port operations per byte for
+// bursts of 1 to 480 bytes, against the pin by pin DigitalInOut reads the
+// driver used before, and a check that random bursts come back intact.
+
+#include "Check.h"
+#include "TftBusSim.h"
+#include "cy8ckit_028_tft.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Port accesses plus the pin direction changes, which are mbed calls too.
+uint32_t Ops() {
+  TftBusSim &bus = TftBusSim::Get();
+  return bus.GetWrites() + bus.GetReads() +
+         DigitalInOut::DirectionChanges();
+}
+
+// The pin the old driver read for each data bit, as a port and a bit.
+const uint8_t PIN_PORT[8] = {9, 9, 9, 9, 9, 0, 13, 13};
+const uint8_t PIN_BIT[8] = {0, 1, 2, 4, 5, 2, 0, 1};
+
+// The driver before whole-port reads: DC through DigitalOut, then per byte
+// all eight pins to input, an NRD pulse around eight single pin reads and
+// all eight pins back to output. Each call is one port operation.
+void LegacyRead(U8 *data, int num) {
+  TftBusSim &bus = TftBusSim::Get();
+  bus.Set(12, 0x02);
+  for (int i = 0; i < num; i++) {
+    DigitalInOut::DirectionChanges() += 8;
+    bus.Clear(12, 0x08);
+    data[i] = 0;
+    for (int bit = 0; bit < 8; bit++)
+      data[i] |= ((bus.Read(PIN_PORT[bit]) >> PIN_BIT[bit]) & 1) << bit;
+    bus.Set(12, 0x08);
+    DigitalInOut::DirectionChanges() += 8;
+  }
+}
+
+void CheckBursts() {
+  TftBusSim &bus = TftBusSim::Get();
+  U8 source[300], legacy[300], read[300];
+  for (int round = 0; round < 100; round++) {
+    int num = 1 + rand() % 300;
+    for (int i = 0; i < num; i++)
+      source[i] = rand();
+    bus.SetReadData(source, num);
+    LegacyRead(legacy, num);
+    bus.SetReadData(source, num);
+    DisplayIntf_ReadM8_A1(read, num);
+    CHECK(memcmp(read, source, num) == 0);
+    CHECK(memcmp(legacy, source, num) == 0);
+    CHECK(bus.GetReadPulses() == (uint32_t)num);
+    bus.SetReadData(source, 1);
+    CHECK(DisplayIntf_Read8_A1() == source[0]);
+
+    // Writes after a read burst still put the right bytes on the bus.
+    DisplayIntf_Write8_A1(0x5A);
+    U8 write[3] = {0x12, 0x5A, 0xFF};
+    bus.Reset();
+    DisplayIntf_WriteM8_A1(write, 3);
+    CHECK(bus.GetByteCount() == 3);
+    for (int i = 0; i < 3; i++)
+      CHECK(bus.GetByte(i).value == write[i]);
+  }
+}
+
+} // namespace
+
+int main() {
+  static U8 buffer[480];
+  printf("Bus reads, port operations per byte\n");
+  printf("  burst   before   after\n");
+  const int bursts[] = {1, 2, 6, 480};
+  for (int num : bursts) {
+    uint32_t start = Ops();
+    LegacyRead(buffer, num);
+    double before = (double)(Ops() - start) / num;
+    start = Ops();
+    DisplayIntf_ReadM8_A1(buffer, num);
+    double after = (double)(Ops() - start) / num;
+    printf("  %5d %8.2f %7.2f\n", num, before, after);
+    CHECK(after < before);
+  }
+  CheckBursts();
+  return CheckResult();
+}
@@ -0,0 +1,110 @@
+// Writing to the CY8CKIT-028-TFT data bus: port operations per pixel for a
+// full 240x320 frame sent line by line as emWin does, against the mbed
+// PortInOut read-modify-write the driver used before, and a decode check of
+// random command and data sequences.
+
+#include "Check.h"
+#include "TftBusSim.h"
+#include "cy8ckit_028_tft.h"
+
+#include <stdlib.h>
+
+namespace {
+
+const int WIDTH = 240;
+const int HEIGHT = 320;
+
+// The driver before the port registers: DC through DigitalOut, then per byte
+// a read and a write of P9, P0 and P13 through PortInOut and an NWR pulse
+// through DigitalOut. Each call is one port operation; the PortInOut writes
+// are modelled as one invert that leaves the port at the merged value.
+void LegacyPort(TftBusSim &bus, uint8_t port, uint32_t mask, uint32_t bits) {
+  uint32_t value = (bus.Read(port) & ~mask) | bits;
+  bus.Invert(port, bus.GetPort(port) ^ value);
+}
+
+void LegacyWrite(bool dc, const U8 *data, int num) {
+  TftBusSim &bus = TftBusSim::Get();
+  if (dc)
+    bus.Set(12, 0x02);
+  else
+    bus.Clear(12, 0x02);
+  for (int i = 0; i < num; i++) {
+    LegacyPort(bus, 9, 0x37, (data[i] & 0x07) | ((data[i] & 0x18) << 1));
+    LegacyPort(bus, 0, 0x04, (data[i] & 0x20) >> 3);
+    LegacyPort(bus, 13, 0x03, (data[i] & 0xC0) >> 6);
+    bus.Clear(12, 0x01);
+    bus.Set(12, 0x01);
+  }
+}
+
+uint32_t Ops() {
+  TftBusSim &bus = TftBusSim::Get();
+  return bus.GetWrites() + bus.GetReads();
+}
+
+enum Content { BLACK, COLOUR, IMAGE };
+
+double Frame(Content content, bool legacy) {
+  static U8 line[2 * WIDTH];
+  const U8 command = 0x2C;
+  uint32_t start = Ops();
+  srand(1);
+  if (legacy)
+    LegacyWrite(false, &command, 1);
+  else
+    DisplayIntf_Write8_A0(command);
+  for (int y = 0; y < HEIGHT; y++) {
+    for (int x = 0; x < WIDTH; x++) {
+      U16 pixel = content == BLACK ? 0x0000 : content == COLOUR ? 0x1F3A : rand();
+      line[2 * x] = pixel >> 8;
+      line[2 * x + 1] = pixel & 0xFF;
+    }
+    if (legacy)
+      LegacyWrite(true, line, sizeof(line));
+    else
+      DisplayIntf_WriteM8_A1(line, sizeof(line));
+  }
+  return (double)(Ops() - start) / (WIDTH * HEIGHT);
+}
+
+void CheckDecode() {
+  TftBusSim &bus = TftBusSim::Get();
+  U8 data[37];
+  for (int round = 0; round < 200; round++) {
+    bus.Reset();
+    int num = rand() % 37;
+    for (int i = 0; i < num; i++)
+      data[i] = rand();
+    U8 command = rand();
+    U8 single = rand();
+    DisplayIntf_Write8_A0(command);
+    DisplayIntf_WriteM8_A1(data, num);
+    DisplayIntf_Write8_A1(single);
+
+    CHECK(bus.GetByteCount() == (uint32_t)num + 2);
+    CHECK(bus.GetByte(0).value == command && !bus.GetByte(0).dc);
+    for (int i = 0; i < num; i++)
+      CHECK(bus.GetByte(i + 1).value == data[i] && bus.GetByte(i + 1).dc);
+    CHECK(bus.GetByte(num + 1).value == single && bus.GetByte(num + 1).dc);
+    // No port bits outside the data bus are touched.
+    CHECK((bus.GetPort(9) & ~0x37u) == 0 && (bus.GetPort(0) & ~0x04u) == 0 &&
+          (bus.GetPort(13) & ~0x03u) == 0);
+  }
+}
+
+} // namespace
+
+int main() {
+  printf("240x320 frame, port operations per pixel\n");
+  printf("                 before   after\n");
+  const char *names[] = {"black", "one colour", "random image"};
+  for (int content = BLACK; content <= IMAGE; content++) {
+    double before = Frame((Content)content, true);
+    double after = Frame((Content)content, false);
+    printf("  %-12s %8.2f %7.2f\n", names[content], before, after);
+    CHECK(after < before);
+  }
+  CheckDecode();
+  return CheckResult();
+}
@@ -0,0 +1,67 @@
+// Chip timer budgets and the host clock backstop at several SPI clocks,
+// with the IRQ line and without: every budget expires on time.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+const uint32_t BUDGETS_US[] = {500, 3000, 20000, 100000, 2000000};
+
+void Run(uint32_t spiHz, bool irq) {
+  MFRC522Sim sim(spiHz);
+  sim.SetIrqConnected(irq);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+
+  uint64_t start = sim.GetTimeUs();
+  CHECK(!rfid.PICC_IsNewCardPresent());
+  printf("  %5u kHz %-6s empty REQA %5llu us;", spiHz / 1000,
+         irq ? "IRQ" : "polled",
+         (unsigned long long)(sim.GetTimeUs() - start));
+
+  for (uint32_t budget : BUDGETS_US) {
+    rfid.PCD_SetTimeout(budget);
+    uint8_t command = MFRC522::PICC_CMD_REQA;
+    uint8_t back[2];
+    uint8_t length = sizeof(back);
+    uint8_t validBits = 7;
+    start = sim.GetTimeUs();
+    CHECK(rfid.PCD_TransceiveData(&command, 1, back, &length, &validBits) ==
+          MFRC522::STATUS_TIMEOUT);
+    uint64_t elapsed = sim.GetTimeUs() - start;
+    // The REQA frame is about 90 us on air; the rest is SPI traffic.
+    CHECK(elapsed >= budget && elapsed < budget + 300 + 320000000ULL / spiHz);
+    printf(" %u->%llu", budget, (unsigned long long)elapsed);
+  }
+
+  uint8_t uid[4] = {1, 2, 3, 4};
+  MifareClassicSim card(uid);
+  sim.AddCard(&card);
+  sim.DelayUs(5000);
+  CHECK(rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial());
+  MFRC522::MIFARE_Key wrong;
+  memset(wrong.keyByte, 0x12, sizeof(wrong.keyByte));
+  start = sim.GetTimeUs();
+  CHECK(rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 4, &wrong,
+                              &rfid.uid) == MFRC522::STATUS_TIMEOUT);
+  printf("; wrong key %llu us\n",
+         (unsigned long long)(sim.GetTimeUs() - start));
+}
+
+} // namespace
+
+int main() {
+  printf("Budget -> time to STATUS_TIMEOUT, in us\n");
+  const uint32_t speeds[] = {250000, 1000000, 4000000, 10000000};
+  for (uint32_t hz : speeds) {
+    Run(hz, false);
+    Run(hz, true);
+  }
+  return CheckResult();
+}
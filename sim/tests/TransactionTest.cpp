@@ -0,0 +1,154 @@
+// Batched register access: how reads and writes are grouped into CS frames,
+// the asynchronous path and its failures, and the frames each card operation
+// costs.
+
+#include "Check.h"
+#include "MFRC522.h"
+#include "MFRC522Sim.h"
+#include "MifareClassicSim.h"
+
+#include <string.h>
+
+namespace {
+
+void Frames() {
+  MFRC522Sim sim;
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  rfid.PCD_SetRegisterShadow(false);
+
+  // Reads of different registers share one frame; each write needs its own.
+  MFRC522::Transaction transaction;
+  uint8_t version = 0, mode = 0, level = 0;
+  CHECK(transaction.Read(MFRC522::VersionReg, &version));
+  CHECK(transaction.Read(MFRC522::ModeReg, &mode));
+  CHECK(transaction.Read(MFRC522::FIFOLevelReg, &level));
+  CHECK(transaction.GetFrameCount() == 1);
+  CHECK(transaction.Write(MFRC522::TModeReg, 0x80));
+  CHECK(transaction.Write(MFRC522::TPrescalerReg, 0xA9));
+  CHECK(transaction.GetFrameCount() == 3);
+
+  uint32_t frames = sim.GetSpiFrames();
+  rfid.PCD_ExecuteTransaction(&transaction);
+  CHECK(sim.GetSpiFrames() - frames == 3);
+  CHECK(version == 0x92 && mode == sim.PeekRegister(MFRC522::ModeReg));
+  CHECK(sim.PeekRegister(MFRC522::TPrescalerReg) == 0xA9);
+
+  // The same frames through the asynchronous path.
+  transaction.Clear();
+  version = 0;
+  CHECK(transaction.Read(MFRC522::VersionReg, &version));
+  CHECK(transaction.Write(MFRC522::TPrescalerReg, 0x3E));
+  bool done = false;
+  CHECK(rfid.PCD_ExecuteTransactionAsync(
+            &transaction, [&](MFRC522::StatusCode status) {
+              done = status == MFRC522::STATUS_OK;
+            }) == MFRC522::STATUS_OK);
+  CHECK(done && version == 0x92);
+  CHECK(sim.PeekRegister(MFRC522::TPrescalerReg) == 0x3E);
+}
+
+// A frame that never reached the chip leaves no value in the register shadow,
+// so writing that value again goes out. Frames that went out before the
+// failure keep theirs.
+void AsyncFailures() {
+  MFRC522Sim sim;
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  uint8_t mode = sim.PeekRegister(MFRC522::TModeReg);
+  MFRC522::StatusCode status = MFRC522::STATUS_OK;
+  auto done = [&](MFRC522::StatusCode result) { status = result; };
+
+  // TransferAsync refused, as on targets without DEVICE_SPI_ASYNCH.
+  sim.SetAsyncFailure(MFRC522Sim::ASYNC_REFUSED);
+  MFRC522::Transaction transaction;
+  CHECK(transaction.Write(MFRC522::TModeReg, mode ^ 0x0F));
+  CHECK(rfid.PCD_ExecuteTransactionAsync(&transaction, done) ==
+        MFRC522::STATUS_OK);
+  CHECK(status == MFRC522::STATUS_ERROR && !rfid.PCD_IsTransactionPending());
+  CHECK(sim.PeekRegister(MFRC522::TModeReg) == mode);
+  sim.SetAsyncFailure(MFRC522Sim::ASYNC_OK);
+  uint32_t hits = rfid.PCD_GetShadowHits(MFRC522::TModeReg);
+  rfid.PCD_WriteRegister(MFRC522::TModeReg, mode ^ 0x0F);
+  CHECK(rfid.PCD_GetShadowHits(MFRC522::TModeReg) == hits);
+  CHECK(sim.PeekRegister(MFRC522::TModeReg) == (mode ^ 0x0F));
+
+  // The second frame completes with an error.
+  sim.SetAsyncFailure(MFRC522Sim::ASYNC_ABORTED, 1);
+  transaction.Clear();
+  CHECK(transaction.Write(MFRC522::TPrescalerReg, 0x11));
+  CHECK(transaction.Write(MFRC522::TReloadRegL, 0x22));
+  status = MFRC522::STATUS_OK;
+  CHECK(rfid.PCD_ExecuteTransactionAsync(&transaction, done) ==
+        MFRC522::STATUS_OK);
+  CHECK(status == MFRC522::STATUS_ERROR);
+  CHECK(sim.PeekRegister(MFRC522::TPrescalerReg) == 0x11);
+  CHECK(sim.PeekRegister(MFRC522::TReloadRegL) != 0x22);
+  sim.SetAsyncFailure(MFRC522Sim::ASYNC_OK);
+  uint32_t prescalerHits = rfid.PCD_GetShadowHits(MFRC522::TPrescalerReg);
+  uint32_t reloadHits = rfid.PCD_GetShadowHits(MFRC522::TReloadRegL);
+  rfid.PCD_WriteRegister(MFRC522::TPrescalerReg, 0x11);
+  rfid.PCD_WriteRegister(MFRC522::TReloadRegL, 0x22);
+  CHECK(rfid.PCD_GetShadowHits(MFRC522::TPrescalerReg) == prescalerHits + 1);
+  CHECK(rfid.PCD_GetShadowHits(MFRC522::TReloadRegL) == reloadHits);
+  CHECK(sim.PeekRegister(MFRC522::TReloadRegL) == 0x22);
+}
+
+void Operations() {
+  MFRC522Sim sim;
+  uint8_t uid[4] = {0x10, 0x20, 0x30, 0x40};
+  MifareClassicSim classic(uid);
+  sim.AddCard(&classic);
+  MFRC522 rfid(&sim);
+  rfid.PCD_Init();
+  sim.DelayUs(5000);
+  rfid.PCD_ResetSpiCounters();
+  sim.ResetCounters();
+
+  printf("CS frames and SPI bytes per operation, IRQ line connected\n");
+  uint32_t frames = 0, bytes = 0;
+  MFRC522::MIFARE_Key key;
+  memset(key.keyByte, 0xFF, sizeof(key.keyByte));
+  uint8_t buffer[18];
+  for (int step = 0; step < 4; step++) {
+    const char *name = "";
+    uint8_t size = sizeof(buffer);
+    switch (step) {
+    case 0:
+      name = "REQA";
+      CHECK(rfid.PICC_IsNewCardPresent());
+      break;
+    case 1:
+      name = "select";
+      CHECK(rfid.PICC_ReadCardSerial());
+      break;
+    case 2:
+      name = "authenticate";
+      CHECK(rfid.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 4, &key,
+                                  &rfid.uid) == MFRC522::STATUS_OK);
+      break;
+    case 3:
+      name = "read block";
+      CHECK(rfid.MIFARE_Read(4, buffer, &size) == MFRC522::STATUS_OK);
+      break;
+    }
+    printf("  %-14s %3u frames %4u bytes\n", name,
+           rfid.PCD_GetSpiFrameCount() - frames,
+           rfid.PCD_GetSpiByteCount() - bytes);
+    frames = rfid.PCD_GetSpiFrameCount();
+    bytes = rfid.PCD_GetSpiByteCount();
+  }
+
+  // The driver's own counters agree with what crossed the bus.
+  CHECK(rfid.PCD_GetSpiFrameCount() == sim.GetSpiFrames());
+  CHECK(rfid.PCD_GetSpiByteCount() == sim.GetSpiBytes());
+}
+
+} // namespace
+
+int main() {
+  Frames();
+  AsyncFailures();
+  Operations();
+  return CheckResult();
+}
@@ -26,9 +26,9 @@
 
 
 #include "cy8ckit_028_tft.h"
+#include "cy8ckit_028_tft_port.h"
 #include <mbed_wait_api.h>
 #include "mbed.h"
-#include "PortInOut.h"
 
 
 DigitalInOut LCD_REG0(P9_0);
@@ -39,15 +39,118 @@ DigitalInOut LCD_REG4(P9_5);
 DigitalInOut LCD_REG5(P0_2);
 DigitalInOut LCD_REG6(P13_0);
 DigitalInOut LCD_REG7(P13_1);
-PortInOut P0(Port0, 0x04);
-PortInOut P9(Port9, 0x37);
-PortInOut P13(Port13, 0x03);
 
 DigitalOut LCD_NWR(P12_0);
 DigitalOut LCD_DC(P12_1);
 DigitalOut LCD_RESET(P12_2);
 DigitalOut LCD_NRD(P12_3);
 
+/* Port bits that carry each data byte, one entry per value. The mapping only
+ * moves bits, so the entry for (a ^ b) holds the bits that differ between a
+ * and b.
+ */
+typedef struct
+{
+    uint8_t p9;
+    uint8_t p0;
+    uint8_t p13;
+} BusPattern;
+
+struct BusPatternTable
+{
+    BusPattern entry[256];
+
+    constexpr BusPatternTable() : entry()
+    {
+        for (int data = 0; data < 256; data++)
+        {
+            entry[data].p9 = (data & 0x07) | ((data & 0x18) << 1);
+            entry[data].p0 = (data & 0x20) >> 3;
+            entry[data].p13 = (data & 0xc0) >> 6;
+        }
+    }
+};
+
+static constexpr BusPatternTable busPatterns;
+
+/* Data bits 4-0 for every value of the P9 data pins, the reverse of the P9
+ * column above. P0 and P13 only need a shift.
+ */
+struct BusBitsTable
+{
+    U8 p9[LCD_DATA_P9_MASK + 1];
+
+    constexpr BusBitsTable() : p9()
+    {
+        for (int in = 0; in <= (int)LCD_DATA_P9_MASK; in++)
+        {
+            p9[in] = (in & 0x07) | ((in & 0x30) >> 1);
+        }
+    }
+};
+
+static constexpr BusBitsTable busBits;
+
+/* The byte the data bus drives now */
+static U8 busByte = 0u;
+
+
+/*******************************************************************************
+* Function Name: DataStrobe
+****************************************************************************/
+/**
+*
+* \brief
+*   Sends low pulse to the LCD_NWR line; the display latches the data bus on
+*   the rising edge.
+*
+* \details
+*   Two peripheral bus writes per cycle already exceed the 66 ns minimum write
+*   cycle of the ST7789.
+*
+*******************************************************************************/
+static inline void DataStrobe(void)
+{
+    TFT_PORT_CLR(12, LCD_NWR_MASK);
+    TFT_PORT_SET(12, LCD_NWR_MASK);
+}
+
+
+/*******************************************************************************
+* Function Name: DataToggle
+****************************************************************************/
+/**
+*
+* \brief
+*   Changes the data bus from one byte to the next and writes it.
+*
+* \details
+*   Only the bits that differ are inverted, and a port is not touched at all
+*   when none of its bits change, so a run of equal bytes costs only the
+*   LCD_NWR pulses.
+*
+*******************************************************************************/
+static inline U8 DataToggle(U8 last, U8 data)
+{
+    const BusPattern &diff = busPatterns.entry[last ^ data];
+
+    if (diff.p9 != 0u)
+    {
+        TFT_PORT_INV(9, diff.p9);
+    }
+    if (diff.p0 != 0u)
+    {
+        TFT_PORT_INV(0, diff.p0);
+    }
+    if (diff.p13 != 0u)
+    {
+        TFT_PORT_INV(13, diff.p13);
+    }
+    DataStrobe();
+    return data;
+}
+
+
 /*******************************************************************************
 * Function Name: DataWrite
 ****************************************************************************/
@@ -58,77 +161,197 @@ DigitalOut LCD_NRD(P12_3);
 *
 * \details
 *   This function:
-*       - Writes data to the data bus
+*       - Sets and clears the data bus bits from the pattern table, which
+*         leaves the other pins of P9, P0 and P13 alone without reading the
+*         ports
 *       - Sends low pulse to the LCD_NWR line to write data
 *
-*   Changed from individual bit banging to port masked writes to 
-*   P9[5,4,2,1,0], P13[1,0], P0[2] to optimise slightly 
-* 
-* \todo
-*   All this should be replaced with a udb register to save all the shifting
-*   and individual bit writing.
-*
 *******************************************************************************/
 void DataWrite(U8 data)
 {
-//    LCD_REG0 = (data & 0x01);
-//    LCD_REG1 = ((data>>1) & 0x01);
-//    LCD_REG2 = ((data>>2) & 0x01);
-//    LCD_REG3 = ((data>>3) & 0x01);
-//    LCD_REG4 = ((data>>4) & 0x01);
-
-/* read the appropriate port and only change the bits we need to then write the
- * affected bits back to the port retaining any unaffected bit values
- */
-    int pbyte = P9.read();
-    int bit012 = (data & 0x07);
-    int bit34 = (data & 0x18) << 1;
-    pbyte = (pbyte & 0xc8) | bit34 | bit012;
-    P9.write(pbyte);
-//    LCD_REG5 = ((data>>5) & 0x01);
-    pbyte = P0.read();
-    int bit5 = (data & 0x20) >> 3 ;
-    pbyte = (pbyte & 0xfb) | bit5 ;
-    P0.write(pbyte);
-
-//    LCD_REG6 = ((data>>6) & 0x01);
-//    LCD_REG7 = ((data>>7) & 0x01);
-    pbyte = P13.read();
-    int bit67 = (data & 0xc0) >> 6 ;
-    pbyte = (pbyte & 0xfc) | bit67 ;
-    P13.write(pbyte);
-    LCD_NWR = 0u;
-    LCD_NWR = 1u;
+    const BusPattern &pattern = busPatterns.entry[data];
+
+    TFT_PORT_SET(9, pattern.p9);
+    TFT_PORT_CLR(9, pattern.p9 ^ LCD_DATA_P9_MASK);
+    TFT_PORT_SET(0, pattern.p0);
+    TFT_PORT_CLR(0, pattern.p0 ^ LCD_DATA_P0_MASK);
+    TFT_PORT_SET(13, pattern.p13);
+    TFT_PORT_CLR(13, pattern.p13 ^ LCD_DATA_P13_MASK);
+    DataStrobe();
+    busByte = data;
+}
+
+
+/*******************************************************************************
+* Function Name: DataWriteBurst
+****************************************************************************/
+/**
+*
+* \brief
+*   Writes multiple bytes of data to the software i8080 interface.
+*
+* \details
+*   Every byte is toggled from the one before it, four bytes per loop pass.
+*   DataWrite has set busByte, so the bus state is known on entry.
+*
+*******************************************************************************/
+static void DataWriteBurst(const U8 data[], int num)
+{
+    U8 last = busByte;
+    int i = 0;
 
+    for(; i + 4 <= num; i += 4)
+    {
+        last = DataToggle(last, data[i]);
+        last = DataToggle(last, data[i + 1]);
+        last = DataToggle(last, data[i + 2]);
+        last = DataToggle(last, data[i + 3]);
+    }
+    for(; i < num; i++)
+    {
+        last = DataToggle(last, data[i]);
+    }
+    busByte = last;
 }
 
 
 /*******************************************************************************
-* Function Name: DataRead
-****************************************************************************//**
+* Function Name: DataWriteRepeat
+****************************************************************************/
+/**
 *
 * \brief
-*   Reads one byte of data from the software i8080 interface.
+*   Writes one RGB565 pixel value count times to the software i8080 interface.
 *
 * \details
-*   This function:
-*       - Changes data bus GPIO pins drive mode to digital Hi-Z with enabled input 
-*         buffer
-*       - Sends low pulse to LCD_NRD line to read data
-*       - Reads data from the data bus
-*       - Sends low pulse to the LCD_NWR line to write data
-*       - Changes data bus GPIO pins drive mode back to to Strong Drive mode
-* 
-* \todo
-*   All this should be replaced with a udb register to save all the shifting
-*   and individual bit reading.
+*   After the first pixel every byte inverts the same data bus bits, those of
+*   (hi ^ lo), so the loop reuses one pattern and touches only the ports that
+*   change. A grey level with equal bytes costs only the LCD_NWR pulses.
 *
 *******************************************************************************/
-U8 DataRead(void)
+static void DataWriteRepeat(U8 hi, U8 lo, uint32_t count)
 {
-    U8 data = 0u;
+    if (count == 0u)
+    {
+        return;
+    }
+
+    DataToggle(DataToggle(busByte, hi), lo);
+    count--;
+
+    const BusPattern &diff = busPatterns.entry[hi ^ lo];
+    uint32_t bytes = count * 2u;
+
+    if (hi == lo)
+    {
+        for(; bytes >= 4u; bytes -= 4u)
+        {
+            DataStrobe();
+            DataStrobe();
+            DataStrobe();
+            DataStrobe();
+        }
+        for(; bytes > 0u; bytes--)
+        {
+            DataStrobe();
+        }
+    }
+    else
+    {
+        for(; bytes > 0u; bytes--)
+        {
+            if (diff.p9 != 0u)
+            {
+                TFT_PORT_INV(9, diff.p9);
+            }
+            if (diff.p0 != 0u)
+            {
+                TFT_PORT_INV(0, diff.p0);
+            }
+            if (diff.p13 != 0u)
+            {
+                TFT_PORT_INV(13, diff.p13);
+            }
+            DataStrobe();
+        }
+    }
+    busByte = lo;
+}
 
-    /* enable input */
+
+/*******************************************************************************
+* Function Name: DataWritePixels
+****************************************************************************/
+/**
+*
+* \brief
+*   Writes RGB565 pixels from memory, high byte first, two pixels per loop
+*   pass.
+*
+*******************************************************************************/
+static void DataWritePixels(const U16 pixels[], int num)
+{
+    U8 last = busByte;
+    int i = 0;
+
+    for(; i + 2 <= num; i += 2)
+    {
+        last = DataToggle(last, (U8)(pixels[i] >> 8));
+        last = DataToggle(last, (U8)pixels[i]);
+        last = DataToggle(last, (U8)(pixels[i + 1] >> 8));
+        last = DataToggle(last, (U8)pixels[i + 1]);
+    }
+    if (i < num)
+    {
+        last = DataToggle(last, (U8)(pixels[i] >> 8));
+        last = DataToggle(last, (U8)pixels[i]);
+    }
+    busByte = last;
+}
+
+
+/*******************************************************************************
+* Function Name: WriteWindow
+****************************************************************************/
+/**
+*
+* \brief
+*   Sets the ST7789 column and row address window and starts a memory write.
+*
+* \details
+*   LCDConf sets MADCTL to match the emWin orientation, so the controller
+*   takes logical coordinates: CASET takes x and RASET takes y.
+*   Pixels written after RAMWR fill the window row by row.
+*
+*******************************************************************************/
+static void WriteWindow(int x0, int y0, int x1, int y1)
+{
+    DisplayIntf_Write8_A0(0x2A);    /* CASET: column address set */
+    DisplayIntf_Write8_A1((U8)(x0 >> 8));
+    DisplayIntf_Write8_A1((U8)x0);
+    DisplayIntf_Write8_A1((U8)(x1 >> 8));
+    DisplayIntf_Write8_A1((U8)x1);
+    DisplayIntf_Write8_A0(0x2B);    /* RASET: row address set */
+    DisplayIntf_Write8_A1((U8)(y0 >> 8));
+    DisplayIntf_Write8_A1((U8)y0);
+    DisplayIntf_Write8_A1((U8)(y1 >> 8));
+    DisplayIntf_Write8_A1((U8)y1);
+    DisplayIntf_Write8_A0(0x2C);    /* RAMWR: memory write */
+    TFT_PORT_SET(12, LCD_DC_MASK);
+}
+
+
+/*******************************************************************************
+* Function Name: DataReadBegin
+****************************************************************************//**
+*
+* \brief
+*   Changes data bus GPIO pins drive mode to digital Hi-Z with enabled input 
+*   buffer, once for a whole burst of reads.
+*
+*******************************************************************************/
+static void DataReadBegin(void)
+{
     LCD_REG0.input();
     LCD_REG1.input();
     LCD_REG2.input();
@@ -137,20 +360,20 @@ U8 DataRead(void)
     LCD_REG5.input();
     LCD_REG6.input();
     LCD_REG7.input();
+}
 
-    LCD_NRD = 0u;  //  Pulse read line low then read the data port
-    
-    data = (U8)LCD_REG0.read();
-    data |= (U8)LCD_REG1.read()<<1;
-    data |= (U8)LCD_REG2.read()<<2;
-    data |= (U8)LCD_REG3.read()<<3;
-    data |= (U8)LCD_REG4.read()<<4;
-    data |= (U8)LCD_REG5.read()<<5;
-    data |= (U8)LCD_REG6.read()<<6;
-    data |= (U8)LCD_REG7.read()<<7;
-    
-    LCD_NRD = 1u;  // Raise the read line and then go back to output port
-       
+
+/*******************************************************************************
+* Function Name: DataReadEnd
+****************************************************************************//**
+*
+* \brief
+*   Changes data bus GPIO pins drive mode back to Strong Drive mode. The output
+*   registers were not touched, so the bus drives busByte again.
+*
+*******************************************************************************/
+static void DataReadEnd(void)
+{
     LCD_REG0.output();
     LCD_REG1.output();
     LCD_REG2.output();
@@ -159,6 +382,60 @@ U8 DataRead(void)
     LCD_REG5.output();
     LCD_REG6.output();
     LCD_REG7.output();
+}
+
+
+/*******************************************************************************
+* Function Name: DataReadByte
+****************************************************************************//**
+*
+* \brief
+*   Reads one byte from the data bus, which must be in input mode.
+*
+* \details
+*   This function:
+*       - Sends low pulse to LCD_NRD line, held for the ST7789 frame memory
+*         read access time
+*       - Reads the three data ports whole and reassembles the byte, with the
+*         P9 bits through a lookup table
+*
+*******************************************************************************/
+static inline U8 DataReadByte(void)
+{
+    TFT_PORT_CLR(12, LCD_NRD_MASK);
+    wait_ns(LCD_NRD_LOW_NS);
+    uint32_t in9 = TFT_PORT_READ(9);
+    uint32_t in0 = TFT_PORT_READ(0);
+    uint32_t in13 = TFT_PORT_READ(13);
+    TFT_PORT_SET(12, LCD_NRD_MASK);
+
+    return busBits.p9[in9 & LCD_DATA_P9_MASK] |
+           (U8)((in0 & LCD_DATA_P0_MASK) << 3) |
+           (U8)((in13 & LCD_DATA_P13_MASK) << 6);
+}
+
+
+/*******************************************************************************
+* Function Name: DataRead
+****************************************************************************//**
+*
+* \brief
+*   Reads one byte of data from the software i8080 interface.
+*
+* \details
+*   This function:
+*       - Changes the data bus to input
+*       - Reads one byte with DataReadByte
+*       - Changes the data bus back to output
+*
+*******************************************************************************/
+U8 DataRead(void)
+{
+    U8 data;
+
+    DataReadBegin();
+    data = DataReadByte();
+    DataReadEnd();
 
     return data;
 }
@@ -292,7 +569,7 @@ void DisplayIntf_Init(void)
 *******************************************************************************/
 void DisplayIntf_Write8_A0(U8 data)
 {
-    LCD_DC = 0u;
+    TFT_PORT_CLR(12, LCD_DC_MASK);
     DataWrite(data);
 }
 
@@ -313,7 +590,7 @@ void DisplayIntf_Write8_A0(U8 data)
 *******************************************************************************/
 void DisplayIntf_Write8_A1(U8 data)
 {
-    LCD_DC = 1u;
+    TFT_PORT_SET(12, LCD_DC_MASK);
     DataWrite(data);
 }
 
@@ -328,19 +605,70 @@ void DisplayIntf_Write8_A1(U8 data)
 *
 * \details
 *   This function:
-*       - Sets LCD_DC pin to 1
-*       - Writes data bytes
+*       - Sets LCD_DC pin to 1 once for the whole block
+*       - Streams the data bytes with DataWriteBurst
 *
 *******************************************************************************/
 void DisplayIntf_WriteM8_A1(U8 data[], int num)
 {
-    int i = 0;
+    TFT_PORT_SET(12, LCD_DC_MASK);
+    DataWriteBurst(data, num);
+}
 
-    LCD_DC = 1u;
 
-    for(i = 0; i < num; i++)
+/*******************************************************************************
+* Function Name: DisplayIntf_FillRect
+****************************************************************************//**
+*
+* \brief
+*   Fills a rectangle with one RGB565 pixel value.
+*
+* \details
+*   This function:
+*       - Sets the address window to the rectangle, once
+*       - Streams the pixel value for the whole area with DataWriteRepeat
+*
+*******************************************************************************/
+void DisplayIntf_FillRect(int x0, int y0, int x1, int y1, U16 pixel)
+{
+    if ((x1 < x0) || (y1 < y0))
+    {
+        return;
+    }
+
+    WriteWindow(x0, y0, x1, y1);
+    DataWriteRepeat((U8)(pixel >> 8), (U8)pixel,
+                    (uint32_t)(x1 - x0 + 1) * (uint32_t)(y1 - y0 + 1));
+}
+
+
+/*******************************************************************************
+* Function Name: DisplayIntf_DrawBitmap16
+****************************************************************************//**
+*
+* \brief
+*   Copies an RGB565 bitmap to the display.
+*
+* \details
+*   This function:
+*       - Sets the address window to the bitmap, once
+*       - Streams the pixels row by row, bytesPerLine apart in memory
+*
+*******************************************************************************/
+void DisplayIntf_DrawBitmap16(int x, int y, int xSize, int ySize, const U16 pixels[], int bytesPerLine)
+{
+    int row = 0;
+
+    if ((xSize <= 0) || (ySize <= 0))
+    {
+        return;
+    }
+
+    WriteWindow(x, y, x + xSize - 1, y + ySize - 1);
+    for(row = 0; row < ySize; row++)
     {
-        DataWrite(data[i]);
+        DataWritePixels(pixels, xSize);
+        pixels = (const U16 *)((const U8 *)pixels + bytesPerLine);
     }
 }
 
@@ -361,7 +689,7 @@ void DisplayIntf_WriteM8_A1(U8 data[], int num)
 *******************************************************************************/
 U8 DisplayIntf_Read8_A1(void)
 {
-    LCD_DC = 1u;
+    TFT_PORT_SET(12, LCD_DC_MASK);
     return DataRead();
 }
 
@@ -377,19 +705,24 @@ U8 DisplayIntf_Read8_A1(void)
 * \details
 *   This function:
 *       - Sets LCD_DC pin to 1
-*       - Reads data bytes
+*       - Changes the data bus to input once for the whole block
+*       - Reads data bytes, keeping LCD_NRD high for the read cycle time
+*         between them
 *
 *******************************************************************************/
 void DisplayIntf_ReadM8_A1(U8 data[], int num)
 {
     int i = 0;
 
-    LCD_DC = 1u;
+    TFT_PORT_SET(12, LCD_DC_MASK);
 
+    DataReadBegin();
     for(i = 0; i < num; i++)
     {
-        data[i] = DataRead();
+        data[i] = DataReadByte();
+        wait_ns(LCD_NRD_HIGH_NS);
     }
+    DataReadEnd();
 }
 
 
@@ -85,6 +85,8 @@ void DisplayIntf_Write8_A1(U8 data);
 void DisplayIntf_WriteM8_A1(U8 data[], int num);
 U8 DisplayIntf_Read8_A1(void);
 void DisplayIntf_ReadM8_A1(U8 data[], int num);
+void DisplayIntf_FillRect(int x0, int y0, int x1, int y1, U16 pixel);
+void DisplayIntf_DrawBitmap16(int x, int y, int xSize, int ySize, const U16 pixels[], int bytesPerLine);
 
 #endif
 
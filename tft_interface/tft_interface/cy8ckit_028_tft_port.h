@@ -0,0 +1,50 @@
+/***************************************************************************//**
+* \file cy8ckit_028_tft_port.h
+* \version 1.0
+*
+* \brief
+* Objective:
+*    Port register access for the software i8080 interface.
+*
+* \details
+*   The data bus is spread over P9[5,4,2,1,0], P0[2] and P13[1,0]; NWR, DC
+*   and NRD are P12[0], P12[1] and P12[3]. The PSoC 6 OUT_SET, OUT_CLR and
+*   OUT_INV registers change only the bits written to them, so the bus is
+*   driven without reading the ports back, and IN reads a whole port at once.
+*   On a host the same macros go to sim/TftBusSim.h, which counts every
+*   access.
+*
+*******************************************************************************/
+
+#ifndef DISPLAYINTERFACEPORT_H
+#define DISPLAYINTERFACEPORT_H
+
+#if defined(TARGET_PSOC6)
+
+#include "cy_gpio.h"
+
+#define TFT_PORT_SET(port, mask)    (GPIO_PRT##port->OUT_SET = (mask))
+#define TFT_PORT_CLR(port, mask)    (GPIO_PRT##port->OUT_CLR = (mask))
+#define TFT_PORT_INV(port, mask)    (GPIO_PRT##port->OUT_INV = (mask))
+#define TFT_PORT_READ(port)         (GPIO_PRT##port->IN)
+
+#else
+
+#include "TftBusSim.h"
+
+#endif
+
+#define LCD_DATA_P9_MASK    (0x37u)     /* data bits 4, 3, 2, 1, 0 */
+#define LCD_DATA_P0_MASK    (0x04u)     /* data bit 5 */
+#define LCD_DATA_P13_MASK   (0x03u)     /* data bits 7, 6 */
+#define LCD_NWR_MASK        (0x01u)     /* P12[0] */
+#define LCD_DC_MASK         (0x02u)     /* P12[1] */
+#define LCD_NRD_MASK        (0x08u)     /* P12[3] */
+
+/* ST7789 frame memory read: RDX low for at least 355 ns, and a 450 ns cycle */
+#define LCD_NRD_LOW_NS      (360)
+#define LCD_NRD_HIGH_NS     (90)
+
+#endif
+
+/* [] END OF FILE */